@@ -1,16 +1,40 @@
 #version 420
 
-layout(binding = 1) uniform sampler2D tx;
+// arrays and atlases alike, entry is picked by texture coordinates
+layout(binding = 1) uniform sampler2DArray tx;
 
 layout(location = 0) in vec3 fragColor;
-layout(location = 1) in vec2 fragTexCoord;
+layout(location = 1) in vec3 fragTexCoord;
+layout(location = 3) in vec3 fragWorldPos;
 
 layout(location = 0) out vec4 outColor;
 
+// AShaderVariant, unused features are compiled out
+layout(constant_id = 0) const bool useTexture = true;
+layout(constant_id = 1) const bool useVertexColor = false;
+layout(constant_id = 2) const bool alphaTest = true;
+layout(constant_id = 3) const uint lightingModel = 0u; // ALightingModel
+const uint LIGHTING_NONE = 0u;
+const uint LIGHTING_HALF_LAMBERT = 2u;
+const vec3 lightDir = normalize(vec3(.3, .5, 1.));
+const float ambient = .2;
+
+float lighting() {
+    // faces are flat, so normals come from derivatives instead of vertex data
+    vec3 normal = normalize(cross(dFdx(fragWorldPos), dFdy(fragWorldPos)));
+    // two-sided, winding of faces does not matter
+    float cosine = abs(dot(normal, lightDir));
+    if (lightingModel == LIGHTING_HALF_LAMBERT) cosine = pow(cosine * .5 + .5, 2.);
+    return ambient + (1. - ambient) * cosine;
+}
+
 void main() {
-    vec4 txColor = texture(tx, fragTexCoord);
-    if (txColor.a < 0.1) discard;
-    outColor = txColor;
-    // outColor = vec4(fragColor, 1.);
-    // outColor = vec4(fragTexCoord, 0., 1.);
+    // before discard, derivatives are undefined past it
+    float light = lightingModel == LIGHTING_NONE ? 1. : lighting();
+    vec4 color = vec4(1.);
+    if (useTexture) color = texture(tx, fragTexCoord);
+    if (alphaTest && color.a < 0.1) discard;
+    if (useVertexColor) color.rgb *= fragColor;
+    color.rgb *= light;
+    outColor = color;
 }
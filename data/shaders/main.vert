@@ -1,19 +1,38 @@
 #version 420
-layout(binding = 0) uniform Transform {
-    mat4 model;
+// per frame, dynamic offset
+layout(binding = 0) uniform Camera {
     mat4 view;
     mat4 proj;
-} mvp;
+} camera;
+
+// per draw, dynamic offset, animated
+layout(binding = 2) uniform Object {
+    mat4 model;
+} object;
+
+// per draw, ADrawConstants, recorded into the command buffer
+layout(push_constant) uniform Texture {
+    vec4 uvRect; // texture entry: offset xy, scale zw
+    uint layer;  // texture entry: array layer
+    // bindless only, slots of ABindlessTable
+    uint imageSlot;
+    uint samplerSlot;
+} tex;
 
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec2 inTexCoord;
 
 layout(location = 0) out vec3 fragColor;
-layout(location = 1) out vec2 fragTexCoord;
+layout(location = 1) out vec3 fragTexCoord;
+layout(location = 2) flat out uvec2 fragTexture;
+layout(location = 3) out vec3 fragWorldPos; // for lighting variants
 
 void main() {
-    gl_Position = mvp.proj * mvp.view * mvp.model * vec4(inPosition, 1.);
+    vec4 worldPos = object.model * vec4(inPosition, 1.);
+    gl_Position = camera.proj * camera.view * worldPos;
+    fragWorldPos = worldPos.xyz;
     fragColor = inColor;
-    fragTexCoord = inTexCoord;
+    fragTexCoord = vec3(tex.uvRect.xy + inTexCoord * tex.uvRect.zw, tex.layer);
+    fragTexture = uvec2(tex.imageSlot, tex.samplerSlot);
 }
@@ -0,0 +1,99 @@
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+
+#include "memstats.h"
+#include "vulkan/vulkan.h"
+
+// default size of one VkDeviceMemory block
+#define A_DEFAULT_BLOCK_SIZE (64ull * 1024 * 1024)
+
+/*
+ * Resources of different kinds placed next to each other
+ * must respect bufferImageGranularity
+ */
+typedef enum AAllocationKind {
+    A_ALLOCATION_FREE = 0,
+    A_ALLOCATION_LINEAR,  // buffers and linear images
+    A_ALLOCATION_OPTIMAL, // optimal images
+} AAllocationKind;
+
+typedef struct ASuballocation {
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    AAllocationKind kind;
+} ASuballocation;
+
+typedef struct AMemoryBlock {
+    struct AMemoryBlock *next;
+    VkDeviceMemory memory;
+    VkDeviceSize size;
+    VkDeviceSize used;
+    uint32_t memoryTypeIndex;
+    VkBool32 dedicated; // holds exactly one allocation
+    void *mapped;       // whole block, NULL if not host visible
+    // sorted by offset, covers whole block
+    // neighbouring free ranges are always merged
+    uint32_t rangeCount;
+    uint32_t rangeCapacity;
+    ASuballocation *ranges;
+} AMemoryBlock;
+
+typedef struct AAllocation {
+    VkDeviceMemory memory;
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    uint32_t memoryTypeIndex;
+    void *mapped; // points at offset, NULL if not host visible
+    AMemoryBlock *block;
+} AAllocation;
+
+typedef struct AAllocator {
+    VkDevice device;
+    VkPhysicalDevice pdevice;
+    VkDeviceSize blockSize;
+    VkDeviceSize bufferImageGranularity;
+    uint32_t maxAllocationCount;
+    uint32_t allocationCount; // vkAllocateMemory calls alive
+    AMemoryBlock *blocks[VK_MAX_MEMORY_TYPES];
+    AMemoryStats stats;
+} AAllocator;
+
+/*
+ * returns AAllocator on success
+ * NULL on failure
+ * blockSize = 0 means A_DEFAULT_BLOCK_SIZE
+ */
+AAllocator *AAllocator_create(
+    VkInstance instance, VkDevice device, VkPhysicalDevice pdevice, VkDeviceSize blockSize);
+
+/*
+ * Frees all blocks, allocations made from them become invalid
+ */
+void AAllocator_destroy(AAllocator *allocator);
+
+/*
+ * 0 on success, valid allocation in out_allocation
+ * 1 if no suitable memory type
+ * 2 if device memory allocation failed
+ * Host visible blocks are mapped persistently
+ */
+int AAllocator_alloc(
+    AAllocator *allocator, VkMemoryRequirements memReqs, VkMemoryPropertyFlags properties,
+    AAllocationKind kind, AAllocation *out_allocation);
+
+/*
+ * Same as AAllocator_alloc, but only places allocation into existing shared blocks
+ *  other than source that are used at least as much as source
+ * 3 if no such block has room
+ * Used to evacuate sparse blocks
+ */
+int AAllocator_alloc_elsewhere(
+    AAllocator *allocator, VkMemoryRequirements memReqs, VkMemoryPropertyFlags properties,
+    AAllocationKind kind, AMemoryBlock const *source, AAllocation *out_allocation);
+
+/*
+ * Empty allocation (.memory == NULL) is ok
+ */
+void AAllocator_free(AAllocator *allocator, AAllocation allocation);
+
+#endif
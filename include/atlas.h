@@ -0,0 +1,55 @@
+#ifndef ATLAS_H
+#define ATLAS_H
+
+#include "image.h"
+#include "vulkan/vulkan.h"
+
+// same size textures fewer than this go to atlas instead of their own array
+#define A_ARRAY_MIN_LAYERS 2
+// guaranteed maxImageArrayLayers
+#define A_ARRAY_MAX_LAYERS 256
+// entries stay apart in levels [0, A_ATLAS_MIP_LEVELS)
+#define A_ATLAS_MIP_LEVELS 3
+// gutter around atlas entries, one texel of it is left in the last level
+#define A_ATLAS_PADDING (1u << (A_ATLAS_MIP_LEVELS - 1))
+#define A_ATLAS_MAX_SIZE 4096
+
+typedef struct ARect {
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+} ARect;
+
+/*
+ * Shelf packer: tallest first, left to right, new shelf when row is full
+ * Writes position of each size into out_rects in order of sizes
+ * 0 on success
+ * 1 if sizes do not fit into width x height
+ */
+int pack_rects(
+    VkExtent2D const *sizes, uint32_t count, uint32_t width, uint32_t height, ARect *out_rects);
+
+/*
+ * Copies textures of equal size, format and staged levels into layers of out_array
+ * Layer i is textures[i]
+ * 0 on success
+ * 1 if textures differ or out of memory
+ */
+int pack_texture_array(
+    ADecodedTexture const *const *textures, uint32_t count, ADecodedTexture *out_array);
+
+/*
+ * Places level 0 of A_TEXTURE_IMAGE_FORMAT textures into one square single layer texture
+ * Entries are padded with their edge texels, so neither filtering
+ *  nor first A_ATLAS_MIP_LEVELS levels mix neighbours
+ * Levels are generated on CPU unless blitMips
+ * Texel rect of textures[i] is written into out_rects[i]
+ * 0 on success
+ * 1 if textures do not fit into A_ATLAS_MAX_SIZE or out of memory
+ */
+int pack_texture_atlas(
+    ADecodedTexture const *const *textures, uint32_t count, VkBool32 blitMips,
+    ADecodedTexture *out_atlas, ARect *out_rects);
+
+#endif
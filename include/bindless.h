@@ -0,0 +1,78 @@
+#ifndef BINDLESS_H
+#define BINDLESS_H
+
+#include "vulkan/vulkan.h"
+
+// far below update after bind limits of any device with descriptor indexing
+#define A_BINDLESS_IMAGE_SLOTS 4096
+// same as samplers[] in main_bindless.frag
+#define A_BINDLESS_SAMPLER_SLOTS 16
+// set of the table in pipeline layouts, set 0 holds per frame uniforms
+#define A_BINDLESS_SET 1
+#define A_BINDLESS_NONE UINT32_MAX
+
+/*
+ * Sampled images and samplers addressed by slot from shaders,
+ *  so draws with different textures share one bound set.
+ * Bindings are partially bound and update after bind, the latter lifts
+ *  per stage descriptor limits of regular pools.
+ * Holds one set per frame in flight. Slots change on CPU only and each set
+ *  catches up in ABindlessTable_update once its frame is done,
+ *  so sets read by pending frames are never written.
+ * Image slots keep pointers to views, views replaced by the defragmenter
+ *  or the streamer are picked up the same way.
+ */
+typedef struct ABindlessTable {
+    VkDevice device;
+    VkDescriptorSetLayout layout;
+    VkDescriptorPool pool;
+    uint32_t setCount;
+    VkDescriptorSet *sets;     // count = setCount
+    VkImageView const **views; // count = A_BINDLESS_IMAGE_SLOTS, NULL if slot is free
+    VkImageView *written;      // [set * A_BINDLESS_IMAGE_SLOTS + slot], NULL if never written
+    uint32_t imageCount;       // slots ever handed out
+    uint32_t freeCount;
+    uint32_t *freeSlots; // released below imageCount, reused first
+    uint32_t samplerCount;
+    VkSampler samplers[A_BINDLESS_SAMPLER_SLOTS];
+    uint32_t *samplersWritten; // per set, samplers written so far
+} ABindlessTable;
+
+/*
+ * Device must be created with descriptor indexing, see ADevice.bindless
+ * returns ABindlessTable on success
+ * NULL on failure
+ */
+ABindlessTable *ABindlessTable_create(VkDevice device, uint32_t setCount);
+
+/*
+ * Views and samplers stay with their owners
+ */
+void ABindlessTable_destroy(ABindlessTable *table);
+
+/*
+ * *view is read on every ABindlessTable_update until the slot is removed
+ * returns slot on success
+ * A_BINDLESS_NONE if table is full
+ */
+uint32_t ABindlessTable_add_image(ABindlessTable *table, VkImageView const *view);
+
+/*
+ * Slot may be handed out again right away,
+ *  pending frames keep reading the old view from their own sets
+ */
+void ABindlessTable_remove_image(ABindlessTable *table, uint32_t slot);
+
+/*
+ * returns slot on success
+ * A_BINDLESS_NONE if table is full
+ */
+uint32_t ABindlessTable_add_sampler(ABindlessTable *table, VkSampler sampler);
+
+/*
+ * Writes slots changed since the last update of set
+ * Call once per frame after its fence, before recording
+ */
+void ABindlessTable_update(ABindlessTable *table, uint32_t set);
+
+#endif
@@ -1,9 +1,28 @@
 #ifndef BUFFER_H
 #define BUFFER_H
 
+#include "allocator.h"
 #include "vulkan/vulkan.h"
 
-VkDescriptorSetLayout A_create_descriptor_set_layout(VkDevice device);
+// TRANSFER_SRC: can be moved by defragmenter
+#define A_VERTEX_BUFFER_USAGE                                                                      \
+    (VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |                         \
+     VK_BUFFER_USAGE_VERTEX_BUFFER_BIT)
+#define A_INDEX_BUFFER_USAGE                                                                       \
+    (VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |                         \
+     VK_BUFFER_USAGE_INDEX_BUFFER_BIT)
+// device local memory the host writes directly, integrated GPUs and software rasterizers
+#define A_UNIFIED_MEMORY_PROPERTIES                                                                \
+    (VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |                   \
+     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+
+/*
+ * binding 0 is per frame uniform buffer with dynamic offset
+ * binding 2 is per draw uniform buffer with dynamic offset
+ * binding 1 is combined image sampler if withSampler,
+ *  bindless textures come from ABindlessTable instead
+ */
+VkDescriptorSetLayout A_create_descriptor_set_layout(VkDevice device, VkBool32 withSampler);
 
 typedef struct FillBufferParams {
     uint32_t bufferOffset;
@@ -16,61 +35,55 @@ typedef struct FillBufferParams {
  * -1 if not found
  */
 int32_t find_memory_type(
-    VkPhysicalDevice pdevice, uint32_t typeFilter, VkMemoryPropertyFlagBits properties);
+    VkPhysicalDeviceMemoryProperties const *memProps, uint32_t typeFilter,
+    VkMemoryPropertyFlagBits properties);
+
+/*
+ * Returns A_UNIFIED_MEMORY_PROPERTIES on integrated and CPU devices
+ *  if typeFilter allows such memory type and its heap is the largest device local heap
+ * VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT otherwise
+ * Host visible VRAM of discrete GPUs, small or resizable BAR, is not considered unified,
+ *  it is read by the device fast but written by the host over PCIe
+ */
+VkMemoryPropertyFlags device_local_properties(AMemoryStats const *stats, uint32_t typeFilter);
 
 /*
- * Returns valid VkBuffer,
- *  VkDeviceMemory in out_bufferMemory,
- *  and used memory type index in out_memoryTypeIndex
+ * Returns valid VkBuffer
+ *  and its memory in out_allocation
  *  on success
- * If out_bufferMemory is NULL, no memory is allocated nor bound
- * If out_memoryTypeIndex is NULL, memory type index is not returned
+ * If out_allocation is NULL, no memory is allocated nor bound
  * NULL on failure
  */
 VkBuffer create_buffer(
-    VkDevice device, VkPhysicalDevice pdevice, uint32_t bufferSize, VkBufferUsageFlags bufferUsage,
-    VkMemoryPropertyFlagBits memoryProperties, VkDeviceMemory *out_bufferMemory);
+    VkDevice device, AAllocator *allocator, uint32_t bufferSize, VkBufferUsageFlags bufferUsage,
+    VkMemoryPropertyFlagBits memoryProperties, AAllocation *out_allocation);
 
 /*
- * Returns valid VkBuffer and VkDeviceMemory in out_bufferMemory on success
+ * Returns valid VkBuffer and its memory in out_allocation on success
  * NULL on failure
  */
 VkBuffer create_staging_buffer(
-    VkDevice device, VkPhysicalDevice pdevice, uint32_t bufferSize,
-    VkDeviceMemory *out_bufferMemory);
+    VkDevice device, AAllocator *allocator, uint32_t bufferSize, AAllocation *out_allocation);
 
 /*
- * Returns valid VkBuffer and VkDeviceMemory in out_bufferMemory on success
+ * Returns valid VkBuffer and its memory in out_allocation on success
  * NULL on failure
+ * Memory is host visible (out_allocation->mapped != NULL) on unified memory devices,
+ *  then data can be written with fill_buffer instead of a staging copy
  */
 VkBuffer create_vertex_buffer(
-    VkDevice device, VkPhysicalDevice pdevice, uint32_t bufferSize,
-    VkDeviceMemory *out_bufferMemory);
+    VkDevice device, AAllocator *allocator, uint32_t bufferSize, AAllocation *out_allocation);
 
 /*
- * Returns valid VkBuffer and VkDeviceMemory in out_bufferMemory on success
- * NULL on failure
+ * Same as create_vertex_buffer
  */
 VkBuffer create_index_buffer(
-    VkDevice device, VkPhysicalDevice pdevice, uint32_t bufferSize,
-    VkDeviceMemory *out_bufferMemory);
-
-/*
- * Returns valid VkBuffer[count],
- *  VkDeviceMemory[count] in out_bufferMemories,
- *  and mapped memory areas in out_buffersMapped[count]
- *  on success
- * NULL on failure
- * Allocated one chunk of memory for all buffers
- */
-VkBuffer *create_uniform_buffers(
-    VkDevice device, VkPhysicalDevice pdevice, uint32_t count, uint32_t buffersSize,
-    VkDeviceMemory **out_bufferMemories, void ***out_buffersMapped);
+    VkDevice device, AAllocator *allocator, uint32_t bufferSize, AAllocation *out_allocation);
 
 /*
  * 0 on success
- * 1 if map memory failed
+ * 1 if memory is not host visible
  */
-int fill_buffer(VkDevice device, VkDeviceMemory bufferMemory, void *data, FillBufferParams args);
+int fill_buffer(AAllocation allocation, void const *data, FillBufferParams args);
 
 #endif
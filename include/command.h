@@ -1,6 +1,7 @@
 #ifndef COMMAND_H
 #define COMMAND_H
 #include "my_vulkan.h"
+#include "profiler.h"
 #include "vulkan/vulkan.h"
 
 VkCommandPool A_create_command_pool(VkDevice device, uint32_t graphicsFamilyIndex);
@@ -10,8 +11,13 @@ VkCommandBuffer *A_create_command_buffers(
 
 VkCommandBuffer cmd_begin_one_time(VkDevice device, VkCommandPool commandPool);
 
+/*
+ * Blocks until cb completes, use AUploadContext for uploads
+ * fence is signaled when cb completes, NULL ok
+ */
 void cmd_end_one_time(
-    VkDevice device, VkCommandPool commandPool, VkQueue drawQueue, VkCommandBuffer cb);
+    VkDevice device, VkCommandPool commandPool, VkQueue drawQueue, VkCommandBuffer cb,
+    VkFence fence);
 
 typedef struct ACopyBufferParams {
     VkBuffer src;
@@ -23,22 +29,76 @@ typedef struct ACopyBufferParams {
 /*
  * 0 on success
  * 1 if buffer copy failed
+ * fence is signaled when copy completes, NULL ok
  */
 int copy_buffer(
-    VkDevice device, VkCommandPool commandPool, VkQueue drawQueue, ACopyBufferParams args);
+    VkDevice device, VkCommandPool commandPool, VkQueue drawQueue, ACopyBufferParams args,
+    VkFence fence);
+
+// vertex stage push constants of a draw, fixed while the draw list is, so they are recorded
+typedef struct ADrawConstants {
+    float uvRect[4]; // texture entry: offset xy, scale zw
+    uint32_t layer;  // texture entry: array layer
+    // bindless only, slots of ABindlessTable
+    uint32_t imageSlot;
+    uint32_t samplerSlot;
+} ADrawConstants;
+
+// one indexed draw
+typedef struct ADraw {
+    uint32_t indexCount;
+    uint32_t firstIndex;
+    uint32_t objectOffset; // dynamic offset of its Object uniforms, changing every frame
+    ADrawConstants constants;
+} ADraw;
 
 typedef struct ARecordCmdBuffersParams {
     VkBuffer vBuffer;
     VkBuffer iBuffer;
-    uint32_t indexCount;
-    uint32_t indexOffset;
     VkDescriptorSet *descriptorSets;
+    uint32_t uniformOffset; // dynamic offset of frame uniforms
+    // per frame sets of ABindlessTable, bound once for all draws, NULL if not bindless
+    VkDescriptorSet *bindlessSets;
+    uint32_t drawCount;
+    ADraw const *draws;
+    // writes scopes "render pass" and "draws" into the set of the frame slot, NULL ok
+    AGpuProfiler *profiler;
 } ARecordCmdBuffersParams;
 
+/*
+ * Begins renderPass on framebuffer, clearing the whole extent
+ */
+void cmd_begin_frame_pass(
+    VkCommandBuffer cmdBuf, VkRenderPass renderPass, VkFramebuffer framebuffer,
+    VkExtent2D swapchainExtent, VkSubpassContents contents);
+
+/*
+ * Binds all state and records draws [first, first + count) of args,
+ *  inside a render pass begun on cmdBuf or one it continues as secondary buffer
+ */
+void record_draw_range(
+    VkCommandBuffer cmdBuf, VkViewport viewport, VkRect2D scissor, VkPipeline pipeline,
+    VkPipelineLayout plLayout, uint32_t currentFrame, ARecordCmdBuffersParams args,
+    uint32_t first, uint32_t count);
+
+/*
+ * Records a frame into cmdBuf, it must be in initial state
+ * Per frame data is only referenced through buffers and dynamic offsets,
+ *  so the recording stays valid while record_state_key does not change
+ */
 void record_command_buffer(
     VkRenderPass renderPass, VkFramebuffer const *framebuffers, VkExtent2D swapchainExtent,
-    VkCommandBuffer const *commandBuffers, VkViewport viewport, VkRect2D scissor,
-    VkPipeline pipeline, VkPipelineLayout plLayout, uint32_t currentFrame, uint32_t imageIndex,
+    VkCommandBuffer cmdBuf, VkViewport viewport, VkRect2D scissor, VkPipeline pipeline,
+    VkPipelineLayout plLayout, uint32_t currentFrame, uint32_t imageIndex,
     ARecordCmdBuffersParams args);
 
+/*
+ * Hash of everything record_command_buffer would record with these arguments,
+ *  but not of buffer or descriptor contents
+ */
+uint64_t record_state_key(
+    VkRenderPass renderPass, VkFramebuffer const *framebuffers, VkExtent2D swapchainExtent,
+    VkViewport viewport, VkRect2D scissor, VkPipeline pipeline, VkPipelineLayout plLayout,
+    uint32_t currentFrame, uint32_t imageIndex, ARecordCmdBuffersParams args);
+
 #endif
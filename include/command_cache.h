@@ -0,0 +1,63 @@
+#ifndef COMMAND_CACHE_H
+#define COMMAND_CACHE_H
+
+#include "retire.h"
+#include "vulkan/vulkan.h"
+#include <stdint.h>
+
+// recordings kept per frame slot and swapchain image, one for each recent draw configuration
+#define A_COMMAND_CACHE_WAYS 4
+
+/*
+ * Primary command buffers recorded once and submitted again while their state key matches,
+ *  see record_state_key.
+ * Buffer of a frame slot is only submitted in that slot, so its fence wait
+ *  is enough to reuse or re-record it.
+ */
+typedef struct ACommandCache {
+    VkDevice device;
+    ARetireQueue *retire; // takes the pool with pending buffers when image count changes
+    uint32_t graphicsFamilyIndex;
+    VkCommandPool pool; // NULL if a replacement could not be created
+    uint32_t frameCount;
+    uint32_t imageCount;
+    // [(frame * imageCount + image) * A_COMMAND_CACHE_WAYS + way]
+    VkCommandBuffer *buffers;
+    uint64_t *keys;     // state key of each recording, 0 if not recorded
+    uint64_t *lastUsed; // lookups value of last hit, least recent way is recorded over
+    uint64_t lookups;
+    uint64_t recordings; // lookups that had to record
+} ACommandCache;
+
+/*
+ * returns ACommandCache on success
+ * NULL on failure
+ */
+ACommandCache *ACommandCache_create(
+    VkDevice device, ARetireQueue *retire, uint32_t graphicsFamilyIndex, uint32_t frameCount,
+    uint32_t imageCount);
+
+void ACommandCache_destroy(ACommandCache *cache);
+
+/*
+ * Drops every recording, e.g. after swapchain recreation,
+ *  handles of destroyed framebuffers may come back for new ones
+ * Buffers are reset only when recorded again, so pending ones stay valid
+ * If imageCount changes, buffers are reallocated from a new pool,
+ *  the old pool is retired with the buffers that may still be pending
+ * 0 on success
+ * 1 on failure, cache is empty then
+ */
+int ACommandCache_reset(ACommandCache *cache, uint32_t imageCount);
+
+/*
+ * returns buffer of frame and image recorded with key
+ * If there is none, a buffer is reset and returned with *out_record set,
+ *  caller records it with the state key stands for
+ * NULL on failure
+ * Previous submit of frame must be complete
+ */
+VkCommandBuffer ACommandCache_lookup(
+    ACommandCache *cache, uint32_t frame, uint32_t image, uint64_t key, VkBool32 *out_record);
+
+#endif
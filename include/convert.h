@@ -0,0 +1,60 @@
+#ifndef CONVERT_H
+#define CONVERT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Texel conversions done at load time
+ * dst is written front to back and never read, so it may be mapped staging memory
+ * dst and src must not overlap
+ * AVX2 or SSE2 paths are picked at compile time, scalar loops cover the rest
+ */
+
+/*
+ * RGB8 to RGBA8, alpha is 255
+ */
+void convert_rgb_to_rgba(uint8_t *dst, uint8_t const *src, size_t texels);
+
+/*
+ * RGBA8, color is multiplied by alpha / 255 rounded to nearest, alpha is kept
+ * Works on stored values, sRGB color is not linearized first
+ */
+void premultiply_alpha(uint8_t *dst, uint8_t const *src, size_t texels);
+
+// sRGB color to 16-bit linear and back, alpha is linear already
+typedef struct ASrgbTables {
+    uint16_t toLinear[256 + 1]; // padded for 32-bit gathers
+    uint8_t toSrgb[4096 + 3];   // indexed by top 12 bits of linear value, padded too
+} ASrgbTables;
+
+void init_srgb_tables(ASrgbTables *tables);
+
+/*
+ * RGBA8 sRGB to RGBA16 linear, alpha is widened
+ */
+void convert_srgb_to_linear(
+    ASrgbTables const *tables, uint16_t *dst, uint8_t const *src, size_t texels);
+
+/*
+ * RGBA16 linear to RGBA8 sRGB, alpha is narrowed with rounding
+ */
+void convert_linear_to_srgb(
+    ASrgbTables const *tables, uint8_t *dst, uint16_t const *src, size_t texels);
+
+/*
+ * RGBA8, channel i of dst is channel order[i] of src, {2, 1, 0, 3} swaps RGBA and BGRA
+ */
+void swizzle_rgba(uint8_t *dst, uint8_t const *src, size_t texels, uint8_t const order[4]);
+
+/*
+ * RGBA8 to RG8, blue and alpha are dropped
+ */
+void pack_rgba_to_rg(uint8_t *dst, uint8_t const *src, size_t texels);
+
+/*
+ * RGBA8 to R8
+ */
+void pack_rgba_to_r(uint8_t *dst, uint8_t const *src, size_t texels);
+
+#endif
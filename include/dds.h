@@ -0,0 +1,34 @@
+#ifndef DDS_H
+#define DDS_H
+
+#include "vulkan/vulkan.h"
+
+/*
+ * Single layer 2D texture as stored in DDS file
+ */
+typedef struct ADdsImage {
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipLevels;
+    VkFormat format;
+    VkDeviceSize size;
+    uint8_t *data; // levels packed, see mip_chain_size
+} ADdsImage;
+
+/*
+ * Reads DX10 header files and legacy DXT1, DXT5 ones
+ * Formats are RGBA8, BC1, BC3 and BC7, legacy ones are taken as sRGB
+ * 0 on success, data is malloc'ed
+ * 1 if file cannot be read
+ * 2 if file is not a DDS or its format is not supported
+ */
+int read_dds(char const *path, ADdsImage *out_image);
+
+/*
+ * Always writes DX10 header
+ * 0 on success
+ * 1 on failure
+ */
+int write_dds(char const *path, ADdsImage const *image);
+
+#endif
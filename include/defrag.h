@@ -0,0 +1,107 @@
+#ifndef DEFRAG_H
+#define DEFRAG_H
+
+#include "allocator.h"
+#include "profiler.h"
+#include "retire.h"
+#include "vulkan/vulkan.h"
+
+// blocks used less than this are evacuated
+#define A_DEFRAG_SPARSE_PERCENT 50
+// default bytes copied per step
+#define A_DEFRAG_STEP_BYTES (4ull * 1024 * 1024)
+// resources moved per step at most
+#define A_DEFRAG_STEP_MOVES 64
+
+typedef enum AMovableKind {
+    A_MOVABLE_BUFFER,
+    A_MOVABLE_IMAGE,
+} AMovableKind;
+
+/*
+ * Resource the defragmenter may move.
+ * Handles are owned by the caller, the defragmenter writes new ones through the pointers.
+ */
+typedef struct AMovable {
+    AMovableKind kind;
+    AAllocation *allocation;
+    VkMemoryPropertyFlags properties;
+    union {
+        struct {
+            VkBuffer *handle;
+            uint32_t size;
+            VkBufferUsageFlags usage; // must include TRANSFER_SRC and TRANSFER_DST
+        } buffer;
+        // in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, any tiling, moved copy is optimal
+        struct {
+            VkImage *handle;
+            VkImageView *view; // recreated, NULL if none
+            VkImageViewType viewType;
+            uint32_t width;
+            uint32_t height;
+            uint32_t mipLevels;
+            uint32_t layers;
+            VkFormat format;
+            VkImageUsageFlags usage; // must include TRANSFER_SRC and TRANSFER_DST
+        } image;
+    };
+} AMovable;
+
+/*
+ * Evacuates sparse memory blocks in bounded steps.
+ * Copies run on the draw queue, so draws submitted after a step
+ * already see moved resources and the old ones go to the retire queue.
+ */
+typedef struct ADefragmenter {
+    VkDevice device;
+    AAllocator *allocator;
+    ARetireQueue *retire;
+    VkQueue queue;
+    VkCommandPool commandPool;
+    VkCommandBuffer cb;
+    VkFence fence;           // signaled when cb is free, NULL if lost after failed submit
+    AGpuProfiler *profiler;  // times copies of a step as scope "defrag", NULL ok
+    uint64_t generation;     // bumped on every move, descriptors older than this are stale
+    VkDeviceSize movedBytes; // total
+    uint32_t count;
+    uint32_t capacity;
+    AMovable *movables;
+} ADefragmenter;
+
+/*
+ * returns ADefragmenter on success
+ * NULL on failure
+ * queue must be from graphics family
+ * profiler NULL ok, must outlive the defragmenter
+ */
+ADefragmenter *ADefragmenter_create(
+    VkDevice device, AAllocator *allocator, ARetireQueue *retire, uint32_t graphicsFamilyIndex,
+    VkQueue queue, AGpuProfiler *profiler);
+
+/*
+ * Waits for the last step, then destroys the defragmenter
+ */
+void ADefragmenter_destroy(ADefragmenter *defrag);
+
+/*
+ * 0 on success
+ * 1 on failure, resource is then never moved
+ */
+int ADefragmenter_add(ADefragmenter *defrag, AMovable movable);
+
+/*
+ * Must be called before the resource is destroyed
+ */
+void ADefragmenter_remove(ADefragmenter *defrag, AAllocation const *allocation);
+
+/*
+ * Moves resources out of the sparsest evacuable block,
+ *  at most maxBytes unless single resource is bigger
+ * Does not block, skipped while previous step is running
+ * Movables take their new handles only once the copies are submitted
+ * Uploads to movables must be flushed before the step
+ * returns 1 if anything was moved
+ */
+int ADefragmenter_step(ADefragmenter *defrag, VkDeviceSize maxBytes);
+
+#endif
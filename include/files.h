@@ -0,0 +1,20 @@
+#ifndef FILES_H
+#define FILES_H
+
+#include <stddef.h>
+
+/*
+ * mkdir -p
+ * 0 on success
+ * 1 on failure
+ */
+int make_dirs(char const *dir);
+
+/*
+ * Whole file in memory, free after use
+ * returns data on success, out_size is its size
+ * NULL if file cannot be read, nothing is printed
+ */
+void *read_file(char const *path, size_t *out_size);
+
+#endif
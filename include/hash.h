@@ -0,0 +1,16 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// start value of fnv1a chains
+#define A_FNV_OFFSET 0xcbf29ce484222325ull
+
+/*
+ * 64-bit FNV-1a of size bytes, continued from hash
+ * Not collision resistant, for cache keys and checksums
+ */
+uint64_t fnv1a(uint64_t hash, void const *data, size_t size);
+
+#endif
@@ -1,28 +1,162 @@
 #ifndef IMAGE_H
 #define IMAGE_H
 
+#include "allocator.h"
+#include "upload.h"
 #include "vulkan/vulkan.h"
 
+// TRANSFER_SRC: can be moved by defragmenter
+#define A_TEXTURE_IMAGE_USAGE                                                                      \
+    (VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |                           \
+     VK_IMAGE_USAGE_SAMPLED_BIT)
+#define A_TEXTURE_IMAGE_FORMAT VK_FORMAT_R8G8B8A8_SRGB
+
+typedef struct ATextureInfo {
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipLevels;
+    uint32_t layers; // array layers, sampled as 2D array either way
+    VkFormat format;
+} ATextureInfo;
+
+/*
+ * Returns valid VkImage and its memory in out_imageMemory on success
+ * If out_imageMemory is NULL, no memory is allocated nor bound
+ * Linear images start in VK_IMAGE_LAYOUT_PREINITIALIZED, others in VK_IMAGE_LAYOUT_UNDEFINED
+ * NULL on failure
+ */
 VkImage create_image(
-    VkDevice device, VkPhysicalDevice pdevice, uint32_t width, uint32_t height, VkFormat format,
-    VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties,
-    VkDeviceMemory *out_imageMemory);
+    VkDevice device, AAllocator *allocator, uint32_t width, uint32_t height, uint32_t mipLevels,
+    uint32_t layers, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage,
+    VkMemoryPropertyFlags properties, AAllocation *out_imageMemory);
 
+/*
+ * Transitions mip levels [baseMipLevel, baseMipLevel + levelCount) of every layer
+ */
 void transition_image_layout(
     VkCommandBuffer cb, VkImage image, VkFormat format, VkImageLayout oldLayout,
-    VkImageLayout newLayout);
+    VkImageLayout newLayout, uint32_t baseMipLevel, uint32_t levelCount);
 
+/*
+ * Writes texel rows [y, y + height) of mipLevel, width is of mipLevel
+ * Layers [baseLayer, baseLayer + layerCount) of the level are packed one after another in buffer
+ * Block compressed levels are whole blocks, bufferOffset must be a multiple of block size
+ *  and y of block height
+ */
 void copy_buffer_to_image(
-    VkCommandBuffer cb, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
+    VkCommandBuffer cb, VkBuffer buffer, VkDeviceSize bufferOffset, VkImage image, uint32_t width,
+    uint32_t height, uint32_t y, uint32_t mipLevel, uint32_t baseLayer, uint32_t layerCount);
+
+/*
+ * Texels of a texture decoded on CPU, ready to be copied
+ */
+typedef struct ADecodedTexture {
+    ATextureInfo info;
+    uint32_t stagedLevels; // levels in texels, the rest are blitted on the draw queue
+    VkDeviceSize size;
+    // stagedLevels packed, every layer of a level before the next level
+    // level n starts at info.layers * mip_chain_size(width, height, n)
+    uint8_t *texels;
+    // level 0 only, texels are RGB8 as decoded, size still counts RGBA8, see copy_texels
+    VkBool32 rgb;
+    void *mapping; // texels point into it if not NULL, see map_cached_texture
+    size_t mappingSize;
+} ADecodedTexture;
+
+/*
+ * Writes size bytes of texels from offset on into dst, both count bytes of what is staged
+ * RGB texels are expanded on the way, so dst can be staging or image memory
+ */
+void copy_texels(
+    uint8_t *dst, ADecodedTexture const *texture, VkDeviceSize offset, VkDeviceSize size);
+
+/*
+ * VK_TRUE if create_texture_image blits mips of format on the draw queue
+ * VK_FALSE if they are generated on CPU
+ */
+VkBool32 texture_blits_mips(AAllocator *allocator, VkFormat format);
+
+// BC1, BC3, BC7 in sRGB and UNORM
+#define A_MAX_COMPRESSED_FORMATS 6
+
+/*
+ * What decode_texture may produce on this device
+ */
+typedef struct ADecodeOptions {
+    VkBool32 blitMips; // PNG textures get level 0 only
+    uint32_t compressedCount;
+    VkFormat compressed[A_MAX_COMPRESSED_FORMATS]; // sampled with linear filter
+} ADecodeOptions;
+
+ADecodeOptions texture_decode_options(AAllocator *allocator);
+
+/*
+ * Prefers DDS file next to PNG with the same name if the device samples its format,
+ *  its levels are taken as they are.
+ * Otherwise maps PNG texels from the texture cache, decoding and storing them on a miss:
+ *  PNG is loaded as A_TEXTURE_IMAGE_FORMAT and mips are generated on CPU unless blitMips,
+ *  8-bit RGB level 0 alone is kept as RGB and expanded as it is staged
+ * Makes no Vulkan calls, safe to call from any thread
+ * 0 on success
+ * 1 on failure
+ */
+int decode_texture(
+    char const *image_path, ADecodeOptions const *options, ADecodedTexture *out_texture);
+
+/*
+ * Frees or unmaps texels
+ */
+void free_decoded_texture(ADecodedTexture *texture);
+
+typedef struct ALoadedTexture {
+    VkImage image; // NULL if loading failed
+    AAllocation memory;
+    ATextureInfo info;
+    // levels [residentLevel, mipLevels) can be sampled, see ATextureStreamer
+    uint32_t residentLevel;
+} ALoadedTexture;
+
+/*
+ * Records upload of decoded texture, see create_texture_image
+ * texture can be freed right after
+ * Returns valid VkImage and its memory in out_imageMemory on success
+ * NULL on failure
+ */
+VkImage upload_texture(
+    VkDevice device, AAllocator *allocator, AUploadContext *upload, ADecodedTexture const *texture,
+    AAllocation *out_imageMemory);
 
+/*
+ * Texels are recorded into upload context,
+ * image can be sampled by draw queue submits after AUploadContext_flush
+ * Block compressed DDS is used if there is one, see decode_texture
+ * Full mip chain is blitted on the draw queue if the format supports linear blits,
+ *  otherwise it is generated on CPU
+ * On unified memory devices texels are written into linear image directly,
+ *  otherwise they go through staging memory
+ * Image size, levels and format are written to out_info, NULL ok
+ */
 VkImage create_texture_image(
-    VkDevice device, VkPhysicalDevice pdevice, char const *image_path, VkCommandPool commandPool,
-    VkQueue drawQueue, VkDeviceMemory *out_imageMemory);
+    VkDevice device, AAllocator *allocator, AUploadContext *upload, char const *image_path,
+    AAllocation *out_imageMemory, ATextureInfo *out_info);
 
-VkImageView create_image_view(VkDevice device, VkImage image, VkFormat format);
+/*
+ * Views levels [baseMipLevel, baseMipLevel + mipLevels)
+ */
+VkImageView create_image_view(
+    VkDevice device, VkImage image, VkImageViewType viewType, VkFormat format,
+    uint32_t baseMipLevel, uint32_t mipLevels, uint32_t layers);
 
-VkImageView create_texture_image_view(VkDevice device, VkImage image);
+/*
+ * VK_IMAGE_VIEW_TYPE_2D_ARRAY view of levels [baseMipLevel, info.mipLevels),
+ *  single textures are arrays of one layer
+ */
+VkImageView create_texture_image_view(
+    VkDevice device, VkImage image, ATextureInfo info, uint32_t baseMipLevel);
 
-VkSampler create_sampler(VkDevice device);
+/*
+ * LOD range covers mipLevels
+ */
+VkSampler create_sampler(VkDevice device, uint32_t mipLevels);
 
 #endif
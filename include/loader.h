@@ -0,0 +1,68 @@
+#ifndef LOADER_H
+#define LOADER_H
+
+#include "atlas.h"
+#include "image.h"
+#include "stream.h"
+#include "upload.h"
+#include "vulkan/vulkan.h"
+
+typedef struct ALoadStats {
+    uint32_t textureCount; // loaded successfully
+    uint32_t workerCount;
+    VkDeviceSize bytes;   // texel bytes uploaded, mips and streamed levels included
+    double seconds;       // wall time until last copy completed
+    double decodeSeconds; // summed over workers
+} ALoadStats;
+
+// ATextureRef.image of textures that could not be loaded
+#define A_TEXTURE_NONE UINT32_MAX
+
+/*
+ * Where a texture ended up in ATextureSet
+ */
+typedef struct ATextureRef {
+    uint32_t image; // index into ATextureSet.images
+    uint32_t layer;
+    float uvRect[4]; // offset xy and scale zw of texture coordinates, whole layer is 0 0 1 1
+} ATextureRef;
+
+/*
+ * Images packed out of many textures
+ */
+typedef struct ATextureSet {
+    uint32_t imageCount;
+    ALoadedTexture *images; // arrays and atlases, in no particular order
+    uint32_t refCount;
+    ATextureRef *refs; // per path
+} ATextureSet;
+
+/*
+ * Decodes paths on worker threads and packs them into few images:
+ *  textures of the same size and format become layers of one array image,
+ *  the odd sized ones share an atlas, unless they are block compressed.
+ * An array is uploaded as soon as it holds half of the staging ring or A_ARRAY_MAX_LAYERS,
+ *  so its copies overlap with decoding of the rest.
+ * With streamer, only small levels are uploaded here, see ATextureStreamer_upload:
+ *  mips are then generated on CPU and set images must stay in place until streamed.
+ * Blocks until every copy is complete, then prints throughput.
+ * workerCount = 0 means one less than CPU count
+ * returns number of loaded textures, out_set->refs has count entries
+ * out_stats can be NULL
+ */
+uint32_t A_load_texture_set(
+    VkDevice device, AAllocator *allocator, AUploadContext *upload, char const *const *paths,
+    uint32_t count, uint32_t workerCount, ATextureStreamer *streamer, ATextureSet *out_set,
+    ALoadStats *out_stats);
+
+void ATextureSet_destroy(VkDevice device, AAllocator *allocator, ATextureSet *set);
+
+/*
+ * Returns sorted paths of PNG files in dir and their count in out_count
+ * NULL if dir cannot be read or has no PNG files
+ */
+char **A_list_textures(char const *dir, uint32_t *out_count);
+
+void A_free_texture_paths(char **paths, uint32_t count);
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef MEMSTATS_H
+#define MEMSTATS_H
+
+#include "vulkan/vulkan.h"
+#include <stdio.h>
+
+// heaps above this share of their budget are reported
+#define A_BUDGET_WARN_PERCENT 90
+
+typedef struct AMemoryCounters {
+    VkDeviceSize blockBytes;      // vkAllocateMemory'd
+    uint32_t blockCount;          // vkAllocateMemory calls alive
+    VkDeviceSize allocationBytes; // handed out to resources
+    uint32_t allocationCount;
+} AMemoryCounters;
+
+typedef struct AMemoryHeapStats {
+    AMemoryCounters counters;
+    // from VK_EXT_memory_budget, whole process
+    // without the extension budget is heap size and usage is counters.blockBytes
+    VkDeviceSize budget;
+    VkDeviceSize usage;
+} AMemoryHeapStats;
+
+/*
+ * Cached memory properties with bytes and allocations
+ * counted per heap and per memory type
+ */
+typedef struct AMemoryStats {
+    VkPhysicalDevice pdevice;
+    VkPhysicalDeviceType deviceType;
+    VkPhysicalDeviceMemoryProperties props;
+    PFN_vkGetPhysicalDeviceMemoryProperties2 getProps2; // NULL if budget is not supported
+    AMemoryCounters types[VK_MAX_MEMORY_TYPES];
+    AMemoryHeapStats heaps[VK_MAX_MEMORY_HEAPS];
+} AMemoryStats;
+
+/*
+ * Queries memory properties once
+ * Budget is read if A_is_memory_budget_supported(pdevice)
+ */
+AMemoryStats AMemoryStats_create(VkInstance instance, VkPhysicalDevice pdevice);
+
+void AMemoryStats_add_block(AMemoryStats *stats, uint32_t memoryTypeIndex, VkDeviceSize size);
+
+void AMemoryStats_remove_block(AMemoryStats *stats, uint32_t memoryTypeIndex, VkDeviceSize size);
+
+void AMemoryStats_add_allocation(
+    AMemoryStats *stats, uint32_t memoryTypeIndex, VkDeviceSize size);
+
+void AMemoryStats_remove_allocation(
+    AMemoryStats *stats, uint32_t memoryTypeIndex, VkDeviceSize size);
+
+/*
+ * Refreshes heap budget and usage
+ * Returns count of heaps above A_BUDGET_WARN_PERCENT of budget
+ */
+uint32_t AMemoryStats_update_budget(AMemoryStats *stats);
+
+/*
+ * Writes stats as one JSON object
+ */
+void AMemoryStats_write_json(AMemoryStats const *stats, FILE *file);
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef MIPMAP_H
+#define MIPMAP_H
+
+#include "vulkan/vulkan.h"
+
+/*
+ * Full chain down to 1x1
+ */
+uint32_t mip_level_count(uint32_t width, uint32_t height);
+
+VkExtent2D mip_extent(uint32_t width, uint32_t height, uint32_t level);
+
+typedef struct ATexelBlock {
+    uint32_t width;
+    uint32_t height;
+    uint32_t size; // bytes
+} ATexelBlock;
+
+/*
+ * 4x4 for BC formats, 1x1 for others, which are taken as 4 bytes per texel
+ */
+ATexelBlock texel_block(VkFormat format);
+
+/*
+ * Bytes of one level, partial blocks at the edges count as whole
+ */
+VkDeviceSize mip_level_size(VkFormat format, uint32_t width, uint32_t height, uint32_t level);
+
+/*
+ * Bytes of levels [0, levels) packed one after another
+ * Offset of level n in such chain is mip_chain_size(format, width, height, n)
+ */
+VkDeviceSize mip_chain_size(VkFormat format, uint32_t width, uint32_t height, uint32_t levels);
+
+/*
+ * Writes RGBA8 sRGB levels [1, levels) packed into out_levels
+ * 2x2 box filter in linear space, odd last row and column are repeated
+ * 0 on success
+ * 1 if out of memory
+ */
+int generate_mip_chain_srgb(
+    uint8_t const *level0, uint32_t width, uint32_t height, uint32_t levels, uint8_t *out_levels);
+
+#endif
@@ -1,14 +1,46 @@
 #ifndef MY_VULKAN_H
 #define MY_VULKAN_H
 #include "SDL_vulkan.h"
+#include "retire.h"
 #include "vulkan/vulkan.h"
 
 /*
  * returns VkInstance on success
  * NULL on failure
+ * Enables VK_KHR_get_physical_device_properties2 if available
  */
 VkInstance A_create_instance(SDL_Window *window, uint32_t apiVersion);
 
+/*
+ * returns VK_TRUE if instance extension is available
+ */
+VkBool32 A_has_instance_extension(char const *name);
+
+/*
+ * returns VK_TRUE if device extension is available
+ */
+VkBool32 A_has_device_extension(VkPhysicalDevice pdevice, char const *name);
+
+/*
+ * returns VK_TRUE if VK_EXT_memory_budget can be enabled
+ * ADevice_create enables it in that case
+ */
+VkBool32 A_is_memory_budget_supported(VkPhysicalDevice pdevice);
+
+/*
+ * returns VK_TRUE if descriptor indexing features of ABindlessTable are supported,
+ *  through VK_EXT_descriptor_indexing
+ * ADevice_create enables them in that case
+ */
+VkBool32 A_is_bindless_supported(VkInstance instance, VkPhysicalDevice pdevice);
+
+/*
+ * returns VK_TRUE if timeline semaphores are supported,
+ *  through VK_KHR_timeline_semaphore, core in Vulkan 1.2
+ * ADevice_create enables them in that case
+ */
+VkBool32 A_is_timeline_supported(VkInstance instance, VkPhysicalDevice pdevice);
+
 /*
  */
 VkSurfaceKHR A_create_surface(SDL_Window *window, VkInstance instance);
@@ -29,12 +61,14 @@ typedef struct AQueueFamilies {
     uint32_t count;
     int32_t graphicsIndex;
     int32_t presentIndex;
+    int32_t transferIndex;
 } AQueueFamilies;
 
 /*
  * AQueueFamilies with valid indices on success
  * .graphicsIndex=-1 if no graphics queue
  * .presentIndex=-1 if no present queue
+ * .transferIndex=-1 if no queue family without graphics can transfer
  */
 AQueueFamilies A_select_queue_families(VkPhysicalDevice pdevice, VkSurfaceKHR surface);
 
@@ -42,31 +76,46 @@ typedef struct ADevice {
     VkDevice device;
     VkQueue drawQueue;
     VkQueue presentQueue;
+    VkQueue transferQueue; // same as drawQueue if no transfer family
+    VkBool32 bindless;     // descriptor indexing enabled, see ABindlessTable
+    VkBool32 timeline;     // timeline semaphores enabled, see AFramePacer
 } ADevice;
 
 /*
  * .device=NULL on fail
+ * Enables VK_EXT_memory_budget if supported
+ * Enables descriptor indexing if supported, see A_is_bindless_supported
+ * Enables timeline semaphores if supported, see A_is_timeline_supported
  */
-ADevice ADevice_create(VkPhysicalDevice pdevice, AQueueFamilies queueFamilies);
+ADevice ADevice_create(
+    VkInstance instance, VkPhysicalDevice pdevice, AQueueFamilies queueFamilies);
 
 void ADevice_destroy(ADevice adevice);
 
 VkBool32 A_is_surface_supported(
     VkPhysicalDevice pdevice, uint32_t graphicsFamilyIndex, VkSurfaceKHR surface);
 
+// let ASwapchain_create pick MAILBOX if supported, FIFO otherwise
+#define A_PRESENT_MODE_AUTO VK_PRESENT_MODE_MAX_ENUM_KHR
+
 typedef struct ASwapchain {
     VkSwapchainKHR swapchain;
     VkExtent2D extent;
     VkFormat imageFormat;
+    VkPresentModeKHR presentMode; // what was picked, may differ from the one asked for
     uint32_t imageCount;
     VkImage *images;         // count = imageCount
     VkImageView *imageViews; // count = imageCount
 } ASwapchain;
 
 /*
+ * presentMode falls back to FIFO if not supported, or A_PRESENT_MODE_AUTO
+ * oldSwapchain is retired by the call, NULL ok
+ * .swapchain=NULL on failure
  */
 ASwapchain ASwapchain_create(
-    VkPhysicalDevice pdevice, VkSurfaceKHR surface, AQueueFamilies queueFamilies, VkDevice device);
+    VkPhysicalDevice pdevice, VkSurfaceKHR surface, AQueueFamilies queueFamilies, VkDevice device,
+    VkPresentModeKHR presentMode, VkSwapchainKHR oldSwapchain);
 
 void ASwapchain_destroy(VkDevice device, ASwapchain swapchain);
 
@@ -88,9 +137,18 @@ typedef struct ARecreatedSwapchain {
     VkFramebuffer *framebuffers; // count = swapchain.imageCount
 } ARecreatedSwapchain;
 
+/*
+ * Creates swapchain for current surface size and presentMode, see ASwapchain_create,
+ *  from oldSwapchain without waiting for the device,
+ *  old swapchain, its views and framebuffers go to retire,
+ *  so frames in flight can finish with them
+ * returns new swapchain and framebuffers on success, old ones are not usable anymore
+ * .swapchain.swapchain=NULL on failure or if surface has no area (minimized),
+ *  old ones are kept then
+ */
 ARecreatedSwapchain A_recreate_swapchain(
     VkPhysicalDevice pdevice, VkSurfaceKHR surface, AQueueFamilies queueFamilies, VkDevice device,
-    VkRenderPass renderPass, ASwapchain oldSwapchain,
-    VkFramebuffer oldFramebuffers[oldSwapchain.imageCount]);
+    VkRenderPass renderPass, ARetireQueue *retire, VkPresentModeKHR presentMode,
+    ASwapchain oldSwapchain, VkFramebuffer oldFramebuffers[oldSwapchain.imageCount]);
 
 #endif
@@ -0,0 +1,30 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include "vulkan/vulkan.h"
+#include <stdint.h>
+
+#define A_DEFAULT_FRAMES_IN_FLIGHT 2
+
+/*
+ * Settings that can change per run without rebuilding
+ */
+typedef struct AOptions {
+    uint32_t framesInFlight; // 1 to A_MAX_FRAMES_IN_FLIGHT, more trades latency for throughput
+    VkPresentModeKHR presentMode; // A_PRESENT_MODE_AUTO if not given
+    uint32_t fps;                 // frame rate cap, 0 for none
+} AOptions;
+
+/*
+ * Fills out_options from command line, missing ones get defaults
+ * 0 on success
+ * 1 on unknown or malformed option, usage is printed then
+ */
+int AOptions_parse(int argc, char **argv, AOptions *out_options);
+
+/*
+ * Name as accepted by --present-mode, "auto" for A_PRESENT_MODE_AUTO
+ */
+char const *A_present_mode_name(VkPresentModeKHR presentMode);
+
+#endif
@@ -31,10 +31,13 @@ VkPipelineLayout A_create_pipeline_layout(
     VkDevice device, uint32_t setLayoutCount, VkDescriptorSetLayout const *setLayouts,
     uint32_t pushConstantRangeCount, VkPushConstantRange const *pushConstantRanges);
 
+/*
+ * cache may be NULL
+ */
 VkPipeline A_create_pipeline(
-    VkDevice device, VkPipelineLayout pipelineLayout, VkRenderPass renderPass,
-    char const *entryPointGroup, uint32_t shaderCount, AShader const *shaders,
-    APipelineParams args);
+    VkDevice device, VkPipelineCache cache, VkPipelineLayout pipelineLayout,
+    VkRenderPass renderPass, char const *entryPointGroup, uint32_t shaderCount,
+    AShader const *shaders, APipelineParams args);
 
 VkViewport make_viewport(VkExtent2D extent);
 
@@ -0,0 +1,26 @@
+#ifndef PIPELINE_CACHE_H
+#define PIPELINE_CACHE_H
+
+#include "vulkan/vulkan.h"
+
+// relative to working directory, next to texture cache
+#define A_PIPELINE_CACHE_PATH "data/cache/pipelines.bin"
+
+/*
+ * returns VkPipelineCache on success, filled from path if that was saved
+ *  by the same device, driver and Vulkan cache header version
+ * Missing or mismatching file gives an empty cache, out_warm tells which, NULL ok
+ * NULL on failure
+ */
+VkPipelineCache A_load_pipeline_cache(
+    VkDevice device, VkPhysicalDevice pdevice, char const *path, VkBool32 *out_warm);
+
+/*
+ * Replaces path with data of cache, written to a temporary file first
+ * 0 on success
+ * 1 on failure
+ */
+int A_save_pipeline_cache(
+    VkDevice device, VkPhysicalDevice pdevice, VkPipelineCache cache, char const *path);
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef PIPELINE_REGISTRY_H
+#define PIPELINE_REGISTRY_H
+
+#include "SDL.h"
+#include "pipeline.h"
+#include "shader.h"
+#include "vulkan/vulkan.h"
+
+#define A_PIPELINE_NONE UINT32_MAX
+
+/*
+ * Everything A_create_pipeline takes apart from device and cache
+ * pNext of params structs and pSampleMask must be NULL
+ */
+typedef struct APipelineDesc {
+    VkPipelineLayout layout;
+    VkRenderPass renderPass;
+    char const *entryPointGroup;
+    uint32_t shaderCount;
+    AShader const *shaders;
+    APipelineParams params;
+} APipelineDesc;
+
+typedef enum APipelineState {
+    A_PIPELINE_PENDING,
+    A_PIPELINE_READY,
+    A_PIPELINE_FAILED,
+} APipelineState;
+
+typedef struct APipelineEntry {
+    uint64_t hash;
+    size_t keySize;
+    uint8_t *key;        // serialized desc, compared on equal hash
+    APipelineDesc desc;  // owned copy until compiled
+    VkPipeline fallback; // not owned, NULL ok
+    VkPipeline pipeline;
+    SDL_atomic_t state; // APipelineState, pipeline is set before READY
+    double seconds;     // spent compiling
+} APipelineEntry;
+
+/*
+ * Pipelines keyed by full state, each distinct one is compiled once
+ *  on a worker thread in request order.
+ * Until an entry is ready its fallback is handed out instead,
+ *  so new states never stall the rendering thread.
+ * Shader modules are keyed by handle, they must stay alive until
+ *  their entries are compiled. Specialization constants are keyed by value.
+ * All calls but the worker are made from one thread.
+ */
+typedef struct APipelineRegistry {
+    VkDevice device;
+    VkPipelineCache cache; // NULL ok
+    SDL_Thread *worker;    // NULL if it could not start, then compiled on request
+    SDL_mutex *mutex;
+    SDL_cond *cond; // broadcast on new entries, compiled entries and quit
+    // entries are appended and compiled in order
+    // guarded by mutex, read without it on requesting thread
+    uint32_t count;
+    uint32_t capacity;
+    APipelineEntry **entries;
+    // guarded by mutex
+    uint32_t compiled; // entries handed to worker so far
+    int quit;
+} APipelineRegistry;
+
+/*
+ * returns APipelineRegistry on success
+ * NULL on failure
+ */
+APipelineRegistry *APipelineRegistry_create(VkDevice device, VkPipelineCache cache);
+
+/*
+ * Waits for the pipeline being compiled, drops the queued ones
+ * Destroys every pipeline, device must not use them anymore
+ */
+void APipelineRegistry_destroy(APipelineRegistry *registry);
+
+/*
+ * desc is copied, it can be freed right after
+ * fallback is returned by APipelineRegistry_get until the entry is ready,
+ *  first request of a state sets it
+ * returns entry of desc, the same for equal states
+ * A_PIPELINE_NONE on failure
+ */
+uint32_t APipelineRegistry_request(
+    APipelineRegistry *registry, APipelineDesc const *desc, VkPipeline fallback);
+
+/*
+ * returns pipeline of entry if it is compiled, its fallback otherwise
+ */
+VkPipeline APipelineRegistry_get(APipelineRegistry *registry, uint32_t entry);
+
+/*
+ * Blocks until entry is compiled
+ * returns its pipeline
+ * NULL if it failed
+ */
+VkPipeline APipelineRegistry_wait(APipelineRegistry *registry, uint32_t entry);
+
+#endif
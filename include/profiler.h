@@ -0,0 +1,111 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "vulkan/vulkan.h"
+#include <stdint.h>
+
+// distinct scope names, each takes two timestamp queries per frame slot
+#define A_PROFILER_MAX_SCOPES 16
+// durations of this many most recent frames are kept per scope
+#define A_PROFILER_HISTORY 128
+#define A_PROFILER_NO_SCOPE UINT32_MAX
+
+// sets after the frame slots, for work submitted on its own
+typedef enum AGpuProfilerSet {
+    A_PROFILER_SET_DEFRAG,
+    A_PROFILER_SET_UPLOAD,
+    A_PROFILER_SET_COUNT
+} AGpuProfilerSet;
+
+typedef struct AGpuScope {
+    char const *name; // not copied, string literals
+    uint32_t sampleCount;
+    uint32_t nextSample;
+    float samples[A_PROFILER_HISTORY]; // ms, ring
+    uint64_t total;                    // samples taken since start
+} AGpuScope;
+
+/*
+ * Summary of the samples a scope holds
+ */
+typedef struct AGpuScopeStats {
+    uint32_t samples;
+    double last, avg, min, max, p99; // ms
+} AGpuScopeStats;
+
+/*
+ * GPU time of named scopes from timestamp queries.
+ * Each frame slot has its own set of queries, reset by the command buffer
+ *  that writes them, so recordings that are submitted again keep working.
+ * Results of a slot are read once its previous submit is complete,
+ *  framesInFlight frames after it was recorded, nothing waits for them.
+ * Sets after the frame slots are for submits outside of frames, see AGpuProfilerSet,
+ *  each is written by one submit at a time and read once it is complete.
+ * Not thread safe, scopes are written by the thread recording primaries and copies.
+ */
+typedef struct AGpuProfiler {
+    VkDevice device;
+    VkQueryPool pool;
+    uint32_t frameCount;
+    double msPerTick;   // from timestampPeriod
+    uint64_t validMask; // of timestampValidBits
+    uint32_t scopeCount;
+    AGpuScope scopes[A_PROFILER_MAX_SCOPES];
+    uint64_t *lastBegins; // per set and scope, begin timestamp of last sample
+} AGpuProfiler;
+
+/*
+ * Queries are reset once with a blocking submit on queue of queueFamilyIndex
+ * returns AGpuProfiler on success
+ * NULL if queue family has no timestamps or on failure
+ */
+AGpuProfiler *AGpuProfiler_create(
+    VkPhysicalDevice pdevice, VkDevice device, uint32_t queueFamilyIndex,
+    VkCommandPool commandPool, VkQueue queue, uint32_t frameCount);
+
+void AGpuProfiler_destroy(AGpuProfiler *profiler);
+
+/*
+ * returns index of set after the frame slots
+ */
+uint32_t AGpuProfiler_set(AGpuProfiler const *profiler, AGpuProfilerSet set);
+
+/*
+ * returns index of scope with name, registering it on first use
+ * A_PROFILER_NO_SCOPE if profiler is NULL or A_PROFILER_MAX_SCOPES are in use
+ */
+uint32_t AGpuProfiler_scope(AGpuProfiler *profiler, char const *name);
+
+/*
+ * Records reset of queries of set, outside of a render pass and before any scope of set
+ * Every function recording into cmdBuf does nothing if profiler is NULL
+ */
+void AGpuProfiler_reset(AGpuProfiler *profiler, VkCommandBuffer cmdBuf, uint32_t set);
+
+void AGpuProfiler_begin(
+    AGpuProfiler *profiler, VkCommandBuffer cmdBuf, uint32_t set, uint32_t scope);
+
+void AGpuProfiler_end(AGpuProfiler *profiler, VkCommandBuffer cmdBuf, uint32_t set, uint32_t scope);
+
+/*
+ * Adds durations of scopes written by the last complete submit of set to their history
+ * Call after waiting for the set's frame slot, does not block
+ * Scopes not written since last call are skipped
+ */
+void AGpuProfiler_collect(AGpuProfiler *profiler, uint32_t set);
+
+AGpuScopeStats AGpuProfiler_stats(AGpuProfiler const *profiler, uint32_t scope);
+
+/*
+ * Logs stats of every scope with eprintff
+ */
+void AGpuProfiler_print(AGpuProfiler const *profiler);
+
+/*
+ * Writes stats of every scope as CSV, one line per scope after a header
+ * 0 on success
+ * 1 if file cannot be written
+ */
+int AGpuProfiler_export(AGpuProfiler const *profiler, char const *path);
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include "SDL.h"
+#include "command.h"
+#include "vulkan/vulkan.h"
+#include <stdint.h>
+
+// fewer draws per thread are recorded on less threads, waking one costs more than they take
+#define A_RECORDER_MIN_DRAWS 256
+
+typedef struct ARecorderThread {
+    struct ARecorder *recorder;
+    uint32_t index;
+    SDL_Thread *thread;       // NULL for the calling thread
+    VkCommandPool *pools;     // per frame, reset before recording its frame
+    VkCommandBuffer *buffers; // secondary, per frame
+    VkBool32 recorded;        // buffer of current frame holds draws of current job
+} ARecorderThread;
+
+typedef struct ARecordJob {
+    VkRenderPass renderPass;
+    VkFramebuffer framebuffer;
+    VkViewport viewport;
+    VkRect2D scissor;
+    VkPipeline pipeline;
+    VkPipelineLayout plLayout;
+    uint32_t frame;
+    ARecordCmdBuffersParams args;
+    uint32_t threadCount; // threads the draws are split across
+} ARecordJob;
+
+/*
+ * Records draw lists on several threads.
+ * Each thread records a contiguous share of draws into a secondary command buffer
+ *  from its own per frame pool, primary buffer executes them in draw order.
+ * Calling thread records a share too, so threadCount = 1 starts no threads.
+ */
+typedef struct ARecorder {
+    VkDevice device;
+    uint32_t frameCount;
+    uint32_t threadCount;
+    ARecorderThread *threads; // [0] is the calling thread
+    VkCommandBuffer *secondaries; // per thread, passed to vkCmdExecuteCommands
+    SDL_mutex *mutex;
+    SDL_cond *cond;
+    uint64_t generation; // of job, bumped to wake threads
+    uint32_t pending;    // threads still working on job
+    VkBool32 quit;
+    ARecordJob job;
+} ARecorder;
+
+/*
+ * threadCount = 0 means CPU count
+ * returns ARecorder on success, with less threads if some could not be started
+ * NULL on failure
+ */
+ARecorder *ARecorder_create(
+    VkDevice device, uint32_t graphicsFamilyIndex, uint32_t frameCount, uint32_t threadCount);
+
+void ARecorder_destroy(ARecorder *recorder);
+
+/*
+ * Records a frame into primary cmdBuf like record_command_buffer, cmdBuf must be in initial state
+ * Blocks until every share is recorded
+ * Previous submit of currentFrame must be complete
+ */
+void ARecorder_record(
+    ARecorder *recorder, VkRenderPass renderPass, VkFramebuffer const *framebuffers,
+    VkExtent2D swapchainExtent, VkCommandBuffer cmdBuf, VkViewport viewport, VkRect2D scissor,
+    VkPipeline pipeline, VkPipelineLayout plLayout, uint32_t currentFrame, uint32_t imageIndex,
+    ARecordCmdBuffersParams args);
+
+#endif
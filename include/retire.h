@@ -0,0 +1,71 @@
+#ifndef RETIRE_H
+#define RETIRE_H
+
+#include "allocator.h"
+#include "vulkan/vulkan.h"
+
+typedef enum ARetiredKind {
+    A_RETIRED_BUFFER,
+    A_RETIRED_IMAGE,
+    A_RETIRED_IMAGE_VIEW,
+    A_RETIRED_FRAMEBUFFER,
+    A_RETIRED_SWAPCHAIN,    // images go with it, their views are retired on their own
+    A_RETIRED_COMMAND_POOL, // buffers allocated from it go with it
+} ARetiredKind;
+
+typedef struct ARetired {
+    ARetiredKind kind;
+    union {
+        VkBuffer buffer;
+        VkImage image;
+        VkImageView imageView;
+        VkFramebuffer framebuffer;
+        VkSwapchainKHR swapchain;
+        VkCommandPool commandPool;
+    };
+    AAllocation allocation; // freed with the handle, empty ok
+    uint64_t frame;         // frame number at retire time
+} ARetired;
+
+/*
+ * Deferred destruction of objects that frames in flight may still use.
+ * Object retired during frame N is destroyed once frame N + framesInFlight starts,
+ * its fence wait guarantees that everything submitted in frame N is complete.
+ */
+typedef struct ARetireQueue {
+    VkDevice device;
+    AAllocator *allocator;
+    uint32_t framesInFlight;
+    uint64_t frame; // frame number given to last ARetireQueue_collect
+    uint32_t count;
+    uint32_t capacity;
+    ARetired *items; // FIFO by frame
+} ARetireQueue;
+
+/*
+ * returns ARetireQueue on success
+ * NULL on failure
+ */
+ARetireQueue *ARetireQueue_create(VkDevice device, AAllocator *allocator, uint32_t framesInFlight);
+
+/*
+ * Destroys everything still queued, device must be idle
+ */
+void ARetireQueue_destroy(ARetireQueue *queue);
+
+/*
+ * item.frame is overwritten with current frame number
+ * 0 on success
+ * 1 if queue cannot grow, item is then destroyed once the device is idle
+ */
+int ARetireQueue_push(ARetireQueue *queue, ARetired item);
+
+/*
+ * Call at the start of each frame, after waiting for its fence
+ * completed is the number of frames known complete on the device, see AFramePacer_completed,
+ *  objects retired before frame number completed are destroyed without waiting framesInFlight
+ * Destroys objects no frame in flight can use anymore
+ */
+void ARetireQueue_collect(ARetireQueue *queue, uint64_t frame, uint64_t completed);
+
+#endif
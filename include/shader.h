@@ -6,6 +6,7 @@
 typedef struct AShader {
     VkShaderModule module;
     VkShaderStageFlagBits stage;
+    VkSpecializationInfo const *specialization; // NULL ok, not owned
 } AShader;
 
 AShader AShader_from_path(VkDevice device, char const *path, VkShaderStageFlagBits stage);
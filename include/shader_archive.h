@@ -0,0 +1,64 @@
+#ifndef SHADER_ARCHIVE_H
+#define SHADER_ARCHIVE_H
+
+#include "shader.h"
+#include "vulkan/vulkan.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// written by tools/shpack.c next to the .spv files it packs
+#define A_SHADER_ARCHIVE_PATH "./data/shaders_compiled/shaders.bin"
+#define A_SHADER_ARCHIVE_MAGIC 0x52414853 // "SHAR"
+#define A_SHADER_ARCHIVE_VERSION 1
+#define A_SHADER_NAME_SIZE 56
+
+/*
+ * File layout, native byte order:
+ *  AShaderArchiveHeader, AShaderArchiveEntry[count], then SPIR-V blobs
+ *  at 4-byte aligned offsets, so they can be used from a mapping as is
+ */
+typedef struct AShaderArchiveHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+    uint32_t reserved;
+} AShaderArchiveHeader;
+
+typedef struct AShaderArchiveEntry {
+    char name[A_SHADER_NAME_SIZE]; // source file name like "main.frag", NUL terminated
+    uint32_t stage;                // VkShaderStageFlagBits
+    uint32_t offset;               // from start of file
+    uint32_t size;                 // of SPIR-V in bytes
+    uint32_t reserved;
+} AShaderArchiveEntry;
+
+/*
+ * Read-only mapping of an archive, entries point into it
+ */
+typedef struct AShaderArchive {
+    uint8_t const *mapping;
+    size_t mappingSize;
+    uint32_t count;
+    AShaderArchiveEntry const *entries;
+} AShaderArchive;
+
+/*
+ * Maps path and checks every entry lies within it
+ * returns AShaderArchive on success
+ * NULL on failure, nothing is printed if path does not exist
+ */
+AShaderArchive *AShaderArchive_open(char const *path);
+
+/*
+ * Shader modules made from archive stay valid
+ */
+void AShaderArchive_close(AShaderArchive *archive);
+
+/*
+ * Module is created straight from the mapping, stage comes from the entry
+ * AShader on success
+ * AShader{0} on fail
+ */
+AShader AShaderArchive_load(VkDevice device, AShaderArchive const *archive, char const *name);
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef STAGING_H
+#define STAGING_H
+
+#include "allocator.h"
+#include "vulkan/vulkan.h"
+
+#define A_DEFAULT_STAGING_SIZE (32ull * 1024 * 1024)
+
+typedef struct AStagingRegion {
+    VkBuffer buffer;
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    void *mapped; // points at offset
+} AStagingRegion;
+
+typedef struct AStagingSubmit {
+    VkFence fence;      // NULL if cancelled, complete once older ones are
+    uint64_t serial;
+    VkDeviceSize end;   // ring head at submit time
+    VkDeviceSize bytes; // consumed since previous submit (with padding)
+} AStagingSubmit;
+
+/*
+ * One persistently mapped host coherent buffer used as a ring.
+ * Regions are handed out at head, and return to the ring
+ * when the fence of the submit that consumed them is signaled.
+ */
+typedef struct AStagingRing {
+    VkDevice device;
+    AAllocator *allocator;
+    VkBuffer buffer;
+    AAllocation memory;
+    VkDeviceSize size;
+    VkDeviceSize head;      // next free byte
+    VkDeviceSize tail;      // oldest byte in use
+    VkDeviceSize used;      // bytes from tail to head, including wrap padding
+    VkDeviceSize openBytes; // consumed since last submit
+    // submits in flight, FIFO
+    uint32_t pendingFirst;
+    uint32_t pendingCount;
+    uint32_t pendingCapacity;
+    AStagingSubmit *pending;
+    // unsignaled fences ready for reuse
+    uint32_t freeFenceCount;
+    uint32_t freeFenceCapacity;
+    VkFence *freeFences;
+    uint64_t nextSerial;      // serial given to next submit
+    uint64_t completedSerial; // every submit <= this is complete
+} AStagingRing;
+
+/*
+ * returns AStagingRing on success
+ * NULL on failure
+ * size = 0 means A_DEFAULT_STAGING_SIZE
+ */
+AStagingRing *AStagingRing_create(VkDevice device, AAllocator *allocator, VkDeviceSize size);
+
+/*
+ * Waits for all submits, then destroys the ring
+ */
+void AStagingRing_destroy(AStagingRing *ring);
+
+/*
+ * 0 on success, region in out_region
+ * 1 if size does not fit into the ring
+ * 2 if the ring is held by regions not submitted yet
+ * Waits for the oldest submits if ring is full
+ * alignment must be power of 2
+ */
+int AStagingRing_alloc(
+    AStagingRing *ring, VkDeviceSize size, VkDeviceSize alignment, AStagingRegion *out_region);
+
+/*
+ * Closes regions allocated since previous submit.
+ * Fence in out_fence must be passed to the vkQueueSubmit
+ * that reads those regions.
+ * Returns serial of this submit, 0 on failure
+ */
+uint64_t AStagingRing_submit(AStagingRing *ring, VkFence *out_fence);
+
+/*
+ * For a vkQueueSubmit of serial that failed, its fence would never be signaled:
+ *  regions of serial return to the ring as soon as older submits complete
+ * Nothing may read them anymore
+ */
+void AStagingRing_cancel(AStagingRing *ring, uint64_t serial);
+
+/*
+ * Returns regions of completed submits to the ring
+ * Does not block
+ */
+void AStagingRing_reclaim(AStagingRing *ring);
+
+/*
+ * Blocks until submit with serial is complete
+ */
+void AStagingRing_wait(AStagingRing *ring, uint64_t serial);
+
+#endif
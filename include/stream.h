@@ -0,0 +1,97 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include "allocator.h"
+#include "defrag.h"
+#include "image.h"
+#include "retire.h"
+#include "upload.h"
+#include "vulkan/vulkan.h"
+
+// levels no larger than this on either side are uploaded with the image
+#define A_STREAM_TAIL_SIZE 32
+// default staging bytes per ATextureStreamer_step
+#define A_STREAM_FRAME_BYTES (1ull * 1024 * 1024)
+
+/*
+ * Image whose levels above residentLevel are still on CPU
+ */
+typedef struct AStreamedImage {
+    ALoadedTexture *texture; // owned by caller, image is not moved while streamed
+    VkImageView *view;       // recreated as levels land, NULL if none
+    uint32_t viewLevel;      // first level of view
+    // levels [0, texture->residentLevel) packed, see ADecodedTexture
+    uint8_t *texels;
+    uint32_t nextLayer; // layers of level residentLevel - 1 copied so far
+    uint32_t nextRow;   // block rows of nextLayer copied so far, see ATextureStreamer_step
+} AStreamedImage;
+
+/*
+ * Makes textures usable right away at small levels and copies the larger ones
+ * a few per frame, smallest missing level of any image first.
+ * A level is only sampled once all its layers are copied: views are recreated
+ * over the resident levels and the old ones go to the retire queue.
+ * Fully resident images are handed to the defragmenter.
+ */
+typedef struct ATextureStreamer {
+    VkDevice device;
+    AAllocator *allocator;
+    AUploadContext *upload;
+    ARetireQueue *retire;
+    ADefragmenter *defrag; // NULL ok
+    VkDeviceSize frameBytes;
+    uint64_t generation;       // bumped on every recreated view
+    VkDeviceSize pendingBytes; // texels still on CPU
+    uint32_t count;
+    uint32_t capacity;
+    AStreamedImage *images;
+} ATextureStreamer;
+
+/*
+ * returns ATextureStreamer on success
+ * NULL on failure
+ * frameBytes = 0 means A_STREAM_FRAME_BYTES
+ */
+ATextureStreamer *ATextureStreamer_create(
+    VkDevice device, AAllocator *allocator, AUploadContext *upload, ARetireQueue *retire,
+    ADefragmenter *defrag, VkDeviceSize frameBytes);
+
+/*
+ * Frees texels not streamed yet, images stay with their owners
+ */
+void ATextureStreamer_destroy(ATextureStreamer *streamer);
+
+/*
+ * Creates image of texture and records upload of its levels up to A_STREAM_TAIL_SIZE,
+ *  the rest is copied by ATextureStreamer_step
+ * Textures with levels blitted on GPU, small ones and those on unified memory
+ *  are uploaded whole, see upload_texture
+ * texture can be freed right after
+ * out_texture must stay in place until it is fully resident
+ * 0 on success, out_texture->residentLevel is the first uploaded level
+ * 1 on failure
+ */
+int ATextureStreamer_upload(
+    ATextureStreamer *streamer, ADecodedTexture const *texture, ALoadedTexture *out_texture);
+
+/*
+ * view of texture must start at its residentLevel,
+ *  it is recreated over resident levels from now on
+ *  and handed to the defragmenter with its image
+ * Does nothing if texture is not streamed
+ */
+void ATextureStreamer_track_view(
+    ATextureStreamer *streamer, ALoadedTexture const *texture, VkImageView *view);
+
+/*
+ * Records copies of at most frameBytes, unless a single layer or block row is bigger,
+ *  and flushes them, so draws submitted after it sample the new levels
+ * Layers larger than half of the staging ring are copied a few block rows at a time
+ * Copies no more than half of free staging, never waits
+ * Image whose block row cannot fit staging is dropped with a warning at its resident level
+ * Call once per frame after ARetireQueue_collect
+ * returns 1 if any view was recreated
+ */
+int ATextureStreamer_step(ATextureStreamer *streamer);
+
+#endif
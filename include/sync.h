@@ -2,9 +2,98 @@
 #define SYNC_H
 #include "vulkan/vulkan.h"
 
+// upper bound of frames in flight, settings above it are clamped
+#define A_MAX_FRAMES_IN_FLIGHT 8
+// binary semaphores one frame submit may wait for and signal
+#define A_PACER_MAX_SEMAPHORES 4
+// latency of this many most recent frames is kept for percentiles
+#define A_PACER_LATENCY_SAMPLES 256
+
 VkSemaphore *create_semaphores(VkDevice device, uint32_t count);
 
 VkFence *create_empty_fences(uint32_t count);
 
 VkFence *create_fences(VkDevice device, uint32_t count);
+
+/*
+ * Tracks completion of frames submitted round robin into framesInFlight slots.
+ * Frame number n signals value n + 1 on one timeline semaphore if the device has them,
+ *  otherwise a fence per slot is used.
+ * Waiting for a slot means its previous submit and everything before it is complete,
+ *  so resources of the slot can be reused.
+ */
+typedef struct AFramePacer {
+    VkDevice device;
+    uint32_t framesInFlight;
+    VkSemaphore timeline; // NULL if fences are used
+    PFN_vkWaitSemaphores waitSemaphores;
+    PFN_vkGetSemaphoreCounterValue getCounterValue;
+    VkFence *fences;      // per slot, without timeline
+    uint64_t *slotValues; // per slot, value of its last submit, 0 if none
+    uint64_t submitted;   // value of last submit, frames submitted so far
+    // latency, from acquire to observed completion, in SDL performance counter ticks
+    uint64_t *slotStarts; // per slot, when its frame began acquiring
+    uint64_t observed;    // frames whose completion is already sampled
+    uint32_t sampleCount;
+    uint32_t nextSample;
+    float samples[A_PACER_LATENCY_SAMPLES]; // ms, ring
+    // frame limiter
+    uint64_t period;   // ticks between frames, 0 if unlimited
+    uint64_t deadline; // when next frame may start
+} AFramePacer;
+
+/*
+ * framesInFlight is clamped to [1, A_MAX_FRAMES_IN_FLIGHT]
+ * timeline can only be set if ADevice enabled timeline semaphores
+ * returns AFramePacer on success
+ * NULL on failure
+ */
+AFramePacer *AFramePacer_create(VkDevice device, uint32_t framesInFlight, VkBool32 timeline);
+
+void AFramePacer_destroy(AFramePacer *pacer);
+
+/*
+ * Blocks until previous submit of slot is complete
+ */
+void AFramePacer_wait(AFramePacer *pacer, uint32_t slot);
+
+/*
+ * returns number of frames completed on the device, without blocking
+ * Completions seen here are sampled for latency
+ */
+uint64_t AFramePacer_completed(AFramePacer *pacer);
+
+/*
+ * Limits frame rate to fps, 0 means unlimited
+ */
+void AFramePacer_set_rate(AFramePacer *pacer, double fps);
+
+/*
+ * Sleeps until the next frame may start, call right before sampling input,
+ *  so frames start as late as the limit allows
+ * Completions are sampled while sleeping
+ */
+void AFramePacer_limit(AFramePacer *pacer);
+
+/*
+ * Marks start of the frame of slot, call right before acquiring its image
+ */
+void AFramePacer_begin(AFramePacer *pacer, uint32_t slot);
+
+/*
+ * Latency percentiles in ms over the last A_PACER_LATENCY_SAMPLES frames
+ * Observed completion of a frame is late by up to the time between two polls,
+ *  AFramePacer_wait, AFramePacer_completed and AFramePacer_limit poll
+ * returns number of samples, percentiles are 0 without any
+ */
+uint32_t AFramePacer_latency(AFramePacer *pacer, double *out_p50, double *out_p99);
+
+/*
+ * Submits info on queue as next frame of slot, adding the completion signal
+ * info may wait for and signal up to A_PACER_MAX_SEMAPHORES binary semaphores
+ * On failure slot keeps its last frame, waiting for it does not block
+ */
+VkResult AFramePacer_submit(
+    AFramePacer *pacer, VkQueue queue, uint32_t slot, VkSubmitInfo const *info);
+
 #endif
@@ -0,0 +1,43 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include "image.h"
+#include "vulkan/vulkan.h"
+
+// relative to working directory, same as textures
+#define A_TEXTURE_CACHE_DIR "data/cache/textures"
+
+/*
+ * Entry of a PNG in the cache
+ * File name comes from the path and decode variant,
+ *  the content hash tells if the entry is still valid
+ */
+typedef struct ATextureCacheKey {
+    uint64_t entry;   // hash of path and blitMips
+    uint64_t content; // hash of PNG file bytes
+} ATextureCacheKey;
+
+/*
+ * Reads and hashes the PNG
+ * 0 on success
+ * 1 if the file cannot be read, nothing is printed
+ */
+int texture_cache_key(char const *image_path, VkBool32 blitMips, ATextureCacheKey *out_key);
+
+/*
+ * Maps entry of key, out_texture->texels point into the mapping,
+ *  see free_decoded_texture
+ * 0 on success
+ * 1 if there is no entry or it is stale, nothing is printed
+ */
+int map_cached_texture(ATextureCacheKey const *key, ADecodedTexture *out_texture);
+
+/*
+ * Replaces entry of key with texture, written to a temporary file first
+ *  so other readers never see a partial entry
+ * 0 on success
+ * 1 on failure
+ */
+int store_cached_texture(ATextureCacheKey const *key, ADecodedTexture const *texture);
+
+#endif
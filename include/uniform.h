@@ -0,0 +1,52 @@
+#ifndef UNIFORM_H
+#define UNIFORM_H
+
+#include "allocator.h"
+#include "vulkan/vulkan.h"
+
+// default bytes of uniform data per frame in flight
+#define A_DEFAULT_UNIFORM_FRAME_SIZE (256u * 1024)
+
+/*
+ * One persistently mapped uniform buffer split into a slot per frame in flight.
+ * Each slot is a linear allocator reset at the start of its frame,
+ * allocations are bound with VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC offsets,
+ * so descriptor sets are written once and never updated per draw.
+ */
+typedef struct AUniformArena {
+    VkBuffer buffer;
+    AAllocation memory;
+    VkDeviceSize alignment; // minUniformBufferOffsetAlignment
+    VkDeviceSize frameSize; // bytes per slot, multiple of alignment
+    VkDeviceSize range;     // descriptor range, max size of one allocation
+    uint32_t frameCount;
+    uint32_t frame;    // current slot
+    VkDeviceSize head; // next free byte in current slot
+} AUniformArena;
+
+/*
+ * returns AUniformArena on success
+ * .buffer=NULL on failure
+ * frameSize = 0 means A_DEFAULT_UNIFORM_FRAME_SIZE
+ * range must not exceed maxUniformBufferRange
+ */
+AUniformArena AUniformArena_create(
+    VkDevice device, VkPhysicalDevice pdevice, AAllocator *allocator, uint32_t frameCount,
+    VkDeviceSize frameSize, VkDeviceSize range);
+
+void AUniformArena_destroy(VkDevice device, AAllocator *allocator, AUniformArena arena);
+
+/*
+ * Resets slot of frame, its previous submit must be complete
+ */
+void AUniformArena_begin_frame(AUniformArena *arena, uint32_t frame);
+
+/*
+ * returns mapped memory for size bytes
+ *  and offset to pass to vkCmdBindDescriptorSets in out_dynamicOffset
+ *  on success
+ * NULL if slot of current frame is full or size > range
+ */
+void *AUniformArena_alloc(AUniformArena *arena, VkDeviceSize size, uint32_t *out_dynamicOffset);
+
+#endif
@@ -0,0 +1,206 @@
+#ifndef UPLOAD_H
+#define UPLOAD_H
+
+#include "my_vulkan.h"
+#include "profiler.h"
+#include "staging.h"
+#include "vulkan/vulkan.h"
+
+/*
+ * Command buffers of one flushed batch
+ */
+typedef struct AUploadBatch {
+    uint64_t serial;            // staging ring serial of the batch
+    VkCommandBuffer transferCb; // copies, on transfer queue
+    VkCommandBuffer acquireCb;  // ownership acquire on draw queue, NULL if same family
+    VkSemaphore semaphore;      // transferCb -> acquireCb, NULL if same family
+    VkBool32 timed;             // transferCb writes A_PROFILER_SET_UPLOAD
+} AUploadBatch;
+
+typedef struct AUploadImageParams {
+    VkImage image; // must be in VK_IMAGE_LAYOUT_UNDEFINED
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipLevels;
+    uint32_t layers;
+    VkFormat format;
+    // region holds level 0 only, others are blitted from it on the draw queue
+    // otherwise region holds all levels packed, see ADecodedTexture
+    VkBool32 blitMips;
+} AUploadImageParams;
+
+/*
+ * Records buffer and image copies into one command buffer
+ * and submits them all at once with AUploadContext_flush.
+ * Copies run on the transfer queue family if device has one,
+ * ownership of destinations is then moved to the graphics family.
+ * Nothing waits for the queue to idle: batch completion is tracked
+ * by the staging ring fence, serials work as tickets.
+ * With a profiler, batches on the graphics family are timed as scope "upload",
+ *  one at a time, a transfer only queue cannot reset queries.
+ */
+typedef struct AUploadContext {
+    VkDevice device;
+    AStagingRing *staging;
+    uint32_t transferFamily;
+    uint32_t graphicsFamily;
+    VkQueue transferQueue;
+    VkQueue graphicsQueue;
+    VkCommandPool transferPool;
+    VkCommandPool graphicsPool; // NULL if same family
+    AGpuProfiler *profiler;     // NULL if off or batches run on transfer family
+    uint64_t timedSerial;       // last batch timed, its results are read once it is complete
+    AUploadBatch open;          // recording, .transferCb = NULL if nothing recorded
+    // barriers after copies of open batch, recorded once on flush
+    VkPipelineStageFlags dstStageMask;
+    uint32_t bufferBarrierCount;
+    uint32_t bufferBarrierCapacity;
+    VkBufferMemoryBarrier *bufferBarriers;
+    uint32_t imageBarrierCount;
+    uint32_t imageBarrierCapacity;
+    VkImageMemoryBarrier *imageBarriers;
+    // images of open batch whose mips are blitted after the barriers
+    uint32_t blitCount;
+    uint32_t blitCapacity;
+    AUploadImageParams *blits;
+    // flushed batches, FIFO by serial
+    uint32_t pendingFirst;
+    uint32_t pendingCount;
+    uint32_t pendingCapacity;
+    AUploadBatch *pending;
+    // completed batches ready for reuse
+    uint32_t freeCount;
+    uint32_t freeCapacity;
+    AUploadBatch *free;
+} AUploadContext;
+
+/*
+ * Part of one level, levels are copied one by one when streamed
+ */
+typedef struct AUploadLevelParams {
+    VkImage image;
+    uint32_t width;  // of mipLevel
+    uint32_t height; // rows from y
+    uint32_t y;      // first row, multiple of block height, 0 for whole layers
+    uint32_t mipLevel;
+    uint32_t baseLayer;
+    uint32_t layerCount; // packed one after another in region
+    VkBool32 lastPart;   // every layer of the level is written after this one
+} AUploadLevelParams;
+
+typedef struct AUploadBufferParams {
+    VkBuffer dst;
+    VkDeviceSize dstOffset;
+    VkDeviceSize size;
+    // how dst is read after upload
+    VkAccessFlags dstAccessMask;
+    VkPipelineStageFlags dstStageMask;
+} AUploadBufferParams;
+
+/*
+ * returns AUploadContext on success
+ * NULL on failure
+ * Uses transfer queue if queueFamilies.transferIndex != -1
+ * profiler NULL ok, must outlive the context
+ */
+AUploadContext *AUploadContext_create(
+    VkDevice device, AStagingRing *staging, AQueueFamilies queueFamilies, ADevice adevice,
+    AGpuProfiler *profiler);
+
+/*
+ * Flushes recorded copies, waits for all batches, then destroys the context
+ */
+void AUploadContext_destroy(AUploadContext *ctx);
+
+/*
+ * Allocates staging memory for data of next copy
+ * Flushes open batch if staging ring is held by it
+ * 0 on success, region in out_region
+ * 1 if staging memory is not available
+ */
+int AUploadContext_stage(
+    AUploadContext *ctx, VkDeviceSize size, VkDeviceSize alignment, AStagingRegion *out_region);
+
+/*
+ * Records copy of staged region to buffer
+ * 0 on success
+ * 1 if command buffer cannot be started or its barriers cannot grow
+ */
+int AUploadContext_copy_to_buffer(
+    AUploadContext *ctx, AStagingRegion region, AUploadBufferParams args);
+
+/*
+ * Records copy of staged region to image
+ * All levels end up in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+ * 0 on success
+ * 1 if command buffer cannot be started or its barriers cannot grow
+ */
+int AUploadContext_copy_to_image(
+    AUploadContext *ctx, AStagingRegion region, AUploadImageParams args);
+
+/*
+ * Records transition of image written by host
+ *  from VK_IMAGE_LAYOUT_PREINITIALIZED to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+ * No copy is made, image is ready after AUploadContext_flush
+ * 0 on success
+ * 1 if command buffer cannot be started or its barriers cannot grow
+ */
+int AUploadContext_transition_image(AUploadContext *ctx, VkImage image, uint32_t mipLevels);
+
+/*
+ * Records transition of every level of new image
+ *  from VK_IMAGE_LAYOUT_UNDEFINED to VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+ *  levels are then written with AUploadContext_copy_to_level
+ * 0 on success
+ * 1 if command buffer cannot be started or its barriers cannot grow
+ */
+int AUploadContext_begin_image(AUploadContext *ctx, VkImage image, uint32_t mipLevels);
+
+/*
+ * Records copy of staged region to part of a level in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
+ * With lastPart the level goes to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+ *  and can be sampled by draw queue submits after AUploadContext_flush,
+ *  other levels keep their layout
+ * 0 on success
+ * 1 if command buffer cannot be started or its barriers cannot grow
+ */
+int AUploadContext_copy_to_level(
+    AUploadContext *ctx, AStagingRegion region, AUploadLevelParams args);
+
+/*
+ * Stages args.size bytes of data and records copy to buffer
+ * 0 on success
+ * 1 on failure
+ */
+int AUploadContext_buffer(AUploadContext *ctx, void const *data, AUploadBufferParams args);
+
+/*
+ * Submits recorded copies, does not block
+ * Draw queue submits made after flush see uploaded data
+ * Returns serial of the batch, 0 if nothing was recorded or on failure
+ * If pending batches cannot grow, the batch stays open for the next flush
+ */
+uint64_t AUploadContext_flush(AUploadContext *ctx);
+
+/*
+ * Recycles command buffers of completed batches
+ * Does not block
+ */
+void AUploadContext_collect(AUploadContext *ctx);
+
+/*
+ * Returns 1 if batch with serial is complete
+ */
+int AUploadContext_is_complete(AUploadContext *ctx, uint64_t serial);
+
+/*
+ * Blocks until batch with serial is complete
+ */
+void AUploadContext_wait(AUploadContext *ctx, uint64_t serial);
+
+/*
+ * Flushes open batch and blocks until every batch is complete
+ */
+void AUploadContext_wait_idle(AUploadContext *ctx);
+
+#endif
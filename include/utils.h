@@ -30,6 +30,8 @@
 
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
+// a must be power of 2
+#define ALIGN_UP(x, a) (((x) + (a)-1) & ~((a)-1))
 
 // #define BIG_INDEX_T
 
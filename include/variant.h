@@ -0,0 +1,60 @@
+#ifndef VARIANT_H
+#define VARIANT_H
+
+#include "pipeline_registry.h"
+#include "vulkan/vulkan.h"
+
+// constant_id 0 to 3 in main.frag and main_bindless.frag
+#define A_VARIANT_CONSTANT_COUNT 4
+
+typedef enum ALightingModel {
+    A_LIGHTING_NONE,
+    A_LIGHTING_LAMBERT,      // flat normals from screen space derivatives, two-sided
+    A_LIGHTING_HALF_LAMBERT, // same, wrapped around so back of light is not black
+    A_LIGHTING_MODEL_COUNT,
+} ALightingModel;
+
+/*
+ * Feature toggles of the main fragment shaders
+ * Each is a specialization constant, disabled features are compiled out
+ *  instead of branched over per fragment
+ */
+typedef struct AShaderVariant {
+    VkBool32 texture;     // sampled color, white otherwise
+    VkBool32 vertexColor; // multiplied in
+    VkBool32 alphaTest;   // mostly transparent fragments are discarded
+    uint32_t lighting;    // ALightingModel
+} AShaderVariant;
+
+/*
+ * Same output as the shaders without specialization
+ */
+AShaderVariant AShaderVariant_default(void);
+
+/*
+ * returns bits of variant, equal for equal variants
+ */
+uint32_t AShaderVariant_key(AShaderVariant variant);
+
+/*
+ * Specialization constants of a variant
+ * info points into the struct, it must not be moved once filled
+ */
+typedef struct ASpecialization {
+    VkSpecializationMapEntry entries[A_VARIANT_CONSTANT_COUNT];
+    uint32_t data[A_VARIANT_CONSTANT_COUNT];
+    VkSpecializationInfo info;
+} ASpecialization;
+
+void AShaderVariant_specialize(AShaderVariant variant, ASpecialization *out_specialization);
+
+/*
+ * Requests base with variant specialized into every stage,
+ *  stages ignore constants they do not declare
+ * See APipelineRegistry_request
+ */
+uint32_t AShaderVariant_request(
+    APipelineRegistry *registry, APipelineDesc const *base, AShaderVariant variant,
+    VkPipeline fallback);
+
+#endif
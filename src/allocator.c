@@ -0,0 +1,315 @@
+#include "allocator.h"
+#include "buffer.h"
+#include "utils.h"
+#include <string.h>
+
+AAllocator *AAllocator_create(
+    VkInstance instance, VkDevice device, VkPhysicalDevice pdevice, VkDeviceSize blockSize) {
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(pdevice, &props);
+    ARR_ALLOC(AAllocator, allocator, 1);
+    if (allocator == NULL) {
+        eprintff(MSG_ERRORF("cannot allocate allocator"));
+        return NULL;
+    }
+    *allocator = (AAllocator){
+        .device = device,
+        .pdevice = pdevice,
+        .blockSize = blockSize == 0 ? A_DEFAULT_BLOCK_SIZE : blockSize,
+        .bufferImageGranularity = props.limits.bufferImageGranularity,
+        .maxAllocationCount = props.limits.maxMemoryAllocationCount,
+        .allocationCount = 0,
+        .stats = AMemoryStats_create(instance, pdevice)};
+    for (uint32_t i = 0; i < VK_MAX_MEMORY_TYPES; i++) { allocator->blocks[i] = NULL; }
+    return allocator;
+}
+
+static void AMemoryBlock_destroy(AAllocator *allocator, AMemoryBlock *block) {
+    // NOTE: vkFreeMemory implies vkUnmapMemory
+    vkFreeMemory(allocator->device, block->memory, NULL);
+    allocator->allocationCount--;
+    AMemoryStats_remove_block(&allocator->stats, block->memoryTypeIndex, block->size);
+    free(block->ranges);
+    free(block);
+}
+
+void AAllocator_destroy(AAllocator *allocator) {
+    if (allocator == NULL) return;
+    for (uint32_t i = 0; i < VK_MAX_MEMORY_TYPES; i++) {
+        AMemoryBlock *block = allocator->blocks[i];
+        while (block != NULL) {
+            AMemoryBlock *next = block->next;
+            if (block->used != 0)
+                eprintff(
+                    MSG_WARNF("block of type %u destroyed with %llu bytes in use"), i,
+                    (unsigned long long)block->used);
+            AMemoryBlock_destroy(allocator, block);
+            block = next;
+        }
+    }
+    free(allocator);
+}
+
+/*
+ * NULL on failure
+ */
+static AMemoryBlock *AMemoryBlock_create(
+    AAllocator *allocator, uint32_t memoryTypeIndex, VkDeviceSize size, VkBool32 dedicated) {
+    if (allocator->allocationCount >= allocator->maxAllocationCount) {
+        eprintff(
+            MSG_ERRORF("maxMemoryAllocationCount (%u) reached"), allocator->maxAllocationCount);
+        return NULL;
+    }
+    VkMemoryAllocateInfo allocInfo = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = size,
+        .memoryTypeIndex = memoryTypeIndex};
+    VkDeviceMemory memory;
+    VkResult res = vkAllocateMemory(allocator->device, &allocInfo, NULL, &memory);
+    if (res != VK_SUCCESS) {
+        eprintff(MSG_ERRORF("cannot allocate memory: %d"), res);
+        return NULL;
+    }
+    VkMemoryPropertyFlags flags = allocator->stats.props.memoryTypes[memoryTypeIndex].propertyFlags;
+    void *mapped = NULL;
+    if (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        res = vkMapMemory(allocator->device, memory, 0, VK_WHOLE_SIZE, 0, &mapped);
+        if (res != VK_SUCCESS) {
+            eprintff(MSG_ERRORF("cannot map memory block: %d"), res);
+            vkFreeMemory(allocator->device, memory, NULL);
+            return NULL;
+        }
+    }
+    ARR_ALLOC(AMemoryBlock, block, 1);
+    uint32_t rangeCapacity = 16;
+    ARR_ALLOC(ASuballocation, ranges, rangeCapacity);
+    if (block == NULL || ranges == NULL) {
+        eprintff(MSG_ERRORF("cannot allocate memory block"));
+        free(block);
+        free(ranges);
+        vkFreeMemory(allocator->device, memory, NULL);
+        return NULL;
+    }
+    ranges[0] = (ASuballocation){.offset = 0, .size = size, .kind = A_ALLOCATION_FREE};
+    *block = (AMemoryBlock){
+        .next = allocator->blocks[memoryTypeIndex],
+        .memory = memory,
+        .size = size,
+        .used = 0,
+        .memoryTypeIndex = memoryTypeIndex,
+        .dedicated = dedicated,
+        .mapped = mapped,
+        .rangeCount = 1,
+        .rangeCapacity = rangeCapacity,
+        .ranges = ranges};
+    allocator->blocks[memoryTypeIndex] = block;
+    allocator->allocationCount++;
+    AMemoryStats_add_block(&allocator->stats, memoryTypeIndex, size);
+    return block;
+}
+
+static VkBool32 on_same_page(VkDeviceSize endA, VkDeviceSize startB, VkDeviceSize pageSize) {
+    // endA is the last byte of resource A, startB is the first byte of resource B
+    return (endA & ~(pageSize - 1)) == (startB & ~(pageSize - 1));
+}
+
+static VkBool32 kinds_conflict(AAllocationKind a, AAllocationKind b) {
+    return a != A_ALLOCATION_FREE && b != A_ALLOCATION_FREE && a != b;
+}
+
+/*
+ * Makes room for count more ranges, count <= rangeCapacity
+ * 0 on success
+ * 1 on failure
+ */
+static int reserve_ranges(AMemoryBlock *block, uint32_t count) {
+    if (block->rangeCount + count <= block->rangeCapacity) return 0;
+    uint32_t capacity = block->rangeCapacity * 2;
+    ASuballocation *ranges = realloc(block->ranges, capacity * sizeof(*ranges));
+    if (ranges == NULL) {
+        eprintff(MSG_ERRORF("cannot grow ranges of memory block"));
+        return 1;
+    }
+    block->ranges = ranges;
+    block->rangeCapacity = capacity;
+    return 0;
+}
+
+// room must be reserved
+static void insert_range(AMemoryBlock *block, uint32_t at, ASuballocation range) {
+    memmove(
+        block->ranges + at + 1, block->ranges + at,
+        (block->rangeCount - at) * sizeof(*block->ranges));
+    block->ranges[at] = range;
+    block->rangeCount++;
+}
+
+static void remove_range(AMemoryBlock *block, uint32_t at) {
+    memmove(
+        block->ranges + at, block->ranges + at + 1,
+        (block->rangeCount - at - 1) * sizeof(*block->ranges));
+    block->rangeCount--;
+}
+
+/*
+ * first fit
+ * returns 1 and offset in out_offset on success
+ * 0 if block has no room, or its ranges cannot grow for the split
+ */
+static int AMemoryBlock_alloc(
+    AMemoryBlock *block, VkDeviceSize granularity, VkMemoryRequirements memReqs,
+    AAllocationKind kind, VkDeviceSize *out_offset) {
+    if (block->size - block->used < memReqs.size) return 0;
+    for (uint32_t i = 0; i < block->rangeCount; i++) {
+        ASuballocation range = block->ranges[i];
+        if (range.kind != A_ALLOCATION_FREE || range.size < memReqs.size) continue;
+        VkDeviceSize offset = ALIGN_UP(range.offset, memReqs.alignment);
+        if (i > 0) {
+            ASuballocation prev = block->ranges[i - 1];
+            if (kinds_conflict(prev.kind, kind) &&
+                on_same_page(prev.offset + prev.size - 1, offset, granularity))
+                offset = ALIGN_UP(offset, granularity);
+        }
+        VkDeviceSize rangeEnd = range.offset + range.size;
+        if (offset + memReqs.size > rangeEnd) continue;
+        if (i + 1 < block->rangeCount) {
+            ASuballocation next = block->ranges[i + 1];
+            if (kinds_conflict(next.kind, kind) &&
+                on_same_page(offset + memReqs.size - 1, next.offset, granularity))
+                continue;
+        }
+        // split [padding][allocation][rest]
+        if (reserve_ranges(block, 2) != 0) return 0;
+        VkDeviceSize end = offset + memReqs.size;
+        block->ranges[i] = (ASuballocation){.offset = offset, .size = memReqs.size, .kind = kind};
+        if (end < rangeEnd) {
+            insert_range(
+                block, i + 1,
+                (ASuballocation){.offset = end, .size = rangeEnd - end, .kind = A_ALLOCATION_FREE});
+        }
+        if (offset > range.offset) {
+            insert_range(
+                block, i,
+                (ASuballocation){
+                    .offset = range.offset,
+                    .size = offset - range.offset,
+                    .kind = A_ALLOCATION_FREE});
+        }
+        block->used += memReqs.size;
+        *out_offset = offset;
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * returns 1 if block became empty
+ */
+static int AMemoryBlock_free(AMemoryBlock *block, VkDeviceSize offset) {
+    // binary search for range starting at offset
+    uint32_t lo = 0, hi = block->rangeCount;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (block->ranges[mid].offset < offset) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo == block->rangeCount || block->ranges[lo].offset != offset ||
+        block->ranges[lo].kind == A_ALLOCATION_FREE) {
+        eprintff(MSG_ERRORF("no allocation at offset %llu"), (unsigned long long)offset);
+        return 0;
+    }
+    block->used -= block->ranges[lo].size;
+    block->ranges[lo].kind = A_ALLOCATION_FREE;
+    // merge with next, then with previous
+    if (lo + 1 < block->rangeCount && block->ranges[lo + 1].kind == A_ALLOCATION_FREE) {
+        block->ranges[lo].size += block->ranges[lo + 1].size;
+        remove_range(block, lo + 1);
+    }
+    if (lo > 0 && block->ranges[lo - 1].kind == A_ALLOCATION_FREE) {
+        block->ranges[lo - 1].size += block->ranges[lo].size;
+        remove_range(block, lo);
+    }
+    return block->used == 0;
+}
+
+/*
+ * source != NULL: only shared blocks other than source
+ *  that are at least as full as source are used, no new blocks
+ */
+static int alloc(
+    AAllocator *allocator, VkMemoryRequirements memReqs, VkMemoryPropertyFlags properties,
+    AAllocationKind kind, AMemoryBlock const *source, AAllocation *out_allocation) {
+    int32_t memoryTypeIndex =
+        find_memory_type(&allocator->stats.props, memReqs.memoryTypeBits, properties);
+    if (memoryTypeIndex == -1) {
+        eprintff(MSG_ERRORF("no suitable memory type"));
+        return 1;
+    }
+    VkDeviceSize granularity = allocator->bufferImageGranularity;
+    VkDeviceSize offset = 0;
+    AMemoryBlock *block = NULL;
+    if (source != NULL) {
+        for (block = allocator->blocks[memoryTypeIndex]; block != NULL; block = block->next) {
+            if (block == source || block->dedicated || block->used < source->used) continue;
+            if (AMemoryBlock_alloc(block, granularity, memReqs, kind, &offset)) break;
+        }
+        if (block == NULL) return 3;
+    }
+    // big resources get their own block
+    else if (memReqs.size > allocator->blockSize / 2) {
+        block = AMemoryBlock_create(allocator, memoryTypeIndex, memReqs.size, VK_TRUE);
+        if (block == NULL) return 2;
+        AMemoryBlock_alloc(block, granularity, memReqs, kind, &offset);
+    }
+    else {
+        for (block = allocator->blocks[memoryTypeIndex]; block != NULL; block = block->next) {
+            if (block->dedicated) continue;
+            if (AMemoryBlock_alloc(block, granularity, memReqs, kind, &offset)) break;
+        }
+        if (block == NULL) {
+            block = AMemoryBlock_create(allocator, memoryTypeIndex, allocator->blockSize, VK_FALSE);
+            if (block == NULL) return 2;
+            AMemoryBlock_alloc(block, granularity, memReqs, kind, &offset);
+        }
+    }
+    AMemoryStats_add_allocation(&allocator->stats, memoryTypeIndex, memReqs.size);
+    *out_allocation = (AAllocation){
+        .memory = block->memory,
+        .offset = offset,
+        .size = memReqs.size,
+        .memoryTypeIndex = memoryTypeIndex,
+        .mapped = block->mapped == NULL ? NULL : (char *)block->mapped + offset,
+        .block = block};
+    return 0;
+}
+
+int AAllocator_alloc(
+    AAllocator *allocator, VkMemoryRequirements memReqs, VkMemoryPropertyFlags properties,
+    AAllocationKind kind, AAllocation *out_allocation) {
+    return alloc(allocator, memReqs, properties, kind, NULL, out_allocation);
+}
+
+int AAllocator_alloc_elsewhere(
+    AAllocator *allocator, VkMemoryRequirements memReqs, VkMemoryPropertyFlags properties,
+    AAllocationKind kind, AMemoryBlock const *source, AAllocation *out_allocation) {
+    return alloc(allocator, memReqs, properties, kind, source, out_allocation);
+}
+
+void AAllocator_free(AAllocator *allocator, AAllocation allocation) {
+    AMemoryBlock *block = allocation.block;
+    if (block == NULL) return;
+    AMemoryStats_remove_allocation(&allocator->stats, block->memoryTypeIndex, allocation.size);
+    if (!AMemoryBlock_free(block, allocation.offset)) return;
+    // block is empty: keep at most one empty shared block per memory type
+    AMemoryBlock **link = allocator->blocks + block->memoryTypeIndex;
+    VkBool32 keep = !block->dedicated;
+    if (keep) {
+        for (AMemoryBlock *other = *link; other != NULL; other = other->next) {
+            if (other != block && !other->dedicated && other->used == 0) keep = VK_FALSE;
+        }
+    }
+    if (keep) return;
+    while (*link != block) link = &(*link)->next;
+    *link = block->next;
+    AMemoryBlock_destroy(allocator, block);
+}
@@ -0,0 +1,159 @@
+#include "atlas.h"
+#include "mipmap.h"
+#include "utils.h"
+#include <string.h>
+
+typedef struct ShelfItem {
+    uint32_t height;
+    uint32_t index;
+} ShelfItem;
+
+static int compare_items(void const *a, void const *b) {
+    ShelfItem const *x = a, *y = b;
+    if (x->height != y->height) return x->height < y->height ? 1 : -1;
+    return x->index < y->index ? -1 : x->index > y->index;
+}
+
+int pack_rects(
+    VkExtent2D const *sizes, uint32_t count, uint32_t width, uint32_t height, ARect *out_rects) {
+    ARR_ALLOC(ShelfItem, items, count);
+    for (uint32_t i = 0; i < count; i++) {
+        items[i] = (ShelfItem){.height = sizes[i].height, .index = i};
+    }
+    qsort(items, count, sizeof(*items), compare_items);
+    uint32_t x = 0, y = 0, shelfHeight = 0;
+    int res = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        VkExtent2D size = sizes[items[i].index];
+        if (x + size.width > width) {
+            y += shelfHeight;
+            x = 0;
+            shelfHeight = 0;
+        }
+        if (size.width > width || y + size.height > height) {
+            res = 1;
+            break;
+        }
+        out_rects[items[i].index] =
+            (ARect){.x = x, .y = y, .width = size.width, .height = size.height};
+        x += size.width;
+        shelfHeight = MAX(shelfHeight, size.height);
+    }
+    free(items);
+    return res;
+}
+
+int pack_texture_array(
+    ADecodedTexture const *const *textures, uint32_t count, ADecodedTexture *out_array) {
+    ATextureInfo info = textures[0]->info;
+    uint32_t stagedLevels = textures[0]->stagedLevels;
+    for (uint32_t i = 0; i < count; i++) {
+        ATextureInfo other = textures[i]->info;
+        if (other.width != info.width || other.height != info.height ||
+            other.format != info.format || other.layers != 1 ||
+            textures[i]->stagedLevels != stagedLevels) {
+            eprintff(MSG_ERRORF("texture %u does not match layer 0 of texture array"), i);
+            return 1;
+        }
+    }
+    info.layers = count;
+    VkDeviceSize size = count * mip_chain_size(info.format, info.width, info.height, stagedLevels);
+    ARR_ALLOC(uint8_t, texels, size);
+    if (texels == NULL) {
+        eprintff(
+            MSG_ERRORF("cannot allocate %ux%ux%u texture array"), info.width, info.height, count);
+        return 1;
+    }
+    for (uint32_t level = 0; level < stagedLevels; level++) {
+        size_t levelSize = mip_level_size(info.format, info.width, info.height, level);
+        VkDeviceSize srcOffset = mip_chain_size(info.format, info.width, info.height, level);
+        uint8_t *dst = texels + count * srcOffset;
+        for (uint32_t layer = 0; layer < count; layer++) {
+            copy_texels(dst + layer * levelSize, textures[layer], srcOffset, levelSize);
+        }
+    }
+    *out_array = (ADecodedTexture){
+        .info = info, .stagedLevels = stagedLevels, .size = size, .texels = texels};
+    return 0;
+}
+
+/*
+ * Copies level 0 of src into cell of dst centered in A_ATLAS_PADDING,
+ *  the rest of cell repeats edge texels
+ */
+static void copy_padded(
+    ADecodedTexture const *src, VkExtent2D extent, uint8_t *dst, uint32_t dstWidth, ARect cell) {
+    uint32_t const pad = A_ATLAS_PADDING;
+    size_t rowSize = (size_t)extent.width * 4;
+    for (uint32_t y = 0; y < cell.height; y++) {
+        uint32_t srcY = y < pad ? 0 : MIN(y - pad, extent.height - 1);
+        uint8_t *dstRow = dst + ((size_t)(cell.y + y) * dstWidth + cell.x) * 4;
+        copy_texels(dstRow + 4 * pad, src, srcY * rowSize, rowSize);
+        uint8_t const *row = dstRow + 4 * pad;
+        uint32_t x = 0;
+        for (; x < pad; x++) { memcpy(dstRow + 4 * x, row, 4); }
+        for (x += extent.width; x < cell.width; x++) {
+            memcpy(dstRow + 4 * x, row + rowSize - 4, 4);
+        }
+    }
+}
+
+int pack_texture_atlas(
+    ADecodedTexture const *const *textures, uint32_t count, VkBool32 blitMips,
+    ADecodedTexture *out_atlas, ARect *out_rects) {
+    uint32_t const pad = A_ATLAS_PADDING;
+    // cells are aligned to pad, so box filtered levels do not cross them
+    ARR_ALLOC(VkExtent2D, cells, count);
+    VkDeviceSize area = 0;
+    uint32_t minSide = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        ATextureInfo info = textures[i]->info;
+        cells[i] = (VkExtent2D){
+            .width = ALIGN_UP(info.width + 2 * pad, pad),
+            .height = ALIGN_UP(info.height + 2 * pad, pad)};
+        area += (VkDeviceSize)cells[i].width * cells[i].height;
+        minSide = MAX(minSide, MAX(cells[i].width, cells[i].height));
+    }
+    uint32_t side = pad;
+    while (side < minSide || (VkDeviceSize)side * side < area) { side *= 2; }
+    for (; side <= A_ATLAS_MAX_SIZE; side *= 2) {
+        if (pack_rects(cells, count, side, side, out_rects) == 0) break;
+    }
+    free(cells);
+    if (side > A_ATLAS_MAX_SIZE) {
+        eprintff(MSG_ERRORF("%u textures do not fit into %u atlas"), count, A_ATLAS_MAX_SIZE);
+        return 1;
+    }
+
+    ATextureInfo info = {
+        .width = side,
+        .height = side,
+        .mipLevels = MIN(A_ATLAS_MIP_LEVELS, mip_level_count(side, side)),
+        .layers = 1,
+        .format = textures[0]->info.format};
+    uint32_t stagedLevels = blitMips ? 1 : info.mipLevels;
+    VkDeviceSize size = mip_chain_size(info.format, side, side, stagedLevels);
+    // space between cells stays transparent
+    uint8_t *texels = calloc(size, 1);
+    if (texels == NULL) {
+        eprintff(MSG_ERRORF("cannot allocate %ux%u atlas"), side, side);
+        return 1;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        VkExtent2D extent = {.width = textures[i]->info.width, .height = textures[i]->info.height};
+        copy_padded(textures[i], extent, texels, side, out_rects[i]);
+        out_rects[i] = (ARect){
+            .x = out_rects[i].x + pad,
+            .y = out_rects[i].y + pad,
+            .width = extent.width,
+            .height = extent.height};
+    }
+    VkDeviceSize level0Size = (VkDeviceSize)side * side * 4;
+    if (generate_mip_chain_srgb(texels, side, side, stagedLevels, texels + level0Size) != 0) {
+        free(texels);
+        return 1;
+    }
+    *out_atlas = (ADecodedTexture){
+        .info = info, .stagedLevels = stagedLevels, .size = size, .texels = texels};
+    return 0;
+}
@@ -0,0 +1,194 @@
+#include "bindless.h"
+#include "utils.h"
+#include <string.h>
+
+// descriptor writes per vkUpdateDescriptorSets call
+#define WRITE_BATCH 64
+
+static VkDescriptorSetLayout create_table_layout(VkDevice device) {
+    VkDescriptorSetLayoutBinding bindings[] = {
+        {.binding = 0,
+         .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+         .descriptorCount = A_BINDLESS_IMAGE_SLOTS,
+         .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT},
+        {.binding = 1,
+         .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER,
+         .descriptorCount = A_BINDLESS_SAMPLER_SLOTS,
+         .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT}
+    };
+    // free and never written slots are fine as long as shaders do not read them
+    VkDescriptorBindingFlags bindingFlags[] = {
+        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT,
+        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT};
+    VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+        .bindingCount = ARR_LEN(bindingFlags),
+        .pBindingFlags = bindingFlags};
+    VkDescriptorSetLayoutCreateInfo info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = &flagsInfo,
+        .flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT,
+        .bindingCount = ARR_LEN(bindings),
+        .pBindings = bindings};
+    VkDescriptorSetLayout layout;
+    VkResult res = vkCreateDescriptorSetLayout(device, &info, NULL, &layout);
+    if (res != VK_SUCCESS) {
+        eprintff(MSG_ERRORF("cannot create bindless set layout: %d"), res);
+        return NULL;
+    }
+    return layout;
+}
+
+ABindlessTable *ABindlessTable_create(VkDevice device, uint32_t setCount) {
+    ARR_ALLOC(ABindlessTable, table, 1);
+    if (table == NULL) {
+        eprintff(MSG_ERRORF("cannot allocate bindless table"));
+        return NULL;
+    }
+    *table = (ABindlessTable){.device = device, .setCount = setCount};
+    table->layout = create_table_layout(device);
+    if (table->layout == NULL) goto no_layout;
+    VkDescriptorPoolSize poolSizes[] = {
+        {.type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+         .descriptorCount = setCount * A_BINDLESS_IMAGE_SLOTS},
+        {.type = VK_DESCRIPTOR_TYPE_SAMPLER,
+         .descriptorCount = setCount * A_BINDLESS_SAMPLER_SLOTS}
+    };
+    VkDescriptorPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
+        .maxSets = setCount,
+        .poolSizeCount = ARR_LEN(poolSizes),
+        .pPoolSizes = poolSizes};
+    VkResult res = vkCreateDescriptorPool(device, &poolInfo, NULL, &table->pool);
+    if (res != VK_SUCCESS) {
+        eprintff(MSG_ERRORF("cannot create bindless descriptor pool: %d"), res);
+        goto no_pool;
+    }
+    ARR_ALLOC(VkDescriptorSetLayout, layouts, setCount);
+    for (uint32_t i = 0; i < setCount; i++) { layouts[i] = table->layout; }
+    table->sets = ARR_INPLACE_ALLOC(VkDescriptorSet, setCount);
+    VkDescriptorSetAllocateInfo dsAInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = table->pool,
+        .descriptorSetCount = setCount,
+        .pSetLayouts = layouts};
+    res = vkAllocateDescriptorSets(device, &dsAInfo, table->sets);
+    free(layouts);
+    if (res != VK_SUCCESS) {
+        eprintff(MSG_ERRORF("cannot allocate bindless descriptor sets: %d"), res);
+        goto no_sets;
+    }
+    table->views = calloc(A_BINDLESS_IMAGE_SLOTS, sizeof(*table->views));
+    table->written = calloc(setCount * A_BINDLESS_IMAGE_SLOTS, sizeof(*table->written));
+    table->freeSlots = ARR_INPLACE_ALLOC(uint32_t, A_BINDLESS_IMAGE_SLOTS);
+    table->samplersWritten = calloc(setCount, sizeof(*table->samplersWritten));
+    if (table->views == NULL || table->written == NULL || table->freeSlots == NULL ||
+        table->samplersWritten == NULL) {
+        eprintff(MSG_ERRORF("cannot allocate bindless slots"));
+        goto no_slots;
+    }
+    return table;
+no_slots:
+    free(table->samplersWritten);
+    free(table->freeSlots);
+    free(table->written);
+    free(table->views);
+no_sets:
+    // sets go with the pool
+    free(table->sets);
+    vkDestroyDescriptorPool(device, table->pool, NULL);
+no_pool:
+    vkDestroyDescriptorSetLayout(device, table->layout, NULL);
+no_layout:
+    free(table);
+    return NULL;
+}
+
+void ABindlessTable_destroy(ABindlessTable *table) {
+    if (table == NULL) return;
+    vkDestroyDescriptorPool(table->device, table->pool, NULL);
+    vkDestroyDescriptorSetLayout(table->device, table->layout, NULL);
+    free(table->samplersWritten);
+    free(table->freeSlots);
+    free(table->written);
+    free(table->views);
+    free(table->sets);
+    free(table);
+}
+
+uint32_t ABindlessTable_add_image(ABindlessTable *table, VkImageView const *view) {
+    uint32_t slot;
+    if (table->freeCount > 0) slot = table->freeSlots[--table->freeCount];
+    else if (table->imageCount < A_BINDLESS_IMAGE_SLOTS) slot = table->imageCount++;
+    else {
+        eprintff(MSG_ERRORF("bindless table is out of image slots"));
+        return A_BINDLESS_NONE;
+    }
+    table->views[slot] = view;
+    return slot;
+}
+
+void ABindlessTable_remove_image(ABindlessTable *table, uint32_t slot) {
+    table->views[slot] = NULL;
+    // view may be destroyed and its handle reused, next one is written for sure
+    for (uint32_t i = 0; i < table->setCount; i++) {
+        table->written[i * A_BINDLESS_IMAGE_SLOTS + slot] = NULL;
+    }
+    table->freeSlots[table->freeCount++] = slot;
+}
+
+uint32_t ABindlessTable_add_sampler(ABindlessTable *table, VkSampler sampler) {
+    if (table->samplerCount == A_BINDLESS_SAMPLER_SLOTS) {
+        eprintff(MSG_ERRORF("bindless table is out of sampler slots"));
+        return A_BINDLESS_NONE;
+    }
+    table->samplers[table->samplerCount] = sampler;
+    return table->samplerCount++;
+}
+
+void ABindlessTable_update(ABindlessTable *table, uint32_t set) {
+    VkDescriptorSet dstSet = table->sets[set];
+    VkImageView *written = table->written + set * A_BINDLESS_IMAGE_SLOTS;
+    VkWriteDescriptorSet writes[WRITE_BATCH];
+    VkDescriptorImageInfo infos[WRITE_BATCH];
+    uint32_t count = 0;
+    uint32_t samplersWritten = table->samplersWritten[set];
+    if (samplersWritten < table->samplerCount) {
+        // samplers are only appended, one write covers the new ones
+        VkDescriptorImageInfo samplerInfos[A_BINDLESS_SAMPLER_SLOTS];
+        for (uint32_t i = samplersWritten; i < table->samplerCount; i++) {
+            samplerInfos[i] = (VkDescriptorImageInfo){.sampler = table->samplers[i]};
+        }
+        VkWriteDescriptorSet write = {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = dstSet,
+            .dstBinding = 1,
+            .dstArrayElement = samplersWritten,
+            .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER,
+            .descriptorCount = table->samplerCount - samplersWritten,
+            .pImageInfo = samplerInfos + samplersWritten};
+        vkUpdateDescriptorSets(table->device, 1, &write, 0, NULL);
+        table->samplersWritten[set] = table->samplerCount;
+    }
+    for (uint32_t slot = 0; slot < table->imageCount; slot++) {
+        if (table->views[slot] == NULL) continue;
+        VkImageView view = *table->views[slot];
+        if (view == written[slot]) continue;
+        infos[count] = (VkDescriptorImageInfo){
+            .imageView = view, .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+        writes[count] = (VkWriteDescriptorSet){
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = dstSet,
+            .dstBinding = 0,
+            .dstArrayElement = slot,
+            .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+            .descriptorCount = 1,
+            .pImageInfo = infos + count};
+        written[slot] = view;
+        if (++count < WRITE_BATCH) continue;
+        vkUpdateDescriptorSets(table->device, count, writes, 0, NULL);
+        count = 0;
+    }
+    if (count > 0) vkUpdateDescriptorSets(table->device, count, writes, 0, NULL);
+}
@@ -2,10 +2,15 @@
 #include "utils.h"
 #include <string.h>
 
-VkDescriptorSetLayout A_create_descriptor_set_layout(VkDevice device) {
+VkDescriptorSetLayout A_create_descriptor_set_layout(VkDevice device, VkBool32 withSampler) {
     VkDescriptorSetLayoutBinding bindings[] = {
         {.binding = 0,
-         .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+         .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+         .descriptorCount = 1,
+         .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+         .pImmutableSamplers = NULL},
+        {.binding = 2,
+         .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
          .descriptorCount = 1,
          .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
          .pImmutableSamplers = NULL},
@@ -17,7 +22,7 @@ VkDescriptorSetLayout A_create_descriptor_set_layout(VkDevice device) {
     };
     VkDescriptorSetLayoutCreateInfo info = {
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
-        .bindingCount = ARR_LEN(bindings),
+        .bindingCount = withSampler ? ARR_LEN(bindings) : 2,
         .pBindings = bindings};
     VkDescriptorSetLayout descriptorSetLayout;
     VkResult res = vkCreateDescriptorSetLayout(device, &info, NULL, &descriptorSetLayout);
@@ -29,21 +34,62 @@ VkDescriptorSetLayout A_create_descriptor_set_layout(VkDevice device) {
 }
 
 int32_t find_memory_type(
-    VkPhysicalDevice pdevice, uint32_t typeFilter, VkMemoryPropertyFlagBits properties) {
-    VkPhysicalDeviceMemoryProperties memProps;
-    vkGetPhysicalDeviceMemoryProperties(pdevice, &memProps);
-    for (uint32_t i = 0; i < memProps.memoryTypeCount; i++) {
+    VkPhysicalDeviceMemoryProperties const *memProps, uint32_t typeFilter,
+    VkMemoryPropertyFlagBits properties) {
+    for (uint32_t i = 0; i < memProps->memoryTypeCount; i++) {
         if (typeFilter & (1 << i)) {
-            uint32_t propFlags = memProps.memoryTypes[i].propertyFlags & properties;
+            uint32_t propFlags = memProps->memoryTypes[i].propertyFlags & properties;
             if (propFlags == properties) return (int32_t)i;
         }
     }
     return -1;
 }
 
+VkMemoryPropertyFlags device_local_properties(AMemoryStats const *stats, uint32_t typeFilter) {
+    if (stats->deviceType != VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU &&
+        stats->deviceType != VK_PHYSICAL_DEVICE_TYPE_CPU)
+        return VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    VkPhysicalDeviceMemoryProperties const *memProps = &stats->props;
+    int32_t unified = find_memory_type(memProps, typeFilter, A_UNIFIED_MEMORY_PROPERTIES);
+    if (unified == -1) return VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    VkDeviceSize largest = 0;
+    for (uint32_t i = 0; i < memProps->memoryHeapCount; i++) {
+        VkMemoryHeap heap = memProps->memoryHeaps[i];
+        if (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) largest = MAX(largest, heap.size);
+    }
+    VkDeviceSize size = memProps->memoryHeaps[memProps->memoryTypes[unified].heapIndex].size;
+    return size == largest ? A_UNIFIED_MEMORY_PROPERTIES : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+}
+
+/*
+ * 0 on success
+ * 1 on failure
+ */
+static int bind_buffer_memory(
+    VkDevice device, AAllocator *allocator, VkBuffer buffer,
+    VkMemoryPropertyFlags memoryProperties, AAllocation *out_allocation) {
+    VkMemoryRequirements memReqs;
+    vkGetBufferMemoryRequirements(device, buffer, &memReqs);
+    AAllocation allocation;
+    int allocRes =
+        AAllocator_alloc(allocator, memReqs, memoryProperties, A_ALLOCATION_LINEAR, &allocation);
+    if (allocRes != 0) {
+        eprintff(MSG_ERRORF("cannot allocate buffer memory"));
+        return 1;
+    }
+    VkResult res = vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset);
+    if (res != VK_SUCCESS) {
+        eprintff(MSG_ERRORF("cannot bind buffer memory: %d"), res);
+        AAllocator_free(allocator, allocation);
+        return 1;
+    }
+    *out_allocation = allocation;
+    return 0;
+}
+
 VkBuffer create_buffer(
-    VkDevice device, VkPhysicalDevice pdevice, uint32_t bufferSize, VkBufferUsageFlags bufferUsage,
-    VkMemoryPropertyFlagBits memoryProperties, VkDeviceMemory *out_bufferMemory) {
+    VkDevice device, AAllocator *allocator, uint32_t bufferSize, VkBufferUsageFlags bufferUsage,
+    VkMemoryPropertyFlagBits memoryProperties, AAllocation *out_allocation) {
     VkBufferCreateInfo bcInfo = {
         .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
         .size = bufferSize,
@@ -55,117 +101,62 @@ VkBuffer create_buffer(
         eprintff(MSG_ERRORF("cannot create buffer: %d"), res);
         return NULL;
     }
-    VkMemoryRequirements memReqs;
-    vkGetBufferMemoryRequirements(device, buffer, &memReqs);
-    int32_t memoryTypeIndex = find_memory_type(pdevice, memReqs.memoryTypeBits, memoryProperties);
-    if (memoryTypeIndex == -1) {
-        eprintff(MSG_ERRORF("no suitable memory type"));
-        goto cleanup;
-    }
-    VkMemoryAllocateInfo allocInfo = {
-        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-        .allocationSize = memReqs.size,
-        .memoryTypeIndex = memoryTypeIndex};
-    if (out_bufferMemory != NULL) {
-        VkDeviceMemory bufMem = NULL;
-        res = vkAllocateMemory(device, &allocInfo, NULL, &bufMem);
-        if (res != VK_SUCCESS) {
-            eprintff(MSG_ERRORF("cannot allocate memory: %d"), res);
-            goto cleanup;
-        }
-        res = vkBindBufferMemory(device, buffer, bufMem, 0);
-        if (res != VK_SUCCESS) {
-            eprintff(MSG_ERRORF("cannot bind buffer memory: %d"), res);
-            vkFreeMemory(device, bufMem, NULL);
-            goto cleanup;
-        }
-        *out_bufferMemory = bufMem;
+    if (out_allocation != NULL &&
+        bind_buffer_memory(device, allocator, buffer, memoryProperties, out_allocation) != 0) {
+        vkDestroyBuffer(device, buffer, NULL);
+        return NULL;
     }
     return buffer;
-cleanup:
+}
+
+/*
+ * Prefers unified memory, falls back to device local memory
+ */
+static VkBuffer create_device_local_buffer(
+    VkDevice device, AAllocator *allocator, uint32_t bufferSize, VkBufferUsageFlags bufferUsage,
+    AAllocation *out_allocation) {
+    VkBuffer buffer = create_buffer(device, allocator, bufferSize, bufferUsage, 0, NULL);
+    if (buffer == NULL || out_allocation == NULL) return buffer;
+    VkMemoryRequirements memReqs;
+    vkGetBufferMemoryRequirements(device, buffer, &memReqs);
+    VkMemoryPropertyFlags memProps =
+        device_local_properties(&allocator->stats, memReqs.memoryTypeBits);
+    if (bind_buffer_memory(device, allocator, buffer, memProps, out_allocation) == 0) return buffer;
+    if (memProps != VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT &&
+        bind_buffer_memory(
+            device, allocator, buffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, out_allocation) == 0)
+        return buffer;
     vkDestroyBuffer(device, buffer, NULL);
     return NULL;
 }
 
 VkBuffer create_staging_buffer(
-    VkDevice device, VkPhysicalDevice pdevice, uint32_t bufferSize,
-    VkDeviceMemory *out_bufferMemory) {
+    VkDevice device, AAllocator *allocator, uint32_t bufferSize, AAllocation *out_allocation) {
     VkBufferUsageFlags usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
     VkMemoryPropertyFlagBits memProps =
         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-    return create_buffer(device, pdevice, bufferSize, usage, memProps, out_bufferMemory);
+    return create_buffer(device, allocator, bufferSize, usage, memProps, out_allocation);
 }
 
 VkBuffer create_vertex_buffer(
-    VkDevice device, VkPhysicalDevice pdevice, uint32_t bufferSize,
-    VkDeviceMemory *out_bufferMemory) {
-    VkBufferUsageFlags usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
-    VkMemoryPropertyFlagBits memProps = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-    return create_buffer(device, pdevice, bufferSize, usage, memProps, out_bufferMemory);
+    VkDevice device, AAllocator *allocator, uint32_t bufferSize, AAllocation *out_allocation) {
+    return create_device_local_buffer(
+        device, allocator, bufferSize, A_VERTEX_BUFFER_USAGE, out_allocation);
 }
 
 VkBuffer create_index_buffer(
-    VkDevice device, VkPhysicalDevice pdevice, uint32_t bufferSize,
-    VkDeviceMemory *out_bufferMemory) {
-    VkBufferUsageFlags usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
-    VkMemoryPropertyFlagBits memProps = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-    return create_buffer(device, pdevice, bufferSize, usage, memProps, out_bufferMemory);
-}
-
-VkBuffer *create_uniform_buffers(
-    VkDevice device, VkPhysicalDevice pdevice, uint32_t count, uint32_t buffersSize,
-    VkDeviceMemory **out_bufferMemories, void ***out_buffersMapped) {
-    ARR_ALLOC(VkBuffer, buffers, count);
-    ARR_ALLOC(VkDeviceMemory, memories, count);
-    ARR_ALLOC(void *, mappedMemories, count);
-    uint32_t successful = 0;
-    VkBufferUsageFlags usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
-    VkMemoryPropertyFlagBits memProps =
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-    // create buffers
-    for (uint32_t i = 0; i < count; i++) {
-        VkBuffer buffer =
-            create_buffer(device, pdevice, buffersSize, usage, memProps, memories + i);
-        if (buffer == NULL) {
-            successful = i; // this buffer is not created
-            goto cleanup;
-        }
-        buffers[i] = buffer;
-    }
-    // map memory to areas
-    uint32_t mapSuccessful = 0;
-    for (uint32_t i = 0; i < count; i++) {
-        VkResult res = vkMapMemory(device, memories[i], 0, buffersSize, 0, mappedMemories + i);
-        if (res != VK_SUCCESS) {
-            eprintff(MSG_ERRORF("cannot map buffer memory: %d"), res);
-            successful = count;
-            mapSuccessful = i;
-            goto unmap;
-        }
-    }
-    *out_bufferMemories = memories;
-    *out_buffersMapped = mappedMemories;
-    return buffers;
-unmap:
-    for (uint32_t i = 0; i < mapSuccessful; i++) { vkUnmapMemory(device, memories[i]); }
-cleanup:
-    for (uint32_t i = 0; i < successful; i++) { vkDestroyBuffer(device, buffers[i], NULL); }
-    free(mappedMemories);
-    free(memories);
-    free(buffers);
-    *out_bufferMemories = NULL;
-    *out_buffersMapped = NULL;
-    return NULL;
+    VkDevice device, AAllocator *allocator, uint32_t bufferSize, AAllocation *out_allocation) {
+    return create_device_local_buffer(
+        device, allocator, bufferSize, A_INDEX_BUFFER_USAGE, out_allocation);
 }
 
-int fill_buffer(VkDevice device, VkDeviceMemory bufferMemory, void *data, FillBufferParams args) {
-    void *mapData;
-    VkResult res = vkMapMemory(device, bufferMemory, args.bufferOffset, args.size, 0, &mapData);
-    if (res != VK_SUCCESS) {
-        eprintff(MSG_ERRORF("map memory failed: %d"), res);
+int fill_buffer(AAllocation allocation, void const *data, FillBufferParams args) {
+    if (allocation.mapped == NULL) {
+        eprintff(MSG_ERRORF("memory is not host visible"));
         return 1;
     }
-    memcpy(mapData, data, (size_t)args.size);
-    vkUnmapMemory(device, bufferMemory);
+    memcpy(
+        (char *)allocation.mapped + args.bufferOffset, (char const *)data + args.dataOffset,
+        (size_t)args.size);
     return 0;
 }
@@ -1,4 +1,6 @@
 #include "command.h"
+#include "bindless.h"
+#include "hash.h"
 #include "utils.h"
 
 VkCommandPool A_create_command_pool(VkDevice device, uint32_t graphicsFamilyIndex) {
@@ -48,11 +50,12 @@ VkCommandBuffer cmd_begin_one_time(VkDevice device, VkCommandPool commandPool) {
 }
 
 void cmd_end_one_time(
-    VkDevice device, VkCommandPool commandPool, VkQueue drawQueue, VkCommandBuffer cb) {
+    VkDevice device, VkCommandPool commandPool, VkQueue drawQueue, VkCommandBuffer cb,
+    VkFence fence) {
     vkEndCommandBuffer(cb);
     VkSubmitInfo sInfo = {
         .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO, .commandBufferCount = 1, .pCommandBuffers = &cb};
-    vkQueueSubmit(drawQueue, 1, &sInfo, NULL);
+    vkQueueSubmit(drawQueue, 1, &sInfo, fence);
     vkQueueWaitIdle(drawQueue);
     vkFreeCommandBuffers(device, commandPool, 1, &cb);
 }
@@ -62,7 +65,8 @@ void cmd_end_one_time(
  * 1 if buffer copy failed
  */
 int copy_buffer(
-    VkDevice device, VkCommandPool commandPool, VkQueue drawQueue, ACopyBufferParams args) {
+    VkDevice device, VkCommandPool commandPool, VkQueue drawQueue, ACopyBufferParams args,
+    VkFence fence) {
     if (args.size == 0) return 0;
 
     VkCommandBuffer cb = cmd_begin_one_time(device, commandPool);
@@ -71,45 +75,105 @@ int copy_buffer(
         .srcOffset = args.srcOffset, .dstOffset = args.dstOffset, .size = args.size};
     vkCmdCopyBuffer(cb, args.src, args.dst, 1, &copyRegion);
 
-    cmd_end_one_time(device, commandPool, drawQueue, cb);
+    cmd_end_one_time(device, commandPool, drawQueue, cb, fence);
     return 0;
 }
 
-void record_command_buffer(
-    VkRenderPass renderPass, VkFramebuffer const *framebuffers, VkExtent2D swapchainExtent,
-    VkCommandBuffer const *commandBuffers, VkViewport viewport, VkRect2D scissor,
-    VkPipeline pipeline, VkPipelineLayout plLayout, uint32_t currentFrame, uint32_t imageIndex,
-    ARecordCmdBuffersParams args) {
-    VkCommandBufferBeginInfo cbBInfo = {.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+void cmd_begin_frame_pass(
+    VkCommandBuffer cmdBuf, VkRenderPass renderPass, VkFramebuffer framebuffer,
+    VkExtent2D swapchainExtent, VkSubpassContents contents) {
     VkClearValue clearValue = {.color = {.float32 = {.325, .375, .75, 0.}}};
     VkRenderPassBeginInfo rpBInfo = {
         .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
         .renderPass = renderPass,
-        .framebuffer = framebuffers[imageIndex],
+        .framebuffer = framebuffer,
         .renderArea = (VkRect2D){.offset = {0, 0}, .extent = swapchainExtent},
         .clearValueCount = 1,
         .pClearValues = &clearValue
     };
-    VkCommandBuffer cmdBuf = commandBuffers[currentFrame];
-    VkResult res = vkBeginCommandBuffer(cmdBuf, &cbBInfo);
-    if (res != VK_SUCCESS) {
-        eprintff(MSG_ERRORF("vkBeginCommandBuffer: %d"), res);
-        return;
-    }
-    vkCmdBeginRenderPass(cmdBuf, &rpBInfo, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBeginRenderPass(cmdBuf, &rpBInfo, contents);
+}
+
+void record_draw_range(
+    VkCommandBuffer cmdBuf, VkViewport viewport, VkRect2D scissor, VkPipeline pipeline,
+    VkPipelineLayout plLayout, uint32_t currentFrame, ARecordCmdBuffersParams args,
+    uint32_t first, uint32_t count) {
     vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
     vkCmdSetViewport(cmdBuf, 0, 1, &viewport);
     vkCmdSetScissor(cmdBuf, 0, 1, &scissor);
     vkCmdBindVertexBuffers(cmdBuf, 0, 1, &args.vBuffer, (VkDeviceSize[]){0});
     vkCmdBindIndexBuffer(cmdBuf, args.iBuffer, 0, VulkanIndexType);
-    vkCmdBindDescriptorSets(
-        cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, plLayout, 0, 1, args.descriptorSets + currentFrame,
-        0, NULL);
-    vkCmdDrawIndexed(cmdBuf, args.indexCount, 1, args.indexOffset, 0, 0);
+    if (args.bindlessSets != NULL)
+        vkCmdBindDescriptorSets(
+            cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, plLayout, A_BINDLESS_SET, 1,
+            args.bindlessSets + currentFrame, 0, NULL);
+    for (uint32_t i = first; i < first + count; i++) {
+        ADraw draw = args.draws[i];
+        // in binding order: Camera, Object
+        uint32_t dynamicOffsets[] = {args.uniformOffset, draw.objectOffset};
+        vkCmdBindDescriptorSets(
+            cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, plLayout, 0, 1,
+            args.descriptorSets + currentFrame, ARR_LEN(dynamicOffsets), dynamicOffsets);
+        vkCmdPushConstants(
+            cmdBuf, plLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(draw.constants),
+            &draw.constants);
+        vkCmdDrawIndexed(cmdBuf, draw.indexCount, 1, draw.firstIndex, 0, 0);
+    }
+}
+
+void record_command_buffer(
+    VkRenderPass renderPass, VkFramebuffer const *framebuffers, VkExtent2D swapchainExtent,
+    VkCommandBuffer cmdBuf, VkViewport viewport, VkRect2D scissor, VkPipeline pipeline,
+    VkPipelineLayout plLayout, uint32_t currentFrame, uint32_t imageIndex,
+    ARecordCmdBuffersParams args) {
+    VkCommandBufferBeginInfo cbBInfo = {.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    VkResult res = vkBeginCommandBuffer(cmdBuf, &cbBInfo);
+    if (res != VK_SUCCESS) {
+        eprintff(MSG_ERRORF("vkBeginCommandBuffer: %d"), res);
+        return;
+    }
+    AGpuProfiler *profiler = args.profiler;
+    uint32_t passScope = AGpuProfiler_scope(profiler, "render pass");
+    uint32_t drawScope = AGpuProfiler_scope(profiler, "draws");
+    AGpuProfiler_reset(profiler, cmdBuf, currentFrame);
+    AGpuProfiler_begin(profiler, cmdBuf, currentFrame, passScope);
+    cmd_begin_frame_pass(
+        cmdBuf, renderPass, framebuffers[imageIndex], swapchainExtent,
+        VK_SUBPASS_CONTENTS_INLINE);
+    AGpuProfiler_begin(profiler, cmdBuf, currentFrame, drawScope);
+    record_draw_range(
+        cmdBuf, viewport, scissor, pipeline, plLayout, currentFrame, args, 0, args.drawCount);
+    AGpuProfiler_end(profiler, cmdBuf, currentFrame, drawScope);
     vkCmdEndRenderPass(cmdBuf);
+    AGpuProfiler_end(profiler, cmdBuf, currentFrame, passScope);
     res = vkEndCommandBuffer(cmdBuf);
     if (res != VK_SUCCESS) {
         eprintff(MSG_ERRORF("vkEndCommandBuffer: %d"), res);
         return;
     }
 }
+
+uint64_t record_state_key(
+    VkRenderPass renderPass, VkFramebuffer const *framebuffers, VkExtent2D swapchainExtent,
+    VkViewport viewport, VkRect2D scissor, VkPipeline pipeline, VkPipelineLayout plLayout,
+    uint32_t currentFrame, uint32_t imageIndex, ARecordCmdBuffersParams args) {
+    // handles are hashed one by one, structs of them may have padding
+    uint64_t hash = A_FNV_OFFSET;
+    hash = fnv1a(hash, &renderPass, sizeof(renderPass));
+    hash = fnv1a(hash, framebuffers + imageIndex, sizeof(*framebuffers));
+    hash = fnv1a(hash, &swapchainExtent, sizeof(swapchainExtent));
+    hash = fnv1a(hash, &viewport, sizeof(viewport));
+    hash = fnv1a(hash, &scissor, sizeof(scissor));
+    hash = fnv1a(hash, &pipeline, sizeof(pipeline));
+    hash = fnv1a(hash, &plLayout, sizeof(plLayout));
+    hash = fnv1a(hash, &args.vBuffer, sizeof(args.vBuffer));
+    hash = fnv1a(hash, &args.iBuffer, sizeof(args.iBuffer));
+    hash = fnv1a(hash, args.descriptorSets + currentFrame, sizeof(*args.descriptorSets));
+    hash = fnv1a(hash, &args.uniformOffset, sizeof(args.uniformOffset));
+    if (args.bindlessSets != NULL)
+        hash = fnv1a(hash, args.bindlessSets + currentFrame, sizeof(*args.bindlessSets));
+    hash = fnv1a(hash, &args.drawCount, sizeof(args.drawCount));
+    if (args.drawCount > 0) hash = fnv1a(hash, args.draws, args.drawCount * sizeof(*args.draws));
+    hash = fnv1a(hash, &args.profiler, sizeof(args.profiler));
+    return hash;
+}
@@ -0,0 +1,127 @@
+#include "command_cache.h"
+#include "command.h"
+#include "utils.h"
+#include <string.h>
+
+/*
+ * 0 on success
+ * 1 on failure
+ */
+static int allocate_buffers(ACommandCache *cache, uint32_t imageCount) {
+    uint32_t count = cache->frameCount * imageCount * A_COMMAND_CACHE_WAYS;
+    VkCommandBuffer *buffers = A_create_command_buffers(cache->device, cache->pool, count);
+    uint64_t *keys = calloc(count, sizeof(*keys));
+    uint64_t *lastUsed = calloc(count, sizeof(*lastUsed));
+    if (buffers == NULL || keys == NULL || lastUsed == NULL) {
+        if (buffers != NULL) vkFreeCommandBuffers(cache->device, cache->pool, count, buffers);
+        free(buffers);
+        free(keys);
+        free(lastUsed);
+        return 1;
+    }
+    cache->imageCount = imageCount;
+    cache->buffers = buffers;
+    cache->keys = keys;
+    cache->lastUsed = lastUsed;
+    return 0;
+}
+
+static void free_buffers(ACommandCache *cache) {
+    uint32_t count = cache->frameCount * cache->imageCount * A_COMMAND_CACHE_WAYS;
+    if (cache->buffers != NULL)
+        vkFreeCommandBuffers(cache->device, cache->pool, count, cache->buffers);
+    free(cache->buffers);
+    free(cache->keys);
+    free(cache->lastUsed);
+    cache->imageCount = 0;
+    cache->buffers = NULL;
+    cache->keys = NULL;
+    cache->lastUsed = NULL;
+}
+
+ACommandCache *ACommandCache_create(
+    VkDevice device, ARetireQueue *retire, uint32_t graphicsFamilyIndex, uint32_t frameCount,
+    uint32_t imageCount) {
+    ACommandCache *cache = ARR_INPLACE_ALLOC(ACommandCache, 1);
+    if (cache == NULL) return NULL;
+    // own pool, resets of the per frame pool leave recordings alone
+    VkCommandPool pool = A_create_command_pool(device, graphicsFamilyIndex);
+    if (pool == NULL) goto no_pool;
+    *cache = (ACommandCache){
+        .device = device,
+        .retire = retire,
+        .graphicsFamilyIndex = graphicsFamilyIndex,
+        .pool = pool,
+        .frameCount = frameCount};
+    if (allocate_buffers(cache, imageCount) != 0) {
+        eprintff(MSG_ERRORF("cannot allocate cached command buffers"));
+        goto no_buffers;
+    }
+    return cache;
+no_buffers:
+    vkDestroyCommandPool(device, pool, NULL);
+no_pool:
+    free(cache);
+    return NULL;
+}
+
+void ACommandCache_destroy(ACommandCache *cache) {
+    if (cache == NULL) return;
+    free_buffers(cache);
+    vkDestroyCommandPool(cache->device, cache->pool, NULL);
+    free(cache);
+}
+
+int ACommandCache_reset(ACommandCache *cache, uint32_t imageCount) {
+    uint32_t count = cache->frameCount * cache->imageCount * A_COMMAND_CACHE_WAYS;
+    if (imageCount == cache->imageCount && cache->buffers != NULL) {
+        memset(cache->keys, 0, count * sizeof(*cache->keys));
+        memset(cache->lastUsed, 0, count * sizeof(*cache->lastUsed));
+        return 0;
+    }
+    // buffers of frames in flight may be pending, they are freed with their pool
+    if (cache->pool != NULL)
+        ARetireQueue_push(
+            cache->retire, (ARetired){.kind = A_RETIRED_COMMAND_POOL, .commandPool = cache->pool});
+    free(cache->buffers);
+    free(cache->keys);
+    free(cache->lastUsed);
+    cache->imageCount = 0;
+    cache->buffers = NULL;
+    cache->keys = NULL;
+    cache->lastUsed = NULL;
+    cache->pool = A_create_command_pool(cache->device, cache->graphicsFamilyIndex);
+    if (cache->pool == NULL || allocate_buffers(cache, imageCount) != 0) {
+        eprintff(MSG_ERRORF("cannot allocate cached command buffers"));
+        return 1;
+    }
+    return 0;
+}
+
+VkCommandBuffer ACommandCache_lookup(
+    ACommandCache *cache, uint32_t frame, uint32_t image, uint64_t key, VkBool32 *out_record) {
+    if (cache->buffers == NULL || frame >= cache->frameCount || image >= cache->imageCount)
+        return NULL;
+    uint32_t base = (frame * cache->imageCount + image) * A_COMMAND_CACHE_WAYS;
+    uint32_t victim = base;
+    if (key == 0) key = 1; // 0 marks empty ways
+    cache->lookups++;
+    for (uint32_t i = base; i < base + A_COMMAND_CACHE_WAYS; i++) {
+        if (cache->keys[i] == key) {
+            cache->lastUsed[i] = cache->lookups;
+            *out_record = VK_FALSE;
+            return cache->buffers[i];
+        }
+        if (cache->lastUsed[i] < cache->lastUsed[victim]) victim = i;
+    }
+    VkResult res = vkResetCommandBuffer(cache->buffers[victim], 0);
+    if (res != VK_SUCCESS) {
+        eprintff(MSG_ERRORF("cannot reset cached command buffer: %d"), res);
+        return NULL;
+    }
+    cache->keys[victim] = key;
+    cache->lastUsed[victim] = cache->lookups;
+    cache->recordings++;
+    *out_record = VK_TRUE;
+    return cache->buffers[victim];
+}
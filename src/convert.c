@@ -0,0 +1,273 @@
+#include "convert.h"
+#include "utils.h"
+#include <math.h>
+#include <string.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+void convert_rgb_to_rgba(uint8_t *dst, uint8_t const *src, size_t texels) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    // each lane gets four texels, then bytes are spread within lanes
+    __m256i const lanes = _mm256_setr_epi32(0, 1, 2, 0, 3, 4, 5, 0);
+    __m256i const spread = _mm256_setr_epi8(
+        0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8,
+        -1, 9, 10, 11, -1);
+    __m256i const alpha = _mm256_set1_epi32((int)0xff000000);
+    // 32 bytes are loaded for 24
+    for (; 3 * i + 32 <= 3 * texels; i += 8) {
+        __m256i v = _mm256_loadu_si256((__m256i const *)(src + 3 * i));
+        v = _mm256_shuffle_epi8(_mm256_permutevar8x32_epi32(v, lanes), spread);
+        _mm256_storeu_si256((__m256i *)(dst + 4 * i), _mm256_or_si256(v, alpha));
+    }
+#elif defined(__SSE2__)
+    // texel k is shifted up by k bytes, no byte shuffle before SSSE3
+    __m128i const mask = _mm_set1_epi32(0x00ffffff);
+    __m128i const alpha = _mm_set1_epi32((int)0xff000000);
+    // 16 bytes are loaded for 12
+    for (; 3 * i + 16 <= 3 * texels; i += 4) {
+        __m128i v = _mm_loadu_si128((__m128i const *)(src + 3 * i));
+        __m128i t0 = _mm_and_si128(v, _mm_set_epi32(0, 0, 0, 0x00ffffff));
+        __m128i t1 = _mm_and_si128(_mm_slli_si128(v, 1), _mm_set_epi32(0, 0, 0x00ffffff, 0));
+        __m128i t2 = _mm_and_si128(_mm_slli_si128(v, 2), _mm_set_epi32(0, 0x00ffffff, 0, 0));
+        __m128i t3 = _mm_and_si128(_mm_slli_si128(v, 3), _mm_set_epi32(0x00ffffff, 0, 0, 0));
+        __m128i out = _mm_or_si128(_mm_or_si128(t0, t1), _mm_or_si128(t2, t3));
+        out = _mm_or_si128(_mm_and_si128(out, mask), alpha);
+        _mm_storeu_si128((__m128i *)(dst + 4 * i), out);
+    }
+#endif
+    for (; i < texels; i++) {
+        dst[4 * i + 0] = src[3 * i + 0];
+        dst[4 * i + 1] = src[3 * i + 1];
+        dst[4 * i + 2] = src[3 * i + 2];
+        dst[4 * i + 3] = 255;
+    }
+}
+
+// c * a / 255 rounded, exact for 8-bit c and a
+#define MUL_DIV255(c, a) ((((c) * (a) + 128) + (((c) * (a) + 128) >> 8)) >> 8)
+
+void premultiply_alpha(uint8_t *dst, uint8_t const *src, size_t texels) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    __m256i const zero = _mm256_setzero_si256();
+    __m256i const bias = _mm256_set1_epi16(128);
+    __m256i const alphaWords = _mm256_set1_epi64x((long long)0xffff000000000000ull);
+    // 8 texels, 16-bit products of two texels per 64 bits
+    for (; i + 8 <= texels; i += 8) {
+        __m256i v = _mm256_loadu_si256((__m256i const *)(src + 4 * i));
+        __m256i halves[2] = {_mm256_unpacklo_epi8(v, zero), _mm256_unpackhi_epi8(v, zero)};
+        for (uint32_t h = 0; h < 2; h++) {
+            __m256i x = halves[h];
+            __m256i a = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(x, 0xff), 0xff);
+            __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(x, a), bias);
+            t = _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+            halves[h] = _mm256_blendv_epi8(t, x, alphaWords);
+        }
+        // unpack and pack both stay within lanes, order is kept
+        _mm256_storeu_si256((__m256i *)(dst + 4 * i), _mm256_packus_epi16(halves[0], halves[1]));
+    }
+#elif defined(__SSE2__)
+    __m128i const zero = _mm_setzero_si128();
+    __m128i const bias = _mm_set1_epi16(128);
+    __m128i const alphaWords = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+    for (; i + 4 <= texels; i += 4) {
+        __m128i v = _mm_loadu_si128((__m128i const *)(src + 4 * i));
+        __m128i halves[2] = {_mm_unpacklo_epi8(v, zero), _mm_unpackhi_epi8(v, zero)};
+        for (uint32_t h = 0; h < 2; h++) {
+            __m128i x = halves[h];
+            __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, 0xff), 0xff);
+            __m128i t = _mm_add_epi16(_mm_mullo_epi16(x, a), bias);
+            t = _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+            halves[h] = _mm_or_si128(_mm_andnot_si128(alphaWords, t), _mm_and_si128(alphaWords, x));
+        }
+        _mm_storeu_si128((__m128i *)(dst + 4 * i), _mm_packus_epi16(halves[0], halves[1]));
+    }
+#endif
+    for (; i < texels; i++) {
+        uint32_t a = src[4 * i + 3];
+        dst[4 * i + 0] = (uint8_t)MUL_DIV255(src[4 * i + 0], a);
+        dst[4 * i + 1] = (uint8_t)MUL_DIV255(src[4 * i + 1], a);
+        dst[4 * i + 2] = (uint8_t)MUL_DIV255(src[4 * i + 2], a);
+        dst[4 * i + 3] = (uint8_t)a;
+    }
+}
+
+void init_srgb_tables(ASrgbTables *tables) {
+    for (uint32_t i = 0; i < 256; i++) {
+        float c = i / 255.f;
+        float l = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+        tables->toLinear[i] = (uint16_t)(l * 65535.f + .5f);
+    }
+    for (uint32_t i = 0; i < 4096; i++) {
+        float l = (i + .5f) / 4096.f;
+        float c = l <= 0.0031308f ? l * 12.92f : 1.055f * powf(l, 1 / 2.4f) - 0.055f;
+        tables->toSrgb[i] = (uint8_t)(MIN(c, 1.f) * 255.f + .5f);
+    }
+    // only read by gathers past the last entry, masked off
+    memset(tables->toLinear + 256, 0, sizeof(tables->toLinear) - 256 * sizeof(uint16_t));
+    memset(tables->toSrgb + 4096, 0, sizeof(tables->toSrgb) - 4096);
+}
+
+// alpha of 16-bit value to 8-bit, (x + 128) / 257 with shifts
+#define NARROW_ALPHA(x) ((((x) + 128) - (((x) + 128) >> 8)) >> 8)
+
+// no gather before AVX2, SSE2 builds use the scalar table lookups
+void convert_srgb_to_linear(
+    ASrgbTables const *tables, uint16_t *dst, uint8_t const *src, size_t texels) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    __m256i const low = _mm256_set1_epi32(0xffff);
+    __m256i const wide = _mm256_set1_epi32(257);
+    // 4 texels, a gather of 2 texels each
+    for (; i + 4 <= texels; i += 4) {
+        __m256i packed[2];
+        for (uint32_t h = 0; h < 2; h++) {
+            __m128i chunk = _mm_loadl_epi64((__m128i const *)(src + 4 * i + 8 * h));
+            __m256i x = _mm256_cvtepu8_epi32(chunk);
+            __m256i l = _mm256_and_si256(
+                _mm256_i32gather_epi32((int const *)tables->toLinear, x, 2), low);
+            packed[h] = _mm256_blend_epi32(l, _mm256_mullo_epi32(x, wide), 0x88);
+        }
+        __m256i out = _mm256_packus_epi32(packed[0], packed[1]);
+        out = _mm256_permute4x64_epi64(out, 0xd8); // 0, 2, 1, 3
+        _mm256_storeu_si256((__m256i *)(dst + 4 * i), out);
+    }
+#endif
+    for (; i < texels; i++) {
+        dst[4 * i + 0] = tables->toLinear[src[4 * i + 0]];
+        dst[4 * i + 1] = tables->toLinear[src[4 * i + 1]];
+        dst[4 * i + 2] = tables->toLinear[src[4 * i + 2]];
+        dst[4 * i + 3] = (uint16_t)(src[4 * i + 3] * 257);
+    }
+}
+
+void convert_linear_to_srgb(
+    ASrgbTables const *tables, uint8_t *dst, uint16_t const *src, size_t texels) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    __m256i const low = _mm256_set1_epi32(0xff);
+    __m256i const bias = _mm256_set1_epi32(128);
+    // 4 texels, a gather of 2 texels each
+    for (; i + 4 <= texels; i += 4) {
+        __m256i packed[2];
+        for (uint32_t h = 0; h < 2; h++) {
+            __m128i chunk = _mm_loadu_si128((__m128i const *)(src + 4 * i + 8 * h));
+            __m256i x = _mm256_cvtepu16_epi32(chunk);
+            __m256i c = _mm256_and_si256(
+                _mm256_i32gather_epi32(
+                    (int const *)tables->toSrgb, _mm256_srli_epi32(x, 4), 1),
+                low);
+            __m256i a = _mm256_add_epi32(x, bias);
+            a = _mm256_srli_epi32(_mm256_sub_epi32(a, _mm256_srli_epi32(a, 8)), 8);
+            packed[h] = _mm256_blend_epi32(c, a, 0x88);
+        }
+        // lanes hold texels 0, 2 and 1, 3 after packing, dwords are put back in order
+        __m256i words = _mm256_packus_epi32(packed[0], packed[1]);
+        __m256i bytes = _mm256_packus_epi16(words, words);
+        bytes = _mm256_permutevar8x32_epi32(bytes, _mm256_setr_epi32(0, 4, 1, 5, 0, 0, 0, 0));
+        _mm_storeu_si128((__m128i *)(dst + 4 * i), _mm256_castsi256_si128(bytes));
+    }
+#endif
+    for (; i < texels; i++) {
+        dst[4 * i + 0] = tables->toSrgb[src[4 * i + 0] >> 4];
+        dst[4 * i + 1] = tables->toSrgb[src[4 * i + 1] >> 4];
+        dst[4 * i + 2] = tables->toSrgb[src[4 * i + 2] >> 4];
+        dst[4 * i + 3] = (uint8_t)NARROW_ALPHA(src[4 * i + 3]);
+    }
+}
+
+void swizzle_rgba(uint8_t *dst, uint8_t const *src, size_t texels, uint8_t const order[4]) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    uint8_t indices[32];
+    for (uint32_t b = 0; b < 32; b++) { indices[b] = (uint8_t)((b & ~3u) + order[b & 3]); }
+    __m256i const shuffle = _mm256_loadu_si256((__m256i const *)indices);
+    for (; i + 8 <= texels; i += 8) {
+        __m256i v = _mm256_loadu_si256((__m256i const *)(src + 4 * i));
+        _mm256_storeu_si256((__m256i *)(dst + 4 * i), _mm256_shuffle_epi8(v, shuffle));
+    }
+#elif defined(__SSE2__)
+    // no byte shuffle before SSSE3, only the red and blue swap is done with shifts
+    if (order[0] == 2 && order[1] == 1 && order[2] == 0 && order[3] == 3) {
+        __m128i const greenAlpha = _mm_set1_epi32((int)0xff00ff00);
+        __m128i const low = _mm_set1_epi32(0xff);
+        for (; i + 4 <= texels; i += 4) {
+            __m128i v = _mm_loadu_si128((__m128i const *)(src + 4 * i));
+            __m128i red = _mm_slli_epi32(_mm_and_si128(v, low), 16);
+            __m128i blue = _mm_and_si128(_mm_srli_epi32(v, 16), low);
+            __m128i out = _mm_or_si128(_mm_and_si128(v, greenAlpha), _mm_or_si128(red, blue));
+            _mm_storeu_si128((__m128i *)(dst + 4 * i), out);
+        }
+    }
+#endif
+    for (; i < texels; i++) {
+        uint8_t const *texel = src + 4 * i;
+        dst[4 * i + 0] = texel[order[0]];
+        dst[4 * i + 1] = texel[order[1]];
+        dst[4 * i + 2] = texel[order[2]];
+        dst[4 * i + 3] = texel[order[3]];
+    }
+}
+
+void pack_rgba_to_rg(uint8_t *dst, uint8_t const *src, size_t texels) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 16 <= texels; i += 16) {
+        __m256i a = _mm256_loadu_si256((__m256i const *)(src + 4 * i));
+        __m256i b = _mm256_loadu_si256((__m256i const *)(src + 4 * i + 32));
+        // sign extended low halves pack back unchanged
+        a = _mm256_srai_epi32(_mm256_slli_epi32(a, 16), 16);
+        b = _mm256_srai_epi32(_mm256_slli_epi32(b, 16), 16);
+        __m256i out = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xd8);
+        _mm256_storeu_si256((__m256i *)(dst + 2 * i), out);
+    }
+#elif defined(__SSE2__)
+    for (; i + 8 <= texels; i += 8) {
+        __m128i a = _mm_loadu_si128((__m128i const *)(src + 4 * i));
+        __m128i b = _mm_loadu_si128((__m128i const *)(src + 4 * i + 16));
+        // no unsigned 32-bit pack before SSE4.1, sign extended low halves pack back unchanged
+        a = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+        b = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+        _mm_storeu_si128((__m128i *)(dst + 2 * i), _mm_packs_epi32(a, b));
+    }
+#endif
+    for (; i < texels; i++) {
+        dst[2 * i + 0] = src[4 * i + 0];
+        dst[2 * i + 1] = src[4 * i + 1];
+    }
+}
+
+void pack_rgba_to_r(uint8_t *dst, uint8_t const *src, size_t texels) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    __m256i const low = _mm256_set1_epi32(0xff);
+    // packing within lanes leaves groups of 4 texels interleaved
+    __m256i const order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    for (; i + 32 <= texels; i += 32) {
+        __m256i v[4];
+        for (uint32_t k = 0; k < 4; k++) {
+            v[k] = _mm256_and_si256(
+                _mm256_loadu_si256((__m256i const *)(src + 4 * i + 32 * k)), low);
+        }
+        __m256i out = _mm256_packus_epi16(
+            _mm256_packs_epi32(v[0], v[1]), _mm256_packs_epi32(v[2], v[3]));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_permutevar8x32_epi32(out, order));
+    }
+#elif defined(__SSE2__)
+    __m128i const low = _mm_set1_epi32(0xff);
+    for (; i + 16 <= texels; i += 16) {
+        __m128i v[4];
+        for (uint32_t k = 0; k < 4; k++) {
+            v[k] = _mm_and_si128(_mm_loadu_si128((__m128i const *)(src + 4 * i + 16 * k)), low);
+        }
+        __m128i out =
+            _mm_packus_epi16(_mm_packs_epi32(v[0], v[1]), _mm_packs_epi32(v[2], v[3]));
+        _mm_storeu_si128((__m128i *)(dst + i), out);
+    }
+#endif
+    for (; i < texels; i++) { dst[i] = src[4 * i]; }
+}
@@ -0,0 +1,171 @@
+#include "dds.h"
+#include "mipmap.h"
+#include "utils.h"
+#include <stdio.h>
+
+#define DDS_MAGIC 0x20534444 // "DDS "
+#define DDS_HEADER_SIZE 124
+#define DDS_DX10_HEADER_SIZE 20
+#define DDS_FOURCC(a, b, c, d) ((uint32_t)(a) | (b) << 8 | (c) << 16 | (uint32_t)(d) << 24)
+// dwFlags
+#define DDSD_CAPS 0x1
+#define DDSD_HEIGHT 0x2
+#define DDSD_WIDTH 0x4
+#define DDSD_PIXELFORMAT 0x1000
+#define DDSD_MIPMAPCOUNT 0x20000
+#define DDSD_LINEARSIZE 0x80000
+// ddspf.dwFlags
+#define DDPF_FOURCC 0x4
+// dwCaps
+#define DDSCAPS_COMPLEX 0x8
+#define DDSCAPS_TEXTURE 0x1000
+#define DDSCAPS_MIPMAP 0x400000
+// DX10 header
+#define DDS_DIMENSION_TEXTURE2D 3
+#define DDS_MISC_TEXTURECUBE 0x4
+
+// header offsets, from the end of magic
+enum {
+    DDS_SIZE = 0,
+    DDS_FLAGS = 4,
+    DDS_HEIGHT = 8,
+    DDS_WIDTH = 12,
+    DDS_PITCH_OR_LINEAR_SIZE = 16,
+    DDS_MIP_MAP_COUNT = 24,
+    DDS_PF_SIZE = 72,
+    DDS_PF_FLAGS = 76,
+    DDS_PF_FOURCC = 80,
+    DDS_CAPS = 104,
+    DX10_FORMAT = 0,
+    DX10_DIMENSION = 4,
+    DX10_MISC_FLAG = 8,
+    DX10_ARRAY_SIZE = 12,
+};
+
+typedef struct DxgiFormat {
+    uint32_t dxgi;
+    VkFormat format;
+} DxgiFormat;
+
+static DxgiFormat const dxgiFormats[] = {
+    {28, VK_FORMAT_R8G8B8A8_UNORM},      {29, VK_FORMAT_R8G8B8A8_SRGB},
+    {71, VK_FORMAT_BC1_RGBA_UNORM_BLOCK}, {72, VK_FORMAT_BC1_RGBA_SRGB_BLOCK},
+    {77, VK_FORMAT_BC3_UNORM_BLOCK},      {78, VK_FORMAT_BC3_SRGB_BLOCK},
+    {98, VK_FORMAT_BC7_UNORM_BLOCK},      {99, VK_FORMAT_BC7_SRGB_BLOCK},
+};
+
+static uint32_t get_u32(uint8_t const *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static void put_u32(uint8_t *p, uint32_t value) {
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+    p[2] = (uint8_t)(value >> 16);
+    p[3] = (uint8_t)(value >> 24);
+}
+
+int read_dds(char const *path, ADdsImage *out_image) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) return 1;
+    int res = 2;
+    uint8_t magic[4], header[DDS_HEADER_SIZE], dx10[DDS_DX10_HEADER_SIZE];
+    if (fread(magic, sizeof(magic), 1, file) != 1 || get_u32(magic) != DDS_MAGIC ||
+        fread(header, sizeof(header), 1, file) != 1 ||
+        get_u32(header + DDS_SIZE) != DDS_HEADER_SIZE) {
+        eprintff(MSG_ERRORF("'%s' is not a DDS file"), path);
+        goto no_header;
+    }
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    // uncompressed ones are only read with DX10 header
+    uint32_t fourCC =
+        get_u32(header + DDS_PF_FLAGS) & DDPF_FOURCC ? get_u32(header + DDS_PF_FOURCC) : 0;
+    if (fourCC == DDS_FOURCC('D', 'X', '1', '0')) {
+        if (fread(dx10, sizeof(dx10), 1, file) != 1) goto no_format;
+        uint32_t dxgi = get_u32(dx10 + DX10_FORMAT);
+        if (get_u32(dx10 + DX10_DIMENSION) != DDS_DIMENSION_TEXTURE2D ||
+            get_u32(dx10 + DX10_ARRAY_SIZE) > 1 ||
+            (get_u32(dx10 + DX10_MISC_FLAG) & DDS_MISC_TEXTURECUBE))
+            goto no_format;
+        for (uint32_t i = 0; i < ARR_LEN(dxgiFormats); i++) {
+            if (dxgiFormats[i].dxgi == dxgi) format = dxgiFormats[i].format;
+        }
+    }
+    // legacy headers carry no color space, textures here are sRGB
+    else if (fourCC == DDS_FOURCC('D', 'X', 'T', '1')) format = VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+    else if (fourCC == DDS_FOURCC('D', 'X', 'T', '5')) format = VK_FORMAT_BC3_SRGB_BLOCK;
+    if (format == VK_FORMAT_UNDEFINED) goto no_format;
+
+    uint32_t width = get_u32(header + DDS_WIDTH), height = get_u32(header + DDS_HEIGHT);
+    uint32_t mipLevels = 1;
+    if (get_u32(header + DDS_FLAGS) & DDSD_MIPMAPCOUNT)
+        mipLevels = MAX(get_u32(header + DDS_MIP_MAP_COUNT), 1u);
+    if (width == 0 || height == 0 || mipLevels > mip_level_count(width, height)) goto no_format;
+    VkDeviceSize size = mip_chain_size(format, width, height, mipLevels);
+    ARR_ALLOC(uint8_t, data, size);
+    if (data == NULL || fread(data, size, 1, file) != 1) {
+        eprintff(MSG_ERRORF("cannot read %ux%u texels of '%s'"), width, height, path);
+        free(data);
+        res = 1;
+        goto no_header;
+    }
+    fclose(file);
+    *out_image = (ADdsImage){
+        .width = width,
+        .height = height,
+        .mipLevels = mipLevels,
+        .format = format,
+        .size = size,
+        .data = data};
+    return 0;
+no_format:
+    eprintff(MSG_ERRORF("'%s' has unsupported format or layout"), path);
+no_header:
+    fclose(file);
+    return res;
+}
+
+int write_dds(char const *path, ADdsImage const *image) {
+    uint32_t dxgi = 0;
+    for (uint32_t i = 0; i < ARR_LEN(dxgiFormats); i++) {
+        if (dxgiFormats[i].format == image->format) dxgi = dxgiFormats[i].dxgi;
+    }
+    if (dxgi == 0) {
+        eprintff(MSG_ERRORF("format %d has no DXGI equivalent"), image->format);
+        return 1;
+    }
+    uint8_t head[4 + DDS_HEADER_SIZE + DDS_DX10_HEADER_SIZE] = {0};
+    uint8_t *header = head + 4, *dx10 = header + DDS_HEADER_SIZE;
+    put_u32(head, DDS_MAGIC);
+    put_u32(header + DDS_SIZE, DDS_HEADER_SIZE);
+    put_u32(
+        header + DDS_FLAGS, DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT |
+                                DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE);
+    put_u32(header + DDS_HEIGHT, image->height);
+    put_u32(header + DDS_WIDTH, image->width);
+    put_u32(
+        header + DDS_PITCH_OR_LINEAR_SIZE,
+        (uint32_t)mip_level_size(image->format, image->width, image->height, 0));
+    put_u32(header + DDS_MIP_MAP_COUNT, image->mipLevels);
+    put_u32(header + DDS_PF_SIZE, 32);
+    put_u32(header + DDS_PF_FLAGS, DDPF_FOURCC);
+    put_u32(header + DDS_PF_FOURCC, DDS_FOURCC('D', 'X', '1', '0'));
+    put_u32(
+        header + DDS_CAPS,
+        DDSCAPS_TEXTURE | (image->mipLevels > 1 ? DDSCAPS_COMPLEX | DDSCAPS_MIPMAP : 0));
+    put_u32(dx10 + DX10_FORMAT, dxgi);
+    put_u32(dx10 + DX10_DIMENSION, DDS_DIMENSION_TEXTURE2D);
+    put_u32(dx10 + DX10_ARRAY_SIZE, 1);
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        eprintff(MSG_ERRORF("cannot open '%s' for writing"), path);
+        return 1;
+    }
+    int res = 0;
+    if (fwrite(head, sizeof(head), 1, file) != 1 || fwrite(image->data, image->size, 1, file) != 1)
+        res = 1;
+    if (fclose(file) != 0) res = 1;
+    if (res != 0) eprintff(MSG_ERRORF("cannot write '%s'"), path);
+    return res;
+}
@@ -0,0 +1,376 @@
+#include "defrag.h"
+#include "buffer.h"
+#include "command.h"
+#include "image.h"
+#include "mipmap.h"
+#include "utils.h"
+
+/*
+ * Copy target of one movable, handed to it only once the step is submitted
+ */
+typedef struct AMove {
+    AMovable *movable;
+    AAllocation allocation;
+    VkBuffer buffer;  // A_MOVABLE_BUFFER
+    VkImage image;    // A_MOVABLE_IMAGE
+    VkImageView view; // NULL if movable has none
+} AMove;
+
+/*
+ * Signaled, so the next step and destroy do not wait for it
+ * NULL on failure
+ */
+static VkFence create_free_fence(VkDevice device) {
+    VkFenceCreateInfo fcCInfo = {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO, .flags = VK_FENCE_CREATE_SIGNALED_BIT};
+    VkFence fence;
+    VkResult res = vkCreateFence(device, &fcCInfo, NULL, &fence);
+    if (res != VK_SUCCESS) {
+        eprintff(MSG_ERRORF("cannot create fence: %d"), res);
+        return NULL;
+    }
+    return fence;
+}
+
+ADefragmenter *ADefragmenter_create(
+    VkDevice device, AAllocator *allocator, ARetireQueue *retire, uint32_t graphicsFamilyIndex,
+    VkQueue queue, AGpuProfiler *profiler) {
+    VkCommandPool commandPool = A_create_command_pool(device, graphicsFamilyIndex);
+    if (commandPool == NULL) goto no_command_pool;
+    VkCommandBuffer *cbs = A_create_command_buffers(device, commandPool, 1);
+    if (cbs == NULL) goto no_cb;
+    VkCommandBuffer cb = cbs[0];
+    free(cbs);
+    VkFence fence = create_free_fence(device);
+    if (fence == NULL) goto no_fence;
+    ARR_ALLOC(ADefragmenter, defrag, 1);
+    if (defrag == NULL) goto no_defrag;
+    uint32_t capacity = 16;
+    *defrag = (ADefragmenter){
+        .device = device,
+        .allocator = allocator,
+        .retire = retire,
+        .queue = queue,
+        .commandPool = commandPool,
+        .cb = cb,
+        .fence = fence,
+        .profiler = profiler,
+        .generation = 0,
+        .movedBytes = 0,
+        .count = 0,
+        .capacity = capacity,
+        .movables = ARR_INPLACE_ALLOC(AMovable, capacity)};
+    if (defrag->movables == NULL) goto no_movables;
+    return defrag;
+no_movables:
+    free(defrag);
+no_defrag:
+    eprintff(MSG_ERRORF("cannot allocate defragmenter"));
+    vkDestroyFence(device, fence, NULL);
+no_fence:
+    // cb is freed with the pool
+no_cb:
+    vkDestroyCommandPool(device, commandPool, NULL);
+no_command_pool:
+    return NULL;
+}
+
+void ADefragmenter_destroy(ADefragmenter *defrag) {
+    if (defrag == NULL) return;
+    if (defrag->fence != NULL) {
+        vkWaitForFences(defrag->device, 1, &defrag->fence, VK_TRUE, UINT64_MAX);
+        vkDestroyFence(defrag->device, defrag->fence, NULL);
+    }
+    vkDestroyCommandPool(defrag->device, defrag->commandPool, NULL);
+    free(defrag->movables);
+    free(defrag);
+}
+
+int ADefragmenter_add(ADefragmenter *defrag, AMovable movable) {
+    if (defrag->count == defrag->capacity) {
+        uint32_t capacity = defrag->capacity * 2;
+        AMovable *movables = realloc(defrag->movables, capacity * sizeof(*movables));
+        if (movables == NULL) {
+            eprintff(MSG_ERRORF("cannot grow defragmenter to %u movables"), capacity);
+            return 1;
+        }
+        defrag->movables = movables;
+        defrag->capacity = capacity;
+    }
+    defrag->movables[defrag->count++] = movable;
+    return 0;
+}
+
+void ADefragmenter_remove(ADefragmenter *defrag, AAllocation const *allocation) {
+    for (uint32_t i = 0; i < defrag->count; i++) {
+        if (defrag->movables[i].allocation != allocation) continue;
+        defrag->movables[i] = defrag->movables[--defrag->count];
+        return;
+    }
+}
+
+/*
+ * Sparsest shared block that holds only movables
+ * NULL if none
+ */
+static AMemoryBlock *pick_block(ADefragmenter *defrag) {
+    AMemoryBlock *best = NULL;
+    for (uint32_t t = 0; t < VK_MAX_MEMORY_TYPES; t++) {
+        for (AMemoryBlock *block = defrag->allocator->blocks[t]; block != NULL;
+             block = block->next) {
+            if (block->dedicated || block->used == 0) continue;
+            if (block->used * 100 >= block->size * A_DEFRAG_SPARSE_PERCENT) continue;
+            if (best != NULL && block->used >= best->used) continue;
+            VkDeviceSize movableBytes = 0;
+            for (uint32_t i = 0; i < defrag->count; i++) {
+                AAllocation const *allocation = defrag->movables[i].allocation;
+                if (allocation->block == block) movableBytes += allocation->size;
+            }
+            if (movableBytes == block->used) best = block;
+        }
+    }
+    return best;
+}
+
+/*
+ * Records copy into a new buffer, movable is not changed
+ * 0 on success, new buffer in out_move
+ * 1 if resource cannot be moved now
+ */
+static int move_buffer(ADefragmenter *defrag, AMovable *movable, AMove *out_move) {
+    VkDevice device = defrag->device;
+    VkBuffer oldBuffer = *movable->buffer.handle;
+    // same create info gives same requirements
+    VkMemoryRequirements memReqs;
+    vkGetBufferMemoryRequirements(device, oldBuffer, &memReqs);
+    AAllocation allocation;
+    if (AAllocator_alloc_elsewhere(
+            defrag->allocator, memReqs, movable->properties, A_ALLOCATION_LINEAR,
+            movable->allocation->block, &allocation) != 0)
+        goto no_allocation;
+    VkBuffer buffer = create_buffer(
+        device, defrag->allocator, movable->buffer.size, movable->buffer.usage,
+        movable->properties, NULL);
+    if (buffer == NULL) goto no_buffer;
+    VkResult res = vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset);
+    if (res != VK_SUCCESS) {
+        eprintff(MSG_ERRORF("cannot bind buffer memory: %d"), res);
+        goto no_bind;
+    }
+    VkBufferCopy region = {.srcOffset = 0, .dstOffset = 0, .size = movable->buffer.size};
+    vkCmdCopyBuffer(defrag->cb, oldBuffer, buffer, 1, &region);
+    *out_move = (AMove){.movable = movable, .allocation = allocation, .buffer = buffer};
+    return 0;
+no_bind:
+    vkDestroyBuffer(device, buffer, NULL);
+no_buffer:
+    AAllocator_free(defrag->allocator, allocation);
+no_allocation:
+    return 1;
+}
+
+static VkImageMemoryBarrier layout_barrier(
+    VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags srcAccessMask,
+    VkAccessFlags dstAccessMask) {
+    return (VkImageMemoryBarrier){
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = srcAccessMask,
+        .dstAccessMask = dstAccessMask,
+        .oldLayout = oldLayout,
+        .newLayout = newLayout,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image,
+        .subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .subresourceRange.baseMipLevel = 0,
+        .subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS,
+        .subresourceRange.baseArrayLayer = 0,
+        .subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS};
+}
+
+/*
+ * Records copy into a new image, movable is not changed
+ * 0 on success, new image and view in out_move
+ * 1 if resource cannot be moved now
+ */
+static int move_image(ADefragmenter *defrag, AMovable *movable, AMove *out_move) {
+    VkDevice device = defrag->device;
+    VkImage oldImage = *movable->image.handle;
+    // copy is always optimal, old image may be linear
+    VkImage image = create_image(
+        device, defrag->allocator, movable->image.width, movable->image.height,
+        movable->image.mipLevels, movable->image.layers, movable->image.format,
+        VK_IMAGE_TILING_OPTIMAL, movable->image.usage, movable->properties, NULL);
+    if (image == NULL) goto no_image;
+    VkMemoryRequirements memReqs;
+    vkGetImageMemoryRequirements(device, image, &memReqs);
+    AAllocation allocation;
+    if (AAllocator_alloc_elsewhere(
+            defrag->allocator, memReqs, movable->properties, A_ALLOCATION_OPTIMAL,
+            movable->allocation->block, &allocation) != 0)
+        goto no_allocation;
+    VkResult res = vkBindImageMemory(device, image, allocation.memory, allocation.offset);
+    if (res != VK_SUCCESS) {
+        eprintff(MSG_ERRORF("cannot bind image memory: %d"), res);
+        goto no_bind;
+    }
+    VkImageView view = NULL;
+    if (movable->image.view != NULL) {
+        view = create_image_view(
+            device, image, movable->image.viewType, movable->image.format, 0,
+            movable->image.mipLevels, movable->image.layers);
+        if (view == NULL) goto no_bind;
+    }
+
+    VkImageMemoryBarrier before[] = {
+        layout_barrier(
+            oldImage, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_SHADER_READ_BIT,
+            VK_ACCESS_TRANSFER_READ_BIT),
+        layout_barrier(
+            image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0,
+            VK_ACCESS_TRANSFER_WRITE_BIT),
+    };
+    vkCmdPipelineBarrier(
+        defrag->cb, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+        NULL, 0, NULL, ARR_LEN(before), before);
+    // one region per level, 32 covers any 32-bit extent
+    VkImageCopy regions[32];
+    uint32_t levels = MIN(movable->image.mipLevels, ARR_LEN(regions));
+    for (uint32_t level = 0; level < levels; level++) {
+        VkExtent2D extent = mip_extent(movable->image.width, movable->image.height, level);
+        regions[level] = (VkImageCopy){
+            .srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, movable->image.layers},
+            .srcOffset = {0, 0, 0},
+            .dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, movable->image.layers},
+            .dstOffset = {0, 0, 0},
+            .extent = {extent.width, extent.height, 1}
+        };
+    }
+    vkCmdCopyImage(
+        defrag->cb, oldImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, levels, regions);
+    VkImageMemoryBarrier after = layout_barrier(
+        image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+    vkCmdPipelineBarrier(
+        defrag->cb, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0,
+        NULL, 0, NULL, 1, &after);
+    *out_move =
+        (AMove){.movable = movable, .allocation = allocation, .image = image, .view = view};
+    return 0;
+no_bind:
+    AAllocator_free(defrag->allocator, allocation);
+no_allocation:
+    vkDestroyImage(device, image, NULL);
+no_image:
+    return 1;
+}
+
+/*
+ * Old resources go to the retire queue, movable takes the new ones
+ */
+static void commit_move(ADefragmenter *defrag, AMove move) {
+    AMovable *movable = move.movable;
+    ARetired retired = {.allocation = *movable->allocation};
+    if (movable->kind == A_MOVABLE_BUFFER) {
+        retired.kind = A_RETIRED_BUFFER;
+        retired.buffer = *movable->buffer.handle;
+        *movable->buffer.handle = move.buffer;
+    } else {
+        // view goes first, it references the image
+        if (move.view != NULL) {
+            ARetired retiredView = {
+                .kind = A_RETIRED_IMAGE_VIEW, .imageView = *movable->image.view};
+            ARetireQueue_push(defrag->retire, retiredView);
+            *movable->image.view = move.view;
+        }
+        retired.kind = A_RETIRED_IMAGE;
+        retired.image = *movable->image.handle;
+        *movable->image.handle = move.image;
+    }
+    ARetireQueue_push(defrag->retire, retired);
+    *movable->allocation = move.allocation;
+}
+
+/*
+ * New resources of a step that was never submitted, nothing uses them
+ */
+static void drop_move(ADefragmenter *defrag, AMove move) {
+    if (move.view != NULL) vkDestroyImageView(defrag->device, move.view, NULL);
+    if (move.image != NULL) vkDestroyImage(defrag->device, move.image, NULL);
+    if (move.buffer != NULL) vkDestroyBuffer(defrag->device, move.buffer, NULL);
+    AAllocator_free(defrag->allocator, move.allocation);
+}
+
+int ADefragmenter_step(ADefragmenter *defrag, VkDeviceSize maxBytes) {
+    if (defrag->fence == NULL) return 0;
+    if (vkGetFenceStatus(defrag->device, defrag->fence) != VK_SUCCESS) return 0;
+    // last step is complete, so are its timestamps
+    uint32_t set = AGpuProfiler_set(defrag->profiler, A_PROFILER_SET_DEFRAG);
+    uint32_t scope = AGpuProfiler_scope(defrag->profiler, "defrag");
+    AGpuProfiler_collect(defrag->profiler, set);
+    AMemoryBlock *source = pick_block(defrag);
+    if (source == NULL) return 0;
+
+    VkCommandBufferBeginInfo cbBInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
+    vkBeginCommandBuffer(defrag->cb, &cbBInfo);
+    AGpuProfiler_reset(defrag->profiler, defrag->cb, set);
+    AGpuProfiler_begin(defrag->profiler, defrag->cb, set, scope);
+    // earlier writes to buffers (uploads, previous frames) before copies
+    VkMemoryBarrier before = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT};
+    vkCmdPipelineBarrier(
+        defrag->cb, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1,
+        &before, 0, NULL, 0, NULL);
+    AMove moves[A_DEFRAG_STEP_MOVES];
+    uint32_t moveCount = 0;
+    VkDeviceSize moved = 0;
+    for (uint32_t i = 0; i < defrag->count && moveCount < ARR_LEN(moves); i++) {
+        AMovable *movable = defrag->movables + i;
+        if (movable->allocation->block != source) continue;
+        VkDeviceSize size = movable->allocation->size;
+        if (moved > 0 && moved + size > maxBytes) break;
+        AMove *move = moves + moveCount;
+        int res = movable->kind == A_MOVABLE_BUFFER ? move_buffer(defrag, movable, move)
+                                                    : move_image(defrag, movable, move);
+        if (res != 0) break;
+        moveCount++;
+        moved += size;
+    }
+    // copies before any later reads
+    VkMemoryBarrier after = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_MEMORY_READ_BIT};
+    vkCmdPipelineBarrier(
+        defrag->cb, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1,
+        &after, 0, NULL, 0, NULL);
+    AGpuProfiler_end(defrag->profiler, defrag->cb, set, scope);
+    vkEndCommandBuffer(defrag->cb);
+    if (moveCount == 0) return 0; // cb is reset by the next begin
+    // fence must be unsignaled when submitted
+    vkResetFences(defrag->device, 1, &defrag->fence);
+    VkSubmitInfo sInfo = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &defrag->cb};
+    VkResult res = vkQueueSubmit(defrag->queue, 1, &sInfo, defrag->fence);
+    if (res != VK_SUCCESS) {
+        eprintff(MSG_ERRORF("cannot submit defragmentation copies: %d"), res);
+        // copies never ran, resources stay where they are
+        for (uint32_t i = 0; i < moveCount; i++) { drop_move(defrag, moves[i]); }
+        // reset fence would never signal, NULL stops further steps
+        vkDestroyFence(defrag->device, defrag->fence, NULL);
+        defrag->fence = create_free_fence(defrag->device);
+        return 0;
+    }
+    for (uint32_t i = 0; i < moveCount; i++) { commit_move(defrag, moves[i]); }
+    defrag->movedBytes += moved;
+    defrag->generation++;
+    return 1;
+}
@@ -0,0 +1,44 @@
+#include "files.h"
+#include "utils.h"
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define PATH_SIZE 256
+
+int make_dirs(char const *dir) {
+    char path[PATH_SIZE];
+    snprintf(path, sizeof(path), "%s", dir);
+    for (char *p = path + 1;; p++) {
+        char c = *p;
+        if (c != '/' && c != '\0') continue;
+        *p = '\0';
+        if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+            eprintff(MSG_ERRORF("cannot create directory '%s'"), path);
+            return 1;
+        }
+        *p = c;
+        if (c == '\0') return 0;
+    }
+}
+
+void *read_file(char const *path, size_t *out_size) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) return NULL;
+    struct stat st;
+    void *data = NULL;
+    if (fstat(fileno(file), &st) != 0) goto no_data;
+    size_t size = (size_t)st.st_size;
+    // one more byte, so empty files are not NULL
+    data = malloc(size + 1);
+    if (data == NULL) goto no_data;
+    if (size > 0 && fread(data, size, 1, file) != 1) {
+        free(data);
+        data = NULL;
+        goto no_data;
+    }
+    *out_size = size;
+no_data:
+    fclose(file);
+    return data;
+}
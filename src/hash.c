@@ -0,0 +1,9 @@
+#include "hash.h"
+
+#define FNV_PRIME 0x100000001b3ull
+
+uint64_t fnv1a(uint64_t hash, void const *data, size_t size) {
+    uint8_t const *bytes = data;
+    for (size_t i = 0; i < size; i++) { hash = (hash ^ bytes[i]) * FNV_PRIME; }
+    return hash;
+}
@@ -1,13 +1,44 @@
 #include "image.h"
 #include "buffer.h"
-#include "command.h"
+#include "convert.h"
+#include "dds.h"
 #include "lodepng.h"
+#include "mipmap.h"
+#include "texture_cache.h"
 #include "utils.h"
+#include <string.h>
+#include <sys/mman.h>
+
+/*
+ * 0 on success
+ * 1 on failure
+ */
+static int bind_image_memory(
+    VkDevice device, AAllocator *allocator, VkImage image, VkImageTiling tiling,
+    VkMemoryPropertyFlags properties, AAllocation *out_imageMemory) {
+    VkMemoryRequirements memReqs;
+    vkGetImageMemoryRequirements(device, image, &memReqs);
+    AAllocationKind kind =
+        tiling == VK_IMAGE_TILING_OPTIMAL ? A_ALLOCATION_OPTIMAL : A_ALLOCATION_LINEAR;
+    AAllocation imageMemory;
+    if (AAllocator_alloc(allocator, memReqs, properties, kind, &imageMemory) != 0) {
+        eprintff(MSG_ERRORF("cannot allocate memory for image"));
+        return 1;
+    }
+    VkResult res = vkBindImageMemory(device, image, imageMemory.memory, imageMemory.offset);
+    if (res != VK_SUCCESS) {
+        eprintff(MSG_ERRORF("cannot bind image memory: %d"), res);
+        AAllocator_free(allocator, imageMemory);
+        return 1;
+    }
+    *out_imageMemory = imageMemory;
+    return 0;
+}
 
 VkImage create_image(
-    VkDevice device, VkPhysicalDevice pdevice, uint32_t width, uint32_t height, VkFormat format,
-    VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties,
-    VkDeviceMemory *out_imageMemory) {
+    VkDevice device, AAllocator *allocator, uint32_t width, uint32_t height, uint32_t mipLevels,
+    uint32_t layers, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage,
+    VkMemoryPropertyFlags properties, AAllocation *out_imageMemory) {
     VkImageCreateInfo imageInfo = {
         .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
         .flags = 0,
@@ -15,11 +46,13 @@ VkImage create_image(
         .extent.width = width,
         .extent.height = height,
         .extent.depth = 1,
-        .mipLevels = 1,
-        .arrayLayers = 1,
+        .mipLevels = mipLevels,
+        .arrayLayers = layers,
         .format = format,
         .tiling = tiling,
-        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        // linear images are written by host, keep texels
+        .initialLayout = tiling == VK_IMAGE_TILING_LINEAR ? VK_IMAGE_LAYOUT_PREINITIALIZED
+                                                          : VK_IMAGE_LAYOUT_UNDEFINED,
         .usage = usage,
         .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
         .samples = VK_SAMPLE_COUNT_1_BIT};
@@ -29,28 +62,11 @@ VkImage create_image(
         eprintff(MSG_ERRORF("cannot create image: %d"), res);
         goto no_image;
     }
-    VkMemoryRequirements memReqs;
-    vkGetImageMemoryRequirements(device, image, &memReqs);
-    int32_t memoryTypeIndex = find_memory_type(pdevice, memReqs.memoryTypeBits, properties);
-    if (memoryTypeIndex == -1) {
-        eprintff(MSG_ERRORF("cannot find suitable memory type for image"));
-        goto no_suitable_memory;
-    }
-    VkMemoryAllocateInfo allocInfo = {
-        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-        .allocationSize = memReqs.size,
-        .memoryTypeIndex = memoryTypeIndex};
-    VkDeviceMemory imageMemory;
-    res = vkAllocateMemory(device, &allocInfo, NULL, &imageMemory);
-    if (res != VK_SUCCESS) {
-        eprintff(MSG_ERRORF("cannot allocate memory for image: %d"), res);
+    if (out_imageMemory == NULL) return image;
+    if (bind_image_memory(device, allocator, image, tiling, properties, out_imageMemory) != 0)
         goto no_image_memory;
-    }
-    vkBindImageMemory(device, image, imageMemory, 0);
-    *out_imageMemory = imageMemory;
     return image;
 no_image_memory:
-no_suitable_memory:
     vkDestroyImage(device, image, NULL);
 no_image:
     return NULL;
@@ -58,7 +74,7 @@ no_image:
 
 void transition_image_layout(
     VkCommandBuffer cb, VkImage image, VkFormat format, VkImageLayout oldLayout,
-    VkImageLayout newLayout) {
+    VkImageLayout newLayout, uint32_t baseMipLevel, uint32_t levelCount) {
 
     VkPipelineStageFlags srcStage, dstStage;
     VkAccessFlags srcAccessMask, dstAccessMask;
@@ -84,6 +100,25 @@ void transition_image_layout(
             dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
             srcStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
             dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+            break;
+        // mip level becomes blit source for the next one
+        case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+            srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            srcStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+            dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+            break;
+        }
+        break;
+    case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+        switch (newLayout) {
+        default: goto invalid_new_layout;
+        case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+            srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            srcStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+            dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+            break;
         }
         break;
     }
@@ -98,10 +133,10 @@ void transition_image_layout(
         .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED, // ^^^
         .image = image,
         .subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-        .subresourceRange.baseMipLevel = 0,
-        .subresourceRange.levelCount = 1,
+        .subresourceRange.baseMipLevel = baseMipLevel,
+        .subresourceRange.levelCount = levelCount,
         .subresourceRange.baseArrayLayer = 0,
-        .subresourceRange.layerCount = 1};
+        .subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS};
 
     vkCmdPipelineBarrier(
         cb, srcStage, dstStage, 0, // flags
@@ -120,17 +155,18 @@ invalid_new_layout:
 }
 
 void copy_buffer_to_image(
-    VkCommandBuffer cb, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height) {
+    VkCommandBuffer cb, VkBuffer buffer, VkDeviceSize bufferOffset, VkImage image, uint32_t width,
+    uint32_t height, uint32_t y, uint32_t mipLevel, uint32_t baseLayer, uint32_t layerCount) {
 
     VkBufferImageCopy region = {
-        .bufferOffset = 0,
+        .bufferOffset = bufferOffset,
         .bufferRowLength = 0,
         .bufferImageHeight = 0,
         .imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-        .imageSubresource.mipLevel = 0,
-        .imageSubresource.baseArrayLayer = 0,
-        .imageSubresource.layerCount = 1,
-        .imageOffset = {0, 0, 0},
+        .imageSubresource.mipLevel = mipLevel,
+        .imageSubresource.baseArrayLayer = baseLayer,
+        .imageSubresource.layerCount = layerCount,
+        .imageOffset = {0, (int32_t)y, 0},
         .imageExtent.width = width,
         .imageExtent.height = height,
         .imageExtent.depth = 1
@@ -138,82 +174,329 @@ void copy_buffer_to_image(
     vkCmdCopyBufferToImage(cb, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
 }
 
-VkImage create_texture_image(
-    VkDevice device, VkPhysicalDevice pdevice, char const *image_path, VkCommandPool commandPool,
-    VkQueue drawQueue, VkDeviceMemory *out_imageMemory) {
-    uint8_t *image;
+/*
+ * Linear image in unified memory with every level written in place
+ * NULL if device has no unified memory or cannot sample such image, nothing is printed
+ */
+static VkImage create_host_written_image(
+    VkDevice device, AAllocator *allocator, AUploadContext *upload, ADecodedTexture const *texture,
+    AAllocation *out_imageMemory) {
+    ATextureInfo info = texture->info;
+    VkImageFormatProperties formatProps;
+    VkResult res = vkGetPhysicalDeviceImageFormatProperties(
+        allocator->pdevice, info.format, VK_IMAGE_TYPE_2D, VK_IMAGE_TILING_LINEAR,
+        A_TEXTURE_IMAGE_USAGE, 0, &formatProps);
+    // linear tiling is only guaranteed for single level images
+    if (res != VK_SUCCESS || info.width > formatProps.maxExtent.width ||
+        info.height > formatProps.maxExtent.height || info.mipLevels > formatProps.maxMipLevels ||
+        info.layers > formatProps.maxArrayLayers)
+        goto no_image;
+    VkImage image = create_image(
+        device, allocator, info.width, info.height, info.mipLevels, info.layers, info.format,
+        VK_IMAGE_TILING_LINEAR, A_TEXTURE_IMAGE_USAGE, 0, NULL);
+    if (image == NULL) goto no_image;
+    VkMemoryRequirements memReqs;
+    vkGetImageMemoryRequirements(device, image, &memReqs);
+    VkMemoryPropertyFlags properties =
+        device_local_properties(&allocator->stats, memReqs.memoryTypeBits);
+    if (!(properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)) goto no_image_memory;
+    AAllocation imageMemory;
+    if (bind_image_memory(
+            device, allocator, image, VK_IMAGE_TILING_LINEAR, properties, &imageMemory) != 0)
+        goto no_image_memory;
+    ATexelBlock block = texel_block(info.format);
+    for (uint32_t level = 0; level < info.mipLevels; level++) {
+        VkExtent2D extent = mip_extent(info.width, info.height, level);
+        // rows of blocks for compressed formats
+        uint32_t rows = (extent.height + block.height - 1) / block.height;
+        size_t rowSize = (size_t)(extent.width + block.width - 1) / block.width * block.size;
+        VkDeviceSize levelOffset = mip_chain_size(info.format, info.width, info.height, level);
+        VkDeviceSize src = info.layers * levelOffset;
+        for (uint32_t layer = 0; layer < info.layers; layer++) {
+            VkImageSubresource subresource = {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .mipLevel = level, .arrayLayer = layer};
+            VkSubresourceLayout layout;
+            vkGetImageSubresourceLayout(device, image, &subresource, &layout);
+            // rows may be padded
+            for (uint32_t y = 0; y < rows; y++) {
+                copy_texels(
+                    (uint8_t *)imageMemory.mapped + layout.offset + y * layout.rowPitch, texture,
+                    src + y * rowSize, rowSize);
+            }
+            src += rowSize * rows;
+        }
+    }
+    if (AUploadContext_transition_image(upload, image, info.mipLevels) != 0) goto no_transition;
+    *out_imageMemory = imageMemory;
+    return image;
+no_transition:
+    AAllocator_free(allocator, imageMemory);
+no_image_memory:
+    vkDestroyImage(device, image, NULL);
+no_image:
+    return NULL;
+}
+
+/*
+ * Mips can be blitted from level 0 with linear filter
+ */
+static VkBool32 can_blit_mips(VkPhysicalDevice pdevice, VkFormat format) {
+    VkFormatProperties props;
+    vkGetPhysicalDeviceFormatProperties(pdevice, format, &props);
+    VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                                  VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    return (props.optimalTilingFeatures & needed) == needed;
+}
+
+VkBool32 texture_blits_mips(AAllocator *allocator, VkFormat format) {
+    // host written linear images need every level from CPU
+    VkImageFormatProperties linearProps;
+    VkResult res = vkGetPhysicalDeviceImageFormatProperties(
+        allocator->pdevice, format, VK_IMAGE_TYPE_2D, VK_IMAGE_TILING_LINEAR,
+        A_TEXTURE_IMAGE_USAGE, 0, &linearProps);
+    VkMemoryPropertyFlags properties = device_local_properties(&allocator->stats, ~0u);
+    if (res == VK_SUCCESS && linearProps.maxMipLevels > 1 &&
+        (properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT))
+        return VK_FALSE;
+    return can_blit_mips(allocator->pdevice, format);
+}
+
+ADecodeOptions texture_decode_options(AAllocator *allocator) {
+    ADecodeOptions options = {
+        .blitMips = texture_blits_mips(allocator, A_TEXTURE_IMAGE_FORMAT), .compressedCount = 0};
+    // device is created with every supported feature
+    VkPhysicalDeviceFeatures features;
+    vkGetPhysicalDeviceFeatures(allocator->pdevice, &features);
+    if (!features.textureCompressionBC) return options;
+    VkFormat const candidates[A_MAX_COMPRESSED_FORMATS] = {
+        VK_FORMAT_BC1_RGBA_SRGB_BLOCK, VK_FORMAT_BC3_SRGB_BLOCK, VK_FORMAT_BC7_SRGB_BLOCK,
+        VK_FORMAT_BC1_RGBA_UNORM_BLOCK, VK_FORMAT_BC3_UNORM_BLOCK, VK_FORMAT_BC7_UNORM_BLOCK};
+    VkFormatFeatureFlags needed =
+        VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    for (uint32_t i = 0; i < A_MAX_COMPRESSED_FORMATS; i++) {
+        VkFormatProperties props;
+        vkGetPhysicalDeviceFormatProperties(allocator->pdevice, candidates[i], &props);
+        if ((props.optimalTilingFeatures & needed) == needed)
+            options.compressed[options.compressedCount++] = candidates[i];
+    }
+    return options;
+}
+
+/*
+ * Reads DDS with the same name as PNG image_path
+ * 0 on success
+ * 1 if there is no such file, nothing is printed
+ * 2 if it cannot be used
+ */
+static int decode_compressed(
+    char const *image_path, ADecodeOptions const *options, ADecodedTexture *out_texture) {
+    size_t length = strlen(image_path);
+    if (length < 4 || strcmp(image_path + length - 4, ".png") != 0) return 1;
+    ARR_ALLOC(char, ddsPath, length + 1);
+    memcpy(ddsPath, image_path, length - 4);
+    memcpy(ddsPath + length - 4, ".dds", 5);
+    ADdsImage dds;
+    int res = read_dds(ddsPath, &dds);
+    if (res != 0) goto no_dds;
+    res = 2;
+    for (uint32_t i = 0; i < options->compressedCount; i++) {
+        if (options->compressed[i] == dds.format) res = 0;
+    }
+    if (res != 0) {
+        eprintff(MSG_WARNF("device cannot sample '%s', format %d"), ddsPath, dds.format);
+        free(dds.data);
+        goto no_dds;
+    }
+    ATextureInfo info = {
+        .width = dds.width,
+        .height = dds.height,
+        .mipLevels = dds.mipLevels,
+        .layers = 1,
+        .format = dds.format};
+    *out_texture = (ADecodedTexture){
+        .info = info, .stagedLevels = dds.mipLevels, .size = dds.size, .texels = dds.data};
+no_dds:
+    free(ddsPath);
+    return res;
+}
+
+void copy_texels(
+    uint8_t *dst, ADecodedTexture const *texture, VkDeviceSize offset, VkDeviceSize size) {
+    if (texture->rgb) convert_rgb_to_rgba(dst, texture->texels + offset / 4 * 3, size / 4);
+    else memcpy(dst, texture->texels + offset, size);
+}
+
+/*
+ * Decodes PNG to RGBA8
+ * 8-bit RGB without color key is decoded as stored, out_rgb is then VK_TRUE,
+ *  lodepng converts texel by texel otherwise
+ * returns texels on success
+ * NULL on failure
+ */
+static uint8_t *decode_png(
+    char const *image_path, uint32_t *out_width, uint32_t *out_height, VkBool32 *out_rgb) {
+    uint8_t *png, *texels = NULL;
+    size_t pngSize;
+    uint32_t error = lodepng_load_file(&png, &pngSize, image_path);
+    if (error) goto no_png;
+    LodePNGState state;
+    lodepng_state_init(&state);
     uint32_t width, height;
-    uint32_t error = lodepng_decode32_file(&image, &width, &height, image_path);
+    error = lodepng_inspect(&width, &height, &state, png, pngSize);
+    LodePNGColorMode color = state.info_png.color;
+    lodepng_state_cleanup(&state);
+    if (error) goto no_texels;
+    *out_rgb = color.colortype == LCT_RGB && color.bitdepth == 8 && !color.key_defined;
+    error = lodepng_decode_memory(
+        &texels, &width, &height, png, pngSize, *out_rgb ? LCT_RGB : LCT_RGBA, 8);
+no_texels:
+    free(png);
+no_png:
     if (error) {
         eprintff(MSG_ERRORF("cannot load image '%s': %d"), image_path, error);
-        goto no_image;
+        return NULL;
     }
-    VkDeviceSize imageSize = width * height * 4;
-    VkDeviceMemory sImageMemory;
-    VkBuffer sImageBuffer = create_staging_buffer(device, pdevice, imageSize, &sImageMemory);
-    if (sImageBuffer == NULL) {
-        eprintff(MSG_ERRORF("failed to create staging buffer for image"));
-        goto no_staging_buffer;
+    *out_width = width;
+    *out_height = height;
+    return texels;
+}
+
+int decode_texture(
+    char const *image_path, ADecodeOptions const *options, ADecodedTexture *out_texture) {
+    if (options->compressedCount > 0 && decode_compressed(image_path, options, out_texture) == 0)
+        return 0;
+    VkBool32 blitMips = options->blitMips;
+    ATextureCacheKey key;
+    VkBool32 cached = texture_cache_key(image_path, blitMips, &key) == 0;
+    if (cached && map_cached_texture(&key, out_texture) == 0) return 0;
+    uint32_t width, height;
+    VkBool32 rgb;
+    uint8_t *texels = decode_png(image_path, &width, &height, &rgb);
+    if (texels == NULL) return 1;
+    ATextureInfo info = {
+        .width = width,
+        .height = height,
+        .mipLevels = mip_level_count(width, height),
+        .layers = 1,
+        .format = A_TEXTURE_IMAGE_FORMAT};
+    uint32_t stagedLevels = blitMips ? 1 : info.mipLevels;
+    VkDeviceSize size = mip_chain_size(info.format, width, height, stagedLevels);
+    if (stagedLevels > 1) {
+        // levels go right after level 0, RGB is expanded straight into it
+        uint8_t *chain = rgb ? malloc(size) : realloc(texels, size);
+        if (chain == NULL) {
+            eprintff(MSG_ERRORF("cannot allocate mip chain of '%s'"), image_path);
+            goto no_chain;
+        }
+        if (rgb) {
+            convert_rgb_to_rgba(chain, texels, (size_t)width * height);
+            free(texels);
+            rgb = VK_FALSE;
+        }
+        texels = chain;
+        VkDeviceSize level0Size = (VkDeviceSize)width * height * 4;
+        if (generate_mip_chain_srgb(texels, width, height, stagedLevels, texels + level0Size) != 0)
+            goto no_chain;
+    }
+    *out_texture = (ADecodedTexture){
+        .info = info, .stagedLevels = stagedLevels, .size = size, .texels = texels, .rgb = rgb};
+    // a failed store only costs decoding again next time
+    if (cached) store_cached_texture(&key, out_texture);
+    return 0;
+no_chain:
+    free(texels);
+    return 1;
+}
+
+void free_decoded_texture(ADecodedTexture *texture) {
+    if (texture->mapping != NULL) munmap(texture->mapping, texture->mappingSize);
+    else free(texture->texels);
+    texture->mapping = NULL;
+    texture->texels = NULL;
+}
+
+VkImage upload_texture(
+    VkDevice device, AAllocator *allocator, AUploadContext *upload, ADecodedTexture const *texture,
+    AAllocation *out_imageMemory) {
+    ATextureInfo info = texture->info;
+    if (texture->stagedLevels == info.mipLevels) {
+        VkImage hostImage =
+            create_host_written_image(device, allocator, upload, texture, out_imageMemory);
+        if (hostImage != NULL) return hostImage;
     }
-    {
-        void *data;
-        vkMapMemory(device, sImageMemory, 0, imageSize, 0, &data);
-        memcpy(data, image, imageSize);
-        vkUnmapMemory(device, sImageMemory);
+    AStagingRegion region;
+    // 16 covers texel size and optimalBufferCopyOffsetAlignment on common devices
+    if (AUploadContext_stage(upload, texture->size, 16, &region) != 0) {
+        eprintff(
+            MSG_ERRORF("no staging memory for %ux%ux%u texture"), info.width, info.height,
+            info.layers);
+        goto no_image;
     }
-    VkDeviceMemory textureImageMemory;
+    copy_texels(region.mapped, texture, 0, texture->size);
+    // region is returned to the ring with the next flush
+    AAllocation textureImageMemory;
     VkImage textureImage = create_image(
-        device, pdevice, width, height, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
-        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &textureImageMemory);
+        device, allocator, info.width, info.height, info.mipLevels, info.layers, info.format,
+        VK_IMAGE_TILING_OPTIMAL, A_TEXTURE_IMAGE_USAGE, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        &textureImageMemory);
     if (textureImage == NULL) {
         eprintff(MSG_ERRORF("failed to create image"));
-        goto no_texture_image;
+        goto no_image;
     }
 
-    {
-        VkCommandBuffer cb = cmd_begin_one_time(device, commandPool);
-        transition_image_layout(
-            cb, textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED,
-            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-        copy_buffer_to_image(cb, sImageBuffer, textureImage, width, height);
-        transition_image_layout(
-            cb, textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-        cmd_end_one_time(device, commandPool, drawQueue, cb);
+    AUploadImageParams args = {
+        .image = textureImage,
+        .width = info.width,
+        .height = info.height,
+        .mipLevels = info.mipLevels,
+        .layers = info.layers,
+        .format = info.format,
+        .blitMips = texture->stagedLevels < info.mipLevels};
+    if (AUploadContext_copy_to_image(upload, region, args) != 0) {
+        eprintff(MSG_ERRORF("cannot record texture upload"));
+        goto no_upload;
     }
 
-    vkFreeMemory(device, sImageMemory, NULL);
-    vkDestroyBuffer(device, sImageBuffer, NULL);
-    free(image);
-
     *out_imageMemory = textureImageMemory;
     return textureImage;
 
-no_texture_image:
-    vkFreeMemory(device, sImageMemory, NULL);
-    vkDestroyBuffer(device, sImageBuffer, NULL);
-no_staging_buffer:
-    free(image);
+no_upload:
+    vkDestroyImage(device, textureImage, NULL);
+    AAllocator_free(allocator, textureImageMemory);
 no_image:
     return NULL;
 }
 
-VkImageView create_image_view(VkDevice device, VkImage image, VkFormat format) {
+VkImage create_texture_image(
+    VkDevice device, AAllocator *allocator, AUploadContext *upload, char const *image_path,
+    AAllocation *out_imageMemory, ATextureInfo *out_info) {
+    ADecodedTexture texture;
+    ADecodeOptions options = texture_decode_options(allocator);
+    if (decode_texture(image_path, &options, &texture) != 0) return NULL;
+    if (out_info != NULL) *out_info = texture.info;
+    VkImage image = upload_texture(device, allocator, upload, &texture, out_imageMemory);
+    free_decoded_texture(&texture);
+    if (image == NULL) eprintff(MSG_ERRORF("cannot upload image '%s'"), image_path);
+    return image;
+}
+
+VkImageView create_image_view(
+    VkDevice device, VkImage image, VkImageViewType viewType, VkFormat format,
+    uint32_t baseMipLevel, uint32_t mipLevels, uint32_t layers) {
     VkImageViewCreateInfo viewInfo = {
         .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
         .image = image,
-        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .viewType = viewType,
         .format = format,
         .components.r = VK_COMPONENT_SWIZZLE_IDENTITY,
         .components.g = VK_COMPONENT_SWIZZLE_IDENTITY,
         .components.b = VK_COMPONENT_SWIZZLE_IDENTITY,
         .components.a = VK_COMPONENT_SWIZZLE_IDENTITY,
         .subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-        .subresourceRange.baseMipLevel = 0,
-        .subresourceRange.levelCount = 1,
+        .subresourceRange.baseMipLevel = baseMipLevel,
+        .subresourceRange.levelCount = mipLevels,
         .subresourceRange.baseArrayLayer = 0,
-        .subresourceRange.layerCount = 1};
+        .subresourceRange.layerCount = layers};
 
     VkImageView imageView;
     VkResult res = vkCreateImageView(device, &viewInfo, NULL, &imageView);
@@ -224,11 +507,14 @@ VkImageView create_image_view(VkDevice device, VkImage image, VkFormat format) {
     return imageView;
 }
 
-VkImageView create_texture_image_view(VkDevice device, VkImage image) {
-    return create_image_view(device, image, VK_FORMAT_R8G8B8A8_SRGB);
+VkImageView create_texture_image_view(
+    VkDevice device, VkImage image, ATextureInfo info, uint32_t baseMipLevel) {
+    return create_image_view(
+        device, image, VK_IMAGE_VIEW_TYPE_2D_ARRAY, info.format, baseMipLevel,
+        info.mipLevels - baseMipLevel, info.layers);
 }
 
-VkSampler create_sampler(VkDevice device) {
+VkSampler create_sampler(VkDevice device, uint32_t mipLevels) {
     // VkPhysicalDeviceProperties.limits.maxSamplerAnisotropy
     float maxAnisotropy = 4.;
     VkSamplerCreateInfo samplerInfo = {
@@ -245,7 +531,7 @@ VkSampler create_sampler(VkDevice device) {
         .compareEnable = VK_FALSE,                      // VK_TRUE for percentage-close filtering
         .compareOp = VK_COMPARE_OP_ALWAYS, // check developer.nvidia gpu gems chapter 11
         .minLod = 0.,                      // to arg
-        .maxLod = 0.,                      // to arg
+        .maxLod = (float)mipLevels,
         .borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK,
         .unnormalizedCoordinates = VK_FALSE};
     VkSampler sampler;
@@ -0,0 +1,364 @@
+#include "loader.h"
+#include "SDL.h"
+#include "utils.h"
+#include <dirent.h>
+#include <string.h>
+
+/*
+ * Shared between decoder threads and the uploading thread
+ */
+typedef struct ALoadJob {
+    char const *const *paths;
+    uint32_t count;
+    ADecodeOptions options;
+    SDL_atomic_t next; // next path to decode
+    SDL_mutex *mutex;
+    SDL_cond *cond; // broadcast on every decoded or uploaded texture
+    // guarded by mutex
+    uint32_t maxPending;
+    uint32_t pending;    // decoding or decoded, not uploaded yet
+    uint32_t readyCount; // ready[0..readyCount) are decoded
+    uint32_t *ready;
+    int *results; // decode_texture result per path
+    double decodeSeconds;
+    ADecodedTexture *decoded; // per path
+} ALoadJob;
+
+static double seconds_since(uint64_t start) {
+    return (double)(SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency();
+}
+
+static int decoder_main(void *data) {
+    ALoadJob *job = data;
+    for (;;) {
+        // reserve a pending slot first, so decoders never run far ahead of uploads
+        SDL_LockMutex(job->mutex);
+        while (job->pending >= job->maxPending) { SDL_CondWait(job->cond, job->mutex); }
+        job->pending++;
+        SDL_UnlockMutex(job->mutex);
+        uint32_t index = (uint32_t)SDL_AtomicAdd(&job->next, 1);
+        if (index >= job->count) {
+            SDL_LockMutex(job->mutex);
+            job->pending--;
+            SDL_CondBroadcast(job->cond);
+            SDL_UnlockMutex(job->mutex);
+            return 0;
+        }
+        uint64_t start = SDL_GetPerformanceCounter();
+        int res = decode_texture(job->paths[index], &job->options, job->decoded + index);
+        double seconds = seconds_since(start);
+        SDL_LockMutex(job->mutex);
+        job->results[index] = res;
+        job->ready[job->readyCount++] = index;
+        job->decodeSeconds += seconds;
+        SDL_CondBroadcast(job->cond);
+        SDL_UnlockMutex(job->mutex);
+    }
+}
+
+static uint32_t worker_count(uint32_t workerCount, uint32_t count) {
+    if (workerCount == 0) workerCount = (uint32_t)MAX(SDL_GetCPUCount() - 1, 1);
+    return MIN(workerCount, MAX(count, 1u));
+}
+
+static ALoadJob create_job(
+    char const *const *paths, uint32_t count, ADecodeOptions options, uint32_t maxPending) {
+    ALoadJob job = {
+        .paths = paths,
+        .count = count,
+        .options = options,
+        .mutex = SDL_CreateMutex(),
+        .cond = SDL_CreateCond(),
+        .maxPending = maxPending,
+        .pending = 0,
+        .readyCount = 0,
+        .ready = ARR_INPLACE_ALLOC(uint32_t, count),
+        .results = ARR_INPLACE_ALLOC(int, count),
+        .decodeSeconds = 0,
+        .decoded = ARR_INPLACE_ALLOC(ADecodedTexture, count)};
+    SDL_AtomicSet(&job.next, 0);
+    return job;
+}
+
+static void destroy_job(ALoadJob *job) {
+    free(job->decoded);
+    free(job->results);
+    free(job->ready);
+    if (job->cond != NULL) SDL_DestroyCond(job->cond);
+    if (job->mutex != NULL) SDL_DestroyMutex(job->mutex);
+}
+
+/*
+ * Returns number of started threads in workers
+ * If none can be started, everything is decoded on calling thread before return
+ */
+static uint32_t start_decoders(ALoadJob *job, uint32_t workerCount, SDL_Thread **workers) {
+    uint32_t started = 0;
+    if (job->mutex != NULL && job->cond != NULL) {
+        for (; started < workerCount; started++) {
+            workers[started] = SDL_CreateThread(decoder_main, "texture decoder", job);
+            if (workers[started] == NULL) break;
+        }
+    }
+    if (started == 0) {
+        // decode everything up front on this thread
+        eprintff(MSG_WARNF("cannot start decoder threads: %s"), SDL_GetError());
+        job->maxPending = job->count + 1;
+        decoder_main(job);
+    }
+    return started;
+}
+
+static void print_stats(ALoadStats stats) {
+    double mb = stats.bytes / (1024. * 1024.);
+    eprintff(
+        MSG_INFOF("%u textures, %.2f MiB in %.3f s: %.1f MiB/s, %.1f textures/s, "
+                  "decode %.3f s on %u threads"),
+        stats.textureCount, mb, stats.seconds, mb / stats.seconds,
+        stats.textureCount / stats.seconds, stats.decodeSeconds, MAX(stats.workerCount, 1u));
+}
+
+/*
+ * Records upload of packed texture as next image of set and points refs of its paths at it
+ * Entry i is layer i if rects is NULL, otherwise rects[i] of layer 0
+ */
+static void add_packed_texture(
+    VkDevice device, AAllocator *allocator, AUploadContext *upload, ATextureStreamer *streamer,
+    ADecodedTexture const *packed, uint32_t const *pathIndices, ARect const *rects, uint32_t count,
+    ATextureSet *set, ALoadStats *stats) {
+    ATextureInfo info = packed->info;
+    ALoadedTexture *texture = set->images + set->imageCount;
+    *texture = (ALoadedTexture){.image = NULL, .info = info, .residentLevel = 0};
+    if (streamer != NULL) ATextureStreamer_upload(streamer, packed, texture);
+    else texture->image = upload_texture(device, allocator, upload, packed, &texture->memory);
+    if (texture->image == NULL) {
+        eprintff(
+            MSG_ERRORF("cannot upload %ux%ux%u texture of %u entries"), info.width, info.height,
+            info.layers, count);
+        return;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        ATextureRef ref = {.image = set->imageCount, .layer = i, .uvRect = {0, 0, 1, 1}};
+        if (rects != NULL) {
+            ref.layer = 0;
+            ref.uvRect[0] = rects[i].x / (float)info.width;
+            ref.uvRect[1] = rects[i].y / (float)info.height;
+            ref.uvRect[2] = rects[i].width / (float)info.width;
+            ref.uvRect[3] = rects[i].height / (float)info.height;
+        }
+        set->refs[pathIndices[i]] = ref;
+    }
+    set->imageCount++;
+    stats->textureCount += count;
+    stats->bytes += packed->size;
+}
+
+/*
+ * Decoded textures that become layers of one array image
+ */
+typedef struct ALayerGroup {
+    ATextureInfo info;
+    uint32_t stagedLevels;
+    uint32_t maxCount; // by A_ARRAY_MAX_LAYERS and staging ring size
+    uint32_t count;
+    uint32_t *paths; // count = maxCount
+} ALayerGroup;
+
+static ALayerGroup *find_group(
+    ALayerGroup *groups, uint32_t groupCount, ADecodedTexture const *decoded) {
+    for (uint32_t i = 0; i < groupCount; i++) {
+        ALayerGroup *group = groups + i;
+        if (group->info.width == decoded->info.width &&
+            group->info.height == decoded->info.height &&
+            group->info.format == decoded->info.format &&
+            group->info.mipLevels == decoded->info.mipLevels &&
+            group->stagedLevels == decoded->stagedLevels)
+            return group;
+    }
+    return NULL;
+}
+
+/*
+ * Records upload of group as one image, or of its only member, then frees its members
+ * members is scratch space for group->count pointers
+ */
+static void add_group(
+    VkDevice device, AAllocator *allocator, AUploadContext *upload, ATextureStreamer *streamer,
+    ALoadJob *job, ALayerGroup *group, ADecodedTexture const **members, ATextureSet *set,
+    ALoadStats *stats) {
+    for (uint32_t i = 0; i < group->count; i++) { members[i] = job->decoded + group->paths[i]; }
+    if (group->count == 1) {
+        // block compressed or too large to share, its own image
+        add_packed_texture(
+            device, allocator, upload, streamer, members[0], group->paths, NULL, 1, set, stats);
+    } else {
+        ADecodedTexture array;
+        if (pack_texture_array(members, group->count, &array) == 0) {
+            add_packed_texture(
+                device, allocator, upload, streamer, &array, group->paths, NULL, group->count,
+                set, stats);
+            free_decoded_texture(&array);
+        }
+    }
+    for (uint32_t i = 0; i < group->count; i++) {
+        free_decoded_texture(job->decoded + group->paths[i]);
+    }
+    group->count = 0;
+}
+
+uint32_t A_load_texture_set(
+    VkDevice device, AAllocator *allocator, AUploadContext *upload, char const *const *paths,
+    uint32_t count, uint32_t workerCount, ATextureStreamer *streamer, ATextureSet *out_set,
+    ALoadStats *out_stats) {
+    uint64_t start = SDL_GetPerformanceCounter();
+    workerCount = worker_count(workerCount, count);
+    ADecodeOptions options = texture_decode_options(allocator);
+    // streamed levels come from CPU, blits would need level 0 first
+    if (streamer != NULL) options.blitMips = VK_FALSE;
+    // groups hold decoded textures until they are full or decoding ends, decoders never wait
+    ALoadJob job = create_job(paths, count, options, count + workerCount);
+    ARR_ALLOC(SDL_Thread *, workers, workerCount);
+    uint32_t started = start_decoders(&job, workerCount, workers);
+
+    ALoadStats stats = {.workerCount = started};
+    // at most one image per texture
+    ATextureSet set = {
+        .imageCount = 0,
+        .images = ARR_INPLACE_ALLOC(ALoadedTexture, MAX(count, 1u)),
+        .refCount = count,
+        .refs = ARR_INPLACE_ALLOC(ATextureRef, MAX(count, 1u))};
+    for (uint32_t i = 0; i < count; i++) { set.refs[i] = (ATextureRef){.image = A_TEXTURE_NONE}; }
+    uint32_t groupCount = 0;
+    ARR_ALLOC(ALayerGroup, groups, MAX(count, 1u));
+    ARR_ALLOC(ADecodedTexture const *, members, MAX(count, 1u));
+    // half of the ring, so one group is copied while the next one is staged
+    VkDeviceSize groupBytes = upload->staging->size / 2;
+    for (uint32_t consumed = 0; consumed < count; consumed++) {
+        SDL_LockMutex(job.mutex);
+        while (consumed == job.readyCount) { SDL_CondWait(job.cond, job.mutex); }
+        uint32_t index = job.ready[consumed];
+        int res = job.results[index];
+        SDL_UnlockMutex(job.mutex);
+        if (res != 0) continue;
+        ADecodedTexture const *decoded = job.decoded + index;
+        ALayerGroup *group = find_group(groups, groupCount, decoded);
+        if (group == NULL) {
+            uint32_t maxCount = (uint32_t)MIN(groupBytes / MAX(decoded->size, 1), count);
+            group = groups + groupCount++;
+            *group = (ALayerGroup){
+                .info = decoded->info,
+                .stagedLevels = decoded->stagedLevels,
+                .maxCount = MAX(MIN(maxCount, A_ARRAY_MAX_LAYERS), 1u),
+                .count = 0};
+            group->paths = ARR_INPLACE_ALLOC(uint32_t, group->maxCount);
+        }
+        group->paths[group->count++] = index;
+        if (group->count < group->maxCount) continue;
+        // full, copied by GPU while the rest is decoded
+        add_group(device, allocator, upload, streamer, &job, group, members, &set, &stats);
+        AUploadContext_flush(upload);
+        AUploadContext_collect(upload);
+    }
+    for (uint32_t i = 0; i < started; i++) { SDL_WaitThread(workers[i], NULL); }
+    stats.decodeSeconds = job.decodeSeconds;
+
+    // what is left of small groups of uncompressed textures shares an atlas
+    ARR_ALLOC(uint32_t, oddPaths, MAX(count, 1u));
+    uint32_t oddCount = 0;
+    for (uint32_t i = 0; i < groupCount; i++) {
+        ALayerGroup *group = groups + i;
+        if (group->count < A_ARRAY_MIN_LAYERS && group->info.format == A_TEXTURE_IMAGE_FORMAT) {
+            for (uint32_t j = 0; j < group->count; j++) { oddPaths[oddCount++] = group->paths[j]; }
+            group->count = 0;
+        }
+        else if (group->count > 0) {
+            add_group(device, allocator, upload, streamer, &job, group, members, &set, &stats);
+        }
+        free(group->paths);
+    }
+    ADecodedTexture atlas = {.texels = NULL};
+    ARR_ALLOC(ARect, rects, MAX(oddCount, 1u));
+    for (uint32_t i = 0; i < oddCount; i++) { members[i] = job.decoded + oddPaths[i]; }
+    if (oddCount > 1 &&
+        pack_texture_atlas(members, oddCount, options.blitMips, &atlas, rects) == 0) {
+        add_packed_texture(
+            device, allocator, upload, streamer, &atlas, oddPaths, rects, oddCount, &set,
+            &stats);
+        free_decoded_texture(&atlas);
+    }
+    else {
+        // single odd texture or atlas overflow, each one is its own image
+        for (uint32_t i = 0; i < oddCount; i++) {
+            add_packed_texture(
+                device, allocator, upload, streamer, members[i], oddPaths + i, NULL, 1, &set,
+                &stats);
+        }
+    }
+    for (uint32_t i = 0; i < oddCount; i++) { free_decoded_texture(job.decoded + oddPaths[i]); }
+    AUploadContext_wait_idle(upload);
+    stats.seconds = seconds_since(start);
+    eprintff(MSG_INFOF("%u textures packed into %u images"), stats.textureCount, set.imageCount);
+    print_stats(stats);
+
+    *out_set = set;
+    if (out_stats != NULL) *out_stats = stats;
+    free(rects);
+    free(oddPaths);
+    free(members);
+    free(groups);
+    free(workers);
+    destroy_job(&job);
+    return stats.textureCount;
+}
+
+void ATextureSet_destroy(VkDevice device, AAllocator *allocator, ATextureSet *set) {
+    for (uint32_t i = 0; i < set->imageCount; i++) {
+        vkDestroyImage(device, set->images[i].image, NULL);
+        AAllocator_free(allocator, set->images[i].memory);
+    }
+    free(set->refs);
+    free(set->images);
+    *set = (ATextureSet){.imageCount = 0};
+}
+
+static int compare_paths(void const *a, void const *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+char **A_list_textures(char const *dir, uint32_t *out_count) {
+    DIR *handle = opendir(dir);
+    if (handle == NULL) {
+        eprintff(MSG_ERRORF("cannot open directory '%s'"), dir);
+        return NULL;
+    }
+    uint32_t count = 0, capacity = 16;
+    ARR_ALLOC(char *, paths, capacity);
+    struct dirent *entry;
+    while ((entry = readdir(handle)) != NULL) {
+        size_t nameLength = strlen(entry->d_name);
+        if (nameLength < 5 || strcmp(entry->d_name + nameLength - 4, ".png") != 0) continue;
+        if (count == capacity) {
+            capacity *= 2;
+            paths = realloc(paths, capacity * sizeof(*paths));
+        }
+        size_t pathSize = strlen(dir) + 1 + nameLength + 1;
+        paths[count] = ARR_INPLACE_ALLOC(char, pathSize);
+        snprintf(paths[count], pathSize, "%s/%s", dir, entry->d_name);
+        count++;
+    }
+    closedir(handle);
+    if (count == 0) {
+        eprintff(MSG_ERRORF("no PNG files in '%s'"), dir);
+        free(paths);
+        return NULL;
+    }
+    qsort(paths, count, sizeof(*paths), compare_paths);
+    *out_count = count;
+    return paths;
+}
+
+void A_free_texture_paths(char **paths, uint32_t count) {
+    if (paths == NULL) return;
+    for (uint32_t i = 0; i < count; i++) { free(paths[i]); }
+    free(paths);
+}
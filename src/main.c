@@ -1,20 +1,40 @@
 #include "SDL.h"
+#include "allocator.h"
+#include "bindless.h"
 #include "buffer.h"
 #include "command.h"
+#include "command_cache.h"
+#include "defrag.h"
+#include "hash.h"
 #include "image.h"
+#include "loader.h"
 #include "lodepng.h"
 #include "my_vulkan.h"
+#include "options.h"
 #include "pipeline.h"
+#include "pipeline_cache.h"
+#include "pipeline_registry.h"
+#include "profiler.h"
+#include "recorder.h"
+#include "retire.h"
 #include "shader.h"
+#include "shader_archive.h"
+#include "stream.h"
 #include "sync.h"
+#include "uniform.h"
+#include "upload.h"
 #include "utils.h"
+#include "variant.h"
 #include "vertex.h"
 #include "vulkan/vulkan.h"
 #include <cglm/cglm.h>
 #include <stdio.h>
+#include <string.h>
 #include <time.h>
 
-int main(void) {
+int main(int argc, char **argv) {
+    AOptions options;
+    if (AOptions_parse(argc, argv, &options) != 0) return 1;
     // init SDL2
     if (SDL_Init(SDL_INIT_EVERYTHING) != 0) {
         eprintf(MSG_ERROR("cannot init sdl: %s"), SDL_GetError());
@@ -29,7 +49,7 @@ int main(void) {
         goto no_window;
     }
     // init vulkan
-    uint32_t maxFrames = 2;
+    uint32_t maxFrames = options.framesInFlight;
     VkInstance instance = A_create_instance(window, VK_API_VERSION_1_0);
     if (instance == NULL) {
         eprintf(MSG_ERROR("cannot create vulkan instance"));
@@ -46,46 +66,95 @@ int main(void) {
         eprintf(MSG_ERROR("cannot find queue families"));
         goto no_queue_families;
     }
-    ADevice adevice = ADevice_create(pdevice, queueFamilies);
+    ADevice adevice = ADevice_create(instance, pdevice, queueFamilies);
     if (adevice.device == NULL) {
         eprintf(MSG_ERROR("cannot create vulkan device"));
         goto no_device;
     }
     VkDevice device = adevice.device;
+    // textures by slot index, regular descriptor per texture otherwise
+    VkBool32 bindless = adevice.bindless;
+    eprintf(MSG_INFO("Bindless textures: %s"), bindless ? "on" : "off");
     if (!A_is_surface_supported(pdevice, queueFamilies.graphicsIndex, surface)) {
         eprintf(MSG_ERROR("surface is not supported by selected physical device"));
         goto no_surface_support;
     }
-    ASwapchain swapchain = ASwapchain_create(pdevice, surface, queueFamilies, device);
+    AAllocator *allocator = AAllocator_create(instance, device, pdevice, 0);
+    if (allocator == NULL) {
+        eprintf(MSG_ERROR("cannot create device memory allocator"));
+        goto no_allocator;
+    }
+    VkPresentModeKHR presentMode = options.presentMode;
+    ASwapchain swapchain =
+        ASwapchain_create(pdevice, surface, queueFamilies, device, presentMode, NULL);
     if (swapchain.swapchain == NULL) {
         eprintf(MSG_ERROR("cannot create swapchain"));
         goto no_swapchain;
     }
+    eprintf(
+        MSG_INFO("present mode %s (asked %s)"), A_present_mode_name(swapchain.presentMode),
+        A_present_mode_name(presentMode));
     VkRenderPass renderPass = A_create_render_pass(device, swapchain.imageFormat);
     if (renderPass == NULL) {
         eprintf(MSG_ERROR("cannot create render pass"));
         goto no_render_pass;
     }
     // descriptor set layout
-    VkDescriptorSetLayout descriptorSetLayout = A_create_descriptor_set_layout(device);
+    VkDescriptorSetLayout descriptorSetLayout = A_create_descriptor_set_layout(device, !bindless);
     if (descriptorSetLayout == NULL) {
         eprintf(MSG_ERROR("cannot create descriptor set layout"));
         goto no_descriptor_set_layout;
     }
+    ABindlessTable *bindlessTable = NULL;
+    if (bindless) {
+        bindlessTable = ABindlessTable_create(device, maxFrames);
+        if (bindlessTable == NULL) {
+            eprintf(MSG_ERROR("cannot create bindless table"));
+            goto no_bindless_table;
+        }
+    }
+    // shared by every pipeline, saved at exit so later starts skip shader compilation
+    VkBool32 warmPipelineCache = VK_FALSE;
+    VkPipelineCache pipelineCache =
+        A_load_pipeline_cache(device, pdevice, A_PIPELINE_CACHE_PATH, &warmPipelineCache);
+    if (pipelineCache == NULL) {
+        eprintf(MSG_ERROR("cannot create pipeline cache"));
+        goto no_pipeline_cache;
+    }
     // graphics pipeline
-    VkPipelineLayout plLayout = A_create_pipeline_layout(device, 1, &descriptorSetLayout, 0, NULL);
+    VkDescriptorSetLayout setLayouts[] = {
+        descriptorSetLayout, bindless ? bindlessTable->layout : NULL};
+    // ADrawConstants of each draw
+    VkPushConstantRange pcRange = {
+        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT, .offset = 0, .size = sizeof(ADrawConstants)};
+    VkPipelineLayout plLayout =
+        A_create_pipeline_layout(device, bindless ? 2 : 1, setLayouts, 1, &pcRange);
     if (plLayout == NULL) {
         eprintf(MSG_ERROR("cannot create pipeline layout"));
         goto no_pipeline_layout;
     }
-    uint32_t uBufBinding = 0, samplerBinding = 1; // binding index for uniform buffers in shaders
+    // binding index for uniform buffers in shaders
+    uint32_t uBufBinding = 0, samplerBinding = 1, objectBinding = 2;
 // shaders
 #define SHADER_PATH_PREFIX "./data/shaders_compiled/"
 #define SHADER_PATH(x) SHADER_PATH_PREFIX x
+    char const *vertShaderName = "main.vert";
+    char const *fragShaderName = bindless ? "main_bindless.frag" : "main.frag";
     char const *vertShaderPath = SHADER_PATH("main.vert.spv");
-    char const *fragShaderPath = SHADER_PATH("main.frag.spv");
-    AShader vertShader = AShader_from_path(device, vertShaderPath, VK_SHADER_STAGE_VERTEX_BIT);
-    AShader fragShader = AShader_from_path(device, fragShaderPath, VK_SHADER_STAGE_FRAGMENT_BIT);
+    char const *fragShaderPath =
+        bindless ? SHADER_PATH("main_bindless.frag.spv") : SHADER_PATH("main.frag.spv");
+    AShader vertShader = {.module = NULL}, fragShader = {.module = NULL};
+    // one mapped file when packed, separate .spv files for what it lacks or cannot load
+    AShaderArchive *shaderArchive = AShaderArchive_open(A_SHADER_ARCHIVE_PATH);
+    if (shaderArchive != NULL) {
+        vertShader = AShaderArchive_load(device, shaderArchive, vertShaderName);
+        fragShader = AShaderArchive_load(device, shaderArchive, fragShaderName);
+        AShaderArchive_close(shaderArchive);
+    }
+    if (vertShader.module == NULL)
+        vertShader = AShader_from_path(device, vertShaderPath, VK_SHADER_STAGE_VERTEX_BIT);
+    if (fragShader.module == NULL)
+        fragShader = AShader_from_path(device, fragShaderPath, VK_SHADER_STAGE_FRAGMENT_BIT);
     if (vertShader.module == NULL || fragShader.module == NULL) {
         eprintf(MSG_ERROR("cannot load shaders"));
         if (vertShader.module == NULL) eprintf(MSG_ERROR("Shader '%s' not loaded"), vertShaderPath);
@@ -96,13 +165,33 @@ int main(void) {
     }
     eprintf(MSG_INFO("Shaders loaded successfully"));
     APipelineParams plArgs = APipeline_default(uBufBinding);
-    VkPipeline graphicsPipeline = A_create_pipeline(
-        device, plLayout, renderPass, "main", 2, (AShader[]){vertShader, fragShader}, plArgs);
-    // destroy excess
-    AShader_destroy(device, vertShader);
-    AShader_destroy(device, fragShader);
-    APipelineParams_free(plArgs);
-    //
+    // shaders and params stay until exit, variants are built from them at runtime
+    APipelineDesc plDesc = {
+        .layout = plLayout,
+        .renderPass = renderPass,
+        .entryPointGroup = "main",
+        .shaderCount = 2,
+        .shaders = (AShader[]){vertShader, fragShader},
+        .params = plArgs};
+    // compiles new pipeline states off this thread
+    APipelineRegistry *pipelines = APipelineRegistry_create(device, pipelineCache);
+    if (pipelines == NULL) {
+        eprintf(MSG_ERROR("cannot create pipeline registry"));
+        goto no_pipeline_registry;
+    }
+    AShaderVariant variant = AShaderVariant_default();
+    VkBool32 variantChanged = VK_FALSE;
+    struct timespec plStart, plEnd;
+    timespec_get(&plStart, TIME_UTC);
+    uint32_t mainPipeline = AShaderVariant_request(pipelines, &plDesc, variant, NULL);
+    // nothing to fall back to before the first frame
+    VkPipeline graphicsPipeline =
+        mainPipeline == A_PIPELINE_NONE ? NULL : APipelineRegistry_wait(pipelines, mainPipeline);
+    timespec_get(&plEnd, TIME_UTC);
+    eprintf(
+        MSG_INFO("Pipeline created in %.2f ms, %s cache"),
+        (plEnd.tv_sec - plStart.tv_sec) * 1e3 + (plEnd.tv_nsec - plStart.tv_nsec) * 1e-6,
+        warmPipelineCache ? "warm" : "cold");
     if (graphicsPipeline == NULL) {
         eprintf(MSG_ERROR("cannot create pipeline"));
         goto no_pipeline;
@@ -119,13 +208,48 @@ int main(void) {
         eprintf(MSG_ERROR("cannot create command pool"));
         goto no_command_pool;
     }
+    // NULL if timestamps are not supported, scopes are then skipped
+    AGpuProfiler *profiler = AGpuProfiler_create(
+        pdevice, device, queueFamilies.graphicsIndex, commandPool, adevice.drawQueue, maxFrames);
+    AStagingRing *staging = AStagingRing_create(device, allocator, 0);
+    if (staging == NULL) {
+        eprintf(MSG_ERROR("cannot create staging ring"));
+        goto no_staging;
+    }
+    AUploadContext *upload =
+        AUploadContext_create(device, staging, queueFamilies, adevice, profiler);
+    if (upload == NULL) {
+        eprintf(MSG_ERROR("cannot create upload context"));
+        goto no_upload;
+    }
+    ARetireQueue *retire = ARetireQueue_create(device, allocator, maxFrames);
+    if (retire == NULL) {
+        eprintf(MSG_ERROR("cannot create retire queue"));
+        goto no_retire;
+    }
+    ADefragmenter *defrag = ADefragmenter_create(
+        device, allocator, retire, queueFamilies.graphicsIndex, adevice.drawQueue, profiler);
+    if (defrag == NULL) {
+        eprintf(MSG_ERROR("cannot create defragmenter"));
+        goto no_defrag;
+    }
+    ATextureStreamer *streamer =
+        ATextureStreamer_create(device, allocator, upload, retire, defrag, 0);
+    if (streamer == NULL) {
+        eprintf(MSG_ERROR("cannot create texture streamer"));
+        goto no_streamer;
+    }
     // create buffers
     // data
-    struct MVP {
-        mat4 model;
+    struct Camera {
         mat4 view;
         mat4 proj;
     };
+    // model matrix and texture entry of each draw, Object in main.vert
+    // texture entry of a draw goes through ADrawConstants
+    struct Object {
+        mat4 model;
+    };
 
 #define RGB(x) {(x >> 16 & 0xff) / 256., (x >> 8 & 0xff) / 256., (x & 0xff) / 256.}
 
@@ -154,23 +278,22 @@ int main(void) {
     uint32_t bufferSize = sizeof(vertexData); // sizeof(*vertexData) * vertexCount;
     uint32_t indexSize = sizeof(indices);
     //
-    VkBuffer svBuffer, vBuffer, siBuffer, iBuffer;
-    VkDeviceMemory svBufMem, vBufMem, siBufMem, iBufMem;
-    VkBuffer *uBuffers;       // count = maxFrames
-    VkDeviceMemory *uBufsMem; // count = maxFrames
-    void **uBufsMapped;       // count = maxFrames
-    VkDeviceSize uBufSize = sizeof(struct MVP);
+    VkBuffer vBuffer, iBuffer;
+    AAllocation vBufMem = {0}, iBufMem = {0};
     // vertex buffer
-    svBuffer = create_staging_buffer(device, pdevice, bufferSize, &svBufMem);
-    vBuffer = create_vertex_buffer(device, pdevice, bufferSize, &vBufMem);
+    vBuffer = create_vertex_buffer(device, allocator, bufferSize, &vBufMem);
     // index buffer
-    siBuffer = create_staging_buffer(device, pdevice, indexSize, &siBufMem);
-    iBuffer = create_index_buffer(device, pdevice, indexSize, &iBufMem);
-    // uniform buffers
-    uBuffers =
-        create_uniform_buffers(device, pdevice, maxFrames, uBufSize, &uBufsMem, &uBufsMapped);
-    if (svBuffer == NULL || vBuffer == NULL || siBuffer == NULL || iBuffer == NULL ||
-        uBuffers == NULL) {
+    iBuffer = create_index_buffer(device, allocator, indexSize, &iBufMem);
+    // copies of the draw in a grid, O cycles, up to the last one
+    uint32_t drawCounts[] = {1, 256, 4096, 16384};
+    uint32_t drawCountIndex = 0, maxDrawCount = drawCounts[ARR_LEN(drawCounts) - 1];
+    // uniform buffer, slot per frame
+    // Camera and an Object per draw, 256 is the largest minUniformBufferOffsetAlignment
+    VkDeviceSize uniformRange = MAX(sizeof(struct Camera), sizeof(struct Object));
+    VkDeviceSize uniformFrameSize = (maxDrawCount + 1) * MAX(uniformRange, 256);
+    AUniformArena uniforms = AUniformArena_create(
+        device, pdevice, allocator, maxFrames, uniformFrameSize, uniformRange);
+    if (vBuffer == NULL || iBuffer == NULL || uniforms.buffer == NULL) {
         eprintf(MSG_ERROR("cannot create buffers"));
         goto partial_buffers;
     }
@@ -178,7 +301,7 @@ int main(void) {
 
     // descriptor pool
     VkDescriptorPoolSize poolSizes[] = {
-        {.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,         .descriptorCount = maxFrames},
+        {.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, .descriptorCount = 2 * maxFrames},
         {.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = maxFrames}
     };
     VkDescriptorPoolCreateInfo poolInfo = {
@@ -208,35 +331,91 @@ int main(void) {
         eprintf(MSG_ERROR("failed to allocate descriptor sets"));
         goto no_descriptor_sets;
     }
-    // textures
-    VkDeviceMemory textureImageMemory;
-    VkImage textureImage = create_texture_image(
-        device, pdevice, "data/textures/256/test2.png", commandPool, adevice.drawQueue,
-        &textureImageMemory);
-    if (textureImage == NULL) {
+    // textures, same sized ones become layers of one image
+    char const *textureDirs[] = {"data/textures/16", "data/textures/256"};
+    uint32_t textureCount = 0;
+    char **texturePaths = NULL;
+    for (uint32_t i = 0; i < ARR_LEN(textureDirs); i++) {
+        uint32_t dirCount;
+        char **dirPaths = A_list_textures(textureDirs[i], &dirCount);
+        if (dirPaths == NULL) continue;
+        texturePaths = realloc(texturePaths, (textureCount + dirCount) * sizeof(*texturePaths));
+        memcpy(texturePaths + textureCount, dirPaths, dirCount * sizeof(*dirPaths));
+        textureCount += dirCount;
+        free(dirPaths);
+    }
+    ATextureSet textureSet;
+    A_load_texture_set(
+        device, allocator, upload, (char const *const *)texturePaths, textureCount, 0, streamer,
+        &textureSet, NULL);
+    // drawn entry, others of its image are picked by push constants alone
+    uint32_t textureEntry = A_TEXTURE_NONE;
+    for (uint32_t i = 0; i < textureCount; i++) {
+        if (strcmp(texturePaths[i], "data/textures/256/test2.png") == 0) textureEntry = i;
+    }
+    A_free_texture_paths(texturePaths, textureCount);
+    if (textureEntry == A_TEXTURE_NONE || textureSet.refs[textureEntry].image == A_TEXTURE_NONE) {
         eprintf(MSG_ERROR("cannot create image"));
         goto no_texture_image;
     }
-    VkImageView textureImageView = create_texture_image_view(device, textureImage);
-    if (textureImageView == NULL) {
-        eprintf(MSG_ERROR("failed to create image view"));
-        goto no_texture_image_view;
+    uint32_t textureSetImage = textureSet.refs[textureEntry].image;
+    // view per image, bindless draws may pick any of them
+    ARR_ALLOC(VkImageView, textureViews, textureSet.imageCount);
+    uint32_t maxMipLevels = 1;
+    for (uint32_t i = 0; i < textureSet.imageCount; i++) {
+        ALoadedTexture *texture = textureSet.images + i;
+        // starts at small levels, larger ones replace it as they are streamed
+        textureViews[i] = create_texture_image_view(
+            device, texture->image, texture->info, texture->residentLevel);
+        if (textureViews[i] == NULL) {
+            eprintf(MSG_ERROR("failed to create image view"));
+            goto no_texture_views;
+        }
+        ATextureStreamer_track_view(streamer, texture, textureViews + i);
+        maxMipLevels = MAX(maxMipLevels, texture->info.mipLevels);
     }
-    VkSampler textureSampler = create_sampler(device);
+    VkImageView *textureImageView = textureViews + textureSetImage;
+    VkSampler textureSampler = create_sampler(device, maxMipLevels);
     if (textureSampler == NULL) {
         eprintf(MSG_ERROR("failed to create texture sampler"));
         goto no_texture_sampler;
     }
+    // slot of each image, written to the table set of a frame before it is recorded
+    uint32_t *textureSlots = NULL, samplerSlot = 0;
+    if (bindless) {
+        textureSlots = ARR_INPLACE_ALLOC(uint32_t, textureSet.imageCount);
+        if (textureSlots == NULL) {
+            eprintf(MSG_ERROR("cannot allocate %u texture slots"), textureSet.imageCount);
+            goto no_texture_slots;
+        }
+        for (uint32_t i = 0; i < textureSet.imageCount; i++) {
+            textureSlots[i] = ABindlessTable_add_image(bindlessTable, textureViews + i);
+            if (textureSlots[i] != A_BINDLESS_NONE) continue;
+            // table is full, draws of the image sample the first one instead
+            if (i == 0) {
+                eprintf(MSG_ERROR("no bindless slot for texture images"));
+                goto no_slot;
+            }
+            eprintf(MSG_WARN("texture image %u shares slot of image 0"), i);
+            textureSlots[i] = textureSlots[0];
+        }
+        samplerSlot = ABindlessTable_add_sampler(bindlessTable, textureSampler);
+        if (samplerSlot == A_BINDLESS_NONE) {
+            eprintf(MSG_ERROR("no bindless slot for texture sampler"));
+            goto no_slot;
+        }
+    }
     // populate descriptors
     for (uint32_t i = 0; i < maxFrames; i++) {
         VkDescriptorBufferInfo bufInfo = {
-            .buffer = uBuffers[i],
-            .offset = 0,
-            .range = sizeof(struct MVP) // VK_WHOLE_SIZE
-        };
+            .buffer = uniforms.buffer,
+            .offset = 0, // + dynamic offset
+            .range = sizeof(struct Camera)};
+        VkDescriptorBufferInfo objectInfo = {
+            .buffer = uniforms.buffer, .offset = 0, .range = sizeof(struct Object)};
         VkDescriptorImageInfo imageInfo = {
             .sampler = textureSampler,
-            .imageView = textureImageView,
+            .imageView = *textureImageView,
             .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
         VkWriteDescriptorSet descriptorWrites[] = {
             {
@@ -244,10 +423,17 @@ int main(void) {
              .dstSet = descriptorSets[i],
              .dstBinding = uBufBinding,
              .dstArrayElement = 0, // from
-                .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
              .descriptorCount = 1, // count
                 .pBufferInfo = &bufInfo,
              },
+            {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+             .dstSet = descriptorSets[i],
+             .dstBinding = objectBinding,
+             .dstArrayElement = 0,
+             .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+             .descriptorCount = 1,
+             .pBufferInfo = &objectInfo},
             {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
              .dstSet = descriptorSets[i],
              .dstBinding = samplerBinding,
@@ -257,7 +443,15 @@ int main(void) {
              .pImageInfo = &imageInfo}
         };
         // device, descriptor count to write, which to write, count to copy, which to copy
-        vkUpdateDescriptorSets(device, ARR_LEN(descriptorWrites), descriptorWrites, 0, NULL);
+        // bindless layout has no sampler binding
+        uint32_t writeCount = bindless ? 2 : ARR_LEN(descriptorWrites);
+        vkUpdateDescriptorSets(device, writeCount, descriptorWrites, 0, NULL);
+    }
+    // descriptors are rewritten when defragmenter moves the texture or streamer replaces its view,
+    // both generations only grow, so does their sum
+    ARR_ALLOC(uint64_t, descriptorGenerations, maxFrames);
+    for (uint32_t i = 0; i < maxFrames; i++) {
+        descriptorGenerations[i] = defrag->generation + streamer->generation;
     }
     // end descriptor sets
     VkCommandBuffer *commandBuffers = A_create_command_buffers(device, commandPool, maxFrames);
@@ -265,15 +459,33 @@ int main(void) {
         eprintf(MSG_ERROR("cannot create command buffers"));
         goto no_command_buffers;
     }
+    // recordings reused across frames, see ACommandCache
+    ACommandCache *commandCache = ACommandCache_create(
+        device, retire, queueFamilies.graphicsIndex, maxFrames, swapchain.imageCount);
+    if (commandCache == NULL) {
+        eprintf(MSG_ERROR("cannot create command cache"));
+        goto no_command_cache;
+    }
+    // secondary buffers recorded on every core
+    ARecorder *recorder = ARecorder_create(device, queueFamilies.graphicsIndex, maxFrames, 0);
+    if (recorder == NULL) {
+        eprintf(MSG_ERROR("cannot create command recorder"));
+        goto no_recorder;
+    }
     // sync
     VkSemaphore *waitSemaphores = create_semaphores(device, maxFrames);
     VkSemaphore *signalSemaphores = create_semaphores(device, maxFrames);
-    VkFence *frontFences = create_fences(device, maxFrames);
+    // completion of frame slots, timeline semaphore where supported
+    AFramePacer *pacer = AFramePacer_create(device, maxFrames, adevice.timeline);
     // TODO: return NULL from upper calls
-    if (waitSemaphores == NULL || signalSemaphores == NULL || frontFences == NULL) {
+    if (waitSemaphores == NULL || signalSemaphores == NULL || pacer == NULL) {
         eprintf("cannot create synchronization objects");
         goto no_sync;
     }
+    eprintf(
+        MSG_INFO("%u frames in flight, completion by %s"), maxFrames,
+        pacer->timeline != NULL ? "timeline semaphore" : "fences");
+    AFramePacer_set_rate(pacer, options.fps);
     // end sync
 
     // end init vulkan
@@ -283,31 +495,100 @@ int main(void) {
     eprintf(MSG_INFO("Vulkan initialized successfully"));
     // uint32_t vertexCount = indexSize / sizeof(*indices);
     // copy data to buffer
-    fill_buffer(device, svBufMem, vertexData, (FillBufferParams){.size = bufferSize});
-    copy_buffer(
-        device, commandPool, adevice.drawQueue,
-        (ACopyBufferParams){.src = svBuffer, .dst = vBuffer, .size = bufferSize});
-    fill_buffer(device, siBufMem, indices, (FillBufferParams){.size = indexSize});
-    copy_buffer(
-        device, commandPool, adevice.drawQueue,
-        (ACopyBufferParams){.src = siBuffer, .dst = iBuffer, .size = indexSize});
+    AUploadBufferParams vUploadArgs = {
+        .dst = vBuffer,
+        .dstOffset = 0,
+        .size = bufferSize,
+        .dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT};
+    AUploadBufferParams iUploadArgs = {
+        .dst = iBuffer,
+        .dstOffset = 0,
+        .size = indexSize,
+        .dstAccessMask = VK_ACCESS_INDEX_READ_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT};
+    // unified memory is written in place, no copy
+    if (vBufMem.mapped != NULL)
+        fill_buffer(vBufMem, vertexData, (FillBufferParams){.size = bufferSize});
+    else AUploadContext_buffer(upload, vertexData, vUploadArgs);
+    if (iBufMem.mapped != NULL)
+        fill_buffer(iBufMem, indices, (FillBufferParams){.size = indexSize});
+    else AUploadContext_buffer(upload, indices, iUploadArgs);
+    // texture and buffers go in one batch, first frame is submitted after it
+    AUploadContext_flush(upload);
     // end copy data to buffer
+    // let defragmenter move them, within the memory type they were placed in
+    VkMemoryType const *memTypes = allocator->stats.props.memoryTypes;
+    AMovable vMovable = {
+        .kind = A_MOVABLE_BUFFER,
+        .allocation = &vBufMem,
+        .properties = memTypes[vBufMem.memoryTypeIndex].propertyFlags,
+        .buffer = {.handle = &vBuffer, .size = bufferSize, .usage = A_VERTEX_BUFFER_USAGE}};
+    AMovable iMovable = {
+        .kind = A_MOVABLE_BUFFER,
+        .allocation = &iBufMem,
+        .properties = memTypes[iBufMem.memoryTypeIndex].propertyFlags,
+        .buffer = {.handle = &iBuffer, .size = indexSize, .usage = A_INDEX_BUFFER_USAGE}};
+    ADefragmenter_add(defrag, vMovable);
+    ADefragmenter_add(defrag, iMovable);
+    for (uint32_t i = 0; i < textureSet.imageCount; i++) {
+        ALoadedTexture *image = textureSet.images + i;
+        // streamer hands the rest over once they are complete
+        if (image->residentLevel > 0) continue;
+        AMovable movable = {
+            .kind = A_MOVABLE_IMAGE,
+            .allocation = &image->memory,
+            .properties = memTypes[image->memory.memoryTypeIndex].propertyFlags,
+            .image =
+                {.handle = &image->image,
+                 .view = textureViews + i,
+                 .viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY,
+                 .width = image->info.width,
+                 .height = image->info.height,
+                 .mipLevels = image->info.mipLevels,
+                 .layers = image->info.layers,
+                 .format = image->info.format,
+                 .usage = A_TEXTURE_IMAGE_USAGE}};
+        ADefragmenter_add(defrag, movable);
+    }
     // setup command buffers
     VkViewport viewport = make_viewport(swapchain.extent);
     VkRect2D scissor = make_scissor(swapchain.extent, 0, 0, 0, 0);
+    ARR_ALLOC(ADraw, draws, maxDrawCount);
+    if (draws == NULL) {
+        eprintf(MSG_ERROR("cannot allocate %u draws"), maxDrawCount);
+        goto no_draws;
+    }
+    for (uint32_t i = 0; i < maxDrawCount; i++) {
+        draws[i] = (ADraw){.indexCount = lengths[index], .firstIndex = offsets[index]};
+    }
     ARecordCmdBuffersParams recordArgs = {
         .vBuffer = vBuffer,
         .iBuffer = iBuffer,
-        .indexCount = lengths[index],
-        .indexOffset = offsets[index],
-        .descriptorSets = descriptorSets};
+        .descriptorSets = descriptorSets,
+        .uniformOffset = 0,
+        .bindlessSets = bindless ? bindlessTable->sets : NULL,
+        .drawCount = drawCounts[drawCountIndex],
+        .draws = draws,
+        .profiler = profiler};
+    // cached records once per frame slot, image and draw configuration,
+    // parallel records every frame on all cores, C cycles
+    enum { RECORD_EVERY_FRAME, RECORD_CACHED, RECORD_PARALLEL, RECORD_MODE_COUNT };
+    char const *recordModeNames[] = {"every frame", "cached", "parallel"};
+    VkPresentModeKHR presentModes[] = {
+        VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_MAILBOX_KHR,
+        VK_PRESENT_MODE_IMMEDIATE_KHR};
+    uint32_t presentModeIndex = 0;
+    uint32_t recordMode = RECORD_CACHED;
 
+    VkBool32 swapchainDirty = VK_FALSE; // surface changed, recreate before next acquire
     uint32_t sizes[] = {800, 600, 900, 540, 512, 512};
     uint32_t sizeIndex = 0, sizesLength = sizeof(sizes) / (sizeof(*sizes) * 2);
 
     SDL_Event event;
     char running = 1, fullscreen = 0, border = 1, timeIncrement = 1, rotationIncrement = 1;
     uint32_t currentFrame = 0;
+    uint64_t frameNumber = 0; // frames submitted
     double gameTime = 0, dayTime = 0, rotationTime = 0, prevTime, timeSpeed = 1, rotationSpeed = 1,
            rotationPeriod = 2 * GLM_PI, dayLength = 24 * 60 * 60;
     {
@@ -317,6 +598,11 @@ int main(void) {
     }
     float aspect = swapchain.extent.width / (float)swapchain.extent.height;
     while (running) {
+        // input is read as late as possible, after the slot is free and the cap is waited out
+        AFramePacer_wait(pacer, currentFrame);
+        // timestamps of the last submit of this slot are ready now
+        AGpuProfiler_collect(profiler, currentFrame);
+        AFramePacer_limit(pacer);
         while (SDL_PollEvent(&event)) {
             // printf("SDL event %d\n", event.type);
             switch (event.type) {
@@ -324,16 +610,9 @@ int main(void) {
             case SDL_QUIT: running = 0; break;
             case SDL_WINDOWEVENT:
                 switch (event.window.event) {
-                case SDL_WINDOWEVENT_SIZE_CHANGED:;
-                    ARecreatedSwapchain newSwapchain = A_recreate_swapchain(
-                        pdevice, surface, queueFamilies, device, renderPass, swapchain,
-                        framebuffers);
-                    swapchain = newSwapchain.swapchain;
-                    framebuffers = newSwapchain.framebuffers;
-                    vkResetCommandPool(device, commandPool, 0);
-                    viewport = make_viewport(swapchain.extent);
-                    scissor = make_scissor(swapchain.extent, 0, 0, 0, 0);
-                    aspect = swapchain.extent.width / (float)swapchain.extent.height;
+                case SDL_WINDOWEVENT_SIZE_CHANGED:
+                    // recreated once before next frame, however many events come
+                    swapchainDirty = VK_TRUE;
                     break;
                 }
                 break;
@@ -354,14 +633,59 @@ int main(void) {
                 case SDL_SCANCODE_G:
                     index = (index + 1) % presetLength;
                     printf("index: %d\n", index);
-                    recordArgs.indexCount = lengths[index];
-                    recordArgs.indexOffset = offsets[index];
-                    ARecreatedSwapchain newSwapchain = A_recreate_swapchain(
-                        pdevice, surface, queueFamilies, device, renderPass, swapchain,
-                        framebuffers);
-                    swapchain = newSwapchain.swapchain;
-                    framebuffers = newSwapchain.framebuffers;
-                    vkResetCommandPool(device, commandPool, 0);
+                    // part of the state key, recorded again on next use
+                    for (uint32_t i = 0; i < maxDrawCount; i++) {
+                        draws[i].indexCount = lengths[index];
+                        draws[i].firstIndex = offsets[index];
+                    }
+                    break;
+                case SDL_SCANCODE_C:
+                    recordMode = (recordMode + 1) % RECORD_MODE_COUNT;
+                    eprintf(
+                        MSG_INFO("recording: %s on %u threads, cache recorded %llu of %llu"
+                                 " lookups"),
+                        recordModeNames[recordMode],
+                        recordMode == RECORD_PARALLEL ? recorder->threadCount : 1,
+                        (unsigned long long)commandCache->recordings,
+                        (unsigned long long)commandCache->lookups);
+                    break;
+                case SDL_SCANCODE_P:
+                    // unsupported ones fall back to FIFO on recreation
+                    presentModeIndex = (presentModeIndex + 1) % ARR_LEN(presentModes);
+                    presentMode = presentModes[presentModeIndex];
+                    eprintf(
+                        MSG_INFO("asked for present mode %s"), A_present_mode_name(presentMode));
+                    swapchainDirty = VK_TRUE;
+                    break;
+                case SDL_SCANCODE_I: {
+                    double p50, p99;
+                    uint32_t samples = AFramePacer_latency(pacer, &p50, &p99);
+                    eprintf(
+                        MSG_INFO("present mode %s, acquire to completion p50 %.2f ms p99 %.2f ms"
+                                 " over %u frames"),
+                        A_present_mode_name(swapchain.presentMode), p50, p99, samples);
+                    AGpuProfiler_print(profiler);
+                    break;
+                }
+                case SDL_SCANCODE_X:
+                    if (profiler == NULL) eprintf(MSG_INFO("GPU profiler is off"));
+                    else if (AGpuProfiler_export(profiler, "gpu_profile.csv") == 0)
+                        eprintf(MSG_INFO("GPU profile written to gpu_profile.csv"));
+                    break;
+                case SDL_SCANCODE_O:
+                    drawCountIndex = (drawCountIndex + 1) % ARR_LEN(drawCounts);
+                    recordArgs.drawCount = drawCounts[drawCountIndex];
+                    eprintf(MSG_INFO("draws: %u"), recordArgs.drawCount);
+                    break;
+                case SDL_SCANCODE_T:
+                    // next entry of the same image unless bindless, no descriptor update needed
+                    do {
+                        textureEntry = (textureEntry + 1) % textureSet.refCount;
+                    } while (textureSet.refs[textureEntry].image == A_TEXTURE_NONE ||
+                             (!bindless && textureSet.refs[textureEntry].image != textureSetImage));
+                    eprintf(
+                        MSG_INFO("texture: %u layer %u"), textureEntry,
+                        textureSet.refs[textureEntry].layer);
                     break;
                 case SDL_SCANCODE_H:
                     timeIncrement = !timeIncrement;
@@ -396,6 +720,27 @@ int main(void) {
                 case SDL_SCANCODE_Q:
                     if (event.key.keysym.mod & KMOD_CTRL) running = 0;
                     break;
+                case SDL_SCANCODE_M:
+                    AMemoryStats_update_budget(&allocator->stats);
+                    AMemoryStats_write_json(&allocator->stats, stdout);
+                    break;
+                // shader variant toggles
+                case SDL_SCANCODE_1:
+                    variant.texture = !variant.texture;
+                    variantChanged = VK_TRUE;
+                    break;
+                case SDL_SCANCODE_2:
+                    variant.vertexColor = !variant.vertexColor;
+                    variantChanged = VK_TRUE;
+                    break;
+                case SDL_SCANCODE_3:
+                    variant.alphaTest = !variant.alphaTest;
+                    variantChanged = VK_TRUE;
+                    break;
+                case SDL_SCANCODE_4:
+                    variant.lighting = (variant.lighting + 1) % A_LIGHTING_MODEL_COUNT;
+                    variantChanged = VK_TRUE;
+                    break;
                 }
                 break;
             case SDL_MOUSEBUTTONDOWN:
@@ -413,28 +758,97 @@ int main(void) {
             }
             break;
         }
+        if (variantChanged) {
+            // drawn as before until the variant is compiled
+            uint32_t entry = AShaderVariant_request(
+                pipelines, &plDesc, variant, APipelineRegistry_get(pipelines, mainPipeline));
+            if (entry != A_PIPELINE_NONE) mainPipeline = entry;
+            eprintf(
+                MSG_INFO("variant %x: texture %u vertexColor %u alphaTest %u lighting %u"),
+                AShaderVariant_key(variant), variant.texture, variant.vertexColor,
+                variant.alphaTest, variant.lighting);
+            variantChanged = VK_FALSE;
+        }
         // draw frame
-        vkWaitForFences(device, 1, frontFences + currentFrame, VK_TRUE, UINT64_MAX);
+        // submit uploads recorded since last frame, recycle finished ones
+        AUploadContext_flush(upload);
+        AUploadContext_collect(upload);
+        ARetireQueue_collect(retire, frameNumber, AFramePacer_completed(pacer));
+        // bounded, copies are ordered before this frame's submit
+        ADefragmenter_step(defrag, A_DEFRAG_STEP_BYTES);
+        // flushed on its own, this frame samples the new levels
+        ATextureStreamer_step(streamer);
+        uint64_t viewGeneration = defrag->generation + streamer->generation;
+        if (bindless) {
+            // table follows the views by itself
+            ABindlessTable_update(bindlessTable, currentFrame);
+        } else if (descriptorGenerations[currentFrame] != viewGeneration) {
+            // set of this frame is not in use anymore
+            VkDescriptorImageInfo imageInfo = {
+                .sampler = textureSampler,
+                .imageView = *textureImageView,
+                .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+            VkWriteDescriptorSet write = {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = descriptorSets[currentFrame],
+                .dstBinding = samplerBinding,
+                .dstArrayElement = 0,
+                .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .descriptorCount = 1,
+                .pImageInfo = &imageInfo};
+            vkUpdateDescriptorSets(device, 1, &write, 0, NULL);
+            descriptorGenerations[currentFrame] = viewGeneration;
+        }
+        recordArgs.vBuffer = vBuffer;
+        recordArgs.iBuffer = iBuffer;
+        if (swapchainDirty) {
+            // old one is retired, frames in flight keep presenting from it
+            ARecreatedSwapchain newSwapchain = A_recreate_swapchain(
+                pdevice, surface, queueFamilies, device, renderPass, retire, presentMode,
+                swapchain, framebuffers);
+            if (newSwapchain.swapchain.swapchain == NULL) {
+                // minimized, or failed and tried again
+                SDL_Delay(10);
+                continue;
+            }
+            VkPresentModeKHR oldPresentMode = swapchain.presentMode;
+            swapchain = newSwapchain.swapchain;
+            framebuffers = newSwapchain.framebuffers;
+            swapchainDirty = VK_FALSE;
+            if (swapchain.presentMode != oldPresentMode)
+                eprintf(MSG_INFO("present mode %s"), A_present_mode_name(swapchain.presentMode));
+            // on a new image count, buffers still in flight are retired with their pool
+            ACommandCache_reset(commandCache, swapchain.imageCount);
+            viewport = make_viewport(swapchain.extent);
+            scissor = make_scissor(swapchain.extent, 0, 0, 0, 0);
+            aspect = swapchain.extent.width / (float)swapchain.extent.height;
+        }
         uint32_t imageIndex = 0;
+        AFramePacer_begin(pacer, currentFrame);
         VkResult res = vkAcquireNextImageKHR(
             device, swapchain.swapchain, UINT64_MAX, waitSemaphores[currentFrame], NULL,
             &imageIndex);
         if (res == VK_ERROR_OUT_OF_DATE_KHR) {
-            ARecreatedSwapchain newSwapchain = A_recreate_swapchain(
-                pdevice, surface, queueFamilies, device, renderPass, swapchain, framebuffers);
-            swapchain = newSwapchain.swapchain;
-            framebuffers = newSwapchain.framebuffers;
-
+            swapchainDirty = VK_TRUE;
             continue;
         }
         if (res != VK_SUCCESS && res != VK_SUBOPTIMAL_KHR) {
             eprintf(MSG_ERROR("vkAcquireNextImageKHR %d"), res);
             break;
         }
+        // image is acquired, so drawn and presented first
+        if (res == VK_SUBOPTIMAL_KHR) swapchainDirty = VK_TRUE;
         // update uniform buffer
-        struct MVP mvp = {
-            .model = GLM_MAT4_IDENTITY_INIT,
-        };
+        // previous submit of this slot is complete, its uniforms can be overwritten
+        AUniformArena_begin_frame(&uniforms, currentFrame);
+        // same allocations in the same order every frame give the same offsets,
+        //  so they do not change the state key
+        struct Camera *camera =
+            AUniformArena_alloc(&uniforms, sizeof(struct Camera), &recordArgs.uniformOffset);
+        if (camera == NULL) {
+            eprintf(MSG_ERROR("no uniform memory for frame"));
+            break;
+        }
         {
             struct timespec currentTime0;
             timespec_get(&currentTime0, TIME_UTC);
@@ -455,20 +869,61 @@ int main(void) {
             }
             prevTime = currentTime;
         }
+        // written straight into mapped memory
+        ATextureRef textureRef = textureSet.refs[textureEntry];
         vec3 axis = {0, 0, 1}, eye = {2, 2, 2};
-        glm_rotate(mvp.model, 2 * GLM_PI * rotationTime, axis);
-        glm_lookat(eye, (vec3){0, 0, 0}, axis, mvp.view);
-        glm_perspective(glm_rad(45), aspect, 0.1, 10, mvp.proj);
-        mvp.proj[1][1] *= -1;
-
-        memcpy(uBufsMapped[currentFrame], &mvp, sizeof(mvp));
+        uint32_t gridSide = (uint32_t)ceil(sqrt(recordArgs.drawCount));
+        float cellSize = 2.f / gridSide;
+        struct Object *object = NULL;
+        for (uint32_t i = 0; i < recordArgs.drawCount; i++) {
+            object = AUniformArena_alloc(&uniforms, sizeof(struct Object), &draws[i].objectOffset);
+            if (object == NULL) break;
+            *object = (struct Object){.model = GLM_MAT4_IDENTITY_INIT};
+            // equal every frame unless the entry moves, only then the draws are re-recorded
+            draws[i].constants = (ADrawConstants){
+                .layer = textureRef.layer,
+                .imageSlot = bindless ? textureSlots[textureRef.image] : 0,
+                .samplerSlot = samplerSlot};
+            glm_vec4_copy(textureRef.uvRect, draws[i].constants.uvRect);
+            vec3 cell = {
+                (i % gridSide + .5f) * cellSize - 1.f, (i / gridSide + .5f) * cellSize - 1.f, 0};
+            glm_translate(object->model, cell);
+            glm_scale_uni(object->model, 1.f / gridSide);
+            glm_rotate(object->model, 2 * GLM_PI * rotationTime, axis);
+        }
+        if (object == NULL) {
+            eprintf(MSG_ERROR("no uniform memory for draws"));
+            break;
+        }
+        glm_lookat(eye, (vec3){0, 0, 0}, axis, camera->view);
+        glm_perspective(glm_rad(45), aspect, 0.1, 10, camera->proj);
+        camera->proj[1][1] *= -1;
         // end update uniform buffer
 
-        vkResetFences(device, 1, frontFences + currentFrame);
-        vkResetCommandBuffer(commandBuffers[currentFrame], 0);
-        record_command_buffer(
-            renderPass, framebuffers, swapchain.extent, commandBuffers, viewport, scissor,
-            graphicsPipeline, plLayout, currentFrame, imageIndex, recordArgs);
+        VkPipeline pipeline = APipelineRegistry_get(pipelines, mainPipeline);
+        VkCommandBuffer cmdBuf = commandBuffers[currentFrame];
+        VkBool32 record = VK_TRUE;
+        if (recordMode == RECORD_CACHED) {
+            uint64_t key = record_state_key(
+                renderPass, framebuffers, swapchain.extent, viewport, scissor, pipeline, plLayout,
+                currentFrame, imageIndex, recordArgs);
+            // rewritten descriptors and moved buffers invalidate recordings that use them
+            uint64_t generations[] = {descriptorGenerations[currentFrame], defrag->generation};
+            key = fnv1a(key, generations, sizeof(generations));
+            cmdBuf = ACommandCache_lookup(commandCache, currentFrame, imageIndex, key, &record);
+            if (cmdBuf == NULL) {
+                eprintf(MSG_ERROR("no command buffer for frame"));
+                break;
+            }
+        } else vkResetCommandBuffer(cmdBuf, 0);
+        if (recordMode == RECORD_PARALLEL)
+            ARecorder_record(
+                recorder, renderPass, framebuffers, swapchain.extent, cmdBuf, viewport, scissor,
+                pipeline, plLayout, currentFrame, imageIndex, recordArgs);
+        else if (record)
+            record_command_buffer(
+                renderPass, framebuffers, swapchain.extent, cmdBuf, viewport, scissor, pipeline,
+                plLayout, currentFrame, imageIndex, recordArgs);
 
         VkPipelineStageFlags plStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
         VkSubmitInfo submitInfo = {
@@ -477,10 +932,15 @@ int main(void) {
             .pWaitSemaphores = waitSemaphores + currentFrame,
             .pWaitDstStageMask = &plStage,
             .commandBufferCount = 1,
-            .pCommandBuffers = commandBuffers + currentFrame,
+            .pCommandBuffers = &cmdBuf,
             .signalSemaphoreCount = 1,
             .pSignalSemaphores = signalSemaphores + currentFrame};
-        vkQueueSubmit(adevice.drawQueue, 1, &submitInfo, frontFences[currentFrame]);
+        res = AFramePacer_submit(pacer, adevice.drawQueue, currentFrame, &submitInfo);
+        if (res != VK_SUCCESS) {
+            // acquire semaphore of this slot stays signaled, it cannot be used again
+            eprintf(MSG_ERROR("cannot submit frame: %d"), res);
+            break;
+        }
 
         VkPresentInfoKHR presentInfo = {
             .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
@@ -489,35 +949,51 @@ int main(void) {
             .swapchainCount = 1,
             .pSwapchains = &swapchain.swapchain,
             .pImageIndices = &imageIndex};
-        vkQueuePresentKHR(adevice.presentQueue, &presentInfo);
+        res = vkQueuePresentKHR(adevice.presentQueue, &presentInfo);
+        if (res == VK_ERROR_OUT_OF_DATE_KHR || res == VK_SUBOPTIMAL_KHR) swapchainDirty = VK_TRUE;
         currentFrame = (currentFrame + 1) % maxFrames;
+        frameNumber++;
         // end draw frame
     }
     vkDeviceWaitIdle(device);
 
     // unwind start
 
+    free(draws);
+no_draws:
     for (uint32_t i = 0; i < maxFrames; i++) {
-        vkDestroyFence(device, frontFences[i], NULL);
         vkDestroySemaphore(device, signalSemaphores[i], NULL);
         vkDestroySemaphore(device, waitSemaphores[i], NULL);
     }
 no_sync:
+    AFramePacer_destroy(pacer);
+    free(signalSemaphores);
+    free(waitSemaphores);
+    ARecorder_destroy(recorder);
+no_recorder:
+    ACommandCache_destroy(commandCache);
+no_command_cache:
     // commandBuffers[maxFrames]
     vkFreeCommandBuffers(device, commandPool, maxFrames, commandBuffers);
     free(commandBuffers);
 no_command_buffers:
+    free(descriptorGenerations);
+    // textureSlots
+no_slot:
+    free(textureSlots);
+no_texture_slots:
     // textureSampler
     vkDestroySampler(device, textureSampler, NULL);
 no_texture_sampler:
-    // textueImageView
-    vkDestroyImageView(device, textureImageView, NULL);
-no_texture_image_view:
-    // textureImageMemory
-    // textureImage
-    vkFreeMemory(device, textureImageMemory, NULL);
-    vkDestroyImage(device, textureImage, NULL);
+no_texture_views:
+    // textureViews[textureSet.imageCount], up to the failed one which is NULL
+    for (uint32_t i = 0; i < textureSet.imageCount && textureViews[i] != NULL; i++) {
+        vkDestroyImageView(device, textureViews[i], NULL);
+    }
+    free(textureViews);
 no_texture_image:
+    // textureSet
+    ATextureSet_destroy(device, allocator, &textureSet);
     // descriptorSets[maxFrames]
     // vkFreeDescriptorSets is not aplicable
     // because descriptor pool's FREE flag is not set
@@ -527,26 +1003,32 @@ no_descriptor_sets:
     vkDestroyDescriptorPool(device, descriptorPool, NULL);
 no_descriptor_pool:
 partial_buffers:
-    // uBufsMapped[maxFrames]
-    // uBufsMem[maxFrames], iBufMem, siBufMem, svBufMem, vBufMem
-    // svBuffer, vBuffer, siBuffer, iBuffer, uBuffers[maxFrames]
-    free(uBufsMapped); // NULL ok
-    // NOTE: vkFreeMemory implies vkUnmapMemory if it was mapped
-    if (uBufsMem != NULL && uBuffers != NULL)
-        for (uint32_t i = 0; i < maxFrames; i++) {
-            // inside are non-null handles
-            vkFreeMemory(device, uBufsMem[i], NULL);
-            vkDestroyBuffer(device, uBuffers[i], NULL);
-        }
-    if (iBufMem != NULL) vkFreeMemory(device, iBufMem, NULL);
-    if (siBufMem != NULL) vkFreeMemory(device, siBufMem, NULL);
-    if (vBufMem != NULL) vkFreeMemory(device, vBufMem, NULL);
-    if (svBufMem != NULL) vkFreeMemory(device, svBufMem, NULL);
+    // uniforms
+    // iBufMem, vBufMem
+    // vBuffer, iBuffer
+    if (uniforms.buffer != NULL) AUniformArena_destroy(device, allocator, uniforms);
     if (iBuffer != NULL) vkDestroyBuffer(device, iBuffer, NULL);
-    if (siBuffer != NULL) vkDestroyBuffer(device, siBuffer, NULL);
     if (vBuffer != NULL) vkDestroyBuffer(device, vBuffer, NULL);
-    if (svBuffer != NULL) vkDestroyBuffer(device, svBuffer, NULL);
+    // empty allocation is ok
+    AAllocator_free(allocator, iBufMem);
+    AAllocator_free(allocator, vBufMem);
     // no_buffers: // (unused)
+    // streamer
+    ATextureStreamer_destroy(streamer);
+no_streamer:
+    // defrag
+    ADefragmenter_destroy(defrag);
+no_defrag:
+    // retire
+    ARetireQueue_destroy(retire);
+no_retire:
+    // upload
+    AUploadContext_destroy(upload);
+no_upload:
+    // staging
+    AStagingRing_destroy(staging);
+no_staging:
+    AGpuProfiler_destroy(profiler);
     // commandPool
     vkDestroyCommandPool(device, commandPool, NULL);
 no_command_pool:
@@ -555,14 +1037,26 @@ no_command_pool:
         vkDestroyFramebuffer(device, framebuffers[i], NULL);
     }
 no_framebuffers:
-    // graphicsPipeline
-    vkDestroyPipeline(device, graphicsPipeline, NULL);
+    // graphicsPipeline and variants are owned by pipelines
 no_pipeline:
-    // empty
+    // pipelines, waits for a variant still compiling
+    APipelineRegistry_destroy(pipelines);
+no_pipeline_registry:
+    // vertShader, fragShader, plArgs
+    AShader_destroy(device, vertShader);
+    AShader_destroy(device, fragShader);
+    APipelineParams_free(plArgs);
 no_shaders:
     // plLayout
     vkDestroyPipelineLayout(device, plLayout, NULL);
 no_pipeline_layout:
+    // pipelineCache
+    A_save_pipeline_cache(device, pdevice, pipelineCache, A_PIPELINE_CACHE_PATH);
+    vkDestroyPipelineCache(device, pipelineCache, NULL);
+no_pipeline_cache:
+    // bindlessTable
+    ABindlessTable_destroy(bindlessTable);
+no_bindless_table:
     // descriptorSetLayout
     vkDestroyDescriptorSetLayout(device, descriptorSetLayout, NULL);
 no_descriptor_set_layout:
@@ -572,6 +1066,9 @@ no_render_pass:
     // swapchain
     ASwapchain_destroy(device, swapchain);
 no_swapchain:
+    // allocator
+    AAllocator_destroy(allocator);
+no_allocator:
     // empty
 no_surface_support:
     // adevice
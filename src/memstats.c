@@ -0,0 +1,131 @@
+#include "memstats.h"
+#include "my_vulkan.h"
+#include "utils.h"
+
+AMemoryStats AMemoryStats_create(VkInstance instance, VkPhysicalDevice pdevice) {
+    VkPhysicalDeviceProperties deviceProps;
+    vkGetPhysicalDeviceProperties(pdevice, &deviceProps);
+    AMemoryStats stats = {
+        .pdevice = pdevice, .deviceType = deviceProps.deviceType, .getProps2 = NULL};
+    vkGetPhysicalDeviceMemoryProperties(pdevice, &stats.props);
+    if (A_is_memory_budget_supported(pdevice)) {
+        // instance is 1.0, use the KHR entry point
+        stats.getProps2 = (PFN_vkGetPhysicalDeviceMemoryProperties2)vkGetInstanceProcAddr(
+            instance, "vkGetPhysicalDeviceMemoryProperties2KHR");
+    }
+    if (stats.getProps2 == NULL)
+        eprintff(MSG_INFOF("VK_EXT_memory_budget is not available, budget is heap size"));
+    AMemoryStats_update_budget(&stats);
+    return stats;
+}
+
+static AMemoryCounters *heap_of(AMemoryStats *stats, uint32_t memoryTypeIndex) {
+    return &stats->heaps[stats->props.memoryTypes[memoryTypeIndex].heapIndex].counters;
+}
+
+void AMemoryStats_add_block(AMemoryStats *stats, uint32_t memoryTypeIndex, VkDeviceSize size) {
+    AMemoryCounters *type = stats->types + memoryTypeIndex, *heap = heap_of(stats, memoryTypeIndex);
+    type->blockBytes += size;
+    type->blockCount++;
+    heap->blockBytes += size;
+    heap->blockCount++;
+}
+
+void AMemoryStats_remove_block(AMemoryStats *stats, uint32_t memoryTypeIndex, VkDeviceSize size) {
+    AMemoryCounters *type = stats->types + memoryTypeIndex, *heap = heap_of(stats, memoryTypeIndex);
+    type->blockBytes -= size;
+    type->blockCount--;
+    heap->blockBytes -= size;
+    heap->blockCount--;
+}
+
+void AMemoryStats_add_allocation(
+    AMemoryStats *stats, uint32_t memoryTypeIndex, VkDeviceSize size) {
+    AMemoryCounters *type = stats->types + memoryTypeIndex, *heap = heap_of(stats, memoryTypeIndex);
+    type->allocationBytes += size;
+    type->allocationCount++;
+    heap->allocationBytes += size;
+    heap->allocationCount++;
+}
+
+void AMemoryStats_remove_allocation(
+    AMemoryStats *stats, uint32_t memoryTypeIndex, VkDeviceSize size) {
+    AMemoryCounters *type = stats->types + memoryTypeIndex, *heap = heap_of(stats, memoryTypeIndex);
+    type->allocationBytes -= size;
+    type->allocationCount--;
+    heap->allocationBytes -= size;
+    heap->allocationCount--;
+}
+
+uint32_t AMemoryStats_update_budget(AMemoryStats *stats) {
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budget = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT};
+    if (stats->getProps2 != NULL) {
+        VkPhysicalDeviceMemoryProperties2 props2 = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2, .pNext = &budget};
+        stats->getProps2(stats->pdevice, &props2);
+    }
+    uint32_t overBudget = 0;
+    for (uint32_t i = 0; i < stats->props.memoryHeapCount; i++) {
+        AMemoryHeapStats *heap = stats->heaps + i;
+        if (stats->getProps2 != NULL) {
+            heap->budget = budget.heapBudget[i];
+            heap->usage = budget.heapUsage[i];
+        }
+        else {
+            heap->budget = stats->props.memoryHeaps[i].size;
+            heap->usage = heap->counters.blockBytes;
+        }
+        if (heap->budget != 0 && heap->usage * 100 > heap->budget * A_BUDGET_WARN_PERCENT) {
+            eprintff(
+                MSG_WARNF("heap %u uses %llu of %llu budget bytes"), i,
+                (unsigned long long)heap->usage, (unsigned long long)heap->budget);
+            overBudget++;
+        }
+    }
+    return overBudget;
+}
+
+static void write_counters(AMemoryCounters counters, FILE *file) {
+    fprintf(
+        file, "\"blockBytes\": %llu, \"blockCount\": %u, \"allocationBytes\": %llu, "
+              "\"allocationCount\": %u",
+        (unsigned long long)counters.blockBytes, counters.blockCount,
+        (unsigned long long)counters.allocationBytes, counters.allocationCount);
+}
+
+void AMemoryStats_write_json(AMemoryStats const *stats, FILE *file) {
+    AMemoryCounters total = {0};
+    for (uint32_t i = 0; i < stats->props.memoryHeapCount; i++) {
+        AMemoryCounters heap = stats->heaps[i].counters;
+        total.blockBytes += heap.blockBytes;
+        total.blockCount += heap.blockCount;
+        total.allocationBytes += heap.allocationBytes;
+        total.allocationCount += heap.allocationCount;
+    }
+    fprintf(file, "{\n  \"budgetExt\": %s,\n  \"total\": {", stats->getProps2 ? "true" : "false");
+    write_counters(total, file);
+    fprintf(file, "},\n  \"heaps\": [\n");
+    for (uint32_t i = 0; i < stats->props.memoryHeapCount; i++) {
+        AMemoryHeapStats const *heap = stats->heaps + i;
+        VkMemoryHeap props = stats->props.memoryHeaps[i];
+        fprintf(
+            file, "    {\"index\": %u, \"size\": %llu, \"deviceLocal\": %s, ", i,
+            (unsigned long long)props.size,
+            props.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT ? "true" : "false");
+        write_counters(heap->counters, file);
+        fprintf(
+            file, ", \"budget\": %llu, \"usage\": %llu}%s\n", (unsigned long long)heap->budget,
+            (unsigned long long)heap->usage, i + 1 < stats->props.memoryHeapCount ? "," : "");
+    }
+    fprintf(file, "  ],\n  \"types\": [\n");
+    for (uint32_t i = 0; i < stats->props.memoryTypeCount; i++) {
+        VkMemoryType props = stats->props.memoryTypes[i];
+        fprintf(
+            file, "    {\"index\": %u, \"heap\": %u, \"flags\": %u, ", i, props.heapIndex,
+            props.propertyFlags);
+        write_counters(stats->types[i], file);
+        fprintf(file, "}%s\n", i + 1 < stats->props.memoryTypeCount ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+}
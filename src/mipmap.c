@@ -0,0 +1,111 @@
+#include "mipmap.h"
+#include "convert.h"
+#include "utils.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+uint32_t mip_level_count(uint32_t width, uint32_t height) {
+    uint32_t levels = 1;
+    for (uint32_t size = MAX(width, height); size > 1; size >>= 1) { levels++; }
+    return levels;
+}
+
+VkExtent2D mip_extent(uint32_t width, uint32_t height, uint32_t level) {
+    return (VkExtent2D){.width = MAX(width >> level, 1u), .height = MAX(height >> level, 1u)};
+}
+
+ATexelBlock texel_block(VkFormat format) {
+    switch (format) {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK: return (ATexelBlock){.width = 4, .height = 4, .size = 8};
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK: return (ATexelBlock){.width = 4, .height = 4, .size = 16};
+    default: return (ATexelBlock){.width = 1, .height = 1, .size = 4};
+    }
+}
+
+VkDeviceSize mip_level_size(VkFormat format, uint32_t width, uint32_t height, uint32_t level) {
+    ATexelBlock block = texel_block(format);
+    VkExtent2D extent = mip_extent(width, height, level);
+    VkDeviceSize columns = (extent.width + block.width - 1) / block.width;
+    VkDeviceSize rows = (extent.height + block.height - 1) / block.height;
+    return columns * rows * block.size;
+}
+
+VkDeviceSize mip_chain_size(VkFormat format, uint32_t width, uint32_t height, uint32_t levels) {
+    VkDeviceSize size = 0;
+    for (uint32_t i = 0; i < levels; i++) { size += mip_level_size(format, width, height, i); }
+    return size;
+}
+
+// filtering is done on 16-bit linear values, see convert_srgb_to_linear
+static void downsample(
+    uint16_t const *src, VkExtent2D srcExtent, uint16_t *dst, VkExtent2D dstExtent) {
+    size_t srcRow = (size_t)srcExtent.width * 4;
+    for (uint32_t y = 0; y < dstExtent.height; y++) {
+        uint16_t const *row0 = src + MIN(2 * y, srcExtent.height - 1) * srcRow;
+        uint16_t const *row1 = src + MIN(2 * y + 1, srcExtent.height - 1) * srcRow;
+        uint16_t *out = dst + (size_t)y * dstExtent.width * 4;
+        uint32_t x = 0;
+#ifdef __SSE2__
+        // two texels out of four full source columns per iteration
+        for (; 2 * x + 3 < srcExtent.width; x += 2) {
+            __m128i a01 = _mm_loadu_si128((__m128i const *)(row0 + 8 * x));
+            __m128i a23 = _mm_loadu_si128((__m128i const *)(row0 + 8 * x + 8));
+            __m128i b01 = _mm_loadu_si128((__m128i const *)(row1 + 8 * x));
+            __m128i b23 = _mm_loadu_si128((__m128i const *)(row1 + 8 * x + 8));
+            __m128i v01 = _mm_avg_epu16(a01, b01), v23 = _mm_avg_epu16(a23, b23);
+            __m128i even = _mm_unpacklo_epi64(v01, v23), odd = _mm_unpackhi_epi64(v01, v23);
+            _mm_storeu_si128((__m128i *)(out + 4 * x), _mm_avg_epu16(even, odd));
+        }
+#endif
+        for (; x < dstExtent.width; x++) {
+            uint32_t x0 = MIN(2 * x, srcExtent.width - 1) * 4;
+            uint32_t x1 = MIN(2 * x + 1, srcExtent.width - 1) * 4;
+            for (uint32_t c = 0; c < 4; c++) {
+                uint32_t sum = row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c];
+                out[4 * x + c] = (uint16_t)((sum + 2) >> 2);
+            }
+        }
+    }
+}
+
+int generate_mip_chain_srgb(
+    uint8_t const *level0, uint32_t width, uint32_t height, uint32_t levels, uint8_t *out_levels) {
+    if (levels <= 1) return 0;
+    VkExtent2D half = mip_extent(width, height, 1);
+    // ping-pong between level 0 sized and level 1 sized buffers
+    ARR_ALLOC(uint16_t, a, (size_t)width * height * 4);
+    ARR_ALLOC(uint16_t, b, (size_t)half.width * half.height * 4);
+    ARR_ALLOC(ASrgbTables, tables, 1);
+    if (a == NULL || b == NULL || tables == NULL) {
+        eprintff(MSG_ERRORF("cannot allocate mip chain scratch for %ux%u"), width, height);
+        free(tables);
+        free(b);
+        free(a);
+        return 1;
+    }
+    init_srgb_tables(tables);
+    convert_srgb_to_linear(tables, a, level0, (size_t)width * height);
+    uint16_t *src = a, *dst = b;
+    for (uint32_t level = 1; level < levels; level++) {
+        VkExtent2D srcExtent = mip_extent(width, height, level - 1);
+        VkExtent2D dstExtent = mip_extent(width, height, level);
+        downsample(src, srcExtent, dst, dstExtent);
+        size_t texels = (size_t)dstExtent.width * dstExtent.height;
+        convert_linear_to_srgb(tables, out_levels, dst, texels);
+        out_levels += texels * 4;
+        uint16_t *t = src;
+        src = dst;
+        dst = t;
+    }
+    free(tables);
+    free(b);
+    free(a);
+    return 0;
+}
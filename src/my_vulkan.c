@@ -6,6 +6,7 @@
 #include "shader.h"
 #include "sync.h"
 #include "utils.h"
+#include <string.h>
 
 VkInstance A_create_instance(SDL_Window *window, uint32_t apiVersion) {
 #ifndef NDEBUG
@@ -22,8 +23,11 @@ VkInstance A_create_instance(SDL_Window *window, uint32_t apiVersion) {
 
     uint32_t extensionCount;
     SDL_Vulkan_GetInstanceExtensions(window, &extensionCount, NULL);
-    ARR_ALLOC(char const *, extensions, extensionCount);
+    ARR_ALLOC(char const *, extensions, extensionCount + 1); // + optional
     SDL_Vulkan_GetInstanceExtensions(window, &extensionCount, extensions);
+    // needed by VK_EXT_memory_budget
+    if (A_has_instance_extension(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME))
+        extensions[extensionCount++] = VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME;
     VkInstanceCreateInfo instanceInfo = {
         .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
         .pApplicationInfo = &appInfo,
@@ -41,6 +45,71 @@ VkInstance A_create_instance(SDL_Window *window, uint32_t apiVersion) {
     return instance;
 }
 
+VkBool32 A_has_instance_extension(char const *name) {
+    uint32_t count;
+    vkEnumerateInstanceExtensionProperties(NULL, &count, NULL);
+    ARR_ALLOC(VkExtensionProperties, props, count);
+    vkEnumerateInstanceExtensionProperties(NULL, &count, props);
+    VkBool32 found = VK_FALSE;
+    for (uint32_t i = 0; i < count && !found; i++) {
+        if (strcmp(props[i].extensionName, name) == 0) found = VK_TRUE;
+    }
+    free(props);
+    return found;
+}
+
+VkBool32 A_has_device_extension(VkPhysicalDevice pdevice, char const *name) {
+    uint32_t count;
+    vkEnumerateDeviceExtensionProperties(pdevice, NULL, &count, NULL);
+    ARR_ALLOC(VkExtensionProperties, props, count);
+    vkEnumerateDeviceExtensionProperties(pdevice, NULL, &count, props);
+    VkBool32 found = VK_FALSE;
+    for (uint32_t i = 0; i < count && !found; i++) {
+        if (strcmp(props[i].extensionName, name) == 0) found = VK_TRUE;
+    }
+    free(props);
+    return found;
+}
+
+VkBool32 A_is_memory_budget_supported(VkPhysicalDevice pdevice) {
+    return A_has_instance_extension(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) &&
+           A_has_device_extension(pdevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+}
+
+VkBool32 A_is_bindless_supported(VkInstance instance, VkPhysicalDevice pdevice) {
+    if (!A_has_instance_extension(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) ||
+        !A_has_device_extension(pdevice, VK_KHR_MAINTENANCE3_EXTENSION_NAME) ||
+        !A_has_device_extension(pdevice, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME))
+        return VK_FALSE;
+    // instance is 1.0, core entry point may be missing
+    PFN_vkGetPhysicalDeviceFeatures2 getFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2)
+        vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR");
+    if (getFeatures2 == NULL) return VK_FALSE;
+    VkPhysicalDeviceDescriptorIndexingFeatures indexing = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES};
+    VkPhysicalDeviceFeatures2 features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &indexing};
+    getFeatures2(pdevice, &features);
+    return indexing.runtimeDescriptorArray && indexing.descriptorBindingPartiallyBound &&
+           indexing.descriptorBindingSampledImageUpdateAfterBind &&
+           indexing.shaderSampledImageArrayNonUniformIndexing;
+}
+
+VkBool32 A_is_timeline_supported(VkInstance instance, VkPhysicalDevice pdevice) {
+    if (!A_has_instance_extension(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) ||
+        !A_has_device_extension(pdevice, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME))
+        return VK_FALSE;
+    PFN_vkGetPhysicalDeviceFeatures2 getFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2)
+        vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR");
+    if (getFeatures2 == NULL) return VK_FALSE;
+    VkPhysicalDeviceTimelineSemaphoreFeatures timeline = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES};
+    VkPhysicalDeviceFeatures2 features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &timeline};
+    getFeatures2(pdevice, &features);
+    return timeline.timelineSemaphore;
+}
+
 VkSurfaceKHR A_create_surface(SDL_Window *window, VkInstance instance) {
     VkSurfaceKHR surface;
     SDL_bool surfaceCreated = SDL_Vulkan_CreateSurface(window, instance, &surface);
@@ -114,12 +183,22 @@ AQueueFamilies A_select_queue_families(VkPhysicalDevice pdevice, VkSurfaceKHR su
         if (presentSupport) pIdx = i;
         if (gIdx != -1 && pIdx != -1) break;
     }
+    // find transfer family, prefer dedicated DMA engine
+    int32_t tIdx = -1;
+    for (uint32_t i = 0; i < qFamCount; i++) {
+        VkQueueFamilyProperties qFam = qFamProps[i];
+        if (qFam.queueCount == 0 || qFam.queueFlags & VK_QUEUE_GRAPHICS_BIT) continue;
+        if (!(qFam.queueFlags & VK_QUEUE_TRANSFER_BIT)) continue;
+        if (tIdx == -1 || !(qFam.queueFlags & VK_QUEUE_COMPUTE_BIT)) tIdx = i;
+    }
     free(qFamProps);
     if (gIdx == -1 || pIdx == -1) { eprintff(MSG_ERRORF("cannot find suitable queue families")); }
-    return (AQueueFamilies){.count = qFamCount, .graphicsIndex = gIdx, .presentIndex = pIdx};
+    return (AQueueFamilies){
+        .count = qFamCount, .graphicsIndex = gIdx, .presentIndex = pIdx, .transferIndex = tIdx};
 }
 
-ADevice ADevice_create(VkPhysicalDevice pdevice, AQueueFamilies queueFamilies) {
+ADevice ADevice_create(
+    VkInstance instance, VkPhysicalDevice pdevice, AQueueFamilies queueFamilies) {
     // device queue create info && queue priorities
     ARR_ALLOC(VkDeviceQueueCreateInfo, deviceQueueInfos, queueFamilies.count);
     float priority = 1.0f;
@@ -134,12 +213,43 @@ ADevice ADevice_create(VkPhysicalDevice pdevice, AQueueFamilies queueFamilies) {
     // physical device extensions
     char const *extensions[VK_MAX_EXTENSION_NAME_SIZE] = {"VK_KHR_swapchain"};
     uint32_t extensionCount = 1;
+    if (A_is_memory_budget_supported(pdevice))
+        extensions[extensionCount++] = VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+    // only what ABindlessTable needs
+    VkBool32 bindless = A_is_bindless_supported(instance, pdevice);
+    VkPhysicalDeviceDescriptorIndexingFeatures indexing = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES,
+        .shaderSampledImageArrayNonUniformIndexing = VK_TRUE,
+        .descriptorBindingSampledImageUpdateAfterBind = VK_TRUE,
+        .descriptorBindingPartiallyBound = VK_TRUE,
+        .runtimeDescriptorArray = VK_TRUE};
+    if (bindless) {
+        extensions[extensionCount++] = VK_KHR_MAINTENANCE3_EXTENSION_NAME;
+        extensions[extensionCount++] = VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME;
+    }
+    // frame completion for AFramePacer
+    VkBool32 timeline = A_is_timeline_supported(instance, pdevice);
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES,
+        .timelineSemaphore = VK_TRUE};
+    if (timeline) extensions[extensionCount++] = VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME;
+    // feature structs chained as enabled
+    void *next = NULL;
+    if (timeline) {
+        timelineFeatures.pNext = next;
+        next = &timelineFeatures;
+    }
+    if (bindless) {
+        indexing.pNext = next;
+        next = &indexing;
+    }
     VkPhysicalDeviceFeatures features;
     vkGetPhysicalDeviceFeatures(pdevice, &features);
     features.samplerAnisotropy = VK_TRUE;
 
     VkDeviceCreateInfo deviceInfo = {
         .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+        .pNext = next,
         .queueCreateInfoCount = queueFamilies.count,
         .pQueueCreateInfos = deviceQueueInfos,
         .enabledExtensionCount = extensionCount,
@@ -154,11 +264,20 @@ ADevice ADevice_create(VkPhysicalDevice pdevice, AQueueFamilies queueFamilies) {
         goto no_device;
     }
     // get queues
-    VkQueue drawQueue, presentQueue;
+    VkQueue drawQueue, presentQueue, transferQueue;
     vkGetDeviceQueue(device, queueFamilies.graphicsIndex, 0, &drawQueue);
     vkGetDeviceQueue(device, queueFamilies.presentIndex, 0, &presentQueue);
+    if (queueFamilies.transferIndex != -1)
+        vkGetDeviceQueue(device, queueFamilies.transferIndex, 0, &transferQueue);
+    else transferQueue = drawQueue;
 
-    return (ADevice){.device = device, .drawQueue = drawQueue, .presentQueue = presentQueue};
+    return (ADevice){
+        .device = device,
+        .drawQueue = drawQueue,
+        .presentQueue = presentQueue,
+        .transferQueue = transferQueue,
+        .bindless = bindless,
+        .timeline = timeline};
 no_device:
     return (ADevice){.device = NULL};
 }
@@ -183,28 +302,35 @@ static VkSurfaceFormatKHR get_surface_format(VkPhysicalDevice pdevice, VkSurface
     return surfFormat;
 }
 
-static VkPresentModeKHR get_present_mode(VkPhysicalDevice pdevice, VkSurfaceKHR surface) {
+static VkPresentModeKHR get_present_mode(
+    VkPhysicalDevice pdevice, VkSurfaceKHR surface, VkPresentModeKHR preferred) {
     uint32_t presentModeCount;
     vkGetPhysicalDeviceSurfacePresentModesKHR(pdevice, surface, &presentModeCount, NULL);
     ARR_ALLOC(VkPresentModeKHR, presentModes, presentModeCount);
     vkGetPhysicalDeviceSurfacePresentModesKHR(pdevice, surface, &presentModeCount, presentModes);
+    VkPresentModeKHR wanted =
+        preferred == A_PRESENT_MODE_AUTO ? VK_PRESENT_MODE_MAILBOX_KHR : preferred;
+    // FIFO is always supported
     VkPresentModeKHR thePresentMode = VK_PRESENT_MODE_FIFO_KHR;
     for (uint32_t i = 0; i < presentModeCount; i++) {
-        if (presentModes[i] == VK_PRESENT_MODE_MAILBOX_KHR) {
-            thePresentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+        if (presentModes[i] == wanted) {
+            thePresentMode = wanted;
             break;
         }
     }
     free(presentModes);
+    if (preferred != A_PRESENT_MODE_AUTO && thePresentMode != preferred)
+        eprintff(MSG_WARNF("present mode %d is not supported, using FIFO"), preferred);
     return thePresentMode;
 }
 
 ASwapchain ASwapchain_create(
-    VkPhysicalDevice pdevice, VkSurfaceKHR surface, AQueueFamilies queueFamilies, VkDevice device) {
+    VkPhysicalDevice pdevice, VkSurfaceKHR surface, AQueueFamilies queueFamilies, VkDevice device,
+    VkPresentModeKHR presentMode, VkSwapchainKHR oldSwapchain) {
     VkSurfaceCapabilitiesKHR surfCaps;
     vkGetPhysicalDeviceSurfaceCapabilitiesKHR(pdevice, surface, &surfCaps);
     VkSurfaceFormatKHR surfFormat = get_surface_format(pdevice, surface);
-    VkPresentModeKHR presentMode = get_present_mode(pdevice, surface);
+    presentMode = get_present_mode(pdevice, surface, presentMode);
     VkExtent2D swapchainExtent = surfCaps.currentExtent;
     VkSharingMode imageSharingMode;
     uint32_t qFamIdxCount;
@@ -240,7 +366,7 @@ ASwapchain ASwapchain_create(
         .compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
         .presentMode = presentMode,
         .clipped = VK_TRUE,
-        .oldSwapchain = NULL};
+        .oldSwapchain = oldSwapchain};
     VkSwapchainKHR swapchain;
     VkResult res = vkCreateSwapchainKHR(device, &swapchainInfo, NULL, &swapchain);
     if (res != VK_SUCCESS) {
@@ -258,7 +384,8 @@ ASwapchain ASwapchain_create(
     ARR_ALLOC(VkImageView, swapchainImageViews, swapchainImageCount);
     uint32_t imageViewSuccessful = swapchainImageCount;
     for (uint32_t i = 0; i < swapchainImageCount; i++) {
-        VkImageView imageView = create_image_view(device, swapchainImages[i], swapchainImageFormat);
+        VkImageView imageView = create_image_view(
+            device, swapchainImages[i], VK_IMAGE_VIEW_TYPE_2D, swapchainImageFormat, 0, 1, 1);
         if (imageView == NULL) {
             eprintff(MSG_ERRORF("failed to create image view"));
             imageViewSuccessful = i; // excluding this
@@ -270,6 +397,7 @@ ASwapchain ASwapchain_create(
         .swapchain = swapchain,
         .extent = swapchainExtent,
         .imageFormat = swapchainImageFormat,
+        .presentMode = presentMode,
         .imageCount = swapchainImageCount,
         .images = swapchainImages,
         .imageViews = swapchainImageViews};
@@ -289,8 +417,8 @@ VkImageView *A_create_swapchain_image_views(VkDevice device, ASwapchain swapchai
     ARR_ALLOC(VkImageView, swapchainImageViews, swapchain.imageCount);
     uint32_t imageViewSuccessful;
     for (uint32_t i = 0; i < swapchain.imageCount; i++) {
-        VkImageView imageView =
-            create_image_view(device, swapchain.images[i], swapchain.imageFormat);
+        VkImageView imageView = create_image_view(
+            device, swapchain.images[i], VK_IMAGE_VIEW_TYPE_2D, swapchain.imageFormat, 0, 1, 1);
         if (imageView == NULL) {
             eprintff(MSG_ERRORF("failed to create image view"));
             imageViewSuccessful = i; // excluding this
@@ -469,15 +597,33 @@ void ASwapchain_destroy(VkDevice device, ASwapchain swapchain) {
 
 ARecreatedSwapchain A_recreate_swapchain(
     VkPhysicalDevice pdevice, VkSurfaceKHR surface, AQueueFamilies queueFamilies, VkDevice device,
-    VkRenderPass renderPass, ASwapchain oldSwapchain,
-    VkFramebuffer oldFramebuffers[oldSwapchain.imageCount]) {
-    vkDeviceWaitIdle(device);
+    VkRenderPass renderPass, ARetireQueue *retire, VkPresentModeKHR presentMode,
+    ASwapchain oldSwapchain, VkFramebuffer oldFramebuffers[oldSwapchain.imageCount]) {
+    VkSurfaceCapabilitiesKHR surfCaps;
+    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(pdevice, surface, &surfCaps);
+    if (surfCaps.currentExtent.width == 0 || surfCaps.currentExtent.height == 0)
+        return (ARecreatedSwapchain){.swapchain = {.swapchain = NULL}};
+    ASwapchain newSwapchain = ASwapchain_create(
+        pdevice, surface, queueFamilies, device, presentMode, oldSwapchain.swapchain);
+    if (newSwapchain.swapchain == NULL)
+        return (ARecreatedSwapchain){.swapchain = {.swapchain = NULL}};
+    VkFramebuffer *newFramebuffers = A_create_framebuffers(device, renderPass, newSwapchain);
+    if (newFramebuffers == NULL) {
+        ASwapchain_destroy(device, newSwapchain);
+        return (ARecreatedSwapchain){.swapchain = {.swapchain = NULL}};
+    }
+    // frames in flight may still render to old images, no wait for the device here
     for (uint32_t i = 0; i < oldSwapchain.imageCount; i++) {
-        vkDestroyFramebuffer(device, oldFramebuffers[i], NULL);
+        ARetireQueue_push(
+            retire, (ARetired){.kind = A_RETIRED_FRAMEBUFFER, .framebuffer = oldFramebuffers[i]});
+        ARetireQueue_push(
+            retire,
+            (ARetired){.kind = A_RETIRED_IMAGE_VIEW, .imageView = oldSwapchain.imageViews[i]});
     }
-    ASwapchain_destroy(device, oldSwapchain);
-    ASwapchain newSwapchain = ASwapchain_create(pdevice, surface, queueFamilies, device);
-    VkFramebuffer *newFramebuffers = A_create_framebuffers(device, renderPass, newSwapchain);
+    ARetireQueue_push(
+        retire, (ARetired){.kind = A_RETIRED_SWAPCHAIN, .swapchain = oldSwapchain.swapchain});
+    free(oldFramebuffers);
+    free(oldSwapchain.imageViews);
+    free(oldSwapchain.images);
     return (ARecreatedSwapchain){.swapchain = newSwapchain, .framebuffers = newFramebuffers};
-    // TODO: errors
 }
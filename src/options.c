@@ -0,0 +1,99 @@
+#include "options.h"
+#include "my_vulkan.h"
+#include "sync.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct PresentModeName {
+    char const *name;
+    VkPresentModeKHR mode;
+} PresentModeName;
+
+static PresentModeName const presentModes[] = {
+    {"auto",         A_PRESENT_MODE_AUTO             },
+    {"fifo",         VK_PRESENT_MODE_FIFO_KHR        },
+    {"fifo-relaxed", VK_PRESENT_MODE_FIFO_RELAXED_KHR},
+    {"mailbox",      VK_PRESENT_MODE_MAILBOX_KHR     },
+    {"immediate",    VK_PRESENT_MODE_IMMEDIATE_KHR   },
+};
+
+static void print_usage(char const *program) {
+    fprintf(
+        stderr,
+        "usage: %s [options]\n"
+        "  --frames-in-flight N  frames recorded ahead of the GPU, 1 to %u (default %u)\n"
+        "  --present-mode MODE   auto, fifo, fifo-relaxed, mailbox or immediate (default auto)\n"
+        "  --fps N               cap frame rate at N, 0 for no cap (default 0)\n",
+        program, A_MAX_FRAMES_IN_FLIGHT, A_DEFAULT_FRAMES_IN_FLIGHT);
+}
+
+char const *A_present_mode_name(VkPresentModeKHR presentMode) {
+    for (uint32_t i = 0; i < ARR_LEN(presentModes); i++) {
+        if (presentModes[i].mode == presentMode) return presentModes[i].name;
+    }
+    return "unknown";
+}
+
+/*
+ * 0 on success
+ * 1 if text names no present mode
+ */
+static int parse_present_mode(char const *text, VkPresentModeKHR *out_mode) {
+    for (uint32_t i = 0; i < ARR_LEN(presentModes); i++) {
+        if (strcmp(presentModes[i].name, text) != 0) continue;
+        *out_mode = presentModes[i].mode;
+        return 0;
+    }
+    return 1;
+}
+
+/*
+ * 0 on success
+ * 1 if text is not a number within [min, max]
+ */
+static int parse_uint(char const *text, uint32_t min, uint32_t max, uint32_t *out_value) {
+    char *end = NULL;
+    unsigned long value = strtoul(text, &end, 10);
+    if (end == text || *end != '\0' || value < min || value > max) return 1;
+    *out_value = (uint32_t)value;
+    return 0;
+}
+
+int AOptions_parse(int argc, char **argv, AOptions *out_options) {
+    AOptions options = {
+        .framesInFlight = A_DEFAULT_FRAMES_IN_FLIGHT, .presentMode = A_PRESENT_MODE_AUTO, .fps = 0};
+    char const *program = argc > 0 ? argv[0] : "vktest";
+    for (int i = 1; i < argc; i++) {
+        char const *arg = argv[i];
+        char const *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(arg, "--frames-in-flight") == 0 && value != NULL) {
+            if (parse_uint(value, 1, A_MAX_FRAMES_IN_FLIGHT, &options.framesInFlight) != 0) {
+                eprintff(MSG_ERRORF("bad frames in flight '%s'"), value);
+                goto bad_option;
+            }
+            i++;
+        } else if (strcmp(arg, "--present-mode") == 0 && value != NULL) {
+            if (parse_present_mode(value, &options.presentMode) != 0) {
+                eprintff(MSG_ERRORF("bad present mode '%s'"), value);
+                goto bad_option;
+            }
+            i++;
+        } else if (strcmp(arg, "--fps") == 0 && value != NULL) {
+            if (parse_uint(value, 0, 1000, &options.fps) != 0) {
+                eprintff(MSG_ERRORF("bad fps '%s'"), value);
+                goto bad_option;
+            }
+            i++;
+        } else {
+            eprintff(MSG_ERRORF("unknown option '%s'"), arg);
+            goto bad_option;
+        }
+    }
+    *out_options = options;
+    return 0;
+bad_option:
+    print_usage(program);
+    return 1;
+}
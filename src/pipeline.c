@@ -106,16 +106,17 @@ VkPipelineLayout A_create_pipeline_layout(
 }
 
 VkPipeline A_create_pipeline(
-    VkDevice device, VkPipelineLayout pipelineLayout, VkRenderPass renderPass,
-    char const *entryPointGroup, uint32_t shaderCount, AShader const *shaders,
-    APipelineParams args) {
+    VkDevice device, VkPipelineCache cache, VkPipelineLayout pipelineLayout,
+    VkRenderPass renderPass, char const *entryPointGroup, uint32_t shaderCount,
+    AShader const *shaders, APipelineParams args) {
     ARR_ALLOC(VkPipelineShaderStageCreateInfo, stages, shaderCount);
     for (uint32_t i = 0; i < shaderCount; i++) {
         stages[i] = (VkPipelineShaderStageCreateInfo){
             .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
             .stage = shaders[i].stage,
             .module = shaders[i].module,
-            .pName = entryPointGroup};
+            .pName = entryPointGroup,
+            .pSpecializationInfo = shaders[i].specialization};
     }
     VkPipelineVertexInputStateCreateInfo vertexInputState = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
@@ -176,7 +177,8 @@ VkPipeline A_create_pipeline(
     };
 
     VkPipeline pipeline;
-    VkResult res = vkCreateGraphicsPipelines(device, NULL, 1, &pipelineCreateInfo, NULL, &pipeline);
+    VkResult res =
+        vkCreateGraphicsPipelines(device, cache, 1, &pipelineCreateInfo, NULL, &pipeline);
     free(stages);
     if (res != VK_SUCCESS) {
         eprintff(MSG_ERRORF("cannot create graphics pipeline: %d"), res);
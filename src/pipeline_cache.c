@@ -0,0 +1,142 @@
+#include "pipeline_cache.h"
+#include "files.h"
+#include "hash.h"
+#include "utils.h"
+#include <string.h>
+
+#define CACHE_MAGIC 0x434c5041 // "APLC"
+// bump when CacheHeader changes
+#define CACHE_VERSION 1
+#define CACHE_PATH_SIZE 256
+// VkPipelineCacheHeaderVersionOne, start of data from vkGetPipelineCacheData
+#define VK_CACHE_HEADER_SIZE (16 + VK_UUID_SIZE)
+
+// native byte order, Vulkan data follows, driver version is not in Vulkan header
+typedef struct CacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vendorID;
+    uint32_t deviceID;
+    uint32_t driverVersion;
+    uint8_t uuid[VK_UUID_SIZE];
+    uint64_t size;     // of Vulkan data
+    uint64_t checksum; // fnv1a of Vulkan data
+} CacheHeader;
+
+static uint32_t get_u32(uint8_t const *bytes) {
+    uint32_t value;
+    memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+/*
+ * returns NULL if Vulkan data after CacheHeader can be given to the driver
+ * why it cannot otherwise
+ */
+static char const *check_file(
+    VkPhysicalDeviceProperties const *props, uint8_t const *file, size_t fileSize) {
+    if (fileSize < sizeof(CacheHeader)) return "is truncated";
+    CacheHeader header;
+    memcpy(&header, file, sizeof(header));
+    if (header.magic != CACHE_MAGIC || header.version != CACHE_VERSION)
+        return "has another format";
+    if (header.vendorID != props->vendorID || header.deviceID != props->deviceID ||
+        memcmp(header.uuid, props->pipelineCacheUUID, VK_UUID_SIZE) != 0)
+        return "is from another device";
+    if (header.driverVersion != props->driverVersion) return "is from another driver";
+    uint8_t const *data = file + sizeof(header);
+    if (header.size != fileSize - sizeof(header) || header.size < VK_CACHE_HEADER_SIZE ||
+        fnv1a(A_FNV_OFFSET, data, header.size) != header.checksum)
+        return "is corrupt";
+    // drivers check this too, mismatching data is still dropped here rather than trusted
+    uint32_t vkHeaderSize = get_u32(data), vkHeaderVersion = get_u32(data + 4);
+    if (vkHeaderSize < VK_CACHE_HEADER_SIZE || vkHeaderSize > header.size ||
+        vkHeaderVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+        get_u32(data + 8) != props->vendorID || get_u32(data + 12) != props->deviceID ||
+        memcmp(data + 16, props->pipelineCacheUUID, VK_UUID_SIZE) != 0)
+        return "has mismatching Vulkan header";
+    return NULL;
+}
+
+VkPipelineCache A_load_pipeline_cache(
+    VkDevice device, VkPhysicalDevice pdevice, char const *path, VkBool32 *out_warm) {
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(pdevice, &props);
+    size_t fileSize = 0;
+    uint8_t *file = read_file(path, &fileSize);
+    char const *stale = file == NULL ? "is missing" : check_file(&props, file, fileSize);
+    VkPipelineCacheCreateInfo info = {.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO};
+    if (stale == NULL) {
+        info.initialDataSize = fileSize - sizeof(CacheHeader);
+        info.pInitialData = file + sizeof(CacheHeader);
+    } else {
+        eprintff(MSG_INFOF("pipeline cache '%s' %s, starting cold"), path, stale);
+    }
+    VkPipelineCache cache;
+    VkResult res = vkCreatePipelineCache(device, &info, NULL, &cache);
+    free(file);
+    if (res != VK_SUCCESS) {
+        eprintff(MSG_ERRORF("cannot create pipeline cache: %d"), res);
+        return NULL;
+    }
+    if (out_warm != NULL) *out_warm = stale == NULL;
+    return cache;
+}
+
+int A_save_pipeline_cache(
+    VkDevice device, VkPhysicalDevice pdevice, VkPipelineCache cache, char const *path) {
+    size_t size;
+    VkResult res = vkGetPipelineCacheData(device, cache, &size, NULL);
+    if (res != VK_SUCCESS) goto no_data;
+    ARR_ALLOC(uint8_t, data, size);
+    if (data == NULL) goto no_alloc;
+    res = vkGetPipelineCacheData(device, cache, &size, data);
+    if (res != VK_SUCCESS) {
+        free(data);
+        goto no_data;
+    }
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(pdevice, &props);
+    CacheHeader header;
+    // padding is written too
+    memset(&header, 0, sizeof(header));
+    header.magic = CACHE_MAGIC;
+    header.version = CACHE_VERSION;
+    header.vendorID = props.vendorID;
+    header.deviceID = props.deviceID;
+    header.driverVersion = props.driverVersion;
+    memcpy(header.uuid, props.pipelineCacheUUID, VK_UUID_SIZE);
+    header.size = size;
+    header.checksum = fnv1a(A_FNV_OFFSET, data, size);
+
+    char dir[CACHE_PATH_SIZE], tmpPath[CACHE_PATH_SIZE + 8];
+    snprintf(dir, sizeof(dir), "%s", path);
+    char *slash = strrchr(dir, '/');
+    if (slash != NULL) *slash = '\0';
+    int result = 1;
+    if (slash != NULL && make_dirs(dir) != 0) goto no_file;
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+    FILE *file = fopen(tmpPath, "wb");
+    if (file == NULL) {
+        eprintff(MSG_ERRORF("cannot open '%s' for writing"), tmpPath);
+        goto no_file;
+    }
+    result = 0;
+    if (fwrite(&header, sizeof(header), 1, file) != 1 || fwrite(data, size, 1, file) != 1)
+        result = 1;
+    if (fclose(file) != 0) result = 1;
+    if (result == 0 && rename(tmpPath, path) != 0) result = 1;
+    if (result != 0) {
+        eprintff(MSG_ERRORF("cannot write pipeline cache '%s'"), path);
+        remove(tmpPath);
+    }
+no_file:
+    free(data);
+    return result;
+no_data:
+    eprintff(MSG_ERRORF("cannot get pipeline cache data: %d"), res);
+    return 1;
+no_alloc:
+    eprintff(MSG_ERRORF("cannot allocate %zu bytes of pipeline cache data"), size);
+    return 1;
+}
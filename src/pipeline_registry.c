@@ -0,0 +1,342 @@
+#include "pipeline_registry.h"
+#include "hash.h"
+#include "utils.h"
+#include <string.h>
+
+#define INITIAL_CAPACITY 16
+
+/*
+ * Growing byte buffer the key is serialized into
+ * Fields are appended one by one, so struct padding and pNext never get in
+ */
+typedef struct KeyWriter {
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+    int failed;
+} KeyWriter;
+
+static void put(KeyWriter *writer, void const *value, size_t size) {
+    if (writer->failed || size == 0) return;
+    if (writer->size + size > writer->capacity) {
+        size_t capacity = MAX(writer->capacity * 2, writer->size + size);
+        uint8_t *data = realloc(writer->data, capacity);
+        if (data == NULL) {
+            writer->failed = 1;
+            return;
+        }
+        writer->data = data;
+        writer->capacity = capacity;
+    }
+    memcpy(writer->data + writer->size, value, size);
+    writer->size += size;
+}
+
+#define PUT(writer, value) put(writer, &(value), sizeof(value))
+
+static void put_desc(KeyWriter *w, APipelineDesc const *desc) {
+    PUT(w, desc->layout);
+    PUT(w, desc->renderPass);
+    uint32_t nameLength = (uint32_t)strlen(desc->entryPointGroup);
+    PUT(w, nameLength);
+    put(w, desc->entryPointGroup, nameLength);
+    PUT(w, desc->shaderCount);
+    for (uint32_t i = 0; i < desc->shaderCount; i++) {
+        PUT(w, desc->shaders[i].module);
+        PUT(w, desc->shaders[i].stage);
+        // no specialization is the same as no constants
+        VkSpecializationInfo const *spec = desc->shaders[i].specialization;
+        uint32_t constantCount = spec == NULL ? 0 : spec->mapEntryCount;
+        PUT(w, constantCount);
+        for (uint32_t j = 0; j < constantCount; j++) {
+            VkSpecializationMapEntry const *entry = spec->pMapEntries + j;
+            uint64_t size = entry->size;
+            PUT(w, entry->constantID);
+            PUT(w, entry->offset);
+            PUT(w, size);
+        }
+        uint64_t dataSize = spec == NULL ? 0 : spec->dataSize;
+        PUT(w, dataSize);
+        put(w, spec == NULL ? NULL : spec->pData, dataSize);
+    }
+    APipelineParams const *p = &desc->params;
+    // vertex input and blend attachment structs have only 32-bit members
+    PUT(w, p->bindingCount);
+    put(w, p->bindings, p->bindingCount * sizeof(*p->bindings));
+    PUT(w, p->attributeCount);
+    put(w, p->attributes, p->attributeCount * sizeof(*p->attributes));
+    VkPipelineRasterizationStateCreateInfo const *r = &p->rasterizationParams;
+    PUT(w, r->flags);
+    PUT(w, r->depthClampEnable);
+    PUT(w, r->rasterizerDiscardEnable);
+    PUT(w, r->polygonMode);
+    PUT(w, r->cullMode);
+    PUT(w, r->frontFace);
+    PUT(w, r->depthBiasEnable);
+    PUT(w, r->depthBiasConstantFactor);
+    PUT(w, r->depthBiasClamp);
+    PUT(w, r->depthBiasSlopeFactor);
+    PUT(w, r->lineWidth);
+    VkPipelineMultisampleStateCreateInfo const *m = &p->multisampleParams;
+    PUT(w, m->flags);
+    PUT(w, m->rasterizationSamples);
+    PUT(w, m->sampleShadingEnable);
+    PUT(w, m->minSampleShading);
+    PUT(w, m->alphaToCoverageEnable);
+    PUT(w, m->alphaToOneEnable);
+    uint32_t attachmentCount = p->colorBlendAttachmentCount;
+    PUT(w, attachmentCount);
+    put(w, p->colorBlendAttachments, attachmentCount * sizeof(*p->colorBlendAttachments));
+    PUT(w, p->colorBlendLogicOpEnable);
+    PUT(w, p->colorBlendLogicOp);
+    PUT(w, p->colorBlendConstants);
+}
+
+static void free_desc(APipelineDesc *desc) {
+    free((char *)desc->entryPointGroup);
+    for (uint32_t i = 0; i < desc->shaderCount && desc->shaders != NULL; i++) {
+        free((VkSpecializationInfo *)desc->shaders[i].specialization);
+    }
+    free((AShader *)desc->shaders);
+    APipelineParams_free(desc->params);
+    *desc = (APipelineDesc){0};
+}
+
+/*
+ * returns malloc copy of size bytes, NULL if size is 0
+ */
+static void *copy_array(void const *src, size_t size) {
+    if (size == 0) return NULL;
+    void *dst = malloc(size);
+    if (dst != NULL) memcpy(dst, src, size);
+    return dst;
+}
+
+/*
+ * returns copy of src in one block, NULL if src is NULL or on failure
+ */
+static VkSpecializationInfo *copy_specialization(VkSpecializationInfo const *src) {
+    if (src == NULL) return NULL;
+    size_t entriesSize = src->mapEntryCount * sizeof(*src->pMapEntries);
+    // info, then entries, then data
+    VkSpecializationInfo *dst = malloc(sizeof(*dst) + entriesSize + src->dataSize);
+    if (dst == NULL) return NULL;
+    VkSpecializationMapEntry *entries = (VkSpecializationMapEntry *)(dst + 1);
+    uint8_t *data = (uint8_t *)entries + entriesSize;
+    if (entriesSize > 0) memcpy(entries, src->pMapEntries, entriesSize);
+    if (src->dataSize > 0) memcpy(data, src->pData, src->dataSize);
+    *dst = (VkSpecializationInfo){
+        .mapEntryCount = src->mapEntryCount,
+        .pMapEntries = entries,
+        .dataSize = src->dataSize,
+        .pData = data};
+    return dst;
+}
+
+/*
+ * Deep copy of arrays and strings in src
+ * 0 on success
+ * 1 on failure, dst is empty then
+ */
+static int copy_desc(APipelineDesc *dst, APipelineDesc const *src) {
+    APipelineParams const *p = &src->params;
+    *dst = *src;
+    dst->entryPointGroup = copy_array(src->entryPointGroup, strlen(src->entryPointGroup) + 1);
+    AShader *shaders = copy_array(src->shaders, src->shaderCount * sizeof(*src->shaders));
+    dst->shaders = shaders;
+    int noSpecialization = 0;
+    for (uint32_t i = 0; i < src->shaderCount && shaders != NULL; i++) {
+        // the rest must not point at memory of src when freed
+        VkSpecializationInfo const *spec = src->shaders[i].specialization;
+        shaders[i].specialization = noSpecialization ? NULL : copy_specialization(spec);
+        if (spec != NULL && shaders[i].specialization == NULL) noSpecialization = 1;
+    }
+    dst->params.bindings = copy_array(p->bindings, p->bindingCount * sizeof(*p->bindings));
+    dst->params.attributes = copy_array(p->attributes, p->attributeCount * sizeof(*p->attributes));
+    dst->params.colorBlendAttachments = copy_array(
+        p->colorBlendAttachments,
+        p->colorBlendAttachmentCount * sizeof(*p->colorBlendAttachments));
+    if (dst->entryPointGroup == NULL || (src->shaderCount > 0 && shaders == NULL) ||
+        noSpecialization ||
+        (p->bindingCount > 0 && dst->params.bindings == NULL) ||
+        (p->attributeCount > 0 && dst->params.attributes == NULL) ||
+        (p->colorBlendAttachmentCount > 0 && dst->params.colorBlendAttachments == NULL)) {
+        free_desc(dst);
+        return 1;
+    }
+    return 0;
+}
+
+static void compile_entry(APipelineRegistry *registry, APipelineEntry *entry) {
+    APipelineDesc *desc = &entry->desc;
+    uint64_t start = SDL_GetPerformanceCounter();
+    entry->pipeline = A_create_pipeline(
+        registry->device, registry->cache, desc->layout, desc->renderPass, desc->entryPointGroup,
+        desc->shaderCount, desc->shaders, desc->params);
+    entry->seconds =
+        (double)(SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency();
+    free_desc(desc);
+    if (entry->pipeline == NULL) {
+        unsigned long long hash = entry->hash;
+        eprintff(MSG_ERRORF("pipeline %016llx failed, keeping fallback"), hash);
+        SDL_AtomicSet(&entry->state, A_PIPELINE_FAILED);
+    } else {
+        SDL_AtomicSet(&entry->state, A_PIPELINE_READY);
+    }
+}
+
+static int worker_main(void *data) {
+    APipelineRegistry *registry = data;
+    SDL_LockMutex(registry->mutex);
+    for (;;) {
+        while (!registry->quit && registry->compiled == registry->count) {
+            SDL_CondWait(registry->cond, registry->mutex);
+        }
+        if (registry->quit) break;
+        APipelineEntry *entry = registry->entries[registry->compiled++];
+        SDL_UnlockMutex(registry->mutex);
+        compile_entry(registry, entry);
+        SDL_LockMutex(registry->mutex);
+        SDL_CondBroadcast(registry->cond);
+    }
+    SDL_UnlockMutex(registry->mutex);
+    return 0;
+}
+
+APipelineRegistry *APipelineRegistry_create(VkDevice device, VkPipelineCache cache) {
+    ARR_ALLOC(APipelineRegistry, registry, 1);
+    if (registry == NULL) {
+        eprintff(MSG_ERRORF("cannot allocate pipeline registry"));
+        return NULL;
+    }
+    *registry = (APipelineRegistry){
+        .device = device,
+        .cache = cache,
+        .mutex = SDL_CreateMutex(),
+        .cond = SDL_CreateCond(),
+        .capacity = INITIAL_CAPACITY,
+        .entries = ARR_INPLACE_ALLOC(APipelineEntry *, INITIAL_CAPACITY)};
+    if (registry->mutex == NULL || registry->cond == NULL || registry->entries == NULL) {
+        eprintff(MSG_ERRORF("cannot create pipeline registry: %s"), SDL_GetError());
+        APipelineRegistry_destroy(registry);
+        return NULL;
+    }
+    registry->worker = SDL_CreateThread(worker_main, "pipeline compiler", registry);
+    if (registry->worker == NULL) {
+        eprintff(
+            MSG_WARNF("cannot start pipeline thread, compiling on request: %s"), SDL_GetError());
+    }
+    return registry;
+}
+
+void APipelineRegistry_destroy(APipelineRegistry *registry) {
+    if (registry == NULL) return;
+    if (registry->worker != NULL) {
+        SDL_LockMutex(registry->mutex);
+        registry->quit = 1;
+        SDL_CondBroadcast(registry->cond);
+        SDL_UnlockMutex(registry->mutex);
+        SDL_WaitThread(registry->worker, NULL);
+    }
+    for (uint32_t i = 0; i < registry->count; i++) {
+        APipelineEntry *entry = registry->entries[i];
+        // queued entries still own their desc
+        free_desc(&entry->desc);
+        vkDestroyPipeline(registry->device, entry->pipeline, NULL);
+        free(entry->key);
+        free(entry);
+    }
+    free(registry->entries);
+    if (registry->cond != NULL) SDL_DestroyCond(registry->cond);
+    if (registry->mutex != NULL) SDL_DestroyMutex(registry->mutex);
+    free(registry);
+}
+
+/*
+ * Linear search, there are few enough states to not need a hash table
+ * returns entry index
+ * A_PIPELINE_NONE if not found
+ */
+static uint32_t find_entry(
+    APipelineRegistry const *registry, uint64_t hash, uint8_t const *key, size_t keySize) {
+    for (uint32_t i = 0; i < registry->count; i++) {
+        APipelineEntry const *entry = registry->entries[i];
+        if (entry->hash == hash && entry->keySize == keySize &&
+            memcmp(entry->key, key, keySize) == 0)
+            return i;
+    }
+    return A_PIPELINE_NONE;
+}
+
+uint32_t APipelineRegistry_request(
+    APipelineRegistry *registry, APipelineDesc const *desc, VkPipeline fallback) {
+    if (desc->params.rasterizationParams.pNext != NULL ||
+        desc->params.multisampleParams.pNext != NULL ||
+        desc->params.multisampleParams.pSampleMask != NULL) {
+        eprintff(MSG_ERRORF("pNext and sample masks are not part of pipeline keys"));
+        return A_PIPELINE_NONE;
+    }
+    KeyWriter writer = {0};
+    put_desc(&writer, desc);
+    if (writer.failed) {
+        free(writer.data);
+        eprintff(MSG_ERRORF("cannot allocate pipeline key"));
+        return A_PIPELINE_NONE;
+    }
+    uint64_t hash = fnv1a(A_FNV_OFFSET, writer.data, writer.size);
+    uint32_t index = find_entry(registry, hash, writer.data, writer.size);
+    if (index != A_PIPELINE_NONE) {
+        free(writer.data);
+        return index;
+    }
+    ARR_ALLOC(APipelineEntry, entry, 1);
+    if (entry == NULL) goto no_entry;
+    *entry = (APipelineEntry){
+        .hash = hash, .keySize = writer.size, .key = writer.data, .fallback = fallback};
+    SDL_AtomicSet(&entry->state, A_PIPELINE_PENDING);
+    if (copy_desc(&entry->desc, desc) != 0) goto no_desc;
+    // worker reads entries under the mutex, the old block must not be freed outside of it
+    SDL_LockMutex(registry->mutex);
+    if (registry->count == registry->capacity) {
+        uint32_t capacity = registry->capacity * 2;
+        APipelineEntry **entries = realloc(registry->entries, capacity * sizeof(*entries));
+        if (entries == NULL) {
+            SDL_UnlockMutex(registry->mutex);
+            goto no_slot;
+        }
+        registry->entries = entries;
+        registry->capacity = capacity;
+    }
+    index = registry->count;
+    registry->entries[registry->count++] = entry;
+    SDL_CondBroadcast(registry->cond);
+    SDL_UnlockMutex(registry->mutex);
+    if (registry->worker == NULL) {
+        registry->compiled++;
+        compile_entry(registry, entry);
+    }
+    return index;
+no_slot:
+    free_desc(&entry->desc);
+no_desc:
+    free(entry);
+no_entry:
+    free(writer.data);
+    eprintff(MSG_ERRORF("cannot allocate pipeline entry"));
+    return A_PIPELINE_NONE;
+}
+
+VkPipeline APipelineRegistry_get(APipelineRegistry *registry, uint32_t entry) {
+    APipelineEntry *e = registry->entries[entry];
+    return SDL_AtomicGet(&e->state) == A_PIPELINE_READY ? e->pipeline : e->fallback;
+}
+
+VkPipeline APipelineRegistry_wait(APipelineRegistry *registry, uint32_t entry) {
+    APipelineEntry *e = registry->entries[entry];
+    SDL_LockMutex(registry->mutex);
+    while (SDL_AtomicGet(&e->state) == A_PIPELINE_PENDING) {
+        SDL_CondWait(registry->cond, registry->mutex);
+    }
+    SDL_UnlockMutex(registry->mutex);
+    return e->pipeline;
+}
@@ -0,0 +1,187 @@
+#include "profiler.h"
+#include "command.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t query_index(uint32_t set, uint32_t scope) {
+    return (set * A_PROFILER_MAX_SCOPES + scope) * 2;
+}
+
+AGpuProfiler *AGpuProfiler_create(
+    VkPhysicalDevice pdevice, VkDevice device, uint32_t queueFamilyIndex,
+    VkCommandPool commandPool, VkQueue queue, uint32_t frameCount) {
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(pdevice, &props);
+    uint32_t qFamCount;
+    vkGetPhysicalDeviceQueueFamilyProperties(pdevice, &qFamCount, NULL);
+    ARR_ALLOC(VkQueueFamilyProperties, qFamProps, qFamCount);
+    if (qFamProps == NULL) return NULL;
+    vkGetPhysicalDeviceQueueFamilyProperties(pdevice, &qFamCount, qFamProps);
+    uint32_t validBits =
+        queueFamilyIndex < qFamCount ? qFamProps[queueFamilyIndex].timestampValidBits : 0;
+    free(qFamProps);
+    if (validBits == 0 || props.limits.timestampPeriod == 0) {
+        eprintff(
+            MSG_INFOF("queue family %u has no timestamps, GPU profiler is off"),
+            queueFamilyIndex);
+        return NULL;
+    }
+    AGpuProfiler *profiler = ARR_INPLACE_ALLOC(AGpuProfiler, 1);
+    if (profiler == NULL) return NULL;
+    uint32_t setCount = frameCount + A_PROFILER_SET_COUNT;
+    *profiler = (AGpuProfiler){
+        .device = device,
+        .frameCount = frameCount,
+        .msPerTick = props.limits.timestampPeriod * 1e-6,
+        .validMask = validBits >= 64 ? UINT64_MAX : ((uint64_t)1 << validBits) - 1,
+        .lastBegins = calloc(setCount * A_PROFILER_MAX_SCOPES, sizeof(uint64_t))};
+    if (profiler->lastBegins == NULL) goto fail;
+    VkQueryPoolCreateInfo qpCInfo = {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = query_index(setCount, 0)};
+    VkResult res = vkCreateQueryPool(device, &qpCInfo, NULL, &profiler->pool);
+    if (res != VK_SUCCESS) {
+        eprintff(MSG_ERRORF("cannot create timestamp query pool: %d"), res);
+        goto fail;
+    }
+    // queries must be reset before results of a never submitted slot are asked for
+    VkCommandBuffer cb = cmd_begin_one_time(device, commandPool);
+    vkCmdResetQueryPool(cb, profiler->pool, 0, qpCInfo.queryCount);
+    cmd_end_one_time(device, commandPool, queue, cb, NULL);
+    return profiler;
+fail:
+    free(profiler->lastBegins);
+    free(profiler);
+    return NULL;
+}
+
+void AGpuProfiler_destroy(AGpuProfiler *profiler) {
+    if (profiler == NULL) return;
+    vkDestroyQueryPool(profiler->device, profiler->pool, NULL);
+    free(profiler->lastBegins);
+    free(profiler);
+}
+
+uint32_t AGpuProfiler_set(AGpuProfiler const *profiler, AGpuProfilerSet set) {
+    return profiler == NULL ? 0 : profiler->frameCount + set;
+}
+
+uint32_t AGpuProfiler_scope(AGpuProfiler *profiler, char const *name) {
+    if (profiler == NULL) return A_PROFILER_NO_SCOPE;
+    for (uint32_t i = 0; i < profiler->scopeCount; i++) {
+        if (strcmp(profiler->scopes[i].name, name) == 0) return i;
+    }
+    if (profiler->scopeCount == A_PROFILER_MAX_SCOPES) {
+        eprintff(MSG_WARNF("no room for GPU scope '%s'"), name);
+        return A_PROFILER_NO_SCOPE;
+    }
+    profiler->scopes[profiler->scopeCount] = (AGpuScope){.name = name};
+    return profiler->scopeCount++;
+}
+
+void AGpuProfiler_reset(AGpuProfiler *profiler, VkCommandBuffer cmdBuf, uint32_t set) {
+    if (profiler == NULL) return;
+    vkCmdResetQueryPool(cmdBuf, profiler->pool, query_index(set, 0), query_index(1, 0));
+}
+
+void AGpuProfiler_begin(
+    AGpuProfiler *profiler, VkCommandBuffer cmdBuf, uint32_t set, uint32_t scope) {
+    if (profiler == NULL || scope == A_PROFILER_NO_SCOPE) return;
+    vkCmdWriteTimestamp(
+        cmdBuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, profiler->pool, query_index(set, scope));
+}
+
+void AGpuProfiler_end(
+    AGpuProfiler *profiler, VkCommandBuffer cmdBuf, uint32_t set, uint32_t scope) {
+    if (profiler == NULL || scope == A_PROFILER_NO_SCOPE) return;
+    // after all work before it is done
+    vkCmdWriteTimestamp(
+        cmdBuf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, profiler->pool,
+        query_index(set, scope) + 1);
+}
+
+void AGpuProfiler_collect(AGpuProfiler *profiler, uint32_t set) {
+    if (profiler == NULL || profiler->scopeCount == 0) return;
+    // value and availability of begin and end of each scope
+    uint64_t results[A_PROFILER_MAX_SCOPES * 2][2];
+    uint32_t queryCount = profiler->scopeCount * 2;
+    VkResult res = vkGetQueryPoolResults(
+        profiler->device, profiler->pool, query_index(set, 0), queryCount,
+        queryCount * sizeof(*results), results, sizeof(*results),
+        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    // VK_NOT_READY if some scope was not written, the others are still there
+    if (res != VK_SUCCESS && res != VK_NOT_READY) return;
+    uint64_t *lastBegins = profiler->lastBegins + set * A_PROFILER_MAX_SCOPES;
+    for (uint32_t i = 0; i < profiler->scopeCount; i++) {
+        uint64_t const *begin = results[2 * i], *end = results[2 * i + 1];
+        if (begin[1] == 0 || end[1] == 0) continue;
+        // results stay until the slot is submitted again, a frame is taken once
+        if (begin[0] == lastBegins[i]) continue;
+        lastBegins[i] = begin[0];
+        AGpuScope *scope = profiler->scopes + i;
+        uint64_t ticks = (end[0] - begin[0]) & profiler->validMask;
+        scope->samples[scope->nextSample] = (float)(ticks * profiler->msPerTick);
+        scope->nextSample = (scope->nextSample + 1) % A_PROFILER_HISTORY;
+        scope->sampleCount = MIN(scope->sampleCount + 1, A_PROFILER_HISTORY);
+        scope->total++;
+    }
+}
+
+static int compare_floats(void const *a, void const *b) {
+    float x = *(float const *)a, y = *(float const *)b;
+    return (x > y) - (x < y);
+}
+
+AGpuScopeStats AGpuProfiler_stats(AGpuProfiler const *profiler, uint32_t scope) {
+    AGpuScopeStats stats = {0};
+    if (profiler == NULL || scope >= profiler->scopeCount) return stats;
+    AGpuScope const *s = profiler->scopes + scope;
+    uint32_t count = s->sampleCount;
+    if (count == 0) return stats;
+    float sorted[A_PROFILER_HISTORY];
+    memcpy(sorted, s->samples, count * sizeof(*sorted));
+    qsort(sorted, count, sizeof(*sorted), compare_floats);
+    double sum = 0;
+    for (uint32_t i = 0; i < count; i++) { sum += sorted[i]; }
+    stats.samples = count;
+    stats.last = s->samples[(s->nextSample + A_PROFILER_HISTORY - 1) % A_PROFILER_HISTORY];
+    stats.avg = sum / count;
+    stats.min = sorted[0];
+    stats.max = sorted[count - 1];
+    stats.p99 = sorted[(uint32_t)((count - 1) * .99)];
+    return stats;
+}
+
+void AGpuProfiler_print(AGpuProfiler const *profiler) {
+    if (profiler == NULL) return;
+    for (uint32_t i = 0; i < profiler->scopeCount; i++) {
+        AGpuScopeStats stats = AGpuProfiler_stats(profiler, i);
+        eprintff(
+            MSG_INFOF("gpu %-12s avg %.3f ms min %.3f max %.3f p99 %.3f over %u frames"),
+            profiler->scopes[i].name, stats.avg, stats.min, stats.max, stats.p99, stats.samples);
+    }
+}
+
+int AGpuProfiler_export(AGpuProfiler const *profiler, char const *path) {
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        eprintff(MSG_ERRORF("cannot open '%s' for writing"), path);
+        return 1;
+    }
+    fprintf(file, "scope,samples,total,last_ms,avg_ms,min_ms,max_ms,p99_ms\n");
+    for (uint32_t i = 0; profiler != NULL && i < profiler->scopeCount; i++) {
+        AGpuScopeStats stats = AGpuProfiler_stats(profiler, i);
+        fprintf(
+            file, "%s,%u,%llu,%.4f,%.4f,%.4f,%.4f,%.4f\n", profiler->scopes[i].name,
+            stats.samples, (unsigned long long)profiler->scopes[i].total, stats.last, stats.avg,
+            stats.min, stats.max, stats.p99);
+    }
+    if (fclose(file) != 0) {
+        eprintff(MSG_ERRORF("cannot write '%s'"), path);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,222 @@
+#include "recorder.h"
+#include "utils.h"
+
+static void record_share(ARecorder *recorder, ARecorderThread *thread) {
+    ARecordJob const *job = &recorder->job;
+    thread->recorded = VK_FALSE;
+    if (thread->index >= job->threadCount) return;
+    uint64_t drawCount = job->args.drawCount;
+    uint32_t first = (uint32_t)(drawCount * thread->index / job->threadCount);
+    uint32_t end = (uint32_t)(drawCount * (thread->index + 1) / job->threadCount);
+    if (first == end) return;
+    // pool is only touched by this thread, previous submit of frame is complete
+    vkResetCommandPool(recorder->device, thread->pools[job->frame], 0);
+    VkCommandBuffer cmdBuf = thread->buffers[job->frame];
+    VkCommandBufferInheritanceInfo inheritance = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+        .renderPass = job->renderPass,
+        .subpass = 0,
+        .framebuffer = job->framebuffer};
+    VkCommandBufferBeginInfo cbBInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+                 VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+        .pInheritanceInfo = &inheritance};
+    VkResult res = vkBeginCommandBuffer(cmdBuf, &cbBInfo);
+    if (res != VK_SUCCESS) {
+        eprintff(MSG_ERRORF("vkBeginCommandBuffer: %d"), res);
+        return;
+    }
+    record_draw_range(
+        cmdBuf, job->viewport, job->scissor, job->pipeline, job->plLayout, job->frame, job->args,
+        first, end - first);
+    res = vkEndCommandBuffer(cmdBuf);
+    if (res != VK_SUCCESS) {
+        eprintff(MSG_ERRORF("vkEndCommandBuffer: %d"), res);
+        return;
+    }
+    thread->recorded = VK_TRUE;
+}
+
+static int worker_main(void *data) {
+    ARecorderThread *thread = data;
+    ARecorder *recorder = thread->recorder;
+    uint64_t seen = 0;
+    SDL_LockMutex(recorder->mutex);
+    for (;;) {
+        while (!recorder->quit && recorder->generation == seen) {
+            SDL_CondWait(recorder->cond, recorder->mutex);
+        }
+        if (recorder->quit) break;
+        seen = recorder->generation;
+        // job does not change until pending drops to 0
+        SDL_UnlockMutex(recorder->mutex);
+        record_share(recorder, thread);
+        SDL_LockMutex(recorder->mutex);
+        if (--recorder->pending == 0) SDL_CondBroadcast(recorder->cond);
+    }
+    SDL_UnlockMutex(recorder->mutex);
+    return 0;
+}
+
+/*
+ * 0 on success
+ * 1 on failure
+ */
+static int create_thread_buffers(
+    VkDevice device, uint32_t graphicsFamilyIndex, uint32_t frameCount,
+    ARecorderThread *thread) {
+    thread->pools = calloc(frameCount, sizeof(*thread->pools));
+    thread->buffers = calloc(frameCount, sizeof(*thread->buffers));
+    if (thread->pools == NULL || thread->buffers == NULL) return 1;
+    for (uint32_t i = 0; i < frameCount; i++) {
+        thread->pools[i] = A_create_command_pool(device, graphicsFamilyIndex);
+        if (thread->pools[i] == NULL) return 1;
+        VkCommandBufferAllocateInfo cbAInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = thread->pools[i],
+            .level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+            .commandBufferCount = 1};
+        VkResult res = vkAllocateCommandBuffers(device, &cbAInfo, thread->buffers + i);
+        if (res != VK_SUCCESS) {
+            eprintff(MSG_ERRORF("cannot allocate secondary command buffer: %d"), res);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// buffers go with their pools, zeroed thread is fine
+static void free_thread_buffers(VkDevice device, uint32_t frameCount, ARecorderThread *thread) {
+    for (uint32_t i = 0; thread->pools != NULL && i < frameCount; i++) {
+        if (thread->pools[i] != NULL) vkDestroyCommandPool(device, thread->pools[i], NULL);
+    }
+    free(thread->pools);
+    free(thread->buffers);
+    thread->pools = NULL;
+    thread->buffers = NULL;
+}
+
+ARecorder *ARecorder_create(
+    VkDevice device, uint32_t graphicsFamilyIndex, uint32_t frameCount, uint32_t threadCount) {
+    if (threadCount == 0) threadCount = (uint32_t)MAX(SDL_GetCPUCount(), 1);
+    ARR_ALLOC(ARecorder, recorder, 1);
+    if (recorder == NULL) {
+        eprintff(MSG_ERRORF("cannot allocate recorder"));
+        return NULL;
+    }
+    *recorder = (ARecorder){
+        .device = device,
+        .frameCount = frameCount,
+        .threadCount = threadCount,
+        .threads = calloc(threadCount, sizeof(ARecorderThread)),
+        .secondaries = ARR_INPLACE_ALLOC(VkCommandBuffer, threadCount),
+        .mutex = SDL_CreateMutex(),
+        .cond = SDL_CreateCond()};
+    if (recorder->threads == NULL || recorder->secondaries == NULL || recorder->mutex == NULL ||
+        recorder->cond == NULL) {
+        eprintff(MSG_ERRORF("cannot create recorder: %s"), SDL_GetError());
+        goto fail;
+    }
+    for (uint32_t i = 0; i < threadCount; i++) {
+        ARecorderThread *thread = recorder->threads + i;
+        *thread = (ARecorderThread){.recorder = recorder, .index = i};
+        if (create_thread_buffers(device, graphicsFamilyIndex, frameCount, thread) != 0) {
+            eprintff(MSG_ERRORF("cannot create command pools of recorder thread %u"), i);
+            goto fail;
+        }
+    }
+    for (uint32_t i = 1; i < threadCount; i++) {
+        ARecorderThread *thread = recorder->threads + i;
+        thread->thread = SDL_CreateThread(worker_main, "command recorder", thread);
+        if (thread->thread != NULL) continue;
+        eprintff(
+            MSG_WARNF("started %u of %u recorder threads: %s"), i - 1, threadCount - 1,
+            SDL_GetError());
+        for (uint32_t j = i; j < threadCount; j++) {
+            free_thread_buffers(device, frameCount, recorder->threads + j);
+        }
+        recorder->threadCount = i;
+        break;
+    }
+    return recorder;
+fail:
+    ARecorder_destroy(recorder);
+    return NULL;
+}
+
+void ARecorder_destroy(ARecorder *recorder) {
+    if (recorder == NULL) return;
+    if (recorder->mutex != NULL && recorder->cond != NULL) {
+        SDL_LockMutex(recorder->mutex);
+        recorder->quit = VK_TRUE;
+        SDL_CondBroadcast(recorder->cond);
+        SDL_UnlockMutex(recorder->mutex);
+    }
+    for (uint32_t i = 0; recorder->threads != NULL && i < recorder->threadCount; i++) {
+        ARecorderThread *thread = recorder->threads + i;
+        if (thread->thread != NULL) SDL_WaitThread(thread->thread, NULL);
+        free_thread_buffers(recorder->device, recorder->frameCount, thread);
+    }
+    free(recorder->threads);
+    free(recorder->secondaries);
+    if (recorder->cond != NULL) SDL_DestroyCond(recorder->cond);
+    if (recorder->mutex != NULL) SDL_DestroyMutex(recorder->mutex);
+    free(recorder);
+}
+
+void ARecorder_record(
+    ARecorder *recorder, VkRenderPass renderPass, VkFramebuffer const *framebuffers,
+    VkExtent2D swapchainExtent, VkCommandBuffer cmdBuf, VkViewport viewport, VkRect2D scissor,
+    VkPipeline pipeline, VkPipelineLayout plLayout, uint32_t currentFrame, uint32_t imageIndex,
+    ARecordCmdBuffersParams args) {
+    uint32_t shares = (args.drawCount + A_RECORDER_MIN_DRAWS - 1) / A_RECORDER_MIN_DRAWS;
+    ARecordJob job = {
+        .renderPass = renderPass,
+        .framebuffer = framebuffers[imageIndex],
+        .viewport = viewport,
+        .scissor = scissor,
+        .pipeline = pipeline,
+        .plLayout = plLayout,
+        .frame = currentFrame,
+        .args = args,
+        .threadCount = MAX(MIN(shares, recorder->threadCount), 1u)};
+    SDL_LockMutex(recorder->mutex);
+    recorder->job = job;
+    if (job.threadCount > 1) {
+        recorder->generation++;
+        recorder->pending = recorder->threadCount - 1;
+        SDL_CondBroadcast(recorder->cond);
+    }
+    SDL_UnlockMutex(recorder->mutex);
+    record_share(recorder, recorder->threads);
+    SDL_LockMutex(recorder->mutex);
+    while (recorder->pending > 0) { SDL_CondWait(recorder->cond, recorder->mutex); }
+    SDL_UnlockMutex(recorder->mutex);
+
+    VkCommandBuffer *secondaries = recorder->secondaries;
+    uint32_t secondaryCount = 0;
+    for (uint32_t i = 0; i < job.threadCount; i++) {
+        ARecorderThread const *thread = recorder->threads + i;
+        if (thread->recorded) secondaries[secondaryCount++] = thread->buffers[currentFrame];
+    }
+    VkCommandBufferBeginInfo cbBInfo = {.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    VkResult res = vkBeginCommandBuffer(cmdBuf, &cbBInfo);
+    if (res != VK_SUCCESS) {
+        eprintff(MSG_ERRORF("vkBeginCommandBuffer: %d"), res);
+        return;
+    }
+    // a pass continued by secondaries takes no timestamps, draws are timed as the whole pass
+    AGpuProfiler *profiler = args.profiler;
+    uint32_t passScope = AGpuProfiler_scope(profiler, "render pass");
+    AGpuProfiler_reset(profiler, cmdBuf, currentFrame);
+    AGpuProfiler_begin(profiler, cmdBuf, currentFrame, passScope);
+    cmd_begin_frame_pass(
+        cmdBuf, renderPass, job.framebuffer, swapchainExtent,
+        VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+    if (secondaryCount > 0) vkCmdExecuteCommands(cmdBuf, secondaryCount, secondaries);
+    vkCmdEndRenderPass(cmdBuf);
+    AGpuProfiler_end(profiler, cmdBuf, currentFrame, passScope);
+    res = vkEndCommandBuffer(cmdBuf);
+    if (res != VK_SUCCESS) eprintff(MSG_ERRORF("vkEndCommandBuffer: %d"), res);
+}
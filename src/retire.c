@@ -0,0 +1,80 @@
+#include "retire.h"
+#include "utils.h"
+#include <string.h>
+
+ARetireQueue *ARetireQueue_create(VkDevice device, AAllocator *allocator, uint32_t framesInFlight) {
+    ARR_ALLOC(ARetireQueue, queue, 1);
+    if (queue == NULL) {
+        eprintff(MSG_ERRORF("cannot allocate retire queue"));
+        return NULL;
+    }
+    uint32_t capacity = 16;
+    *queue = (ARetireQueue){
+        .device = device,
+        .allocator = allocator,
+        .framesInFlight = framesInFlight,
+        .frame = 0,
+        .count = 0,
+        .capacity = capacity,
+        .items = ARR_INPLACE_ALLOC(ARetired, capacity)};
+    if (queue->items == NULL) {
+        eprintff(MSG_ERRORF("cannot allocate retire queue"));
+        free(queue);
+        return NULL;
+    }
+    return queue;
+}
+
+static void destroy_item(ARetireQueue *queue, ARetired item) {
+    switch (item.kind) {
+    case A_RETIRED_BUFFER: vkDestroyBuffer(queue->device, item.buffer, NULL); break;
+    case A_RETIRED_IMAGE: vkDestroyImage(queue->device, item.image, NULL); break;
+    case A_RETIRED_IMAGE_VIEW: vkDestroyImageView(queue->device, item.imageView, NULL); break;
+    case A_RETIRED_FRAMEBUFFER: vkDestroyFramebuffer(queue->device, item.framebuffer, NULL); break;
+    case A_RETIRED_SWAPCHAIN: vkDestroySwapchainKHR(queue->device, item.swapchain, NULL); break;
+    case A_RETIRED_COMMAND_POOL:
+        vkDestroyCommandPool(queue->device, item.commandPool, NULL);
+        break;
+    }
+    AAllocator_free(queue->allocator, item.allocation);
+}
+
+void ARetireQueue_destroy(ARetireQueue *queue) {
+    if (queue == NULL) return;
+    for (uint32_t i = 0; i < queue->count; i++) { destroy_item(queue, queue->items[i]); }
+    free(queue->items);
+    free(queue);
+}
+
+int ARetireQueue_push(ARetireQueue *queue, ARetired item) {
+    if (queue->count == queue->capacity) {
+        uint32_t capacity = queue->capacity * 2;
+        ARetired *items = realloc(queue->items, capacity * sizeof(*items));
+        if (items == NULL) {
+            // nothing would destroy it later, an idle device cannot be using it
+            eprintff(MSG_ERRORF("cannot grow retire queue, waiting for device idle"));
+            vkDeviceWaitIdle(queue->device);
+            destroy_item(queue, item);
+            return 1;
+        }
+        queue->items = items;
+        queue->capacity = capacity;
+    }
+    item.frame = queue->frame;
+    queue->items[queue->count++] = item;
+    return 0;
+}
+
+void ARetireQueue_collect(ARetireQueue *queue, uint64_t frame, uint64_t completed) {
+    queue->frame = frame;
+    uint32_t done = 0;
+    while (done < queue->count) {
+        uint64_t retired = queue->items[done].frame;
+        if (retired >= completed && retired + queue->framesInFlight > frame) break;
+        destroy_item(queue, queue->items[done]);
+        done++;
+    }
+    if (done == 0) return;
+    memmove(queue->items, queue->items + done, (queue->count - done) * sizeof(*queue->items));
+    queue->count -= done;
+}
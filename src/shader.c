@@ -1,4 +1,5 @@
 #include "shader.h"
+#include "files.h"
 #include "utils.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -25,19 +26,14 @@ AShader AShader_from_code(
  * `path` is not owned (not freed after process)
  */
 AShader AShader_from_path(VkDevice device, char const *path, VkShaderStageFlagBits stage) {
-    FILE *fp = fopen(path, "rb");
-    if (fp == NULL) {
-        eprintff(MSG_ERRORF("read_fp: cannot open '%s'"), path);
+    size_t size;
+    uint32_t *code = read_file(path, &size);
+    if (code == NULL) {
+        eprintff(MSG_ERRORF("cannot read '%s'"), path);
         return (AShader){.module = NULL};
     }
-    fseek(fp, 0, SEEK_END);
-    uint32_t fpSize = (uint32_t)ftell(fp);
-    fseek(fp, 0, SEEK_SET);
-    ARR_ALLOC(uint32_t, data, fpSize);
-    fread(data, 1, fpSize, fp);
-    fclose(fp);
-    AShader result = AShader_from_code(device, fpSize, data, stage);
-    free(data);
+    AShader result = AShader_from_code(device, (uint32_t)size, code, stage);
+    free(code);
     return result;
 }
 
@@ -0,0 +1,72 @@
+#include "shader_archive.h"
+#include "utils.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static int check_entry(AShaderArchiveEntry const *entry, size_t mappingSize) {
+    return memchr(entry->name, '\0', A_SHADER_NAME_SIZE) != NULL && entry->offset % 4 == 0 &&
+           entry->size % 4 == 0 && entry->size > 0 && entry->offset <= mappingSize &&
+           entry->size <= mappingSize - entry->offset;
+}
+
+AShaderArchive *AShaderArchive_open(char const *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        if (errno != ENOENT) eprintff(MSG_ERRORF("cannot open '%s'"), path);
+        return NULL;
+    }
+    AShaderArchive *archive = NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(AShaderArchiveHeader)) goto bad_file;
+    size_t mappingSize = (size_t)st.st_size;
+    uint8_t *mapping = mmap(NULL, mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) goto bad_file;
+    AShaderArchiveHeader header;
+    memcpy(&header, mapping, sizeof(header));
+    size_t indexSize = (size_t)header.count * sizeof(AShaderArchiveEntry);
+    if (header.magic != A_SHADER_ARCHIVE_MAGIC || header.version != A_SHADER_ARCHIVE_VERSION ||
+        indexSize > mappingSize - sizeof(header))
+        goto bad_mapping;
+    // header is 16 bytes, so entries are aligned within the page aligned mapping
+    AShaderArchiveEntry const *entries = (AShaderArchiveEntry const *)(mapping + sizeof(header));
+    for (uint32_t i = 0; i < header.count; i++) {
+        if (!check_entry(entries + i, mappingSize)) goto bad_mapping;
+    }
+    archive = ARR_INPLACE_ALLOC(AShaderArchive, 1);
+    if (archive == NULL) goto bad_mapping;
+    *archive = (AShaderArchive){
+        .mapping = mapping,
+        .mappingSize = mappingSize,
+        .count = header.count,
+        .entries = entries};
+    // mapping outlives the descriptor
+    close(fd);
+    return archive;
+bad_mapping:
+    munmap(mapping, mappingSize);
+bad_file:
+    close(fd);
+    eprintff(MSG_ERRORF("cannot map shader archive '%s'"), path);
+    return NULL;
+}
+
+void AShaderArchive_close(AShaderArchive *archive) {
+    if (archive == NULL) return;
+    munmap((void *)archive->mapping, archive->mappingSize);
+    free(archive);
+}
+
+AShader AShaderArchive_load(VkDevice device, AShaderArchive const *archive, char const *name) {
+    for (uint32_t i = 0; i < archive->count; i++) {
+        AShaderArchiveEntry const *entry = archive->entries + i;
+        if (strcmp(entry->name, name) != 0) continue;
+        uint32_t const *code = (uint32_t const *)(archive->mapping + entry->offset);
+        return AShader_from_code(device, entry->size, code, (VkShaderStageFlagBits)entry->stage);
+    }
+    eprintff(MSG_WARNF("no shader '%s' in archive"), name);
+    return (AShader){.module = NULL};
+}
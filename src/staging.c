@@ -0,0 +1,214 @@
+#include "staging.h"
+#include "buffer.h"
+#include "utils.h"
+
+AStagingRing *AStagingRing_create(VkDevice device, AAllocator *allocator, VkDeviceSize size) {
+    if (size == 0) size = A_DEFAULT_STAGING_SIZE;
+    AAllocation memory;
+    VkBuffer buffer = create_staging_buffer(device, allocator, size, &memory);
+    if (buffer == NULL) {
+        eprintff(MSG_ERRORF("cannot create staging buffer"));
+        return NULL;
+    }
+    ARR_ALLOC(AStagingRing, ring, 1);
+    if (ring == NULL) goto no_ring;
+    uint32_t capacity = 8;
+    *ring = (AStagingRing){
+        .device = device,
+        .allocator = allocator,
+        .buffer = buffer,
+        .memory = memory,
+        .size = size,
+        .head = 0,
+        .tail = 0,
+        .used = 0,
+        .openBytes = 0,
+        .pendingFirst = 0,
+        .pendingCount = 0,
+        .pendingCapacity = capacity,
+        .pending = ARR_INPLACE_ALLOC(AStagingSubmit, capacity),
+        .freeFenceCount = 0,
+        .freeFenceCapacity = capacity,
+        .freeFences = ARR_INPLACE_ALLOC(VkFence, capacity),
+        .nextSerial = 1,
+        .completedSerial = 0};
+    if (ring->pending == NULL || ring->freeFences == NULL) goto no_arrays;
+    return ring;
+no_arrays:
+    free(ring->pending);
+    free(ring->freeFences);
+    free(ring);
+no_ring:
+    eprintff(MSG_ERRORF("cannot allocate staging ring"));
+    vkDestroyBuffer(device, buffer, NULL);
+    AAllocator_free(allocator, memory);
+    return NULL;
+}
+
+void AStagingRing_destroy(AStagingRing *ring) {
+    if (ring == NULL) return;
+    AStagingRing_wait(ring, ring->nextSerial - 1);
+    for (uint32_t i = 0; i < ring->freeFenceCount; i++) {
+        vkDestroyFence(ring->device, ring->freeFences[i], NULL);
+    }
+    vkDestroyBuffer(ring->device, ring->buffer, NULL);
+    AAllocator_free(ring->allocator, ring->memory);
+    free(ring->freeFences);
+    free(ring->pending);
+    free(ring);
+}
+
+// fence must not be in use
+static void free_fence(AStagingRing *ring, VkFence fence) {
+    if (ring->freeFenceCount == ring->freeFenceCapacity) {
+        uint32_t capacity = ring->freeFenceCapacity * 2;
+        VkFence *fences = realloc(ring->freeFences, capacity * sizeof(*fences));
+        if (fences == NULL) {
+            // a later submit creates a new one
+            eprintff(MSG_WARNF("cannot keep staging fence for reuse"));
+            vkDestroyFence(ring->device, fence, NULL);
+            return;
+        }
+        ring->freeFences = fences;
+        ring->freeFenceCapacity = capacity;
+    }
+    ring->freeFences[ring->freeFenceCount++] = fence;
+}
+
+static void release_front(AStagingRing *ring) {
+    AStagingSubmit submit = ring->pending[ring->pendingFirst];
+    ring->pendingFirst = (ring->pendingFirst + 1) % ring->pendingCapacity;
+    ring->pendingCount--;
+    ring->tail = submit.end;
+    ring->used -= submit.bytes;
+    ring->completedSerial = submit.serial;
+    if (submit.fence == NULL) return;
+    vkResetFences(ring->device, 1, &submit.fence);
+    free_fence(ring, submit.fence);
+}
+
+void AStagingRing_cancel(AStagingRing *ring, uint64_t serial) {
+    for (uint32_t i = 0; i < ring->pendingCount; i++) {
+        AStagingSubmit *submit = ring->pending + (ring->pendingFirst + i) % ring->pendingCapacity;
+        if (submit->serial != serial || submit->fence == NULL) continue;
+        // failed submit leaves the fence unsignaled, it can be used again as is
+        free_fence(ring, submit->fence);
+        submit->fence = NULL;
+        return;
+    }
+}
+
+void AStagingRing_reclaim(AStagingRing *ring) {
+    while (ring->pendingCount > 0) {
+        VkFence fence = ring->pending[ring->pendingFirst].fence;
+        if (fence != NULL && vkGetFenceStatus(ring->device, fence) != VK_SUCCESS) break;
+        release_front(ring);
+    }
+}
+
+void AStagingRing_wait(AStagingRing *ring, uint64_t serial) {
+    while (ring->completedSerial < serial && ring->pendingCount > 0) {
+        VkFence fence = ring->pending[ring->pendingFirst].fence;
+        if (fence != NULL) vkWaitForFences(ring->device, 1, &fence, VK_TRUE, UINT64_MAX);
+        release_front(ring);
+    }
+}
+
+/*
+ * returns 1 and offset in out_offset if region fits right now
+ */
+static int try_alloc(
+    AStagingRing *ring, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize *out_offset) {
+    if (ring->used == 0 && ring->pendingCount == 0) {
+        // empty, start over to keep regions contiguous
+        // not while submits are pending, even empty ones move tail to their end on release
+        ring->head = ring->tail = 0;
+    }
+    VkDeviceSize offset = ALIGN_UP(ring->head, alignment);
+    VkDeviceSize consumed;
+    if (ring->used == 0 || ring->head > ring->tail) {
+        // free space is [head, size) and [0, tail)
+        if (offset + size <= ring->size) {
+            consumed = offset + size - ring->head;
+        }
+        else if (size <= ring->tail) {
+            // skip the end of the ring
+            offset = 0;
+            consumed = ring->size - ring->head + size;
+        }
+        else return 0;
+    }
+    else {
+        // free space is [head, tail)
+        if (offset + size > ring->tail) return 0;
+        consumed = offset + size - ring->head;
+    }
+    ring->head = (offset + size) % ring->size;
+    ring->used += consumed;
+    ring->openBytes += consumed;
+    *out_offset = offset;
+    return 1;
+}
+
+int AStagingRing_alloc(
+    AStagingRing *ring, VkDeviceSize size, VkDeviceSize alignment, AStagingRegion *out_region) {
+    if (size > ring->size) {
+        eprintff(
+            MSG_ERRORF("%llu bytes do not fit into staging ring of %llu"),
+            (unsigned long long)size, (unsigned long long)ring->size);
+        return 1;
+    }
+    AStagingRing_reclaim(ring);
+    VkDeviceSize offset;
+    while (!try_alloc(ring, size, alignment, &offset)) {
+        // the rest is held by regions that are not submitted yet
+        if (ring->pendingCount == 0) return 2;
+        AStagingRing_wait(ring, ring->pending[ring->pendingFirst].serial);
+    }
+    *out_region = (AStagingRegion){
+        .buffer = ring->buffer,
+        .offset = offset,
+        .size = size,
+        .mapped = (char *)ring->memory.mapped + offset};
+    return 0;
+}
+
+uint64_t AStagingRing_submit(AStagingRing *ring, VkFence *out_fence) {
+    // before taking a fence, nothing is left to undo on failure
+    if (ring->pendingCount == ring->pendingCapacity) {
+        // grow and unwrap FIFO
+        uint32_t newCapacity = ring->pendingCapacity * 2;
+        ARR_ALLOC(AStagingSubmit, pending, newCapacity);
+        if (pending == NULL) {
+            eprintff(MSG_ERRORF("cannot grow pending staging submits"));
+            return 0;
+        }
+        for (uint32_t i = 0; i < ring->pendingCount; i++) {
+            pending[i] = ring->pending[(ring->pendingFirst + i) % ring->pendingCapacity];
+        }
+        free(ring->pending);
+        ring->pending = pending;
+        ring->pendingFirst = 0;
+        ring->pendingCapacity = newCapacity;
+    }
+    VkFence fence;
+    if (ring->freeFenceCount > 0) {
+        fence = ring->freeFences[--ring->freeFenceCount];
+    }
+    else {
+        VkFenceCreateInfo fcCInfo = {.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+        VkResult res = vkCreateFence(ring->device, &fcCInfo, NULL, &fence);
+        if (res != VK_SUCCESS) {
+            eprintff(MSG_ERRORF("cannot create fence: %d"), res);
+            return 0;
+        }
+    }
+    uint64_t serial = ring->nextSerial++;
+    uint32_t last = (ring->pendingFirst + ring->pendingCount) % ring->pendingCapacity;
+    ring->pending[last] = (AStagingSubmit){
+        .fence = fence, .serial = serial, .end = ring->head, .bytes = ring->openBytes};
+    ring->pendingCount++;
+    ring->openBytes = 0;
+    *out_fence = fence;
+    return serial;
+}
@@ -0,0 +1,313 @@
+#include "stream.h"
+#include "buffer.h"
+#include "mipmap.h"
+#include "utils.h"
+#include <string.h>
+
+ATextureStreamer *ATextureStreamer_create(
+    VkDevice device, AAllocator *allocator, AUploadContext *upload, ARetireQueue *retire,
+    ADefragmenter *defrag, VkDeviceSize frameBytes) {
+    ARR_ALLOC(ATextureStreamer, streamer, 1);
+    if (streamer == NULL) {
+        eprintff(MSG_ERRORF("cannot allocate texture streamer"));
+        return NULL;
+    }
+    uint32_t capacity = 8;
+    *streamer = (ATextureStreamer){
+        .device = device,
+        .allocator = allocator,
+        .upload = upload,
+        .retire = retire,
+        .defrag = defrag,
+        .frameBytes = frameBytes != 0 ? frameBytes : A_STREAM_FRAME_BYTES,
+        .generation = 0,
+        .pendingBytes = 0,
+        .count = 0,
+        .capacity = capacity,
+        .images = ARR_INPLACE_ALLOC(AStreamedImage, capacity)};
+    if (streamer->images == NULL) {
+        eprintff(MSG_ERRORF("cannot allocate streamed images"));
+        free(streamer);
+        return NULL;
+    }
+    return streamer;
+}
+
+void ATextureStreamer_destroy(ATextureStreamer *streamer) {
+    if (streamer == NULL) return;
+    for (uint32_t i = 0; i < streamer->count; i++) { free(streamer->images[i].texels); }
+    free(streamer->images);
+    free(streamer);
+}
+
+/*
+ * First level no larger than A_STREAM_TAIL_SIZE on either side, the last one at most
+ */
+static uint32_t tail_level(ATextureInfo info) {
+    uint32_t level = 0;
+    for (; level + 1 < info.mipLevels; level++) {
+        VkExtent2D extent = mip_extent(info.width, info.height, level);
+        if (MAX(extent.width, extent.height) <= A_STREAM_TAIL_SIZE) break;
+    }
+    return level;
+}
+
+int ATextureStreamer_upload(
+    ATextureStreamer *streamer, ADecodedTexture const *texture, ALoadedTexture *out_texture) {
+    VkDevice device = streamer->device;
+    AAllocator *allocator = streamer->allocator;
+    AUploadContext *upload = streamer->upload;
+    ATextureInfo info = texture->info;
+    uint32_t tailLevel = tail_level(info);
+    // unified memory writes every level in place, nothing to wait for
+    VkMemoryPropertyFlags properties = device_local_properties(&allocator->stats, ~0u);
+    if (tailLevel == 0 || texture->stagedLevels < info.mipLevels ||
+        (properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)) {
+        AAllocation memory;
+        VkImage image = upload_texture(device, allocator, upload, texture, &memory);
+        if (image == NULL) return 1;
+        *out_texture = (ALoadedTexture){
+            .image = image, .memory = memory, .info = info, .residentLevel = 0};
+        return 0;
+    }
+    // before anything is recorded, the image could not be tracked after it
+    if (streamer->count == streamer->capacity) {
+        uint32_t capacity = streamer->capacity * 2;
+        AStreamedImage *images = realloc(streamer->images, capacity * sizeof(*images));
+        if (images == NULL) {
+            eprintff(MSG_ERRORF("cannot grow streamed images"));
+            return 1;
+        }
+        streamer->images = images;
+        streamer->capacity = capacity;
+    }
+    // levels are packed from the largest, tail is the end of texels
+    VkDeviceSize tailOffset =
+        info.layers * mip_chain_size(info.format, info.width, info.height, tailLevel);
+    AStagingRegion region;
+    if (AUploadContext_stage(upload, texture->size - tailOffset, 16, &region) != 0)
+        goto no_staging;
+    copy_texels(region.mapped, texture, tailOffset, texture->size - tailOffset);
+    AAllocation memory;
+    VkImage image = create_image(
+        device, allocator, info.width, info.height, info.mipLevels, info.layers, info.format,
+        VK_IMAGE_TILING_OPTIMAL, A_TEXTURE_IMAGE_USAGE, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        &memory);
+    if (image == NULL) goto no_image;
+    ARR_ALLOC(uint8_t, texels, tailOffset);
+    if (texels == NULL) goto no_texels;
+    copy_texels(texels, texture, 0, tailOffset);
+    // levels above the tail wait in TRANSFER_DST, views never cover them
+    if (AUploadContext_begin_image(upload, image, info.mipLevels) != 0) goto no_upload;
+    for (uint32_t level = tailLevel; level < info.mipLevels; level++) {
+        VkExtent2D extent = mip_extent(info.width, info.height, level);
+        VkDeviceSize offset =
+            info.layers * mip_chain_size(info.format, info.width, info.height, level) - tailOffset;
+        AStagingRegion levelRegion = {
+            .buffer = region.buffer,
+            .offset = region.offset + offset,
+            .size = info.layers * mip_level_size(info.format, info.width, info.height, level),
+            .mapped = (uint8_t *)region.mapped + offset};
+        AUploadLevelParams args = {
+            .image = image,
+            .width = extent.width,
+            .height = extent.height,
+            .mipLevel = level,
+            .baseLayer = 0,
+            .layerCount = info.layers,
+            .lastPart = VK_TRUE};
+        if (AUploadContext_copy_to_level(upload, levelRegion, args) != 0) goto no_levels;
+    }
+
+    *out_texture = (ALoadedTexture){
+        .image = image, .memory = memory, .info = info, .residentLevel = tailLevel};
+    streamer->images[streamer->count++] = (AStreamedImage){
+        .texture = out_texture,
+        .view = NULL,
+        .viewLevel = tailLevel,
+        .texels = texels,
+        .nextLayer = 0,
+        .nextRow = 0};
+    streamer->pendingBytes += tailOffset;
+    return 0;
+no_levels:
+    // open batch already records the image
+    AUploadContext_wait_idle(upload);
+no_upload:
+    free(texels);
+no_texels:
+    vkDestroyImage(device, image, NULL);
+    AAllocator_free(allocator, memory);
+no_image:
+    // staged region returns to the ring with the next flush
+no_staging:
+    eprintff(
+        MSG_ERRORF("cannot upload %ux%ux%u texture for streaming"), info.width, info.height,
+        info.layers);
+    return 1;
+}
+
+void ATextureStreamer_track_view(
+    ATextureStreamer *streamer, ALoadedTexture const *texture, VkImageView *view) {
+    for (uint32_t i = 0; i < streamer->count; i++) {
+        AStreamedImage *image = streamer->images + i;
+        if (image->texture != texture) continue;
+        image->view = view;
+        image->viewLevel = texture->residentLevel;
+    }
+}
+
+/*
+ * Image with the smallest missing level, NULL if every one is resident
+ */
+static AStreamedImage *next_image(ATextureStreamer *streamer) {
+    AStreamedImage *next = NULL;
+    for (uint32_t i = 0; i < streamer->count; i++) {
+        AStreamedImage *image = streamer->images + i;
+        uint32_t level = image->texture->residentLevel;
+        if (level > 0 && (next == NULL || level > next->texture->residentLevel)) next = image;
+    }
+    return next;
+}
+
+/*
+ * Stops streaming image, leftBytes of its texels were not copied
+ */
+static void drop_image(ATextureStreamer *streamer, AStreamedImage *image, VkDeviceSize leftBytes) {
+    streamer->pendingBytes -= leftBytes;
+    free(image->texels);
+    *image = streamer->images[--streamer->count];
+}
+
+/*
+ * Records copies of layers, or block rows of large ones, within the budget
+ * returns 1 if anything was recorded
+ */
+static int record_copies(ATextureStreamer *streamer) {
+    AUploadContext *upload = streamer->upload;
+    AStagingRing *staging = upload->staging;
+    AStagingRing_reclaim(staging);
+    // a part no larger than half of the ring fits wherever its free space wraps
+    VkDeviceSize maxPart = staging->size / 2 - MIN(staging->size / 2, 16);
+    VkDeviceSize budget = streamer->frameBytes;
+    int recorded = 0;
+    AStreamedImage *image;
+    while ((image = next_image(streamer)) != NULL) {
+        ALoadedTexture *texture = image->texture;
+        ATextureInfo info = texture->info;
+        uint32_t level = texture->residentLevel - 1;
+        VkExtent2D extent = mip_extent(info.width, info.height, level);
+        // rows of blocks for compressed formats
+        ATexelBlock block = texel_block(info.format);
+        uint32_t blockRows = (extent.height + block.height - 1) / block.height;
+        VkDeviceSize rowSize =
+            (VkDeviceSize)(extent.width + block.width - 1) / block.width * block.size;
+        VkDeviceSize layerSize = blockRows * rowSize;
+        VkDeviceSize levelOffset =
+            info.layers * mip_chain_size(info.format, info.width, info.height, level);
+        VkDeviceSize copied = image->nextLayer * layerSize + image->nextRow * rowSize;
+        if (rowSize > maxPart) {
+            eprintff(
+                MSG_WARNF("%ux%u level %u does not fit %llu byte staging, texture stays at %u"),
+                extent.width, extent.height, level, (unsigned long long)staging->size,
+                texture->residentLevel);
+            drop_image(streamer, image, levelOffset + info.layers * layerSize - copied);
+            continue;
+        }
+        // any wrapped half of the free ring fits the part, so staging never waits
+        VkDeviceSize freeHalf = (staging->size - staging->used) / 2;
+        VkDeviceSize fits = freeHalf - MIN(freeHalf, 16);
+        uint32_t layers = 1, rows = blockRows;
+        // first copy of a step may go over the budget, so every part lands
+        if (image->nextRow == 0 && layerSize <= maxPart) {
+            layers = (uint32_t)MIN(budget / layerSize, info.layers - image->nextLayer);
+            if (layers == 0 && recorded) break;
+            layers = (uint32_t)MIN(MAX(layers, 1u), fits / layerSize);
+        } else {
+            rows = (uint32_t)MIN(budget / rowSize, blockRows - image->nextRow);
+            if (rows == 0 && recorded) break;
+            rows = (uint32_t)MIN(MAX(rows, 1u), fits / rowSize);
+        }
+        // staging is busy, retried next step
+        if (layers == 0 || rows == 0) break;
+        VkDeviceSize size = layers * rows * rowSize;
+        AStagingRegion region;
+        if (AUploadContext_stage(upload, size, 16, &region) != 0) break;
+        memcpy(region.mapped, image->texels + levelOffset + copied, size);
+        uint32_t y = image->nextRow * block.height;
+        AUploadLevelParams args = {
+            .image = texture->image,
+            .width = extent.width,
+            .height = MIN(rows * block.height, extent.height - y),
+            .y = y,
+            .mipLevel = level,
+            .baseLayer = image->nextLayer,
+            .layerCount = layers,
+            .lastPart = image->nextLayer + layers == info.layers &&
+                        image->nextRow + rows == blockRows};
+        if (AUploadContext_copy_to_level(upload, region, args) != 0) break;
+        recorded = 1;
+        budget -= MIN(budget, size);
+        streamer->pendingBytes -= size;
+        image->nextRow += rows;
+        if (image->nextRow == blockRows) {
+            image->nextRow = 0;
+            image->nextLayer += layers;
+        }
+        if (!args.lastPart) continue;
+        // sampled after the flush below
+        image->nextLayer = 0;
+        texture->residentLevel = level;
+    }
+    return recorded;
+}
+
+int ATextureStreamer_step(ATextureStreamer *streamer) {
+    if (streamer->count == 0) return 0;
+    if (record_copies(streamer)) AUploadContext_flush(streamer->upload);
+    int recreated = 0;
+    for (uint32_t i = 0; i < streamer->count;) {
+        AStreamedImage *image = streamer->images + i;
+        ALoadedTexture *texture = image->texture;
+        if (image->view != NULL && image->viewLevel != texture->residentLevel) {
+            VkImageView view = create_texture_image_view(
+                streamer->device, texture->image, texture->info, texture->residentLevel);
+            // old view still covers resident levels only, retried next step
+            if (view != NULL) {
+                ARetireQueue_push(
+                    streamer->retire,
+                    (ARetired){.kind = A_RETIRED_IMAGE_VIEW, .imageView = *image->view});
+                *image->view = view;
+                image->viewLevel = texture->residentLevel;
+                recreated = 1;
+            }
+        }
+        if (texture->residentLevel > 0 || (image->view != NULL && image->viewLevel > 0)) {
+            i++;
+            continue;
+        }
+        // fully resident, defragmenter may move it from now on
+        if (streamer->defrag != NULL) {
+            VkMemoryType const *memTypes = streamer->allocator->stats.props.memoryTypes;
+            AMovable movable = {
+                .kind = A_MOVABLE_IMAGE,
+                .allocation = &texture->memory,
+                .properties = memTypes[texture->memory.memoryTypeIndex].propertyFlags,
+                .image =
+                    {.handle = &texture->image,
+                     .view = image->view,
+                     .viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY,
+                     .width = texture->info.width,
+                     .height = texture->info.height,
+                     .mipLevels = texture->info.mipLevels,
+                     .layers = texture->info.layers,
+                     .format = texture->info.format,
+                     .usage = A_TEXTURE_IMAGE_USAGE}};
+            ADefragmenter_add(streamer->defrag, movable);
+        }
+        free(image->texels);
+        streamer->images[i] = streamer->images[--streamer->count];
+    }
+    if (recreated) streamer->generation++;
+    return recreated;
+}
@@ -1,5 +1,8 @@
 #include "sync.h"
+#include "SDL.h"
 #include "utils.h"
+#include <stdlib.h>
+#include <string.h>
 
 VkSemaphore *create_semaphores(VkDevice device, uint32_t count) {
     VkSemaphoreCreateInfo smCInfo = {.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
@@ -25,3 +28,199 @@ VkFence *create_fences(VkDevice device, uint32_t count) {
     for (uint32_t i = 0; i < count; i++) { vkCreateFence(device, &fcCInfo, NULL, fences + i); }
     return fences;
 }
+
+AFramePacer *AFramePacer_create(VkDevice device, uint32_t framesInFlight, VkBool32 timeline) {
+    framesInFlight = MAX(MIN(framesInFlight, A_MAX_FRAMES_IN_FLIGHT), 1u);
+    ARR_ALLOC(AFramePacer, pacer, 1);
+    if (pacer == NULL) {
+        eprintff(MSG_ERRORF("cannot allocate frame pacer"));
+        return NULL;
+    }
+    *pacer = (AFramePacer){
+        .device = device,
+        .framesInFlight = framesInFlight,
+        .slotValues = calloc(framesInFlight, sizeof(uint64_t)),
+        .slotStarts = calloc(framesInFlight, sizeof(uint64_t))};
+    if (pacer->slotValues == NULL || pacer->slotStarts == NULL) goto fail;
+    if (timeline) {
+        // device is created with VK_KHR_timeline_semaphore, not as 1.2
+        pacer->waitSemaphores =
+            (PFN_vkWaitSemaphores)vkGetDeviceProcAddr(device, "vkWaitSemaphoresKHR");
+        pacer->getCounterValue = (PFN_vkGetSemaphoreCounterValue)vkGetDeviceProcAddr(
+            device, "vkGetSemaphoreCounterValueKHR");
+        VkSemaphoreTypeCreateInfo typeInfo = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+            .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+            .initialValue = 0};
+        VkSemaphoreCreateInfo smCInfo = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO, .pNext = &typeInfo};
+        VkResult res = VK_ERROR_EXTENSION_NOT_PRESENT;
+        if (pacer->waitSemaphores != NULL && pacer->getCounterValue != NULL)
+            res = vkCreateSemaphore(device, &smCInfo, NULL, &pacer->timeline);
+        if (res == VK_SUCCESS) return pacer;
+        eprintff(MSG_WARNF("cannot create timeline semaphore, using fences: %d"), res);
+        pacer->timeline = NULL;
+    }
+    pacer->fences = create_fences(device, framesInFlight);
+    if (pacer->fences == NULL) goto fail;
+    return pacer;
+fail:
+    eprintff(MSG_ERRORF("cannot create frame pacer"));
+    AFramePacer_destroy(pacer);
+    return NULL;
+}
+
+void AFramePacer_destroy(AFramePacer *pacer) {
+    if (pacer == NULL) return;
+    if (pacer->timeline != NULL) vkDestroySemaphore(pacer->device, pacer->timeline, NULL);
+    for (uint32_t i = 0; pacer->fences != NULL && i < pacer->framesInFlight; i++) {
+        vkDestroyFence(pacer->device, pacer->fences[i], NULL);
+    }
+    free(pacer->fences);
+    free(pacer->slotValues);
+    free(pacer->slotStarts);
+    free(pacer);
+}
+
+void AFramePacer_wait(AFramePacer *pacer, uint32_t slot) {
+    if (pacer->timeline == NULL) {
+        if (pacer->fences[slot] != NULL)
+            vkWaitForFences(pacer->device, 1, pacer->fences + slot, VK_TRUE, UINT64_MAX);
+    } else if (pacer->slotValues[slot] != 0) {
+        VkSemaphoreWaitInfo waitInfo = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+            .semaphoreCount = 1,
+            .pSemaphores = &pacer->timeline,
+            .pValues = pacer->slotValues + slot};
+        pacer->waitSemaphores(pacer->device, &waitInfo, UINT64_MAX);
+    }
+    // sampled before AFramePacer_begin reuses the start of slot
+    AFramePacer_completed(pacer);
+}
+
+/*
+ * Each slot holds the newest frame submitted into it,
+ *  older ones were sampled by AFramePacer_wait before the slot was reused
+ */
+static void sample_latency(AFramePacer *pacer, uint64_t completed) {
+    if (completed <= pacer->observed) return;
+    uint64_t now = SDL_GetPerformanceCounter();
+    double msPerTick = 1000. / SDL_GetPerformanceFrequency();
+    for (uint32_t i = 0; i < pacer->framesInFlight; i++) {
+        uint64_t value = pacer->slotValues[i];
+        if (value <= pacer->observed || value > completed) continue;
+        pacer->samples[pacer->nextSample] = (float)((now - pacer->slotStarts[i]) * msPerTick);
+        pacer->nextSample = (pacer->nextSample + 1) % A_PACER_LATENCY_SAMPLES;
+        pacer->sampleCount = MIN(pacer->sampleCount + 1, A_PACER_LATENCY_SAMPLES);
+    }
+    pacer->observed = completed;
+}
+
+uint64_t AFramePacer_completed(AFramePacer *pacer) {
+    uint64_t completed = 0;
+    if (pacer->timeline != NULL) {
+        pacer->getCounterValue(pacer->device, pacer->timeline, &completed);
+    } else {
+        // slots complete in submit order, so the newest signaled one bounds the rest
+        for (uint32_t i = 0; i < pacer->framesInFlight; i++) {
+            if (pacer->fences[i] == NULL ||
+                vkGetFenceStatus(pacer->device, pacer->fences[i]) == VK_SUCCESS)
+                completed = MAX(completed, pacer->slotValues[i]);
+        }
+    }
+    sample_latency(pacer, completed);
+    return completed;
+}
+
+void AFramePacer_set_rate(AFramePacer *pacer, double fps) {
+    pacer->period = fps > 0 ? (uint64_t)(SDL_GetPerformanceFrequency() / fps) : 0;
+    pacer->deadline = SDL_GetPerformanceCounter();
+}
+
+void AFramePacer_limit(AFramePacer *pacer) {
+    if (pacer->period == 0) return;
+    uint64_t frequency = SDL_GetPerformanceFrequency();
+    uint64_t now = SDL_GetPerformanceCounter();
+    // behind by more than a frame, e.g. after a stall: start over instead of catching up
+    if (pacer->deadline + pacer->period < now) pacer->deadline = now;
+    while (now < pacer->deadline) {
+        // SDL_Delay may oversleep by a scheduler tick, the last 2 ms are spun
+        if ((pacer->deadline - now) * 1000 > 2 * frequency) {
+            SDL_Delay(1);
+            AFramePacer_completed(pacer);
+        }
+        now = SDL_GetPerformanceCounter();
+    }
+    pacer->deadline += pacer->period;
+}
+
+void AFramePacer_begin(AFramePacer *pacer, uint32_t slot) {
+    pacer->slotStarts[slot] = SDL_GetPerformanceCounter();
+}
+
+static int compare_floats(void const *a, void const *b) {
+    float x = *(float const *)a, y = *(float const *)b;
+    return (x > y) - (x < y);
+}
+
+uint32_t AFramePacer_latency(AFramePacer *pacer, double *out_p50, double *out_p99) {
+    uint32_t count = pacer->sampleCount;
+    *out_p50 = *out_p99 = 0;
+    if (count == 0) return 0;
+    float sorted[A_PACER_LATENCY_SAMPLES];
+    memcpy(sorted, pacer->samples, count * sizeof(*sorted));
+    qsort(sorted, count, sizeof(*sorted), compare_floats);
+    *out_p50 = sorted[(count - 1) / 2];
+    *out_p99 = sorted[(uint32_t)((count - 1) * .99)];
+    return count;
+}
+
+VkResult AFramePacer_submit(
+    AFramePacer *pacer, VkQueue queue, uint32_t slot, VkSubmitInfo const *info) {
+    uint64_t value = pacer->submitted + 1;
+    if (pacer->timeline == NULL) {
+        // lost with a failed submit below if it could not be created again
+        if (pacer->fences[slot] == NULL) return VK_ERROR_OUT_OF_HOST_MEMORY;
+        // fence must be unsignaled when submitted, so it cannot be reset after success
+        vkResetFences(pacer->device, 1, pacer->fences + slot);
+        VkResult res = vkQueueSubmit(queue, 1, info, pacer->fences[slot]);
+        if (res != VK_SUCCESS) {
+            // nothing will signal it now, next wait on slot would block forever
+            vkDestroyFence(pacer->device, pacer->fences[slot], NULL);
+            VkFenceCreateInfo fcCInfo = {
+                .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+                .flags = VK_FENCE_CREATE_SIGNALED_BIT};
+            if (vkCreateFence(pacer->device, &fcCInfo, NULL, pacer->fences + slot) != VK_SUCCESS)
+                pacer->fences[slot] = NULL;
+            return res;
+        }
+        pacer->slotValues[slot] = pacer->submitted = value;
+        return VK_SUCCESS;
+    }
+    if (info->waitSemaphoreCount > A_PACER_MAX_SEMAPHORES ||
+        info->signalSemaphoreCount > A_PACER_MAX_SEMAPHORES)
+        return VK_ERROR_INITIALIZATION_FAILED;
+    // values of binary semaphores are ignored
+    uint64_t waitValues[A_PACER_MAX_SEMAPHORES] = {0};
+    uint64_t signalValues[A_PACER_MAX_SEMAPHORES + 1] = {0};
+    VkSemaphore signals[A_PACER_MAX_SEMAPHORES + 1];
+    uint32_t signalCount = info->signalSemaphoreCount;
+    for (uint32_t i = 0; i < signalCount; i++) { signals[i] = info->pSignalSemaphores[i]; }
+    signals[signalCount] = pacer->timeline;
+    signalValues[signalCount++] = value;
+    VkTimelineSemaphoreSubmitInfo timelineInfo = {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .pNext = info->pNext,
+        .waitSemaphoreValueCount = info->waitSemaphoreCount,
+        .pWaitSemaphoreValues = waitValues,
+        .signalSemaphoreValueCount = signalCount,
+        .pSignalSemaphoreValues = signalValues};
+    VkSubmitInfo submitInfo = *info;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.signalSemaphoreCount = signalCount;
+    submitInfo.pSignalSemaphores = signals;
+    VkResult res = vkQueueSubmit(queue, 1, &submitInfo, NULL);
+    if (res != VK_SUCCESS) return res;
+    pacer->slotValues[slot] = pacer->submitted = value;
+    return VK_SUCCESS;
+}
@@ -0,0 +1,157 @@
+#include "texture_cache.h"
+#include "files.h"
+#include "hash.h"
+#include "mipmap.h"
+#include "utils.h"
+#include <fcntl.h>
+#include <inttypes.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CACHE_MAGIC 0x58455441 // "ATEX"
+// bump when layout of entries or decoding changes
+#define CACHE_VERSION 1
+// texels start here, aligned for copies out of the mapping
+#define CACHE_DATA_OFFSET 64
+#define CACHE_PATH_SIZE 256
+
+// native byte order, entries are not shared between machines
+typedef struct CacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t content;
+    uint64_t size;
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipLevels;
+    uint32_t stagedLevels;
+    uint32_t format;
+} CacheHeader;
+
+static void entry_path(ATextureCacheKey const *key, char *out_path) {
+    snprintf(out_path, CACHE_PATH_SIZE, A_TEXTURE_CACHE_DIR "/%016" PRIx64 ".atex", key->entry);
+}
+
+int texture_cache_key(char const *image_path, VkBool32 blitMips, ATextureCacheKey *out_key) {
+    FILE *file = fopen(image_path, "rb");
+    if (file == NULL) return 1;
+    uint64_t content = A_FNV_OFFSET;
+    uint8_t chunk[1 << 14];
+    size_t read;
+    while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        content = fnv1a(content, chunk, read);
+    }
+    int failed = ferror(file);
+    fclose(file);
+    if (failed) return 1;
+    uint8_t variant = blitMips ? 1 : 0;
+    uint64_t entry = fnv1a(A_FNV_OFFSET, (uint8_t const *)image_path, strlen(image_path));
+    *out_key = (ATextureCacheKey){.entry = fnv1a(entry, &variant, 1), .content = content};
+    return 0;
+}
+
+int map_cached_texture(ATextureCacheKey const *key, ADecodedTexture *out_texture) {
+    char path[CACHE_PATH_SIZE];
+    entry_path(key, path);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 1;
+    int res = 1;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < CACHE_DATA_OFFSET) goto no_mapping;
+    size_t mappingSize = (size_t)st.st_size;
+    // private writable mapping, so texels can be treated as any other
+    uint8_t *mapping = mmap(NULL, mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) goto no_mapping;
+    CacheHeader header;
+    memcpy(&header, mapping, sizeof(header));
+    if (header.magic != CACHE_MAGIC || header.version != CACHE_VERSION ||
+        header.content != key->content || header.stagedLevels == 0 ||
+        header.stagedLevels > header.mipLevels ||
+        header.mipLevels > mip_level_count(header.width, header.height) ||
+        header.size != mip_chain_size(
+                           (VkFormat)header.format, header.width, header.height,
+                           header.stagedLevels) ||
+        mappingSize != CACHE_DATA_OFFSET + header.size) {
+        munmap(mapping, mappingSize);
+        goto no_mapping;
+    }
+    ATextureInfo info = {
+        .width = header.width,
+        .height = header.height,
+        .mipLevels = header.mipLevels,
+        .layers = 1,
+        .format = (VkFormat)header.format};
+    *out_texture = (ADecodedTexture){
+        .info = info,
+        .stagedLevels = header.stagedLevels,
+        .size = header.size,
+        .texels = mapping + CACHE_DATA_OFFSET,
+        .mapping = mapping,
+        .mappingSize = mappingSize};
+    res = 0;
+no_mapping:
+    // mapping outlives the descriptor
+    close(fd);
+    return res;
+}
+
+/*
+ * Writes texels as they are staged, RGB is expanded a chunk at a time
+ * 0 on success
+ * 1 on failure
+ */
+static int write_texels(FILE *file, ADecodedTexture const *texture) {
+    if (!texture->rgb) return fwrite(texture->texels, texture->size, 1, file) != 1;
+    VkDeviceSize const chunkSize = 256 * 1024;
+    ARR_ALLOC(uint8_t, chunk, chunkSize);
+    if (chunk == NULL) return 1;
+    int res = 0;
+    for (VkDeviceSize offset = 0; res == 0 && offset < texture->size; offset += chunkSize) {
+        VkDeviceSize size = MIN(chunkSize, texture->size - offset);
+        copy_texels(chunk, texture, offset, size);
+        if (fwrite(chunk, size, 1, file) != 1) res = 1;
+    }
+    free(chunk);
+    return res;
+}
+
+int store_cached_texture(ATextureCacheKey const *key, ADecodedTexture const *texture) {
+    ATextureInfo info = texture->info;
+    if (info.layers != 1) {
+        eprintff(MSG_ERRORF("texture cache takes single layer textures"));
+        return 1;
+    }
+    if (make_dirs(A_TEXTURE_CACHE_DIR) != 0) return 1;
+    char path[CACHE_PATH_SIZE], tmpPath[CACHE_PATH_SIZE + 32];
+    entry_path(key, path);
+    // decoders of the same path may store at once, texture tells them apart
+    snprintf(tmpPath, sizeof(tmpPath), "%s.%p.tmp", path, (void const *)texture);
+    CacheHeader header = {
+        .magic = CACHE_MAGIC,
+        .version = CACHE_VERSION,
+        .content = key->content,
+        .size = texture->size,
+        .width = info.width,
+        .height = info.height,
+        .mipLevels = info.mipLevels,
+        .stagedLevels = texture->stagedLevels,
+        .format = (uint32_t)info.format};
+    uint8_t head[CACHE_DATA_OFFSET] = {0};
+    memcpy(head, &header, sizeof(header));
+    FILE *file = fopen(tmpPath, "wb");
+    if (file == NULL) {
+        eprintff(MSG_ERRORF("cannot open '%s' for writing"), tmpPath);
+        return 1;
+    }
+    int res = 0;
+    if (fwrite(head, sizeof(head), 1, file) != 1 || write_texels(file, texture) != 0) res = 1;
+    if (fclose(file) != 0) res = 1;
+    if (res == 0 && rename(tmpPath, path) != 0) res = 1;
+    if (res != 0) {
+        eprintff(MSG_ERRORF("cannot write texture cache entry '%s'"), path);
+        remove(tmpPath);
+    }
+    return res;
+}
@@ -0,0 +1,59 @@
+#include "uniform.h"
+#include "buffer.h"
+#include "utils.h"
+
+AUniformArena AUniformArena_create(
+    VkDevice device, VkPhysicalDevice pdevice, AAllocator *allocator, uint32_t frameCount,
+    VkDeviceSize frameSize, VkDeviceSize range) {
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(pdevice, &props);
+    VkDeviceSize alignment = props.limits.minUniformBufferOffsetAlignment;
+    if (range > props.limits.maxUniformBufferRange) {
+        eprintff(
+            MSG_ERRORF("uniform range %llu exceeds maxUniformBufferRange (%u)"),
+            (unsigned long long)range, props.limits.maxUniformBufferRange);
+        return (AUniformArena){.buffer = NULL};
+    }
+    if (frameSize == 0) frameSize = A_DEFAULT_UNIFORM_FRAME_SIZE;
+    frameSize = ALIGN_UP(frameSize, alignment);
+    AAllocation memory;
+    VkBuffer buffer = create_buffer(
+        device, allocator, frameSize * frameCount, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &memory);
+    if (buffer == NULL) {
+        eprintff(MSG_ERRORF("cannot create uniform buffer"));
+        return (AUniformArena){.buffer = NULL};
+    }
+    return (AUniformArena){
+        .buffer = buffer,
+        .memory = memory,
+        .alignment = alignment,
+        .frameSize = frameSize,
+        .range = range,
+        .frameCount = frameCount,
+        .frame = 0,
+        .head = 0};
+}
+
+void AUniformArena_destroy(VkDevice device, AAllocator *allocator, AUniformArena arena) {
+    vkDestroyBuffer(device, arena.buffer, NULL);
+    AAllocator_free(allocator, arena.memory);
+}
+
+void AUniformArena_begin_frame(AUniformArena *arena, uint32_t frame) {
+    arena->frame = frame;
+    arena->head = 0;
+}
+
+void *AUniformArena_alloc(AUniformArena *arena, VkDeviceSize size, uint32_t *out_dynamicOffset) {
+    VkDeviceSize offset = ALIGN_UP(arena->head, arena->alignment);
+    // descriptor reads range bytes from offset, keep them inside the slot
+    if (size > arena->range || offset + arena->range > arena->frameSize) {
+        eprintff(MSG_ERRORF("uniform slot of frame %u is full"), arena->frame);
+        return NULL;
+    }
+    arena->head = offset + size;
+    offset += arena->frame * arena->frameSize;
+    *out_dynamicOffset = (uint32_t)offset;
+    return (char *)arena->memory.mapped + offset;
+}
@@ -0,0 +1,539 @@
+#include "upload.h"
+#include "image.h"
+#include "mipmap.h"
+#include "utils.h"
+#include <string.h>
+
+static VkCommandPool create_transient_pool(VkDevice device, uint32_t familyIndex) {
+    VkCommandPoolCreateInfo cpCInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
+                 VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        .queueFamilyIndex = familyIndex};
+    VkCommandPool pool;
+    VkResult res = vkCreateCommandPool(device, &cpCInfo, NULL, &pool);
+    if (res != VK_SUCCESS) {
+        eprintff(MSG_ERRORF("cannot create upload command pool: %d"), res);
+        return NULL;
+    }
+    return pool;
+}
+
+AUploadContext *AUploadContext_create(
+    VkDevice device, AStagingRing *staging, AQueueFamilies queueFamilies, ADevice adevice,
+    AGpuProfiler *profiler) {
+    uint32_t graphicsFamily = queueFamilies.graphicsIndex;
+    uint32_t transferFamily =
+        queueFamilies.transferIndex != -1 ? (uint32_t)queueFamilies.transferIndex : graphicsFamily;
+    VkCommandPool transferPool = create_transient_pool(device, transferFamily);
+    if (transferPool == NULL) goto no_transfer_pool;
+    VkCommandPool graphicsPool = NULL;
+    if (transferFamily != graphicsFamily) {
+        graphicsPool = create_transient_pool(device, graphicsFamily);
+        if (graphicsPool == NULL) goto no_graphics_pool;
+    }
+    ARR_ALLOC(AUploadContext, ctx, 1);
+    if (ctx == NULL) goto no_ctx;
+    uint32_t capacity = 8;
+    *ctx = (AUploadContext){
+        .device = device,
+        .staging = staging,
+        .transferFamily = transferFamily,
+        .graphicsFamily = graphicsFamily,
+        .transferQueue = adevice.transferQueue,
+        .graphicsQueue = adevice.drawQueue,
+        .transferPool = transferPool,
+        .graphicsPool = graphicsPool,
+        .profiler = transferFamily == graphicsFamily ? profiler : NULL,
+        .timedSerial = 0,
+        .open = {0},
+        .dstStageMask = 0,
+        .bufferBarrierCount = 0,
+        .bufferBarrierCapacity = capacity,
+        .bufferBarriers = ARR_INPLACE_ALLOC(VkBufferMemoryBarrier, capacity),
+        .imageBarrierCount = 0,
+        .imageBarrierCapacity = capacity,
+        .imageBarriers = ARR_INPLACE_ALLOC(VkImageMemoryBarrier, capacity),
+        .blitCount = 0,
+        .blitCapacity = capacity,
+        .blits = ARR_INPLACE_ALLOC(AUploadImageParams, capacity),
+        .pendingFirst = 0,
+        .pendingCount = 0,
+        .pendingCapacity = capacity,
+        .pending = ARR_INPLACE_ALLOC(AUploadBatch, capacity),
+        .freeCount = 0,
+        .freeCapacity = capacity,
+        .free = ARR_INPLACE_ALLOC(AUploadBatch, capacity)};
+    if (ctx->bufferBarriers == NULL || ctx->imageBarriers == NULL || ctx->blits == NULL ||
+        ctx->pending == NULL || ctx->free == NULL)
+        goto no_arrays;
+    if (transferFamily != graphicsFamily)
+        eprintff(MSG_INFOF("uploading on transfer queue family %u"), transferFamily);
+    return ctx;
+no_arrays:
+    free(ctx->free);
+    free(ctx->pending);
+    free(ctx->blits);
+    free(ctx->imageBarriers);
+    free(ctx->bufferBarriers);
+    free(ctx);
+no_ctx:
+    eprintff(MSG_ERRORF("cannot allocate upload context"));
+    if (graphicsPool != NULL) vkDestroyCommandPool(device, graphicsPool, NULL);
+no_graphics_pool:
+    vkDestroyCommandPool(device, transferPool, NULL);
+no_transfer_pool:
+    return NULL;
+}
+
+void AUploadContext_destroy(AUploadContext *ctx) {
+    if (ctx == NULL) return;
+    AUploadContext_wait_idle(ctx);
+    for (uint32_t i = 0; i < ctx->freeCount; i++) {
+        if (ctx->free[i].semaphore != NULL)
+            vkDestroySemaphore(ctx->device, ctx->free[i].semaphore, NULL);
+    }
+    // NOTE: destroying a pool frees its command buffers
+    if (ctx->graphicsPool != NULL) vkDestroyCommandPool(ctx->device, ctx->graphicsPool, NULL);
+    vkDestroyCommandPool(ctx->device, ctx->transferPool, NULL);
+    free(ctx->free);
+    free(ctx->pending);
+    free(ctx->blits);
+    free(ctx->imageBarriers);
+    free(ctx->bufferBarriers);
+    free(ctx);
+}
+
+/*
+ * 0 on success
+ * 1 on failure
+ */
+static int create_batch(AUploadContext *ctx, AUploadBatch *out_batch) {
+    AUploadBatch batch = {0};
+    VkCommandBufferAllocateInfo cbAInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = ctx->transferPool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1};
+    VkResult res = vkAllocateCommandBuffers(ctx->device, &cbAInfo, &batch.transferCb);
+    if (res != VK_SUCCESS) goto no_transfer_cb;
+    if (ctx->graphicsPool != NULL) {
+        cbAInfo.commandPool = ctx->graphicsPool;
+        res = vkAllocateCommandBuffers(ctx->device, &cbAInfo, &batch.acquireCb);
+        if (res != VK_SUCCESS) goto no_acquire_cb;
+        VkSemaphoreCreateInfo smCInfo = {.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+        res = vkCreateSemaphore(ctx->device, &smCInfo, NULL, &batch.semaphore);
+        if (res != VK_SUCCESS) goto no_semaphore;
+    }
+    *out_batch = batch;
+    return 0;
+no_semaphore:
+    vkFreeCommandBuffers(ctx->device, ctx->graphicsPool, 1, &batch.acquireCb);
+no_acquire_cb:
+    vkFreeCommandBuffers(ctx->device, ctx->transferPool, 1, &batch.transferCb);
+no_transfer_cb:
+    eprintff(MSG_ERRORF("cannot create upload batch: %d"), res);
+    return 1;
+}
+
+/*
+ * Doubles capacity of items
+ * returns grown items, *capacity is updated then
+ * NULL on failure, items are left as they are
+ */
+static void *grow_array(void *items, uint32_t *capacity, size_t itemSize) {
+    void *grown = realloc(items, *capacity * 2 * itemSize);
+    if (grown == NULL) {
+        eprintff(MSG_ERRORF("cannot grow upload array to %u items"), *capacity * 2);
+        return NULL;
+    }
+    *capacity *= 2;
+    return grown;
+}
+
+/*
+ * Makes room for one more of each barrier kind and blit of open batch, before anything is recorded
+ * 0 on success
+ * 1 on failure
+ */
+static int reserve_barriers(AUploadContext *ctx) {
+    if (ctx->bufferBarrierCount == ctx->bufferBarrierCapacity) {
+        VkBufferMemoryBarrier *barriers = grow_array(
+            ctx->bufferBarriers, &ctx->bufferBarrierCapacity, sizeof(*barriers));
+        if (barriers == NULL) return 1;
+        ctx->bufferBarriers = barriers;
+    }
+    if (ctx->imageBarrierCount == ctx->imageBarrierCapacity) {
+        VkImageMemoryBarrier *barriers =
+            grow_array(ctx->imageBarriers, &ctx->imageBarrierCapacity, sizeof(*barriers));
+        if (barriers == NULL) return 1;
+        ctx->imageBarriers = barriers;
+    }
+    if (ctx->blitCount == ctx->blitCapacity) {
+        AUploadImageParams *blits = grow_array(ctx->blits, &ctx->blitCapacity, sizeof(*blits));
+        if (blits == NULL) return 1;
+        ctx->blits = blits;
+    }
+    return 0;
+}
+
+// batch must be complete or never submitted
+static void destroy_batch(AUploadContext *ctx, AUploadBatch batch) {
+    if (batch.semaphore != NULL) vkDestroySemaphore(ctx->device, batch.semaphore, NULL);
+    if (batch.acquireCb != NULL)
+        vkFreeCommandBuffers(ctx->device, ctx->graphicsPool, 1, &batch.acquireCb);
+    vkFreeCommandBuffers(ctx->device, ctx->transferPool, 1, &batch.transferCb);
+}
+
+/*
+ * Starts recording of open batch if not started yet
+ * Reserves room for the barriers and blit of one copy
+ * 0 on success
+ * 1 on failure
+ */
+static int begin_batch(AUploadContext *ctx) {
+    if (reserve_barriers(ctx) != 0) return 1;
+    if (ctx->open.transferCb != NULL) return 0;
+    AUploadBatch batch;
+    if (ctx->freeCount > 0) batch = ctx->free[--ctx->freeCount];
+    else if (create_batch(ctx, &batch) != 0) return 1;
+    // NOTE: begin implicitly resets, pools have RESET_COMMAND_BUFFER flag
+    VkCommandBufferBeginInfo cbBInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
+    vkBeginCommandBuffer(batch.transferCb, &cbBInfo);
+    if (batch.acquireCb != NULL) vkBeginCommandBuffer(batch.acquireCb, &cbBInfo);
+    // the set is reused once the last timed batch is complete, batches meanwhile are not timed
+    batch.timed = ctx->profiler != NULL && ctx->timedSerial <= ctx->staging->completedSerial;
+    if (batch.timed) {
+        uint32_t set = AGpuProfiler_set(ctx->profiler, A_PROFILER_SET_UPLOAD);
+        AGpuProfiler_collect(ctx->profiler, set);
+        AGpuProfiler_reset(ctx->profiler, batch.transferCb, set);
+        AGpuProfiler_begin(
+            ctx->profiler, batch.transferCb, set, AGpuProfiler_scope(ctx->profiler, "upload"));
+    }
+    ctx->open = batch;
+    return 0;
+}
+
+int AUploadContext_stage(
+    AUploadContext *ctx, VkDeviceSize size, VkDeviceSize alignment, AStagingRegion *out_region) {
+    int res = AStagingRing_alloc(ctx->staging, size, alignment, out_region);
+    if (res == 2 && AUploadContext_flush(ctx) != 0) {
+        // open batch held the ring, now it can be waited on
+        res = AStagingRing_alloc(ctx->staging, size, alignment, out_region);
+    }
+    if (res != 0) {
+        eprintff(MSG_ERRORF("no staging memory for %llu bytes"), (unsigned long long)size);
+        return 1;
+    }
+    return 0;
+}
+
+int AUploadContext_copy_to_buffer(
+    AUploadContext *ctx, AStagingRegion region, AUploadBufferParams args) {
+    if (begin_batch(ctx) != 0) return 1;
+    VkBufferCopy copyRegion = {
+        .srcOffset = region.offset, .dstOffset = args.dstOffset, .size = args.size};
+    vkCmdCopyBuffer(ctx->open.transferCb, region.buffer, args.dst, 1, &copyRegion);
+    VkBool32 transfer = ctx->graphicsPool != NULL;
+    ctx->bufferBarriers[ctx->bufferBarrierCount++] = (VkBufferMemoryBarrier){
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = args.dstAccessMask,
+        .srcQueueFamilyIndex = transfer ? ctx->transferFamily : VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = transfer ? ctx->graphicsFamily : VK_QUEUE_FAMILY_IGNORED,
+        .buffer = args.dst,
+        .offset = args.dstOffset,
+        .size = args.size};
+    ctx->dstStageMask |= args.dstStageMask;
+    return 0;
+}
+
+/*
+ * Queues transition of levels [baseMipLevel, baseMipLevel + levelCount) of image
+ *  for the flush of open batch
+ * newLayout is VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+ *  or VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL if mips are blitted after it
+ * Room is reserved by begin_batch
+ */
+static void push_image_barrier(
+    AUploadContext *ctx, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+    uint32_t baseMipLevel, uint32_t levelCount) {
+    VkBool32 transfer = ctx->graphicsPool != NULL;
+    VkBool32 sampled = newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    ctx->imageBarriers[ctx->imageBarrierCount++] = (VkImageMemoryBarrier){
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = sampled ? VK_ACCESS_SHADER_READ_BIT
+                                 : VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+        .oldLayout = oldLayout,
+        .newLayout = newLayout,
+        .srcQueueFamilyIndex = transfer ? ctx->transferFamily : VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = transfer ? ctx->graphicsFamily : VK_QUEUE_FAMILY_IGNORED,
+        .image = image,
+        .subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .subresourceRange.baseMipLevel = baseMipLevel,
+        .subresourceRange.levelCount = levelCount,
+        .subresourceRange.baseArrayLayer = 0,
+        .subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS};
+    ctx->dstStageMask |=
+        sampled ? VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT : VK_PIPELINE_STAGE_TRANSFER_BIT;
+}
+
+int AUploadContext_copy_to_image(
+    AUploadContext *ctx, AStagingRegion region, AUploadImageParams args) {
+    if (begin_batch(ctx) != 0) return 1;
+    VkCommandBuffer cb = ctx->open.transferCb;
+    transition_image_layout(
+        cb, args.image, VK_FORMAT_UNDEFINED, VK_IMAGE_LAYOUT_UNDEFINED,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, args.mipLevels);
+    VkBool32 blit = args.blitMips && args.mipLevels > 1;
+    uint32_t stagedLevels = blit ? 1 : args.mipLevels;
+    for (uint32_t level = 0; level < stagedLevels; level++) {
+        VkExtent2D extent = mip_extent(args.width, args.height, level);
+        VkDeviceSize levelOffset = mip_chain_size(args.format, args.width, args.height, level);
+        VkDeviceSize offset = region.offset + args.layers * levelOffset;
+        copy_buffer_to_image(
+            cb, region.buffer, offset, args.image, extent.width, extent.height, 0, level, 0,
+            args.layers);
+    }
+    if (!blit) {
+        push_image_barrier(
+            ctx, args.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 0, args.mipLevels);
+        return 0;
+    }
+    // transfer queue cannot blit, levels stay TRANSFER_DST until record_mip_blits
+    push_image_barrier(
+        ctx, args.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, args.mipLevels);
+    ctx->blits[ctx->blitCount++] = args;
+    return 0;
+}
+
+int AUploadContext_transition_image(AUploadContext *ctx, VkImage image, uint32_t mipLevels) {
+    if (begin_batch(ctx) != 0) return 1;
+    // host writes are made visible by the submit itself
+    push_image_barrier(
+        ctx, image, VK_IMAGE_LAYOUT_PREINITIALIZED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 0,
+        mipLevels);
+    return 0;
+}
+
+int AUploadContext_begin_image(AUploadContext *ctx, VkImage image, uint32_t mipLevels) {
+    if (begin_batch(ctx) != 0) return 1;
+    transition_image_layout(
+        ctx->open.transferCb, image, VK_FORMAT_UNDEFINED, VK_IMAGE_LAYOUT_UNDEFINED,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, mipLevels);
+    return 0;
+}
+
+int AUploadContext_copy_to_level(
+    AUploadContext *ctx, AStagingRegion region, AUploadLevelParams args) {
+    if (begin_batch(ctx) != 0) return 1;
+    copy_buffer_to_image(
+        ctx->open.transferCb, region.buffer, region.offset, args.image, args.width, args.height,
+        args.y, args.mipLevel, args.baseLayer, args.layerCount);
+    if (args.lastPart)
+        push_image_barrier(
+            ctx, args.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, args.mipLevel, 1);
+    return 0;
+}
+
+int AUploadContext_buffer(AUploadContext *ctx, void const *data, AUploadBufferParams args) {
+    if (args.size == 0) return 0;
+    AStagingRegion region;
+    if (AUploadContext_stage(ctx, args.size, 4, &region) != 0) return 1;
+    memcpy(region.mapped, data, args.size);
+    return AUploadContext_copy_to_buffer(ctx, region, args);
+}
+
+/*
+ * Records barriers collected for open batch
+ * Same family: one barrier in transferCb
+ * Different families: release in transferCb, acquire in acquireCb
+ */
+static void record_barriers(AUploadContext *ctx) {
+    if (ctx->open.acquireCb == NULL) {
+        vkCmdPipelineBarrier(
+            ctx->open.transferCb, VK_PIPELINE_STAGE_TRANSFER_BIT, ctx->dstStageMask, 0, 0, NULL,
+            ctx->bufferBarrierCount, ctx->bufferBarriers, ctx->imageBarrierCount,
+            ctx->imageBarriers);
+        return;
+    }
+    // acquire: access masks after the transfer, srcAccessMask is ignored
+    for (uint32_t i = 0; i < ctx->bufferBarrierCount; i++) {
+        ctx->bufferBarriers[i].srcAccessMask = 0;
+    }
+    for (uint32_t i = 0; i < ctx->imageBarrierCount; i++) {
+        ctx->imageBarriers[i].srcAccessMask = 0;
+    }
+    vkCmdPipelineBarrier(
+        ctx->open.acquireCb, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, ctx->dstStageMask, 0, 0, NULL,
+        ctx->bufferBarrierCount, ctx->bufferBarriers, ctx->imageBarrierCount, ctx->imageBarriers);
+    // release: transfer family cannot name graphics stages, dstAccessMask is ignored
+    for (uint32_t i = 0; i < ctx->bufferBarrierCount; i++) {
+        ctx->bufferBarriers[i].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        ctx->bufferBarriers[i].dstAccessMask = 0;
+    }
+    for (uint32_t i = 0; i < ctx->imageBarrierCount; i++) {
+        ctx->imageBarriers[i].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        ctx->imageBarriers[i].dstAccessMask = 0;
+    }
+    vkCmdPipelineBarrier(
+        ctx->open.transferCb, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+        0, 0, NULL, ctx->bufferBarrierCount, ctx->bufferBarriers, ctx->imageBarrierCount,
+        ctx->imageBarriers);
+}
+
+/*
+ * Generates mips of queued images level by level, all layers of a level in one blit
+ * cb must be on graphics family and recorded after the acquire barriers
+ */
+static void record_mip_blits(AUploadContext *ctx, VkCommandBuffer cb) {
+    for (uint32_t i = 0; i < ctx->blitCount; i++) {
+        AUploadImageParams args = ctx->blits[i];
+        for (uint32_t level = 1; level < args.mipLevels; level++) {
+            VkExtent2D src = mip_extent(args.width, args.height, level - 1);
+            VkExtent2D dst = mip_extent(args.width, args.height, level);
+            transition_image_layout(
+                cb, args.image, VK_FORMAT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, level - 1, 1);
+            VkImageBlit blit = {
+                .srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, args.layers},
+                .srcOffsets = {{0, 0, 0}, {(int32_t)src.width, (int32_t)src.height, 1}},
+                .dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, args.layers},
+                .dstOffsets = {{0, 0, 0}, {(int32_t)dst.width, (int32_t)dst.height, 1}}
+            };
+            vkCmdBlitImage(
+                cb, args.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, args.image,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+            transition_image_layout(
+                cb, args.image, VK_FORMAT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, level - 1, 1);
+        }
+        transition_image_layout(
+            cb, args.image, VK_FORMAT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, args.mipLevels - 1, 1);
+    }
+    ctx->blitCount = 0;
+}
+
+uint64_t AUploadContext_flush(AUploadContext *ctx) {
+    if (ctx->open.transferCb == NULL) return 0;
+    if (ctx->pendingCount == ctx->pendingCapacity) {
+        // grow and unwrap FIFO, before submit so a submitted batch is always tracked
+        uint32_t newCapacity = ctx->pendingCapacity * 2;
+        ARR_ALLOC(AUploadBatch, pending, newCapacity);
+        if (pending == NULL) {
+            eprintff(MSG_ERRORF("cannot grow pending upload batches, batch stays open"));
+            return 0;
+        }
+        for (uint32_t i = 0; i < ctx->pendingCount; i++) {
+            pending[i] = ctx->pending[(ctx->pendingFirst + i) % ctx->pendingCapacity];
+        }
+        free(ctx->pending);
+        ctx->pending = pending;
+        ctx->pendingFirst = 0;
+        ctx->pendingCapacity = newCapacity;
+    }
+    AUploadBatch batch = ctx->open;
+    record_barriers(ctx);
+    // same family means transferCb runs on a graphics capable queue
+    record_mip_blits(ctx, batch.acquireCb != NULL ? batch.acquireCb : batch.transferCb);
+    if (batch.timed)
+        AGpuProfiler_end(
+            ctx->profiler, batch.transferCb, AGpuProfiler_set(ctx->profiler, A_PROFILER_SET_UPLOAD),
+            AGpuProfiler_scope(ctx->profiler, "upload"));
+    vkEndCommandBuffer(batch.transferCb);
+    if (batch.acquireCb != NULL) vkEndCommandBuffer(batch.acquireCb);
+    ctx->open = (AUploadBatch){0};
+    ctx->dstStageMask = 0;
+    ctx->bufferBarrierCount = 0;
+    ctx->imageBarrierCount = 0;
+
+    // fence goes to the last submit, staging is released when acquire is done
+    VkFence fence;
+    batch.serial = AStagingRing_submit(ctx->staging, &fence);
+    if (batch.serial == 0) goto no_serial;
+    VkSubmitInfo sInfo = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &batch.transferCb};
+    VkResult res;
+    VkBool32 transferSubmitted = VK_FALSE;
+    if (batch.acquireCb == NULL) {
+        res = vkQueueSubmit(ctx->transferQueue, 1, &sInfo, fence);
+        if (res != VK_SUCCESS) goto no_submit;
+    }
+    else {
+        sInfo.signalSemaphoreCount = 1;
+        sInfo.pSignalSemaphores = &batch.semaphore;
+        res = vkQueueSubmit(ctx->transferQueue, 1, &sInfo, NULL);
+        if (res != VK_SUCCESS) goto no_submit;
+        transferSubmitted = VK_TRUE;
+        VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        VkSubmitInfo acquireInfo = {
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .waitSemaphoreCount = 1,
+            .pWaitSemaphores = &batch.semaphore,
+            .pWaitDstStageMask = &waitStage,
+            .commandBufferCount = 1,
+            .pCommandBuffers = &batch.acquireCb};
+        res = vkQueueSubmit(ctx->graphicsQueue, 1, &acquireInfo, fence);
+        if (res != VK_SUCCESS) goto no_submit;
+    }
+    uint32_t last = (ctx->pendingFirst + ctx->pendingCount) % ctx->pendingCapacity;
+    ctx->pending[last] = batch;
+    ctx->pendingCount++;
+    if (batch.timed) ctx->timedSerial = batch.serial;
+    return batch.serial;
+no_submit:
+    eprintff(MSG_ERRORF("cannot submit upload batch: %d"), res);
+    // copies may still read staging and signal the semaphore, nothing else will wait for them
+    if (transferSubmitted) vkQueueWaitIdle(ctx->transferQueue);
+    // fence is never signaled, the batch's staging is released without it
+    AStagingRing_cancel(ctx->staging, batch.serial);
+no_serial:
+    destroy_batch(ctx, batch);
+    return 0;
+}
+
+void AUploadContext_collect(AUploadContext *ctx) {
+    AStagingRing_reclaim(ctx->staging);
+    while (ctx->pendingCount > 0) {
+        AUploadBatch batch = ctx->pending[ctx->pendingFirst];
+        if (batch.serial > ctx->staging->completedSerial) break;
+        ctx->pendingFirst = (ctx->pendingFirst + 1) % ctx->pendingCapacity;
+        ctx->pendingCount--;
+        if (ctx->freeCount == ctx->freeCapacity) {
+            AUploadBatch *batches = grow_array(ctx->free, &ctx->freeCapacity, sizeof(*batches));
+            if (batches == NULL) {
+                // complete, nothing uses it anymore
+                destroy_batch(ctx, batch);
+                continue;
+            }
+            ctx->free = batches;
+        }
+        ctx->free[ctx->freeCount++] = batch;
+    }
+}
+
+int AUploadContext_is_complete(AUploadContext *ctx, uint64_t serial) {
+    AUploadContext_collect(ctx);
+    return serial <= ctx->staging->completedSerial;
+}
+
+void AUploadContext_wait(AUploadContext *ctx, uint64_t serial) {
+    AStagingRing_wait(ctx->staging, serial);
+    AUploadContext_collect(ctx);
+}
+
+void AUploadContext_wait_idle(AUploadContext *ctx) {
+    AUploadContext_flush(ctx);
+    if (ctx->pendingCount == 0) return;
+    uint32_t last = (ctx->pendingFirst + ctx->pendingCount - 1) % ctx->pendingCapacity;
+    AUploadContext_wait(ctx, ctx->pending[last].serial);
+}
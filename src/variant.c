@@ -0,0 +1,54 @@
+#include "variant.h"
+#include "utils.h"
+#include <string.h>
+
+AShaderVariant AShaderVariant_default(void) {
+    return (AShaderVariant){
+        .texture = VK_TRUE,
+        .vertexColor = VK_FALSE,
+        .alphaTest = VK_TRUE,
+        .lighting = A_LIGHTING_NONE};
+}
+
+uint32_t AShaderVariant_key(AShaderVariant variant) {
+    return (variant.texture ? 1u : 0u) | (variant.vertexColor ? 2u : 0u) |
+           (variant.alphaTest ? 4u : 0u) | variant.lighting << 3;
+}
+
+void AShaderVariant_specialize(AShaderVariant variant, ASpecialization *out_specialization) {
+    ASpecialization *spec = out_specialization;
+    // bool constants are 32-bit
+    spec->data[0] = variant.texture ? VK_TRUE : VK_FALSE;
+    spec->data[1] = variant.vertexColor ? VK_TRUE : VK_FALSE;
+    spec->data[2] = variant.alphaTest ? VK_TRUE : VK_FALSE;
+    spec->data[3] = variant.lighting;
+    for (uint32_t i = 0; i < A_VARIANT_CONSTANT_COUNT; i++) {
+        spec->entries[i] = (VkSpecializationMapEntry){
+            .constantID = i, .offset = i * sizeof(*spec->data), .size = sizeof(*spec->data)};
+    }
+    spec->info = (VkSpecializationInfo){
+        .mapEntryCount = A_VARIANT_CONSTANT_COUNT,
+        .pMapEntries = spec->entries,
+        .dataSize = sizeof(spec->data),
+        .pData = spec->data};
+}
+
+uint32_t AShaderVariant_request(
+    APipelineRegistry *registry, APipelineDesc const *base, AShaderVariant variant,
+    VkPipeline fallback) {
+    ASpecialization spec;
+    AShaderVariant_specialize(variant, &spec);
+    ARR_ALLOC(AShader, shaders, base->shaderCount);
+    if (shaders == NULL) {
+        eprintff(MSG_ERRORF("cannot allocate shaders of variant %x"), AShaderVariant_key(variant));
+        return A_PIPELINE_NONE;
+    }
+    memcpy(shaders, base->shaders, base->shaderCount * sizeof(*shaders));
+    for (uint32_t i = 0; i < base->shaderCount; i++) { shaders[i].specialization = &spec.info; }
+    APipelineDesc desc = *base;
+    desc.shaders = shaders;
+    // desc is copied by the registry, spec and shaders can go right after
+    uint32_t entry = APipelineRegistry_request(registry, &desc, fallback);
+    free(shaders);
+    return entry;
+}
@@ -0,0 +1,578 @@
+/*
+ * Offline block compressor: PNG -> DDS with full mip chain
+ * Every PNG given directly or found in a given directory gets a .dds next to it,
+ *  decode_texture prefers it when the device samples its format
+ */
+#include "dds.h"
+#include "lodepng.h"
+#include "mipmap.h"
+#include "utils.h"
+#include <dirent.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+typedef enum BcFormat { BC_AUTO, BC_1, BC_3, BC_7 } BcFormat;
+
+static VkFormat const vkFormats[] = {
+    [BC_1] = VK_FORMAT_BC1_RGBA_SRGB_BLOCK,
+    [BC_3] = VK_FORMAT_BC3_SRGB_BLOCK,
+    [BC_7] = VK_FORMAT_BC7_SRGB_BLOCK,
+};
+static char const *const formatNames[] = {
+    [BC_AUTO] = "auto", [BC_1] = "bc1", [BC_3] = "bc3", [BC_7] = "bc7"};
+
+/*
+ * 4x4 RGBA texels at x, y, edges of levels smaller than a block are repeated
+ */
+static void fetch_block(
+    uint8_t const *texels, VkExtent2D extent, uint32_t x, uint32_t y, uint8_t *out_block) {
+    for (uint32_t j = 0; j < 4; j++) {
+        uint32_t row = MIN(y + j, extent.height - 1);
+        for (uint32_t i = 0; i < 4; i++) {
+            uint32_t column = MIN(x + i, extent.width - 1);
+            size_t offset = ((size_t)row * extent.width + column) * 4;
+            memcpy(out_block + 4 * (4 * j + i), texels + offset, 4);
+        }
+    }
+}
+
+/*
+ * Per channel bounding box of 16 texels
+ */
+static void block_bounds(uint8_t const *block, uint8_t *out_min, uint8_t *out_max) {
+#ifdef __SSE2__
+    __m128i r0 = _mm_loadu_si128((__m128i const *)block);
+    __m128i r1 = _mm_loadu_si128((__m128i const *)(block + 16));
+    __m128i r2 = _mm_loadu_si128((__m128i const *)(block + 32));
+    __m128i r3 = _mm_loadu_si128((__m128i const *)(block + 48));
+    __m128i lo = _mm_min_epu8(_mm_min_epu8(r0, r1), _mm_min_epu8(r2, r3));
+    __m128i hi = _mm_max_epu8(_mm_max_epu8(r0, r1), _mm_max_epu8(r2, r3));
+    // fold four texels of a row into one
+    lo = _mm_min_epu8(lo, _mm_srli_si128(lo, 8));
+    lo = _mm_min_epu8(lo, _mm_srli_si128(lo, 4));
+    hi = _mm_max_epu8(hi, _mm_srli_si128(hi, 8));
+    hi = _mm_max_epu8(hi, _mm_srli_si128(hi, 4));
+    uint32_t min = (uint32_t)_mm_cvtsi128_si32(lo), max = (uint32_t)_mm_cvtsi128_si32(hi);
+    memcpy(out_min, &min, 4);
+    memcpy(out_max, &max, 4);
+#else
+    memcpy(out_min, block, 4);
+    memcpy(out_max, block, 4);
+    for (uint32_t i = 4; i < 64; i++) {
+        out_min[i % 4] = MIN(out_min[i % 4], block[i]);
+        out_max[i % 4] = MAX(out_max[i % 4], block[i]);
+    }
+#endif
+}
+
+/*
+ * Endpoints at the extremes of texels projected onto their principal axis
+ * Texels with alpha below 128 are skipped if opaqueOnly
+ */
+static void fit_endpoints(
+    uint8_t const *block, uint32_t channels, VkBool32 opaqueOnly, uint8_t *out_start,
+    uint8_t *out_end) {
+    float mean[4] = {0}, cov[4][4] = {{0}};
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < 16; i++) {
+        if (opaqueOnly && block[4 * i + 3] < 128) continue;
+        for (uint32_t c = 0; c < channels; c++) { mean[c] += block[4 * i + c]; }
+        count++;
+    }
+    if (count == 0) {
+        memset(out_start, 0, 4);
+        memset(out_end, 0, 4);
+        return;
+    }
+    for (uint32_t c = 0; c < channels; c++) { mean[c] /= count; }
+    for (uint32_t i = 0; i < 16; i++) {
+        if (opaqueOnly && block[4 * i + 3] < 128) continue;
+        for (uint32_t a = 0; a < channels; a++) {
+            for (uint32_t b = 0; b < channels; b++) {
+                cov[a][b] += (block[4 * i + a] - mean[a]) * (block[4 * i + b] - mean[b]);
+            }
+        }
+    }
+    // power iteration from the bounding box diagonal
+    uint8_t min[4], max[4];
+    block_bounds(block, min, max);
+    float axis[4] = {0};
+    for (uint32_t c = 0; c < channels; c++) { axis[c] = (float)(max[c] - min[c]) + 1.f; }
+    for (uint32_t iteration = 0; iteration < 8; iteration++) {
+        float next[4] = {0}, length = 0;
+        for (uint32_t a = 0; a < channels; a++) {
+            for (uint32_t b = 0; b < channels; b++) { next[a] += cov[a][b] * axis[b]; }
+            length = fmaxf(length, fabsf(next[a]));
+        }
+        if (length == 0) break;
+        for (uint32_t c = 0; c < channels; c++) { axis[c] = next[c] / length; }
+    }
+    float axisLength = 0;
+    for (uint32_t c = 0; c < channels; c++) { axisLength += axis[c] * axis[c]; }
+    float low = 0, high = 0;
+    for (uint32_t i = 0; i < 16; i++) {
+        if (opaqueOnly && block[4 * i + 3] < 128) continue;
+        float t = 0;
+        for (uint32_t c = 0; c < channels; c++) { t += (block[4 * i + c] - mean[c]) * axis[c]; }
+        low = fminf(low, t);
+        high = fmaxf(high, t);
+    }
+    for (uint32_t c = 0; c < channels; c++) {
+        float scale = axisLength > 0 ? axis[c] / axisLength : 0;
+        out_start[c] = (uint8_t)fminf(fmaxf(mean[c] + low * scale + .5f, 0), 255);
+        out_end[c] = (uint8_t)fminf(fmaxf(mean[c] + high * scale + .5f, 0), 255);
+    }
+    for (uint32_t c = channels; c < 4; c++) {
+        out_start[c] = 255;
+        out_end[c] = 255;
+    }
+}
+
+static uint32_t distance(uint8_t const *a, uint8_t const *b, uint32_t channels) {
+    uint32_t sum = 0;
+    for (uint32_t c = 0; c < channels; c++) {
+        int32_t d = (int32_t)a[c] - b[c];
+        sum += (uint32_t)(d * d);
+    }
+    return sum;
+}
+
+/*
+ * Palette is a whole multiple of 4 entries, those past count are read but never picked
+ */
+static uint32_t nearest(
+    uint8_t const *texel, uint8_t const (*palette)[4], uint32_t count, uint32_t channels) {
+    uint32_t best = 0, bestDistance = UINT32_MAX;
+#ifdef __SSE2__
+    // channels past channels are masked out, texel may end the block so only those are read
+    uint32_t value = 0, mask = channels >= 4 ? UINT32_MAX : (1u << 8 * channels) - 1;
+    memcpy(&value, texel, channels);
+    __m128i zero = _mm_setzero_si128();
+    __m128i channelMask = _mm_set1_epi32((int)mask);
+    __m128i t = _mm_unpacklo_epi8(_mm_set1_epi32((int)value), zero);
+    for (uint32_t i = 0; i < count; i += 4) {
+        __m128i p = _mm_and_si128(_mm_loadu_si128((__m128i const *)palette[i]), channelMask);
+        __m128i lo = _mm_sub_epi16(_mm_unpacklo_epi8(p, zero), t);
+        __m128i hi = _mm_sub_epi16(_mm_unpackhi_epi8(p, zero), t);
+        // squares summed by pairs of channels, then the two pairs of each entry
+        lo = _mm_madd_epi16(lo, lo);
+        hi = _mm_madd_epi16(hi, hi);
+        __m128 loPairs = _mm_castsi128_ps(lo), hiPairs = _mm_castsi128_ps(hi);
+        __m128 even = _mm_shuffle_ps(loPairs, hiPairs, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 odd = _mm_shuffle_ps(loPairs, hiPairs, _MM_SHUFFLE(3, 1, 3, 1));
+        uint32_t distances[4];
+        _mm_storeu_si128(
+            (__m128i *)distances, _mm_add_epi32(_mm_castps_si128(even), _mm_castps_si128(odd)));
+        for (uint32_t j = 0; j < 4 && i + j < count; j++) {
+            if (distances[j] < bestDistance) {
+                best = i + j;
+                bestDistance = distances[j];
+            }
+        }
+    }
+#else
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t d = distance(texel, palette[i], channels);
+        if (d < bestDistance) {
+            best = i;
+            bestDistance = d;
+        }
+    }
+#endif
+    return best;
+}
+
+static void put_u16(uint8_t *p, uint16_t value) {
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+}
+
+static uint16_t to_565(uint8_t const *c) {
+    return (uint16_t)((c[0] >> 3) << 11 | (c[1] >> 2) << 5 | c[2] >> 3);
+}
+
+static void from_565(uint16_t v, uint8_t *out_c) {
+    uint32_t r = v >> 11 & 31, g = v >> 5 & 63, b = v & 31;
+    out_c[0] = (uint8_t)(r << 3 | r >> 2);
+    out_c[1] = (uint8_t)(g << 2 | g >> 4);
+    out_c[2] = (uint8_t)(b << 3 | b >> 2);
+    out_c[3] = 255;
+}
+
+/*
+ * 8 bytes, transparent texels use 3 color mode with index 3 when punchThrough
+ */
+static void encode_bc1_color(uint8_t const *block, VkBool32 punchThrough, uint8_t *out) {
+    // transparent texels are not drawn, their color does not matter
+    uint8_t start[4], end[4];
+    fit_endpoints(block, 3, punchThrough, start, end);
+    uint16_t c0 = to_565(end), c1 = to_565(start);
+    // c0 > c1 selects 4 colors, c0 <= c1 selects 3 colors and transparent
+    if (punchThrough ? c0 > c1 : c0 < c1) {
+        uint16_t t = c0;
+        c0 = c1;
+        c1 = t;
+    }
+    uint8_t palette[4][4] = {{0}};
+    from_565(c0, palette[0]);
+    from_565(c1, palette[1]);
+    for (uint32_t c = 0; c < 3; c++) {
+        if (punchThrough) palette[2][c] = (uint8_t)((palette[0][c] + palette[1][c]) / 2);
+        else {
+            palette[2][c] = (uint8_t)((2 * palette[0][c] + palette[1][c]) / 3);
+            palette[3][c] = (uint8_t)((palette[0][c] + 2 * palette[1][c]) / 3);
+        }
+    }
+    uint32_t indices = 0;
+    for (uint32_t i = 0; i < 16; i++) {
+        uint8_t const *texel = block + 4 * i;
+        uint32_t index;
+        if (punchThrough && texel[3] < 128) index = 3;
+        else if (c0 == c1) index = 0;
+        else index = nearest(texel, (uint8_t const(*)[4])palette, punchThrough ? 3 : 4, 3);
+        indices |= index << (2 * i);
+    }
+    put_u16(out, c0);
+    put_u16(out + 2, c1);
+    for (uint32_t i = 0; i < 4; i++) { out[4 + i] = (uint8_t)(indices >> (8 * i)); }
+}
+
+static void encode_bc1(uint8_t const *block, uint8_t *out) {
+    VkBool32 punchThrough = VK_FALSE;
+    for (uint32_t i = 0; i < 16; i++) { punchThrough |= block[4 * i + 3] < 128; }
+    encode_bc1_color(block, punchThrough, out);
+}
+
+/*
+ * 16 bytes: 8 interpolated alpha values, then 4 color BC1
+ */
+static void encode_bc3(uint8_t const *block, uint8_t *out) {
+    uint8_t min[4], max[4];
+    block_bounds(block, min, max);
+    uint8_t a0 = max[3], a1 = min[3];
+    // a0 > a1 selects 6 interpolated values, a0 == a1 needs index 0 only
+    uint8_t palette[8][4] = {{a0}, {a1}};
+    for (uint32_t i = 1; i < 7; i++) {
+        palette[i + 1][0] = (uint8_t)(((7 - i) * a0 + i * a1) / 7);
+    }
+    uint64_t indices = 0;
+    for (uint32_t i = 0; a0 != a1 && i < 16; i++) {
+        uint64_t index = nearest(block + 4 * i + 3, (uint8_t const(*)[4])palette, 8, 1);
+        indices |= index << (3 * i);
+    }
+    out[0] = a0;
+    out[1] = a1;
+    for (uint32_t i = 0; i < 6; i++) { out[2 + i] = (uint8_t)(indices >> (8 * i)); }
+    encode_bc1_color(block, VK_FALSE, out + 8);
+}
+
+typedef struct BitWriter {
+    uint8_t *out; // zeroed
+    uint32_t position;
+} BitWriter;
+
+static void put_bits(BitWriter *writer, uint32_t value, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++, writer->position++) {
+        if (value >> i & 1)
+            writer->out[writer->position / 8] |= (uint8_t)(1 << writer->position % 8);
+    }
+}
+
+/*
+ * Endpoint of 7 bits per channel and shared lowest bit p, p minimizing the error
+ * Writes reconstructed endpoint into out_endpoint
+ */
+static void quantize_endpoint(
+    uint8_t const *endpoint, uint8_t *out_quantized, uint32_t *out_p, uint8_t *out_endpoint) {
+    uint32_t bestError = UINT32_MAX;
+    for (uint32_t p = 0; p < 2; p++) {
+        uint8_t quantized[4], reconstructed[4];
+        for (uint32_t c = 0; c < 4; c++) {
+            int32_t q = ((int32_t)endpoint[c] - (int32_t)p + 1) >> 1;
+            quantized[c] = (uint8_t)MIN(MAX(q, 0), 127);
+            reconstructed[c] = (uint8_t)(quantized[c] << 1 | p);
+        }
+        uint32_t error = distance(endpoint, reconstructed, 4);
+        if (error < bestError) {
+            bestError = error;
+            memcpy(out_quantized, quantized, 4);
+            memcpy(out_endpoint, reconstructed, 4);
+            *out_p = p;
+        }
+    }
+}
+
+/*
+ * Palette interpolated between endpoints with BC7 weights of 2 or 4 bit indices
+ * Writes index of nearest entry for each texel, returns total squared error
+ * Channels are [first, first + channels)
+ */
+static uint32_t bc7_indices(
+    uint8_t const *block, uint32_t first, uint32_t channels, uint8_t const (*endpoints)[4],
+    uint32_t indexBits, uint32_t *out_indices) {
+    static uint8_t const weights2[4] = {0, 21, 43, 64};
+    static uint8_t const weights4[16] = {0,  4,  9,  13, 17, 21, 26, 30,
+                                         34, 38, 43, 47, 51, 55, 60, 64};
+    uint8_t const *weights = indexBits == 2 ? weights2 : weights4;
+    uint32_t count = 1u << indexBits;
+    uint8_t palette[16][4] = {{0}};
+    for (uint32_t i = 0; i < count; i++) {
+        for (uint32_t c = 0; c < channels; c++) {
+            uint32_t e0 = endpoints[0][first + c], e1 = endpoints[1][first + c];
+            palette[i][c] = (uint8_t)(((64 - weights[i]) * e0 + weights[i] * e1 + 32) >> 6);
+        }
+    }
+    uint32_t error = 0;
+    for (uint32_t i = 0; i < 16; i++) {
+        uint8_t const *texel = block + 4 * i + first;
+        out_indices[i] = nearest(texel, (uint8_t const(*)[4])palette, count, channels);
+        error += distance(texel, palette[out_indices[i]], channels);
+    }
+    return error;
+}
+
+/*
+ * Anchor index has implicit zero top bit, so indices are flipped along with endpoints
+ */
+static void fix_anchor(
+    uint32_t *indices, uint32_t indexBits, uint8_t (*quantized)[4], uint32_t first,
+    uint32_t channels) {
+    uint32_t top = (1u << indexBits) - 1;
+    if (indices[0] <= top / 2) return;
+    for (uint32_t i = 0; i < 16; i++) { indices[i] = top - indices[i]; }
+    for (uint32_t c = first; c < first + channels; c++) {
+        uint8_t t = quantized[0][c];
+        quantized[0][c] = quantized[1][c];
+        quantized[1][c] = t;
+    }
+}
+
+/*
+ * Mode 6: one subset, RGBA endpoints with p bits, 16 indices of 4 bits
+ * Returns squared error
+ */
+static uint32_t encode_bc7_mode6(uint8_t const *block, uint8_t *out) {
+    uint8_t start[4], end[4];
+    fit_endpoints(block, 4, VK_FALSE, start, end);
+    uint8_t quantized[2][4], endpoints[2][4];
+    uint32_t p[2];
+    quantize_endpoint(start, quantized[0], p + 0, endpoints[0]);
+    quantize_endpoint(end, quantized[1], p + 1, endpoints[1]);
+    uint32_t indices[16];
+    uint32_t error = bc7_indices(block, 0, 4, (uint8_t const(*)[4])endpoints, 4, indices);
+    if (indices[0] >= 8) {
+        uint32_t t = p[0];
+        p[0] = p[1];
+        p[1] = t;
+    }
+    fix_anchor(indices, 4, quantized, 0, 4);
+    memset(out, 0, 16);
+    BitWriter writer = {.out = out, .position = 0};
+    put_bits(&writer, 1 << 6, 7);
+    for (uint32_t c = 0; c < 4; c++) {
+        put_bits(&writer, quantized[0][c], 7);
+        put_bits(&writer, quantized[1][c], 7);
+    }
+    put_bits(&writer, p[0], 1);
+    put_bits(&writer, p[1], 1);
+    put_bits(&writer, indices[0], 3);
+    for (uint32_t i = 1; i < 16; i++) { put_bits(&writer, indices[i], 4); }
+    return error;
+}
+
+/*
+ * Mode 5: one subset, RGB endpoints of 7 bits and alpha of 8 bits
+ *  with separate 2 bit indices, for alpha not following color
+ * Returns squared error
+ */
+static uint32_t encode_bc7_mode5(uint8_t const *block, uint8_t *out) {
+    uint8_t start[4], end[4], min[4], max[4];
+    fit_endpoints(block, 3, VK_FALSE, start, end);
+    block_bounds(block, min, max);
+    uint8_t quantized[2][4], endpoints[2][4];
+    for (uint32_t c = 0; c < 3; c++) {
+        quantized[0][c] = (uint8_t)((start[c] * 127 + 127) / 255);
+        quantized[1][c] = (uint8_t)((end[c] * 127 + 127) / 255);
+        for (uint32_t e = 0; e < 2; e++) {
+            endpoints[e][c] = (uint8_t)(quantized[e][c] << 1 | quantized[e][c] >> 6);
+        }
+    }
+    quantized[0][3] = endpoints[0][3] = min[3];
+    quantized[1][3] = endpoints[1][3] = max[3];
+    uint32_t colorIndices[16], alphaIndices[16];
+    uint32_t error = bc7_indices(block, 0, 3, (uint8_t const(*)[4])endpoints, 2, colorIndices) +
+                     bc7_indices(block, 3, 1, (uint8_t const(*)[4])endpoints, 2, alphaIndices);
+    fix_anchor(colorIndices, 2, quantized, 0, 3);
+    fix_anchor(alphaIndices, 2, quantized, 3, 1);
+    memset(out, 0, 16);
+    BitWriter writer = {.out = out, .position = 0};
+    put_bits(&writer, 1 << 5, 6);
+    put_bits(&writer, 0, 2); // no channel rotation
+    for (uint32_t c = 0; c < 3; c++) {
+        put_bits(&writer, quantized[0][c], 7);
+        put_bits(&writer, quantized[1][c], 7);
+    }
+    put_bits(&writer, quantized[0][3], 8);
+    put_bits(&writer, quantized[1][3], 8);
+    uint32_t const *indices[2] = {colorIndices, alphaIndices};
+    for (uint32_t set = 0; set < 2; set++) {
+        put_bits(&writer, indices[set][0], 1);
+        for (uint32_t i = 1; i < 16; i++) { put_bits(&writer, indices[set][i], 2); }
+    }
+    return error;
+}
+
+/*
+ * 16 bytes, mode 6 or mode 5 whichever is closer
+ */
+static void encode_bc7(uint8_t const *block, uint8_t *out) {
+    uint8_t mode5[16];
+    uint32_t error6 = encode_bc7_mode6(block, out);
+    if (error6 == 0) return;
+    if (encode_bc7_mode5(block, mode5) < error6) memcpy(out, mode5, 16);
+}
+
+static void encode_level(
+    BcFormat format, uint8_t const *texels, VkExtent2D extent, uint8_t *out_blocks) {
+    uint32_t blockSize = texel_block(vkFormats[format]).size;
+    uint8_t block[64];
+    for (uint32_t y = 0; y < extent.height; y += 4) {
+        for (uint32_t x = 0; x < extent.width; x += 4) {
+            fetch_block(texels, extent, x, y, block);
+            switch (format) {
+            case BC_1: encode_bc1(block, out_blocks); break;
+            case BC_3: encode_bc3(block, out_blocks); break;
+            default: encode_bc7(block, out_blocks); break;
+            }
+            out_blocks += blockSize;
+        }
+    }
+}
+
+/*
+ * BC1 if alpha is only 0 or 255, BC7 otherwise
+ */
+static BcFormat pick_format(uint8_t const *texels, size_t texelCount) {
+    for (size_t i = 0; i < texelCount; i++) {
+        uint8_t alpha = texels[4 * i + 3];
+        if (alpha != 0 && alpha != 255) return BC_7;
+    }
+    return BC_1;
+}
+
+/*
+ * 0 on success
+ * 1 on failure
+ */
+static int compress_file(char const *path, BcFormat format) {
+    uint8_t *texels;
+    uint32_t width, height;
+    uint32_t error = lodepng_decode32_file(&texels, &width, &height, path);
+    if (error) {
+        eprintff(MSG_ERRORF("cannot load image '%s': %s"), path, lodepng_error_text(error));
+        return 1;
+    }
+    if (format == BC_AUTO) format = pick_format(texels, (size_t)width * height);
+    VkFormat vkFormat = vkFormats[format];
+    uint32_t levels = mip_level_count(width, height);
+    VkDeviceSize rgbaSize = mip_chain_size(VK_FORMAT_R8G8B8A8_SRGB, width, height, levels);
+    uint8_t *chain = realloc(texels, rgbaSize);
+    ADdsImage image = {
+        .width = width,
+        .height = height,
+        .mipLevels = levels,
+        .format = vkFormat,
+        .size = mip_chain_size(vkFormat, width, height, levels)};
+    image.data = malloc(image.size);
+    int res = 1;
+    if (chain == NULL || image.data == NULL) {
+        eprintff(MSG_ERRORF("cannot allocate mip chain of '%s'"), path);
+        goto done;
+    }
+    texels = chain;
+    VkDeviceSize level0Size = (VkDeviceSize)width * height * 4;
+    if (generate_mip_chain_srgb(texels, width, height, levels, texels + level0Size) != 0) goto done;
+    for (uint32_t level = 0; level < levels; level++) {
+        uint8_t const *src =
+            texels + mip_chain_size(VK_FORMAT_R8G8B8A8_SRGB, width, height, level);
+        uint8_t *dst = image.data + mip_chain_size(vkFormat, width, height, level);
+        encode_level(format, src, mip_extent(width, height, level), dst);
+    }
+
+    size_t length = strlen(path);
+    ARR_ALLOC(char, ddsPath, length + 5);
+    memcpy(ddsPath, path, length + 1);
+    if (length > 4 && strcmp(path + length - 4, ".png") == 0) length -= 4;
+    memcpy(ddsPath + length, ".dds", 5);
+    res = write_dds(ddsPath, &image);
+    if (res == 0) {
+        printf(
+            "%s: %ux%u %s, %u levels, %.1f KiB -> %.1f KiB\n", ddsPath, width, height,
+            formatNames[format], levels, rgbaSize / 1024., image.size / 1024.);
+    }
+    free(ddsPath);
+done:
+    free(image.data);
+    free(texels);
+    return res;
+}
+
+/*
+ * 0 on success
+ * 1 if any file failed
+ */
+static int compress_dir(char const *dir, BcFormat format) {
+    DIR *handle = opendir(dir);
+    if (handle == NULL) {
+        eprintff(MSG_ERRORF("cannot open directory '%s'"), dir);
+        return 1;
+    }
+    int res = 0;
+    struct dirent *entry;
+    while ((entry = readdir(handle)) != NULL) {
+        size_t nameLength = strlen(entry->d_name);
+        if (nameLength < 5 || strcmp(entry->d_name + nameLength - 4, ".png") != 0) continue;
+        size_t pathSize = strlen(dir) + 1 + nameLength + 1;
+        ARR_ALLOC(char, path, pathSize);
+        snprintf(path, pathSize, "%s/%s", dir, entry->d_name);
+        res |= compress_file(path, format);
+        free(path);
+    }
+    closedir(handle);
+    return res;
+}
+
+int main(int argc, char **argv) {
+    BcFormat format = BC_AUTO;
+    int res = 0, inputs = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            i++;
+            format = BC_AUTO;
+            while (format <= BC_7 && strcmp(formatNames[format], argv[i]) != 0) { format++; }
+            if (format > BC_7) {
+                eprintff(MSG_ERRORF("unknown format '%s'"), argv[i]);
+                return 2;
+            }
+            continue;
+        }
+        struct stat st;
+        if (stat(argv[i], &st) != 0) {
+            eprintff(MSG_ERRORF("cannot stat '%s'"), argv[i]);
+            res = 1;
+        }
+        else if (S_ISDIR(st.st_mode)) res |= compress_dir(argv[i], format);
+        else res |= compress_file(argv[i], format);
+        inputs++;
+    }
+    if (inputs == 0) {
+        fprintf(stderr, "usage: %s [-f auto|bc1|bc3|bc7] <png or directory>...\n", argv[0]);
+        return 2;
+    }
+    return res;
+}
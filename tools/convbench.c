@@ -0,0 +1,190 @@
+/*
+ * Benchmark of texel conversion kernels against plain scalar loops
+ * Checks that both give the same bytes, then prints best of a few runs
+ * Build with -march=native to get AVX2 kernels
+ */
+#include "convert.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define RUNS 20
+
+static ASrgbTables tables;
+static uint8_t const bgra[4] = {2, 1, 0, 3};
+
+// reference loops, same results as convert.c by construction, not by sharing code
+
+static void ref_rgb_to_rgba(void *dst, void const *src, size_t texels) {
+    uint8_t *d = dst;
+    uint8_t const *s = src;
+    for (size_t i = 0; i < texels; i++) {
+        for (uint32_t c = 0; c < 3; c++) { d[4 * i + c] = s[3 * i + c]; }
+        d[4 * i + 3] = 255;
+    }
+}
+
+static void ref_premultiply(void *dst, void const *src, size_t texels) {
+    uint8_t *d = dst;
+    uint8_t const *s = src;
+    for (size_t i = 0; i < texels; i++) {
+        uint32_t a = s[4 * i + 3];
+        for (uint32_t c = 0; c < 3; c++) {
+            d[4 * i + c] = (uint8_t)((s[4 * i + c] * a + 127) / 255);
+        }
+        d[4 * i + 3] = (uint8_t)a;
+    }
+}
+
+static void ref_srgb_to_linear(void *dst, void const *src, size_t texels) {
+    uint16_t *d = dst;
+    uint8_t const *s = src;
+    for (size_t i = 0; i < texels; i++) {
+        for (uint32_t c = 0; c < 3; c++) { d[4 * i + c] = tables.toLinear[s[4 * i + c]]; }
+        d[4 * i + 3] = (uint16_t)(s[4 * i + 3] * 257);
+    }
+}
+
+static void ref_linear_to_srgb(void *dst, void const *src, size_t texels) {
+    uint8_t *d = dst;
+    uint16_t const *s = src;
+    for (size_t i = 0; i < texels; i++) {
+        for (uint32_t c = 0; c < 3; c++) { d[4 * i + c] = tables.toSrgb[s[4 * i + c] >> 4]; }
+        d[4 * i + 3] = (uint8_t)((s[4 * i + 3] + 128) / 257);
+    }
+}
+
+static void ref_swizzle(void *dst, void const *src, size_t texels) {
+    uint8_t *d = dst;
+    uint8_t const *s = src;
+    for (size_t i = 0; i < texels; i++) {
+        for (uint32_t c = 0; c < 4; c++) { d[4 * i + c] = s[4 * i + bgra[c]]; }
+    }
+}
+
+static void ref_pack_rg(void *dst, void const *src, size_t texels) {
+    uint8_t *d = dst;
+    uint8_t const *s = src;
+    for (size_t i = 0; i < texels; i++) {
+        for (uint32_t c = 0; c < 2; c++) { d[2 * i + c] = s[4 * i + c]; }
+    }
+}
+
+static void ref_pack_r(void *dst, void const *src, size_t texels) {
+    uint8_t *d = dst;
+    uint8_t const *s = src;
+    for (size_t i = 0; i < texels; i++) { d[i] = s[4 * i]; }
+}
+
+static void rgb_to_rgba(void *dst, void const *src, size_t texels) {
+    convert_rgb_to_rgba(dst, src, texels);
+}
+
+static void premultiply(void *dst, void const *src, size_t texels) {
+    premultiply_alpha(dst, src, texels);
+}
+
+static void srgb_to_linear(void *dst, void const *src, size_t texels) {
+    convert_srgb_to_linear(&tables, dst, src, texels);
+}
+
+static void linear_to_srgb(void *dst, void const *src, size_t texels) {
+    convert_linear_to_srgb(&tables, dst, src, texels);
+}
+
+static void swizzle(void *dst, void const *src, size_t texels) {
+    swizzle_rgba(dst, src, texels, bgra);
+}
+
+static void pack_rg(void *dst, void const *src, size_t texels) {
+    pack_rgba_to_rg(dst, src, texels);
+}
+
+static void pack_r(void *dst, void const *src, size_t texels) {
+    pack_rgba_to_r(dst, src, texels);
+}
+
+typedef void (*Kernel)(void *dst, void const *src, size_t texels);
+
+typedef struct Bench {
+    char const *name;
+    uint32_t srcTexelSize;
+    uint32_t dstTexelSize;
+    Kernel kernel;
+    Kernel reference;
+} Bench;
+
+static Bench const benches[] = {
+    {"rgb_to_rgba",    3, 4, rgb_to_rgba,    ref_rgb_to_rgba   },
+    {"premultiply",    4, 4, premultiply,    ref_premultiply   },
+    {"srgb_to_linear", 4, 8, srgb_to_linear, ref_srgb_to_linear},
+    {"linear_to_srgb", 8, 4, linear_to_srgb, ref_linear_to_srgb},
+    {"swizzle_bgra",   4, 4, swizzle,        ref_swizzle       },
+    {"pack_rg",        4, 2, pack_rg,        ref_pack_rg       },
+    {"pack_r",         4, 1, pack_r,         ref_pack_r        },
+};
+
+static double now(void) {
+    struct timespec t;
+    timespec_get(&t, TIME_UTC);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/*
+ * Best time of RUNS calls in seconds
+ */
+static double best_time(Kernel kernel, void *dst, void const *src, size_t texels) {
+    double best = 1e30;
+    for (uint32_t run = 0; run < RUNS; run++) {
+        double start = now();
+        kernel(dst, src, texels);
+        best = MIN(best, now() - start);
+    }
+    return best;
+}
+
+int main(int argc, char **argv) {
+    // odd count, so scalar tails of every kernel are covered
+    size_t texels = argc > 1 ? strtoull(argv[1], NULL, 10) : 1024 * 1024 + 7;
+    if (texels == 0) {
+        fprintf(stderr, "usage: %s [texel count]\n", argv[0]);
+        return 2;
+    }
+    init_srgb_tables(&tables);
+    ARR_ALLOC(uint8_t, src, texels * 8);
+    ARR_ALLOC(uint8_t, dst, texels * 8);
+    ARR_ALLOC(uint8_t, expected, texels * 8);
+    if (src == NULL || dst == NULL || expected == NULL) {
+        eprintff(MSG_ERRORF("cannot allocate %zu texels"), texels);
+        return 1;
+    }
+    srand(1);
+    for (size_t i = 0; i < texels * 8; i++) { src[i] = (uint8_t)rand(); }
+    int res = 0;
+    printf("%zu texels, best of %d runs\n", texels, RUNS);
+    printf("%-16s %10s %10s %8s\n", "kernel", "scalar MB/s", "simd MB/s", "speedup");
+    for (uint32_t i = 0; i < ARR_LEN(benches); i++) {
+        Bench const *bench = benches + i;
+        size_t dstSize = texels * bench->dstTexelSize;
+        bench->reference(expected, src, texels);
+        memset(dst, 0, dstSize);
+        bench->kernel(dst, src, texels);
+        if (memcmp(dst, expected, dstSize) != 0) {
+            eprintff(MSG_ERRORF("%s differs from scalar loop"), bench->name);
+            res = 1;
+        }
+        double scalar = best_time(bench->reference, expected, src, texels);
+        double simd = best_time(bench->kernel, dst, src, texels);
+        // bytes read and written
+        double bytes = (double)texels * (bench->srcTexelSize + bench->dstTexelSize);
+        printf(
+            "%-16s %10.0f %10.0f %7.2fx\n", bench->name, bytes / scalar / 1e6, bytes / simd / 1e6,
+            scalar / simd);
+    }
+    free(expected);
+    free(dst);
+    free(src);
+    return res;
+}
@@ -0,0 +1,129 @@
+/*
+ * Packs compiled shaders into one archive, see shader_archive.h
+ * Usage: shpack <archive> <name.stage.spv>...
+ * Entries are named after the files without directory and .spv,
+ *  stage comes from the extension before .spv
+ */
+#include "shader_archive.h"
+#include "utils.h"
+#include <stdio.h>
+#include <string.h>
+
+typedef struct StageExtension {
+    char const *extension;
+    VkShaderStageFlagBits stage;
+} StageExtension;
+
+static StageExtension const stages[] = {
+    {".vert", VK_SHADER_STAGE_VERTEX_BIT                 },
+    {".frag", VK_SHADER_STAGE_FRAGMENT_BIT               },
+    {".comp", VK_SHADER_STAGE_COMPUTE_BIT                },
+    {".geom", VK_SHADER_STAGE_GEOMETRY_BIT               },
+    {".tesc", VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT   },
+    {".tese", VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT},
+};
+
+/*
+ * Fills name and stage of entry from path
+ * 0 on success
+ * 1 on failure
+ */
+static int name_entry(char const *path, AShaderArchiveEntry *entry) {
+    char const *slash = strrchr(path, '/');
+    char const *name = slash == NULL ? path : slash + 1;
+    size_t length = strlen(name);
+    if (length < 4 || strcmp(name + length - 4, ".spv") != 0) return 1;
+    length -= 4;
+    if (length >= A_SHADER_NAME_SIZE) return 1;
+    memcpy(entry->name, name, length);
+    entry->name[length] = '\0';
+    char const *extension = strrchr(entry->name, '.');
+    if (extension == NULL) return 1;
+    for (uint32_t i = 0; i < ARR_LEN(stages); i++) {
+        if (strcmp(extension, stages[i].extension) != 0) continue;
+        entry->stage = stages[i].stage;
+        return 0;
+    }
+    return 1;
+}
+
+static void *read_whole(char const *path, size_t *out_size) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) return NULL;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    void *data = size > 0 ? malloc((size_t)size) : NULL;
+    if (data != NULL && fread(data, (size_t)size, 1, file) != 1) {
+        free(data);
+        data = NULL;
+    }
+    fclose(file);
+    *out_size = (size_t)size;
+    return data;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <archive> <name.stage.spv>...\n", argv[0]);
+        return 2;
+    }
+    uint32_t count = (uint32_t)(argc - 2);
+    AShaderArchiveEntry *entries = calloc(MAX(count, 1u), sizeof(*entries));
+    void **blobs = calloc(MAX(count, 1u), sizeof(*blobs));
+    int res = 1;
+    if (entries == NULL || blobs == NULL) {
+        eprintff(MSG_ERRORF("cannot allocate %u entries"), count);
+        goto done;
+    }
+    // index follows the 16-byte header, blobs follow the index
+    size_t offset = sizeof(AShaderArchiveHeader) + count * sizeof(AShaderArchiveEntry);
+    for (uint32_t i = 0; i < count; i++) {
+        char const *path = argv[i + 2];
+        if (name_entry(path, entries + i) != 0) {
+            eprintff(MSG_ERRORF("'%s' is not named like name.stage.spv"), path);
+            goto done;
+        }
+        for (uint32_t j = 0; j < i; j++) {
+            if (strcmp(entries[j].name, entries[i].name) != 0) continue;
+            eprintff(MSG_ERRORF("'%s' is given twice"), entries[i].name);
+            goto done;
+        }
+        size_t size = 0;
+        blobs[i] = read_whole(path, &size);
+        if (blobs[i] == NULL || size % 4 != 0) {
+            eprintff(MSG_ERRORF("cannot read SPIR-V from '%s'"), path);
+            goto done;
+        }
+        offset = ALIGN_UP(offset, 4);
+        if (offset + size > UINT32_MAX) {
+            eprintff(MSG_ERRORF("archive does not fit in 4 GiB"));
+            goto done;
+        }
+        entries[i].offset = (uint32_t)offset;
+        entries[i].size = (uint32_t)size;
+        offset += size;
+    }
+    char const *archivePath = argv[1];
+    FILE *file = fopen(archivePath, "wb");
+    if (file == NULL) {
+        eprintff(MSG_ERRORF("cannot open '%s' for writing"), archivePath);
+        goto done;
+    }
+    AShaderArchiveHeader header = {
+        .magic = A_SHADER_ARCHIVE_MAGIC, .version = A_SHADER_ARCHIVE_VERSION, .count = count};
+    res = fwrite(&header, sizeof(header), 1, file) != 1;
+    if (count > 0 && fwrite(entries, sizeof(*entries) * count, 1, file) != 1) res = 1;
+    // sizes are multiples of 4, so aligned offsets leave no gaps
+    for (uint32_t i = 0; i < count && res == 0; i++) {
+        if (fwrite(blobs[i], entries[i].size, 1, file) != 1) res = 1;
+    }
+    if (fclose(file) != 0) res = 1;
+    if (res != 0) eprintff(MSG_ERRORF("cannot write '%s'"), archivePath);
+    else printf("%s: %u shaders, %zu bytes\n", archivePath, count, offset);
+done:
+    for (uint32_t i = 0; i < count && blobs != NULL; i++) { free(blobs[i]); }
+    free(blobs);
+    free(entries);
+    return res;
+}